@@ -1,9 +1,12 @@
 #ifndef __NC_JSON_H__
 #define __NC_JSON_H__
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <cmath>
 #include <cstring>
 
@@ -58,6 +61,9 @@ private:
 #define JSON_TSTRING(type) basic_string<type>
 #endif
 
+/* String type of ValueT<type, alloc>: alloc rebound to type. */
+#define JSON_TSTRING_A(type, alloc) basic_string<type, char_traits<type>, JSON::detail::json_rebind<alloc, type>>
+
 #define JSON_CHECK_TYPE(type, except)                                                           \
     JSON_INTERNAL_ASSERT_CHECK_EX (type == except, "Type error: except(%s), actual(%s)",        \
                                                     get_type_name(except),                      \
@@ -73,6 +79,10 @@ private:
 
 namespace JSON {
     namespace detail {
+        /** alloc_t rebound to T. */
+        template<class alloc_t, class T>
+        using json_rebind = typename std::allocator_traits<alloc_t>::template rebind_alloc<T>;
+
         template<bool, typename T = void>
         struct json_enable_if
         {
@@ -247,15 +257,113 @@ namespace JSON {
 
     inline const char* get_type_name (int type);
 
+    /** Error code of the non-throwing parse API. */
+    enum ParseError
+    {
+        PARSE_OK = 0,
+        PARSE_UNEXPECTED_END,       // Input ended inside a value
+        PARSE_UNEXPECTED_CHARACTER, // Character not allowed at this position
+        PARSE_INVALID_LITERAL,      // Not true, false or null
+        PARSE_INVALID_NUMBER,       // Malformed number
+        PARSE_INVALID_ESCAPE,       // Malformed escape sequence in a string
+        PARSE_NOT_CONTAINER,        // Topmost value is not an object/array
+        PARSE_INVALID_UTF8          // Malformed UTF-8 in a string
+    };
+
+    inline const char* get_parse_error_name (int error);
+
+    /**
+            Transcode UTF-8 to wchar_t (UTF-16 or UTF-32, as wide as wchar_t
+            is), appending to out.
+            Return char count consumed, less than len if malformed UTF-8
+            starts at that offset.
+        */
+    template<class S>
+    inline size_t utf8_to_wide (const char* in, size_t len, std::basic_string<wchar_t, std::char_traits<wchar_t>, S>& out);
+
+    /**
+            Transcode wchar_t (UTF-16 or UTF-32) to UTF-8, appending to out.
+            Return wchar_t count consumed, less than len if a lone surrogate
+            or an invalid code point is at that offset.
+        */
+    template<class S>
+    inline size_t wide_to_utf8 (const wchar_t* in, size_t len, std::basic_string<char, std::char_traits<char>, S>& out);
+
+    /** Result of a non-throwing parse: error code, and the char_t offset the
+        error was detected at (the count parsed on success). */
+    struct ParseResult
+    {
+        ParseError error;
+        size_t     offset;
+
+        ParseResult (ParseError error_ = PARSE_OK, size_t offset_ = 0)
+            : error (error_)
+            , offset (offset_)
+        {
+        }
+
+        inline bool ok () const
+        {
+            return error == PARSE_OK;
+        }
+    };
+
+    /** How WriteOptions writes non-ASCII characters. */
+    enum Ascii
+    {
+        ASCII_DEFAULT, /* Escaped by wchar_t writers (as ValueW always did),
+                          written as is by char writers and if canonical. */
+        ASCII_ESCAPE,  /* Escape every non-ASCII character as \uXXXX. */
+        ASCII_RAW      /* Write non-ASCII characters as they are. */
+    };
+
+    /** Options of ValueT::write/WriterT. Default is compact output. */
+    struct WriteOptions
+    {
+        unsigned indent;    /* Spaces per nesting level, 0 for compact output. */
+        bool     canonical; /* RFC 8785 (JCS): keys in UTF-16 order, shortest
+                               round-trip floats, minimal escaping. */
+        Ascii    ascii;
+
+        WriteOptions (unsigned indent_ = 0, bool canonical_ = false, Ascii ascii_ = ASCII_DEFAULT)
+            : indent (indent_)
+            , canonical (canonical_)
+            , ascii (ascii_)
+        {
+        }
+    };
+
+    /** Options of ValueT::read/parse and EventReaderT. Default converts
+        every number while it is read. */
+    struct ReadOptions
+    {
+        bool raw_numbers; /* Keep numbers as their text, converted on the first
+                             i ()/f (). write () emits the text unchanged while
+                             the value is, so big integers and long decimals
+                             pass through exactly. */
+
+        ReadOptions (bool raw_numbers_ = false)
+            : raw_numbers (raw_numbers_)
+        {
+        }
+    };
+
     // Forward declaration
-    template<class char_t>
+    template<class char_t, class alloc_t = std::allocator<char_t>>
     class ValueT;
+    template<class char_t>
+    class FrozenT;
+    template<class char_t>
+    class EventReaderT;
 
     /** A JSON object, i.e., a container whose keys are strings, this
         is roughly equivalent to a Python dictionary, a PHP's associative
         array, a Perl or a C++ map (depending on the implementation). */
-    template<class char_t>
-    class ObjectT : public std::map<JSON_TSTRING (char_t), ValueT<char_t>>
+    template<class char_t, class alloc_t = std::allocator<char_t>>
+    class ObjectT : public std::map<JSON_TSTRING_A (char_t, alloc_t),
+                                    ValueT<char_t, alloc_t>,
+                                    std::less<JSON_TSTRING_A (char_t, alloc_t)>,
+                                    detail::json_rebind<alloc_t, std::pair<const JSON_TSTRING_A (char_t, alloc_t), ValueT<char_t, alloc_t>>>>
     {
     };
 
@@ -264,20 +372,26 @@ namespace JSON {
 
     /** A JSON array, i.e., an indexed container of elements. It contains
         JSON values, that can have any of the types in ValueType. */
-    template<class char_t>
-    class ArrayT : public std::vector<ValueT<char_t>>
+    template<class char_t, class alloc_t = std::allocator<char_t>>
+    class ArrayT : public std::vector<ValueT<char_t, alloc_t>, detail::json_rebind<alloc_t, ValueT<char_t, alloc_t>>>
     {
     };
 
     using Array  = ArrayT<char>;
     using ArrayW = ArrayT<wchar_t>;
 
-    /** A JSON value. Can have either type in ValueTypes. */
-    template<class char_t>
+    /** A JSON value. Can have either type in ValueTypes.
+
+        alloc_t is rebound for strings, object nodes and array storage. Nodes
+        are created with default-constructed allocators, so alloc_t must be
+        stateless or keep its state elsewhere (a global or thread-local arena),
+        and every instance must compare equal. */
+    template<class char_t, class alloc_t>
     class ValueT
     {
     public:
-        using tstring = JSON_TSTRING (char_t);
+        using tstring        = JSON_TSTRING_A (char_t, alloc_t);
+        using allocator_type = alloc_t;
 
         /** Default constructor (type = NIL). */
         ValueT ()
@@ -289,7 +403,11 @@ namespace JSON {
         ValueT (Type type);
 
         /** Copy constructor. */
-        ValueT (const ValueT<char_t>& v);
+        ValueT (const ValueT<char_t, alloc_t>& v);
+
+        /** Deep copy of a value held with another allocator. */
+        template<class other_alloc_t>
+        explicit ValueT (const ValueT<char_t, other_alloc_t>& v);
 
         /** Constructor from integer. */
     #define JSON_INTEGER_CTOR(type) \
@@ -353,14 +471,14 @@ namespace JSON {
         }
 
         /** Constructor from pointer to Object. */
-        ValueT (const ObjectT<char_t>& o)
+        ValueT (const ObjectT<char_t, alloc_t>& o)
             : _type (OBJECT)
             , _object (o)
         {
         }
 
         /** Constructor from pointer to Array. */
-        ValueT (const ArrayT<char_t>& a)
+        ValueT (const ArrayT<char_t, alloc_t>& a)
             : _type (ARRAY)
             , _array (a)
         {
@@ -368,7 +486,7 @@ namespace JSON {
 
     #ifdef __ENABLE_CXX11__
         /** Move constructor. */
-        ValueT (ValueT<char_t>&& v) noexcept
+        ValueT (ValueT<char_t, alloc_t>&& v) noexcept
             : _type (v._type)
         {
             assign (JSON_MOVE (v));
@@ -383,14 +501,14 @@ namespace JSON {
         }
 
         /** Move constructor from pointer to Object. */
-        ValueT (ObjectT<char_t>&& o)
+        ValueT (ObjectT<char_t, alloc_t>&& o)
             : _type (OBJECT)
             , _object (JSON_MOVE (o))
         {
         }
 
         /** Move constructor from pointer to Array. */
-        ValueT (ArrayT<char_t>&& a)
+        ValueT (ArrayT<char_t, alloc_t>&& a)
             : _type (ARRAY)
             , _array (JSON_MOVE (a))
         {
@@ -398,7 +516,7 @@ namespace JSON {
     #endif
 
         /** Assign function. */
-        void assign (const ValueT<char_t>& v);
+        void assign (const ValueT<char_t, alloc_t>& v);
 
         /** Assign function from integer. */
         template<class T>
@@ -461,7 +579,7 @@ namespace JSON {
 
         /** Assign function from pointer to Object. */
         inline void
-        assign (const ObjectT<char_t>& o)
+        assign (const ObjectT<char_t, alloc_t>& o)
         {
             clear ();
             _type   = OBJECT;
@@ -470,7 +588,7 @@ namespace JSON {
 
         /** Assign function from pointer to Array. */
         inline void
-        assign (const ArrayT<char_t>& a)
+        assign (const ArrayT<char_t, alloc_t>& a)
         {
             clear ();
             _type  = ARRAY;
@@ -479,7 +597,7 @@ namespace JSON {
 
     #ifdef __ENABLE_CXX11__
         /** Assign function. */
-        void assign (ValueT<char_t>&& v);
+        void assign (ValueT<char_t, alloc_t>&& v);
 
         /** Assign function from STD string  */
         inline void
@@ -493,7 +611,7 @@ namespace JSON {
 
         /** Assign function from pointer to Object. */
         inline void
-        assign (ObjectT<char_t>&& o)
+        assign (ObjectT<char_t, alloc_t>&& o)
         {
             clear ();
             _type   = OBJECT;
@@ -502,7 +620,7 @@ namespace JSON {
 
         /** Assign function from pointer to Array. */
         inline void
-        assign (ArrayT<char_t>&& a)
+        assign (ArrayT<char_t, alloc_t>&& a)
         {
             clear ();
             _type  = ARRAY;
@@ -511,8 +629,8 @@ namespace JSON {
     #endif
 
         /** Assignment operator. */
-        inline ValueT<char_t>&
-        operator= (const ValueT<char_t>& v)
+        inline ValueT<char_t, alloc_t>&
+        operator= (const ValueT<char_t, alloc_t>& v)
         {
             if (this != &v)
             {
@@ -529,29 +647,29 @@ namespace JSON {
 
         /** Assignment operator from int/float/bool. */
         template<class T>
-        inline typename detail::json_enable_if<detail::json_is_arithmetic<T>::value, ValueT<char_t>&>::type
+        inline typename detail::json_enable_if<detail::json_is_arithmetic<T>::value, ValueT<char_t, alloc_t>&>::type
         operator= (T a) JSON_ASSIGNMENT (a)
 
             /** Assignment operator from pointer to char (C-string).  */
-            inline ValueT<char_t>&
+            inline ValueT<char_t, alloc_t>&
             operator= (const char_t* s) JSON_ASSIGNMENT (s)
 
             /** Assignment operator from STD string  */
-            inline ValueT<char_t>&
+            inline ValueT<char_t, alloc_t>&
             operator= (const tstring& s) JSON_ASSIGNMENT (s)
 
             /** Assignment operator from pointer to Object. */
-            inline ValueT<char_t>&
-            operator= (const ObjectT<char_t>& o) JSON_ASSIGNMENT (o)
+            inline ValueT<char_t, alloc_t>&
+            operator= (const ObjectT<char_t, alloc_t>& o) JSON_ASSIGNMENT (o)
 
             /** Assignment operator from pointer to Array. */
-            inline ValueT<char_t>&
-            operator= (const ArrayT<char_t>& a) JSON_ASSIGNMENT (a)
+            inline ValueT<char_t, alloc_t>&
+            operator= (const ArrayT<char_t, alloc_t>& a) JSON_ASSIGNMENT (a)
 
     #ifdef __ENABLE_CXX11__
             /** Assignment operator. */
-            inline ValueT<char_t>&
-            operator= (ValueT<char_t>&& v) noexcept
+            inline ValueT<char_t, alloc_t>&
+            operator= (ValueT<char_t, alloc_t>&& v) noexcept
         {
             if (this != &v)
             {
@@ -561,16 +679,16 @@ namespace JSON {
         }
 
         /** Assignment operator from STD string  */
-        inline ValueT<char_t>&
+        inline ValueT<char_t, alloc_t>&
         operator= (tstring&& s) JSON_ASSIGNMENT (JSON_MOVE (s))
 
             /** Assignment operator from pointer to Object. */
-            inline ValueT<char_t>&
-            operator= (ObjectT<char_t>&& o) JSON_ASSIGNMENT (JSON_MOVE (o))
+            inline ValueT<char_t, alloc_t>&
+            operator= (ObjectT<char_t, alloc_t>&& o) JSON_ASSIGNMENT (JSON_MOVE (o))
 
             /** Assignment operator from pointer to Array. */
-            inline ValueT<char_t>&
-            operator= (ArrayT<char_t>&& a) JSON_ASSIGNMENT (JSON_MOVE (a))
+            inline ValueT<char_t, alloc_t>&
+            operator= (ArrayT<char_t, alloc_t>&& a) JSON_ASSIGNMENT (JSON_MOVE (a))
     #endif
 
         /** Type query. */
@@ -584,6 +702,7 @@ namespace JSON {
         inline operator type () const         \
         {                                     \
             JSON_CHECK_TYPE (_type, INTEGER); \
+            load_number ();                   \
             return _integer;                  \
         }
 
@@ -604,6 +723,7 @@ namespace JSON {
         inline operator type () const       \
         {                                   \
             JSON_CHECK_TYPE (_type, FLOAT); \
+            load_number ();                 \
             return _float;                  \
         }
 
@@ -626,14 +746,14 @@ namespace JSON {
         }
 
         /** Cast operator for Object */
-        inline operator ObjectT<char_t> () const
+        inline operator ObjectT<char_t, alloc_t> () const
         {
             JSON_CHECK_TYPE (_type, OBJECT);
             return _object;
         }
 
         /** Cast operator for Array */
-        inline operator ArrayT<char_t> () const
+        inline operator ArrayT<char_t, alloc_t> () const
         {
             JSON_CHECK_TYPE (_type, ARRAY);
             return _array;
@@ -648,6 +768,7 @@ namespace JSON {
                 _integer = 0;
             }
             JSON_CHECK_TYPE (_type, INTEGER);
+            load_number ();
             return _integer;
         }
 
@@ -656,6 +777,7 @@ namespace JSON {
         i () const
         {
             JSON_CHECK_TYPE (_type, INTEGER);
+            load_number ();
             return _integer;
         }
 
@@ -668,6 +790,7 @@ namespace JSON {
                 _float = 0;
             }
             JSON_CHECK_TYPE (_type, FLOAT);
+            load_number ();
             return _float;
         }
 
@@ -676,6 +799,7 @@ namespace JSON {
         f () const
         {
             JSON_CHECK_TYPE (_type, FLOAT);
+            load_number ();
             return _float;
         }
 
@@ -720,7 +844,7 @@ namespace JSON {
         }
 
         /** Fetch object reference */
-        inline ObjectT<char_t>&
+        inline ObjectT<char_t, alloc_t>&
         o ()
         {
             if (_type == NIL) {
@@ -731,7 +855,7 @@ namespace JSON {
         }
 
         /** Fetch object const-reference */
-        inline const ObjectT<char_t>&
+        inline const ObjectT<char_t, alloc_t>&
         o () const
         {
             JSON_CHECK_TYPE (_type, OBJECT);
@@ -739,7 +863,7 @@ namespace JSON {
         }
 
         /** Fetch array reference */
-        inline ArrayT<char_t>&
+        inline ArrayT<char_t, alloc_t>&
         a ()
         {
             if (_type == NIL) {
@@ -750,7 +874,7 @@ namespace JSON {
         }
 
         /** Fetch array const-reference */
-        inline const ArrayT<char_t>&
+        inline const ArrayT<char_t, alloc_t>&
         a () const
         {
             JSON_CHECK_TYPE (_type, ARRAY);
@@ -758,7 +882,7 @@ namespace JSON {
         }
 
         /** Support [] operator for object. */
-        inline ValueT<char_t>&
+        inline ValueT<char_t, alloc_t>&
         operator[] (const char_t* key)
         {
             if (_type == NIL) {
@@ -769,7 +893,7 @@ namespace JSON {
         }
 
         /** Support [] operator for object. */
-        inline ValueT<char_t>&
+        inline ValueT<char_t, alloc_t>&
         operator[] (const tstring& key)
         {
             if (_type == NIL) {
@@ -780,7 +904,7 @@ namespace JSON {
         }
 
         /** Support [] operator for array. */
-        inline ValueT<char_t>&
+        inline ValueT<char_t, alloc_t>&
         operator[] (size_t pos)
         {
             JSON_CHECK_TYPE (_type, ARRAY);
@@ -790,18 +914,58 @@ namespace JSON {
         template<class T>
         T get (const tstring& key, const T& value) const;
 
+        /**
+                Get value of key without throwing.
+                Return false (out is left unchanged) if this is not an object,
+                key is missing or null, or its value can not be cast to T.
+            */
+        template<class T>
+        bool try_get (const tstring& key, T& out) const;
+
+        /** Find member of object. Return 0 if this is not an object or key is missing. */
+        const ValueT<char_t, alloc_t>* find (const tstring& key) const;
+
         /** Clear current value. */
         void clear ();
 
         /** Write value to stream. */
         void write (tstring& out) const;
 
+        /**
+                Write value to stream with options, depth is the nesting level
+                of this value (used for indentation).
+                Canonical output of a non-finite float throws a exception.
+            */
+        void write (tstring& out, const WriteOptions& options, size_t depth = 0) const;
+
         /**
                 Read object/array from stream.
                 Return char_t count(offset) parsed.
                 If error occurred, throws a exception.
             */
-        size_t read (const char_t* in, size_t len);
+        size_t read (const char_t* in, size_t len, const ReadOptions& options = ReadOptions ());
+
+        /**
+                Read object/array from stream without throwing.
+                Return the error code and the char_t count(offset) parsed, or
+                the offset the error was detected at; after an error this
+                value holds what was parsed so far.
+            */
+        ParseResult parse (const char_t* in, size_t len, const ReadOptions& options = ReadOptions ());
+
+        /**
+                Read object/array from UTF-8 without throwing, like parse ().
+                Strings are transcoded to char_t while they are read, so a
+                ValueW is built from UTF-8 bytes without a conversion pass.
+            */
+        ParseResult parse_utf8 (const char* in, size_t len, const ReadOptions& options = ReadOptions ());
+
+        /**
+                Read the value whose first event is the current event of reader,
+                the reader is left on the last event of that value.
+                If error occurred, throws a exception.
+            */
+        void read (EventReaderT<char_t>& reader);
 
         /**
                 Read string from stream.
@@ -844,40 +1008,239 @@ namespace JSON {
             */
         std::vector<string> get_keys_like (const string& key_like);
 
+        /**
+                Build an immutable, contiguous snapshot of this value.
+                The result can be shared by any number of reader threads.
+                If error occurred, throws a exception.
+            */
+        FrozenT<char_t> freeze () const;
+
     protected:
+        template<class, class>
+        friend class ValueT;
+
+        template<class in_char_t>
+        ParseResult parse (EventReaderT<in_char_t>& reader);
+
+        /** Store the text of a number read with ReadOptions::raw_numbers. */
+        template<class in_char_t>
+        void assign_number (Type type, const in_char_t* in, size_t len);
+
+        /** Convert the number text kept by ReadOptions::raw_numbers, once. */
+        inline void
+        load_number () const
+        {
+            if (_lazy)
+            {
+                convert_number ();
+            }
+        }
+
+        void convert_number () const;
+
+        /** Return true if the kept number text still is the current value. */
+        bool raw_number () const;
+
         /** Indicate current value type. */
         Type _type = NIL;
 
+        /** Number not converted yet, its text is packed in _string
+            (detail::packed_number). */
+        mutable bool _lazy = false;
+
         union
         {
-            int64_t _integer;
-            double  _float;
-            bool    _boolean;
-            bool    _needConv; /* Used for string. */
+            mutable int64_t _integer;
+            mutable double  _float;
+            bool            _boolean;
+            bool            _needConv; /* Used for string. */
         };
         tstring         _string;
-        ObjectT<char_t> _object;
-        ArrayT<char_t>  _array;
+        ObjectT<char_t, alloc_t> _object;
+        ArrayT<char_t, alloc_t>  _array;
     };
 
     using Value  = ValueT<char>;
     using ValueW = ValueT<wchar_t>;
 
+    /** A read-only view of one node of a FrozenT document. It is a
+        (document, index) pair, cheap to copy and only valid while the
+        document it was taken from is alive. */
+    template<class char_t>
+    class FrozenValueT
+    {
+    public:
+        using tstring = JSON_TSTRING (char_t);
+
+        /** Default constructor (invalid view). */
+        FrozenValueT ()
+            : _doc (0)
+            , _index (0)
+        {
+        }
+
+        FrozenValueT (const FrozenT<char_t>* doc, size_t index)
+            : _doc (doc)
+            , _index (index)
+        {
+        }
+
+        /** False for the result of a failed find (). */
+        inline bool valid () const
+        {
+            return _doc != 0;
+        }
+
+        /** Type query. */
+        inline Type type () const;
+
+        /** Fetch integer value */
+        inline int64_t i () const;
+
+        /** Fetch float value */
+        inline double f () const;
+
+        /** Fetch boolean value */
+        inline bool b () const;
+
+        /** Fetch string value, NUL terminated. */
+        inline const char_t* c_str () const;
+
+        /** Fetch string length. */
+        inline size_t length () const;
+
+        /** Fetch string value as a copy. */
+        inline tstring s () const
+        {
+            return tstring (c_str (), length ());
+        }
+
+        /** Element count of an array, or member count of an object. */
+        inline size_t size () const;
+
+        /** Array element at pos. */
+        FrozenValueT<char_t> operator[] (size_t pos) const;
+
+        /** Object member key at pos, members are sorted by key. */
+        FrozenValueT<char_t> key (size_t pos) const;
+
+        /** Object member value at pos, members are sorted by key. */
+        FrozenValueT<char_t> value (size_t pos) const;
+
+        /** Binary search an object member, returns an invalid view if not found. */
+        FrozenValueT<char_t> find (const char_t* key, size_t len) const;
+
+        inline FrozenValueT<char_t> find (const tstring& key) const
+        {
+            return find (key.c_str (), key.length ());
+        }
+
+        /** Object member lookup, throws a exception if not found. */
+        FrozenValueT<char_t> operator[] (const tstring& key) const;
+
+        template<class T>
+        T get (const tstring& key, const T& value) const;
+
+        /** Convert back to a mutable value. */
+        ValueT<char_t> thaw () const;
+
+        /** Write value to stream. */
+        void write (tstring& out) const;
+
+    private:
+        const FrozenT<char_t>* _doc;
+        size_t                 _index;
+    };
+
+    using FrozenValue  = FrozenValueT<char>;
+    using FrozenValueW = FrozenValueT<wchar_t>;
+
+    /** An immutable JSON document produced by ValueT::freeze ().
+        All nodes live in one array; an array node refers to its elements
+        as a contiguous node range, an object node to its members as
+        contiguous (key, value) node pairs sorted by key, and strings to
+        one shared character pool. There are no pointers inside, so the
+        document may be copied freely and read by many threads at once. */
     template<class char_t>
+    class FrozenT
+    {
+    public:
+        struct Node
+        {
+            Type     type;
+            uint32_t size; /* String length, array/object element count. */
+            union
+            {
+                int64_t  integer;
+                double   real;
+                bool     boolean;
+                uint64_t offset; /* String: pool offset, array/object: first child node. */
+            };
+        };
+
+        /** Default constructor (a single null node). */
+        FrozenT ();
+
+        /** Root value of the document. */
+        inline FrozenValueT<char_t> root () const
+        {
+            return FrozenValueT<char_t> (this, 0);
+        }
+
+        inline const Node& node (size_t index) const
+        {
+            return _nodes[index];
+        }
+
+        inline const char_t* pool () const
+        {
+            return &_pool[0];
+        }
+
+        /** Memory held by the document, in bytes. */
+        inline size_t memory_size () const
+        {
+            return _nodes.size () * sizeof (Node) + _pool.size () * sizeof (char_t);
+        }
+
+    private:
+        template<class, class>
+        friend class ValueT;
+
+        template<class alloc_t>
+        void count (const ValueT<char_t, alloc_t>& v, size_t& nodes, size_t& chars) const;
+        void store_string (size_t index, const char_t* s, size_t len);
+        template<class alloc_t>
+        void store (const ValueT<char_t, alloc_t>& v, size_t index);
+
+        std::vector<Node>   _nodes;
+        std::vector<char_t> _pool;
+    };
+
+    using Frozen  = FrozenT<char>;
+    using FrozenW = FrozenT<wchar_t>;
+
+    template<class char_t, class alloc_t = std::allocator<char_t>>
     struct WriterT
     {
-        static void write (const ObjectT<char_t>& o, JSON_TSTRING (char_t) & out);
-        static void write (const ArrayT<char_t>& a, JSON_TSTRING (char_t) & out);
+        static void write (const ObjectT<char_t, alloc_t>& o, JSON_TSTRING_A (char_t, alloc_t) & out);
+        static void write (const ArrayT<char_t, alloc_t>& a, JSON_TSTRING_A (char_t, alloc_t) & out);
+
+        static void write (const ObjectT<char_t, alloc_t>& o, JSON_TSTRING_A (char_t, alloc_t) & out, const WriteOptions& options, size_t depth = 0);
+        static void write (const ArrayT<char_t, alloc_t>& a, JSON_TSTRING_A (char_t, alloc_t) & out, const WriteOptions& options, size_t depth = 0);
+
+    private:
+        static void write_indent (JSON_TSTRING_A (char_t, alloc_t) & out, const WriteOptions& options, size_t depth);
     };
 
     using Writer  = WriterT<char>;
     using WriterW = WriterT<wchar_t>;
 
-    template<class char_t>
+    template<class char_t, class alloc_t = std::allocator<char_t>>
     struct ReaderT
     {
         static inline size_t
-        read (ValueT<char_t>& v, const char_t* in, size_t len)
+        read (ValueT<char_t, alloc_t>& v, const char_t* in, size_t len)
         {
             return v.read (in, len);
         }
@@ -886,177 +1249,312 @@ namespace JSON {
     using Reader  = ReaderT<char>;
     using ReaderW = ReaderT<wchar_t>;
 
-    /* Compare functions */
-    template<class char_t>
-    bool operator== (const ObjectT<char_t>& lhs, const ObjectT<char_t>& rhs);
-    template<class char_t>
-    bool operator== (const ArrayT<char_t>& lhs, const ArrayT<char_t>& rhs);
-    template<class char_t>
-    bool operator== (const ValueT<char_t>& lhs, const ValueT<char_t>& rhs);
+    /** Parse events reported by EventReaderT. */
+    enum Event
+    {
+        EVENT_NIL,          // null
+        EVENT_INTEGER,      // integer(), str(), length() is the number text
+        EVENT_FLOAT,        // real(), str(), length() is the number text
+        EVENT_BOOLEAN,      // boolean()
+        EVENT_STRING,       // str(), length()
+        EVENT_KEY,          // str(), length(), object member name
+        EVENT_OBJECT_BEGIN, // {
+        EVENT_OBJECT_END,   // }
+        EVENT_ARRAY_BEGIN,  // [
+        EVENT_ARRAY_END,    // ]
+        EVENT_END           // Topmost value parsed, nothing more to read.
+    };
 
+    /** A pull parser: every call to next () consumes one token of the input
+        and reports it as an event, without building any ValueT. Strings
+        without escapes are reported in place, escaped ones are decoded into
+        a scratch buffer that is reused by the next string. */
     template<class char_t>
+    class EventReaderT
+    {
+    public:
+        using tstring = JSON_TSTRING (char_t);
+
+        EventReaderT (const char_t* in, size_t len, const ReadOptions& options = ReadOptions ());
+
+        /**
+                Read next event.
+                If error occurred, throws a exception.
+            */
+        Event next ();
+
+        /**
+                Read next event without throwing. On error return EVENT_END
+                (and keep returning it), error () and offset () tell what
+                and where.
+            */
+        Event try_next ();
+
+        /** Error of the last event read, PARSE_OK if none. */
+        inline ParseError error () const
+        {
+            return _error;
+        }
+
+        /**
+                Skip the value whose first event is the current one, i.e. for
+                EVENT_OBJECT_BEGIN/EVENT_ARRAY_BEGIN read up to the matching end.
+            */
+        void skip ();
+
+        /** Current event. */
+        inline Event event () const
+        {
+            return _event;
+        }
+
+        inline const ReadOptions& options () const
+        {
+            return _options;
+        }
+
+        /** Not set with ReadOptions::raw_numbers, use str (), length (). */
+        inline int64_t integer () const
+        {
+            return _integer;
+        }
+
+        inline double real () const
+        {
+            return _float;
+        }
+
+        inline bool boolean () const
+        {
+            return _boolean;
+        }
+
+        /** String or key of the current event, not NUL terminated. */
+        inline const char_t* str () const
+        {
+            return _str;
+        }
+
+        inline size_t length () const
+        {
+            return _length;
+        }
+
+        /** char_t count(offset) parsed so far. */
+        inline size_t offset () const
+        {
+            return _pos;
+        }
+
+        /** Count of objects/arrays currently open. */
+        inline size_t depth () const
+        {
+            return _stack.size ();
+        }
+
+    private:
+        void   skip_white_space ();
+        Event  read_value ();
+        Event  read_key ();
+        Event  read_after_value ();
+        Event  read_string ();
+        Event  read_number ();
+        Event  read_literal (const char_t* literal, size_t len, Event e);
+        Event  fail (ParseError error);
+
+        const char_t*              _in;
+        size_t                     _len;
+        ReadOptions                _options;
+        size_t                     _pos;
+        unsigned char              _state;
+        Event                      _event;
+        ParseError                 _error;
+        std::vector<unsigned char> _stack;
+        union
+        {
+            int64_t _integer;
+            double  _float;
+            bool    _boolean;
+        };
+        const char_t* _str;
+        size_t        _length;
+        tstring       _scratch;
+    };
+
+    using EventReader  = EventReaderT<char>;
+    using EventReaderW = EventReaderT<wchar_t>;
+
+    /* Compare functions */
+    template<class char_t, class alloc_t>
+    bool operator== (const ObjectT<char_t, alloc_t>& lhs, const ObjectT<char_t, alloc_t>& rhs);
+    template<class char_t, class alloc_t>
+    bool operator== (const ArrayT<char_t, alloc_t>& lhs, const ArrayT<char_t, alloc_t>& rhs);
+    template<class char_t, class alloc_t>
+    bool operator== (const ValueT<char_t, alloc_t>& lhs, const ValueT<char_t, alloc_t>& rhs);
+
+    template<class char_t, class alloc_t>
     inline bool
-    operator!= (const ObjectT<char_t>& lhs, const ObjectT<char_t>& rhs)
+    operator!= (const ObjectT<char_t, alloc_t>& lhs, const ObjectT<char_t, alloc_t>& rhs)
     {
         return !operator== (lhs, rhs);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator!= (const ArrayT<char_t>& lhs, const ArrayT<char_t>& rhs)
+    operator!= (const ArrayT<char_t, alloc_t>& lhs, const ArrayT<char_t, alloc_t>& rhs)
     {
         return !operator== (lhs, rhs);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator!= (const ValueT<char_t>& lhs, const ValueT<char_t>& rhs)
+    operator!= (const ValueT<char_t, alloc_t>& lhs, const ValueT<char_t, alloc_t>& rhs)
     {
         return !operator== (lhs, rhs);
     }
 
-    template<class char_t, class T>
+    template<class char_t, class alloc_t, class T>
     inline typename detail::json_enable_if<detail::json_is_integral<T>::value, bool>::type
-    operator== (const ValueT<char_t>& v, T i)
+    operator== (const ValueT<char_t, alloc_t>& v, T i)
     {
         return v.type () == INTEGER && i == v.i ();
     }
-    template<class char_t, class T>
+    template<class char_t, class alloc_t, class T>
     inline typename detail::json_enable_if<detail::json_is_floating_point<T>::value, bool>::type
-    operator== (const ValueT<char_t>& v, T f)
+    operator== (const ValueT<char_t, alloc_t>& v, T f)
     {
         return v.type () == FLOAT && fabs (f - v.f ()) < JSON_EPSILON;
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator== (const ValueT<char_t>& v, bool b)
+    operator== (const ValueT<char_t, alloc_t>& v, bool b)
     {
         return v.type () == BOOLEAN && b == v.b ();
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator== (const ValueT<char_t>& v, const ObjectT<char_t>& o)
+    operator== (const ValueT<char_t, alloc_t>& v, const ObjectT<char_t, alloc_t>& o)
     {
         return v.type () == OBJECT && o == v.o ();
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator== (const ValueT<char_t>& v, const ArrayT<char_t>& a)
+    operator== (const ValueT<char_t, alloc_t>& v, const ArrayT<char_t, alloc_t>& a)
     {
         return v.type () == ARRAY && a == v.a ();
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator== (const ValueT<char_t>& v, const JSON_TSTRING (char_t) & s)
+    operator== (const ValueT<char_t, alloc_t>& v, const JSON_TSTRING_A (char_t, alloc_t) & s)
     {
         return v.type () == STRING && s == v.s ();
     }
 
-    template<class char_t, class T>
+    template<class char_t, class alloc_t, class T>
     inline typename detail::json_enable_if<detail::json_is_integral<T>::value, bool>::type
-    operator== (T i, const ValueT<char_t>& v)
+    operator== (T i, const ValueT<char_t, alloc_t>& v)
     {
         return operator== (v, i);
     }
-    template<class char_t, class T>
+    template<class char_t, class alloc_t, class T>
     inline typename detail::json_enable_if<detail::json_is_floating_point<T>::value, bool>::type
-    operator== (T f, const ValueT<char_t>& v)
+    operator== (T f, const ValueT<char_t, alloc_t>& v)
     {
         return operator== (v, f);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator== (bool b, const ValueT<char_t>& v)
+    operator== (bool b, const ValueT<char_t, alloc_t>& v)
     {
         return operator== (v, b);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator== (const ObjectT<char_t>& o, const ValueT<char_t>& v)
+    operator== (const ObjectT<char_t, alloc_t>& o, const ValueT<char_t, alloc_t>& v)
     {
         return operator== (v, o);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator== (const ArrayT<char_t>& a, const ValueT<char_t>& v)
+    operator== (const ArrayT<char_t, alloc_t>& a, const ValueT<char_t, alloc_t>& v)
     {
         return operator== (v, a);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator== (const JSON_TSTRING (char_t) & s, const ValueT<char_t>& v)
+    operator== (const JSON_TSTRING_A (char_t, alloc_t) & s, const ValueT<char_t, alloc_t>& v)
     {
         return operator== (v, s);
     }
 
-    template<class char_t, class T>
+    template<class char_t, class alloc_t, class T>
     inline typename detail::json_enable_if<detail::json_is_integral<T>::value, bool>::type
-    operator!= (const ValueT<char_t>& v, T i)
+    operator!= (const ValueT<char_t, alloc_t>& v, T i)
     {
         return !operator== (v, i);
     }
-    template<class char_t, class T>
+    template<class char_t, class alloc_t, class T>
     inline typename detail::json_enable_if<detail::json_is_floating_point<T>::value, bool>::type
-    operator!= (const ValueT<char_t>& v, T f)
+    operator!= (const ValueT<char_t, alloc_t>& v, T f)
     {
         return !operator== (v, f);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator!= (const ValueT<char_t>& v, bool b)
+    operator!= (const ValueT<char_t, alloc_t>& v, bool b)
     {
         return !operator== (v, b);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator!= (const ValueT<char_t>& v, const ObjectT<char_t>& o)
+    operator!= (const ValueT<char_t, alloc_t>& v, const ObjectT<char_t, alloc_t>& o)
     {
         return !operator== (v, o);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator!= (const ValueT<char_t>& v, const ArrayT<char_t>& a)
+    operator!= (const ValueT<char_t, alloc_t>& v, const ArrayT<char_t, alloc_t>& a)
     {
         return !operator== (v, a);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator!= (const ValueT<char_t>& v, const JSON_TSTRING (char_t) & s)
+    operator!= (const ValueT<char_t, alloc_t>& v, const JSON_TSTRING_A (char_t, alloc_t) & s)
     {
         return !operator== (v, s);
     }
 
-    template<class char_t, class T>
+    template<class char_t, class alloc_t, class T>
     inline typename detail::json_enable_if<detail::json_is_integral<T>::value, bool>::type
-    operator!= (T i, const ValueT<char_t>& v)
+    operator!= (T i, const ValueT<char_t, alloc_t>& v)
     {
         return !operator== (v, i);
     }
-    template<class char_t, class T>
+    template<class char_t, class alloc_t, class T>
     inline typename detail::json_enable_if<detail::json_is_floating_point<T>::value, bool>::type
-    operator!= (T f, const ValueT<char_t>& v)
+    operator!= (T f, const ValueT<char_t, alloc_t>& v)
     {
         return !operator== (v, f);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator!= (bool b, const ValueT<char_t>& v)
+    operator!= (bool b, const ValueT<char_t, alloc_t>& v)
     {
         return !operator== (v, b);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator!= (const ObjectT<char_t>& o, const ValueT<char_t>& v)
+    operator!= (const ObjectT<char_t, alloc_t>& o, const ValueT<char_t, alloc_t>& v)
     {
         return !operator== (v, o);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator!= (const ArrayT<char_t>& a, const ValueT<char_t>& v)
+    operator!= (const ArrayT<char_t, alloc_t>& a, const ValueT<char_t, alloc_t>& v)
     {
         return !operator== (v, a);
     }
-    template<class char_t>
+    template<class char_t, class alloc_t>
     inline bool
-    operator!= (const JSON_TSTRING (char_t) & s, const ValueT<char_t>& v)
+    operator!= (const JSON_TSTRING_A (char_t, alloc_t) & s, const ValueT<char_t, alloc_t>& v)
     {
         return !operator== (v, s);
     }
@@ -23,13 +23,13 @@ convert_json_string (const JSON_TSTRING (char) & str)
     return str;
 }
 
-// inline std::string
-// convert_json_string (const JSON_TSTRING (wchar_t) & wstr)
-// {
-//     String str;
-//     str.format ("%S", wstr.c_str ());
-//     return str;
-// }
+inline std::string
+convert_json_string (const JSON_TSTRING (wchar_t) & wstr)
+{
+    std::string str;
+    wide_to_utf8 (wstr.data (), wstr.length (), str);
+    return str;
+}
 
 inline const char*
 get_type_name (int type)
@@ -54,8 +54,33 @@ get_type_name (int type)
     return "Unknown";
 }
 
-template<class char_t>
-ValueT<char_t>::ValueT (Type type)
+inline const char*
+get_parse_error_name (int error)
+{
+    switch (error)
+    {
+        case PARSE_OK:
+            return "OK";
+        case PARSE_UNEXPECTED_END:
+            return "Unexpected end";
+        case PARSE_UNEXPECTED_CHARACTER:
+            return "Unexpected character";
+        case PARSE_INVALID_LITERAL:
+            return "Invalid literal";
+        case PARSE_INVALID_NUMBER:
+            return "Invalid number";
+        case PARSE_INVALID_ESCAPE:
+            return "Invalid escape";
+        case PARSE_NOT_CONTAINER:
+            return "Not an object/array";
+        case PARSE_INVALID_UTF8:
+            return "Invalid UTF-8";
+    }
+    return "Unknown";
+}
+
+template<class char_t, class alloc_t>
+ValueT<char_t, alloc_t>::ValueT (Type type)
     : _type (type)
 {
     switch (_type)
@@ -81,8 +106,8 @@ ValueT<char_t>::ValueT (Type type)
     }
 }
 
-template<class char_t>
-ValueT<char_t>::ValueT (const ValueT<char_t> &v)
+template<class char_t, class alloc_t>
+ValueT<char_t, alloc_t>::ValueT (const ValueT<char_t, alloc_t> &v)
     : _type (v._type)
 {
     switch (_type)
@@ -92,9 +117,13 @@ ValueT<char_t>::ValueT (const ValueT<char_t> &v)
             break;
         case INTEGER:
             _integer = v._integer;
+            _lazy    = v._lazy;
+            _string  = v._string;
             break;
         case FLOAT:
-            _float = v._float;
+            _float  = v._float;
+            _lazy   = v._lazy;
+            _string = v._string;
             break;
         case BOOLEAN:
             _boolean = v._boolean;
@@ -112,9 +141,51 @@ ValueT<char_t>::ValueT (const ValueT<char_t> &v)
     }
 }
 
-template<class char_t>
+template<class char_t, class alloc_t>
+template<class other_alloc_t>
+ValueT<char_t, alloc_t>::ValueT (const ValueT<char_t, other_alloc_t> &v)
+    : _type (v._type)
+{
+    switch (_type)
+    {
+        case NIL:
+            break;
+        case INTEGER:
+            _integer = v._integer;
+            _lazy    = v._lazy;
+            _string.assign (v._string.data (), v._string.length ());
+            break;
+        case FLOAT:
+            _float = v._float;
+            _lazy  = v._lazy;
+            _string.assign (v._string.data (), v._string.length ());
+            break;
+        case BOOLEAN:
+            _boolean = v._boolean;
+            break;
+        case STRING:
+            _needConv = v._needConv;
+            _string.assign (v._string.data (), v._string.length ());
+            break;
+        case ARRAY:
+            _array.reserve (v._array.size ());
+            for (size_t pos = 0; pos < v._array.size (); ++pos)
+            {
+                _array.push_back (ValueT<char_t, alloc_t> (v._array[pos]));
+            }
+            break;
+        case OBJECT:
+            for (typename ObjectT<char_t, other_alloc_t>::const_iterator it = v._object.begin (); it != v._object.end (); ++it)
+            {
+                _object.insert (_object.end (), std::make_pair (tstring (it->first.data (), it->first.length ()), ValueT<char_t, alloc_t> (it->second)));
+            }
+            break;
+    }
+}
+
+template<class char_t, class alloc_t>
 void
-ValueT<char_t>::assign (const ValueT<char_t> &v)
+ValueT<char_t, alloc_t>::assign (const ValueT<char_t, alloc_t> &v)
 {
     if (_type != v._type)
     {
@@ -128,9 +199,13 @@ ValueT<char_t>::assign (const ValueT<char_t> &v)
             break;
         case INTEGER:
             _integer = v._integer;
+            _lazy    = v._lazy;
+            _string  = v._string;
             break;
         case FLOAT:
-            _float = v._float;
+            _float  = v._float;
+            _lazy   = v._lazy;
+            _string = v._string;
             break;
         case BOOLEAN:
             _boolean = v._boolean;
@@ -149,9 +224,9 @@ ValueT<char_t>::assign (const ValueT<char_t> &v)
 }
 
 #ifdef __ENABLE_CXX11__
-template<class char_t>
+template<class char_t, class alloc_t>
 void
-ValueT<char_t>::assign (ValueT<char_t>&& v)
+ValueT<char_t, alloc_t>::assign (ValueT<char_t, alloc_t>&& v)
 {
     if (_type != v._type)
     {
@@ -165,9 +240,13 @@ ValueT<char_t>::assign (ValueT<char_t>&& v)
             break;
         case INTEGER:
             _integer = v._integer;
+            _lazy    = v._lazy;
+            _string  = v._string;
             break;
         case FLOAT:
-            _float = v._float;
+            _float  = v._float;
+            _lazy   = v._lazy;
+            _string = v._string;
             break;
         case BOOLEAN:
             _boolean = v._boolean;
@@ -187,12 +266,14 @@ ValueT<char_t>::assign (ValueT<char_t>&& v)
 }
 #endif
 
-template<class char_t>
+template<class char_t, class alloc_t>
 void
-ValueT<char_t>::clear ()
+ValueT<char_t, alloc_t>::clear ()
 {
     switch (_type)
     {
+        case INTEGER:
+        case FLOAT:
         case STRING:
             _string.clear ();
             break;
@@ -206,16 +287,17 @@ ValueT<char_t>::clear ()
             break;
     }
     _type = NIL;
+    _lazy = false;
 }
 
 namespace detail {
     namespace {
-        template<class T, class char_t>
+        template<class T, class string_t>
         inline void
         internal_to_string (const T& v,
-                            JSON_TSTRING (char_t) & out,
-                            int (*fmter) (char_t*, size_t, const char_t*, ...),
-                            const char_t* fmt)
+                            string_t& out,
+                            int (*fmter) (typename string_t::value_type*, size_t, const typename string_t::value_type*, ...),
+                            const typename string_t::value_type* fmt)
         {
             // double 24 bytes, int64 20 bytes
             static const size_t bufSize = 25;
@@ -229,193 +311,330 @@ namespace detail {
             out.resize (len + ret);
         }
 
-        template<class T, class char_t>
-        void to_string (const T& v, JSON_TSTRING (char_t) & out);
-
-        template<>
+        template<class S>
         inline void
-        to_string<int64_t, char> (const int64_t& v, JSON_TSTRING (char) & out)
+        to_string (const int64_t& v, std::basic_string<char, std::char_traits<char>, S>& out)
         {
-            internal_to_string<int64_t, char> (v, out,
+            internal_to_string (v, out,
         #ifdef __WINDOWS__
-                                            _snprintf, "%I64d"
+                                _snprintf, "%I64d"
         #else
-                                            snprintf, "%lld"
+                                snprintf, "%lld"
         #endif
             );
         }
 
-        template<>
+        template<class S>
         inline void
-        to_string<int64_t, wchar_t> (const int64_t& v, JSON_TSTRING (wchar_t) & out)
+        to_string (const int64_t& v, std::basic_string<wchar_t, std::char_traits<wchar_t>, S>& out)
         {
-            internal_to_string<int64_t, wchar_t> (v, out, swprintf,
+            internal_to_string (v, out, swprintf,
         #ifdef __WINDOWS__
-                                                L"%I64d"
+                                L"%I64d"
         #else
-                                                L"%lld"
+                                L"%lld"
         #endif
             );
         }
 
-        template<>
+        template<class S>
         inline void
-        to_string<double, char> (const double& v, JSON_TSTRING (char) & out)
+        to_string (const double& v, std::basic_string<char, std::char_traits<char>, S>& out)
         {
-            internal_to_string<double, char> (v, out,
+            internal_to_string (v, out,
         #ifdef __WINDOWS__
-                                            _snprintf
+                                _snprintf
         #else
-                                            snprintf
+                                snprintf
         #endif
-                                            ,
-                                            "%.16g");
+                                ,
+                                "%.16g");
         }
 
-        template<>
+        template<class S>
         inline void
-        to_string<double, wchar_t> (const double& v, JSON_TSTRING (wchar_t) & out)
+        to_string (const double& v, std::basic_string<wchar_t, std::char_traits<wchar_t>, S>& out)
         {
-            internal_to_string<double, wchar_t> (v, out, swprintf, L"%.16g");
+            internal_to_string (v, out, swprintf, L"%.16g");
         }
 
-        template<class T, class char_t>
-        inline JSON_TSTRING (char_t) to_string (const T& v)
+        template<class string_t, class T>
+        inline string_t to_string (const T& v)
         {
-            JSON_TSTRING (char_t)
-            out;
+            string_t out;
             to_string (v, out);
-            return JSON_MOVE (JSON_TSTRING (char_t) (out));
+            return JSON_MOVE (out);
         }
 
-        char
-        int_to_hex (int n)
+        /**
+                Format a float as ECMAScript Number::toString does (RFC 8785):
+                the shortest digits that round-trip, exponent form outside
+                [1e-6, 1e21).
+            */
+        template<class string_t>
+        inline void
+        to_canonical_string (double v, string_t& out)
         {
-            return n["0123456789abcdef"];
+            JSON_INTERNAL_ASSERT_CHECK_EX (std::isfinite (v), "Format error: %g has no canonical form.", v);
+            if (v == 0)
+            {
+                out += '0';
+                return;
+            }
+            char buffer[32];
+            for (int precision = 1; precision <= 17; ++precision)
+            {
+                snprintf (buffer, sizeof (buffer), "%.*e", precision - 1, v);
+                if (strtod (buffer, 0) == v)
+                {
+                    break;
+                }
+            }
+            // buffer is [-]d[.ddd]e(+|-)xx
+            char        digits[20];
+            size_t      count = 0;
+            const char* p     = buffer;
+            if (*p == '-')
+            {
+                out += '-';
+                ++p;
+            }
+            for (; *p != 'e'; ++p)
+            {
+                if (*p >= '0' && *p <= '9')
+                {
+                    digits[count++] = *p;
+                }
+            }
+            const int k = static_cast<int> (count);
+            const int n = atoi (p + 1) + 1; /* Decimal point position. */
+            if (k <= n && n <= 21)
+            {
+                out.append (digits, digits + k);
+                out.append (n - k, '0');
+            }
+            else if (0 < n && n <= 21)
+            {
+                out.append (digits, digits + n);
+                out += '.';
+                out.append (digits + n, digits + k);
+            }
+            else if (-6 < n && n <= 0)
+            {
+                out += '0';
+                out += '.';
+                out.append (-n, '0');
+                out.append (digits, digits + k);
+            }
+            else
+            {
+                out += digits[0];
+                if (k > 1)
+                {
+                    out += '.';
+                    out.append (digits + 1, digits + k);
+                }
+                out += 'e';
+                out += n - 1 < 0 ? '-' : '+';
+                snprintf (buffer, sizeof (buffer), "%d", n - 1 < 0 ? 1 - n : n - 1);
+                out.append (buffer, buffer + strlen (buffer));
+            }
         }
 
-        void
-        to_hex (int ch, JSON_TSTRING (wchar_t) & out)
+        inline char
+        int_to_hex (int n)
         {
-            out += int_to_hex ((ch >> 4) & 0xF);
-            out += int_to_hex (ch & 0xF);
+            return n["0123456789abcdef"];
         }
 
-        template<int size>
-        void encode_unicode (wchar_t ch, JSON_TSTRING (wchar_t) & out);
-
-        // For UTF16 Encoding
-        template<>
-        void
-        encode_unicode<2> (wchar_t ch, JSON_TSTRING (wchar_t) & out)
+        /** Append \uXXXX for a UTF-16 code unit. */
+        template<class string_t>
+        inline void
+        encode_unit (unsigned int unit, string_t& out)
         {
             out += '\\';
             out += 'u';
-            to_hex ((ch >> 8) & 0xFF, out);
-            to_hex (ch & 0xFF, out);
+            out += int_to_hex ((unit >> 12) & 0xF);
+            out += int_to_hex ((unit >> 8) & 0xF);
+            out += int_to_hex ((unit >> 4) & 0xF);
+            out += int_to_hex (unit & 0xF);
         }
 
-        // For UTF32 Encoding
-        template<>
-        void
-        encode_unicode<4> (wchar_t ch, JSON_TSTRING (wchar_t) & out)
+        template<class string_t>
+        inline void
+        encode_unicode (unsigned int ch, string_t& out)
         {
             if (ch > 0xFFFF)
             {
-                ch = static_cast<int> (ch) - 0x10000;
-                encode_unicode<2> ((unsigned short)(0xD800 | (ch >> 10)), out);
-                encode_unicode<2> ((unsigned short)(0xDC00 | (ch & 0x03FF)), out);
+                ch -= 0x10000;
+                encode_unit (0xD800 | (ch >> 10), out);
+                encode_unit (0xDC00 | (ch & 0x03FF), out);
             }
             else
             {
-                encode_unicode<2> ((unsigned short)ch, out);
+                encode_unit (ch, out);
+            }
+        }
+
+        /** Read one code point at pos (UTF-8), pos is moved past it. */
+        inline unsigned int
+        next_code_point (const char* in, size_t len, size_t& pos)
+        {
+            unsigned char lead = static_cast<unsigned char> (in[pos++]);
+            if (lead < 0x80)
+            {
+                return lead;
+            }
+            size_t extra = lead >= 0xF0 ? 3 : (lead >= 0xE0 ? 2 : (lead >= 0xC0 ? 1 : 0));
+            if (extra == 0 || pos + extra > len)
+            {
+                return 0xFFFD;
+            }
+            unsigned int ch = lead & (0x3F >> extra);
+            for (size_t count = 0; count < extra; ++count, ++pos)
+            {
+                if ((static_cast<unsigned char> (in[pos]) & 0xC0) != 0x80)
+                {
+                    return 0xFFFD;
+                }
+                ch = (ch << 6) | (in[pos] & 0x3F);
             }
+            return ch;
+        }
+
+        /** Read one code unit at pos (UTF-16 or UTF-32), pos is moved past it. */
+        inline unsigned int
+        next_code_point (const wchar_t* in, size_t, size_t& pos)
+        {
+            return static_cast<unsigned int> (in[pos++]);
         }
 
+        /**
+                Escape a string in a single pass, unescaped runs are appended
+                as a whole. '/' is escaped unless options.canonical, other
+                control characters become \u00XX, non-ASCII characters become
+                \uXXXX (surrogate pairs above U+FFFF) as options.ascii says.
+            */
+        template<class char_t, class string_t>
         inline void
-        encode (const char* in, size_t len, JSON_TSTRING (char) & out)
+        encode (const char_t* in, size_t len, string_t& out, const WriteOptions& options = WriteOptions ())
         {
+            const bool ascii = options.ascii == ASCII_DEFAULT ? sizeof (char_t) != 1 && !options.canonical
+                                                              : options.ascii == ASCII_ESCAPE;
+            size_t     start = 0;
             for (size_t pos = 0; pos < len; ++pos)
             {
+                char_t escape = 0;
                 switch (in[pos])
                 {
                     case '\"':
-                        out += "\\\"";
+                        escape = '\"';
                         break;
                     case '\\':
-                        out += "\\\\";
+                        escape = '\\';
                         break;
                     case '/':
-                        out += "\\/";
+                        escape = options.canonical ? 0 : '/';
                         break;
                     case '\b':
-                        out += "\\b";
+                        escape = 'b';
                         break;
                     case '\f':
-                        out += "\\f";
+                        escape = 'f';
                         break;
                     case '\n':
-                        out += "\\n";
+                        escape = 'n';
                         break;
                     case '\r':
-                        out += "\\r";
+                        escape = 'r';
                         break;
                     case '\t':
-                        out += "\\t";
-                        break;
-                    default:
-                        out += in[pos];
+                        escape = 't';
                         break;
                 }
+                // Signed char: bytes above 0x7F convert to large values too.
+                unsigned int unit = static_cast<unsigned int> (in[pos]);
+                if (escape == 0 && unit >= 0x20 && (unit <= 0x7F || !ascii))
+                {
+                    continue;
+                }
+                out.append (in + start, pos - start);
+                if (escape != 0)
+                {
+                    out += '\\';
+                    out += escape;
+                }
+                else if (unit < 0x20)
+                {
+                    encode_unit (unit, out);
+                }
+                else
+                {
+                    encode_unicode (next_code_point (in, len, pos), out);
+                    --pos;
+                }
+                start = pos + 1;
             }
+            out.append (in + start, len - start);
         }
 
-        inline void
-        encode (const wchar_t* in, size_t len, JSON_TSTRING (wchar_t) & out)
+        /** Sort rank of a code point in UTF-16 code unit order. */
+        inline unsigned int
+        utf16_rank (unsigned int ch)
         {
-            for (size_t pos = 0; pos < len; ++pos)
+            // Surrogate pairs (above U+FFFF) sort before U+E000..U+FFFF.
+            return (ch >= 0xE000 && ch <= 0xFFFF) ? ch + 0x110000 : ch;
+        }
+
+        /**
+                ObjectT keeps keys in code unit order, which only differs from
+                UTF-16 order when a key has a character in U+E000..U+FFFF
+                (UTF-8 lead byte 0xEE/0xEF) and wchar_t is UTF-32.
+            */
+        template<class string_t>
+        inline bool
+        utf16_order_differs (const string_t& key)
+        {
+            typedef typename string_t::value_type char_t;
+            for (size_t pos = 0; pos < key.length (); ++pos)
             {
-                if (in[pos] > 127)
+                unsigned int unit = static_cast<unsigned int> (key[pos]);
+                if (sizeof (char_t) == 1 ? ((unit & 0xFF) == 0xEE || (unit & 0xFF) == 0xEF)
+                                         : (sizeof (char_t) == 4 && unit >= 0xE000 && unit <= 0xFFFF))
                 {
-                    encode_unicode<sizeof (wchar_t)> (in[pos], out);
+                    return true;
                 }
-                else
+            }
+            return false;
+        }
+
+        template<class object_t>
+        struct utf16_less
+        {
+            typedef typename object_t::const_iterator iterator;
+
+            bool
+            operator() (const iterator& lhs, const iterator& rhs) const
+            {
+                const typename object_t::key_type& l = lhs->first;
+                const typename object_t::key_type& r = rhs->first;
+                size_t lpos = 0;
+                size_t rpos = 0;
+                while (lpos < l.length () && rpos < r.length ())
                 {
-                    switch (in[pos])
+                    unsigned int lch = utf16_rank (next_code_point (l.data (), l.length (), lpos));
+                    unsigned int rch = utf16_rank (next_code_point (r.data (), r.length (), rpos));
+                    if (lch != rch)
                     {
-                        case '\"':
-                            out += L"\\\"";
-                            break;
-                        case '\\':
-                            out += L"\\\\";
-                            break;
-                        case '/':
-                            out += L"\\/";
-                            break;
-                        case '\b':
-                            out += L"\\b";
-                            break;
-                        case '\f':
-                            out += L"\\f";
-                            break;
-                        case '\n':
-                            out += L"\\n";
-                            break;
-                        case '\r':
-                            out += L"\\r";
-                            break;
-                        case '\t':
-                            out += L"\\t";
-                            break;
-                        default:
-                            out += in[pos];
-                            break;
+                        return lch < rch;
                     }
                 }
+                return lpos == l.length () && rpos < r.length ();
             }
-        }
+        };
 
-        int
+        /** Value of a hex digit, -1 if ch is not one. */
+        inline int
         hex_to_int (int ch)
         {
             if ('0' <= ch && ch <= '9')
@@ -424,25 +643,33 @@ namespace detail {
                 return (ch - 'a' + 10);
             else if ('A' <= ch && ch <= 'F')
                 return (ch - 'A' + 10);
-            JSON_INTERNAL_ASSERT_CHECK_EX(false, "Decode error: invalid character=0x%x.", ch);
+            return -1;
         }
 
         template<class char_t>
-        unsigned short
-        hex_to_ushort (const char_t* in, size_t len)
+        inline bool
+        hex_to_unit (const char_t* in, size_t len, unsigned int& unit)
         {
-            JSON_DECODE_CHECK (len >= 4);
-            unsigned char highByte = (hex_to_int (in[0]) << 4) | hex_to_int (in[1]);
-            unsigned char lowByte  = (hex_to_int (in[2]) << 4) | hex_to_int (in[3]);
-            return (highByte << 8) | lowByte;
+            if (len < 4)
+            {
+                return false;
+            }
+            unit = 0;
+            for (size_t pos = 0; pos < 4; ++pos)
+            {
+                int n = hex_to_int (in[pos]);
+                if (n < 0)
+                {
+                    return false;
+                }
+                unit = (unit << 4) | n;
+            }
+            return true;
         }
 
-        template<class char_t>
-        void decode_unicode_append (unsigned int ui, JSON_TSTRING (char_t) & out);
-
-        template<>
-        void
-        decode_unicode_append<char> (unsigned int ui, JSON_TSTRING (char) & out)
+        template<class S>
+        inline void
+        decode_unicode_append (unsigned int ui, std::basic_string<char, std::char_traits<char>, S>& out)
         {
             const size_t len = out.length ();
             if (ui <= 0x0000007F) {
@@ -463,104 +690,240 @@ namespace detail {
                 out[len + 1] = ((ui >> 6) & 0x3F) | 0x80;
                 out[len]     = ((ui >> 12) & 0x0F) | 0xE0;
             }
-            else if (ui >= 0x00010000 && ui <= 0x001FFFFF) {
-                // * U-00010000 - U-001FFFFF:  11110xxx 10xxxxxx 10xxxxxx 10xxxxxx
+            else if (ui >= 0x00010000 && ui <= 0x0010FFFF) {
+                // * U-00010000 - U-0010FFFF:  11110xxx 10xxxxxx 10xxxxxx 10xxxxxx
+                // Longer (5/6 bytes) forms are not UTF-8 since RFC 3629.
                 out.resize (len + 4);
                 out[len + 3] = (ui & 0x3F) | 0x80;
                 out[len + 2] = ((ui >> 6) & 0x3F) | 0x80;
                 out[len + 1] = ((ui >> 12) & 0x3F) | 0x80;
                 out[len]     = ((ui >> 18) & 0x07) | 0xF0;
             }
-            else if (ui >= 0x00200000 && ui <= 0x03FFFFFF) {
-                // * U-00200000 - U-03FFFFFF:  111110xx 10xxxxxx 10xxxxxx 10xxxxxx 10xxxxxx
-                out.resize (len + 5);
-                out[len + 4] = (ui & 0x3F) | 0x80;
-                out[len + 3] = ((ui >> 6) & 0x3F) | 0x80;
-                out[len + 2] = ((ui >> 12) & 0x3F) | 0x80;
-                out[len + 1] = ((ui >> 18) & 0x3F) | 0x80;
-                out[len]     = ((ui >> 24) & 0x03) | 0xF8;
+        }
+
+        template<class S>
+        inline void
+        decode_unicode_append (unsigned int ui, std::basic_string<wchar_t, std::char_traits<wchar_t>, S>& out)
+        {
+            if (sizeof (wchar_t) == 2 && ui > 0xFFFF)
+            {
+                // UTF-16 surrogate pair
+                ui -= 0x10000;
+                out += static_cast<wchar_t> (0xD800 | (ui >> 10));
+                out += static_cast<wchar_t> (0xDC00 | (ui & 0x03FF));
+            }
+            else
+            {
+                out += static_cast<wchar_t> (ui);
+            }
+        }
+
+        /**
+                Length of the well-formed UTF-8 sequence at in (RFC 3629: no
+                overlong forms, no surrogates, nothing above U+10FFFF).
+                Return 0 if malformed.
+            */
+        inline size_t
+        validate_utf8 (const char* in, size_t len)
+        {
+            const unsigned char* s     = reinterpret_cast<const unsigned char*> (in);
+            size_t               count = 0;
+            unsigned char        lo    = 0x80;
+            unsigned char        hi    = 0xBF;
+            if (s[0] < 0x80)
+            {
+                return 1;
+            }
+            else if (s[0] >= 0xC2 && s[0] <= 0xDF)
+            {
+                count = 2;
+            }
+            else if (s[0] >= 0xE0 && s[0] <= 0xEF)
+            {
+                count = 3;
+                lo    = s[0] == 0xE0 ? 0xA0 : lo;
+                hi    = s[0] == 0xED ? 0x9F : hi;
+            }
+            else if (s[0] >= 0xF0 && s[0] <= 0xF4)
+            {
+                count = 4;
+                lo    = s[0] == 0xF0 ? 0x90 : lo;
+                hi    = s[0] == 0xF4 ? 0x8F : hi;
+            }
+            if (count == 0 || len < count || s[1] < lo || s[1] > hi)
+            {
+                return 0;
             }
-            else if (ui >= 0x04000000 && ui <= 0x7FFFFFFF) {
-                // * U-04000000 - U-7FFFFFFF:  1111110x 10xxxxxx 10xxxxxx 10xxxxxx 10xxxxxx 10xxxxxx
-                out.resize (len + 6);
-                out[len + 5] = (ui & 0x3F) | 0x80;
-                out[len + 4] = ((ui >> 6) & 0x3F) | 0x80;
-                out[len + 3] = ((ui >> 12) & 0x3F) | 0x80;
-                out[len + 2] = ((ui >> 18) & 0x3F) | 0x80;
-                out[len + 1] = ((ui >> 24) & 0x3F) | 0x80;
-                out[len]     = ((ui >> 30) & 0x01) | 0xFC;
+            for (size_t pos = 2; pos < count; ++pos)
+            {
+                if ((s[pos] & 0xC0) != 0x80)
+                {
+                    return 0;
+                }
             }
+            return count;
         }
 
-        template<>
-        void
-        decode_unicode_append<wchar_t> (unsigned int ui, JSON_TSTRING (wchar_t) & out)
+        /** Wide input is not UTF-8, every unit is accepted. */
+        inline size_t
+        validate_utf8 (const wchar_t*, size_t)
         {
-            out += ui;
+            return 1;
         }
 
-        template<class char_t>
-        size_t
-        decode_unicode (const char_t* in, size_t len, JSON_TSTRING (char_t) & out)
+        static const uint64_t WORD_ONES  = 0x0101010101010101ull;
+        static const uint64_t WORD_HIGHS = 0x8080808080808080ull;
+
+        /** True if any of the 8 bytes of word is zero. */
+        inline bool
+        word_has_zero (uint64_t word)
+        {
+            return ((word - WORD_ONES) & ~word & WORD_HIGHS) != 0;
+        }
+
+        /**
+                Offset of the first '"', '\\' or non-ASCII byte at or after pos
+                (len if none). Plain ASCII runs are skipped 8 bytes per step.
+            */
+        inline size_t
+        scan_string (const char* in, size_t pos, size_t len)
+        {
+            for (; pos + 8 <= len; pos += 8)
+            {
+                uint64_t word;
+                memcpy (&word, in + pos, 8);
+                if ((word & WORD_HIGHS) != 0 || word_has_zero (word ^ (WORD_ONES * '\"')) ||
+                    word_has_zero (word ^ (WORD_ONES * '\\')))
+                {
+                    break;
+                }
+            }
+            while (pos < len && in[pos] != '\"' && in[pos] != '\\' && static_cast<unsigned char> (in[pos]) < 0x80)
+            {
+                ++pos;
+            }
+            return pos;
+        }
+
+        inline size_t
+        scan_string (const wchar_t* in, size_t pos, size_t len)
+        {
+            while (pos < len && in[pos] != '\"' && in[pos] != '\\')
+            {
+                ++pos;
+            }
+            return pos;
+        }
+
+        /** Decode the UTF-8 sequence of count bytes at in (already validated). */
+        inline unsigned int
+        utf8_code_point (const char* in, size_t count)
+        {
+            const unsigned char* s  = reinterpret_cast<const unsigned char*> (in);
+            unsigned int         ch = count == 1 ? s[0] : s[0] & (0x7F >> count);
+            for (size_t pos = 1; pos < count; ++pos)
+            {
+                ch = (ch << 6) | (s[pos] & 0x3F);
+            }
+            return ch;
+        }
+
+        /**
+                Decode the XXXX (or surrogate pair XXXX\uXXXX) following "\u".
+                Return char_t count consumed, 0 if malformed.
+            */
+        template<class char_t, class string_t>
+        inline size_t
+        decode_unicode (const char_t* in, size_t len, string_t& out)
         {
-            size_t       ret = 4;
-            unsigned int ui  = hex_to_ushort (in, len);
+            unsigned int ui = 0;
+            if (!hex_to_unit (in, len, ui) || (ui >= 0xDC00 && ui <= 0xDFFF))
+            {
+                return 0;
+            }
             if (ui >= 0xD800 && ui < 0xDC00)
             {
-                JSON_DECODE_CHECK (len >= 6 && in[4] == '\\' && in[5] == 'u');
-                ui = (ui & 0x3FF) << 10;
-                ui += (hex_to_ushort (in + 6, len - 6) & 0x3FF) + 0x10000;
-                ret += 6;
+                unsigned int low = 0;
+                if (len < 10 || in[4] != '\\' || in[5] != 'u' || !hex_to_unit (in + 6, len - 6, low) ||
+                    low < 0xDC00 || low > 0xDFFF)
+                {
+                    return 0;
+                }
+                decode_unicode_append (0x10000 + ((ui & 0x3FF) << 10) + (low & 0x3FF), out);
+                return 10;
             }
-            decode_unicode_append<char_t> (ui, out);
-            return ret;
+            decode_unicode_append (ui, out);
+            return 4;
         }
 
-        template<class char_t>
-        void
-        decode (const char_t* in, size_t len, JSON_TSTRING (char_t) & out)
+        /**
+                Decode escapes, unescaped runs are appended as a whole.
+                Return char_t count decoded, less than len if a malformed escape
+                starts at that offset.
+            */
+        template<class char_t, class string_t>
+        size_t
+        try_decode (const char_t* in, size_t len, string_t& out)
         {
+            size_t start = 0;
             for (size_t pos = 0; pos < len; ++pos)
             {
+                if (in[pos] != '\\')
+                {
+                    continue;
+                }
+                out.append (in + start, pos - start);
+                start = pos;
+                if (++pos == len)
+                {
+                    return start;
+                }
                 switch (in[pos])
                 {
+                    case '\"':
                     case '\\':
-                        JSON_PARSE_CHECK (pos + 1 < len);
-                        ++pos;
-                        switch (in[pos])
+                    case '/':
+                        out += in[pos];
+                        break;
+                    case 'b':
+                        out += '\b';
+                        break;
+                    case 'f':
+                        out += '\f';
+                        break;
+                    case 'n':
+                        out += '\n';
+                        break;
+                    case 'r':
+                        out += '\r';
+                        break;
+                    case 't':
+                        out += '\t';
+                        break;
+                    case 'u':
+                    {
+                        size_t count = decode_unicode (in + pos + 1, len - pos - 1, out);
+                        if (count == 0)
                         {
-                            case '\"':
-                            case '\\':
-                            case '/':
-                                out += in[pos];
-                                break;
-                            case 'b':
-                                out += '\b';
-                                break;
-                            case 'f':
-                                out += '\f';
-                                break;
-                            case 'n':
-                                out += '\n';
-                                break;
-                            case 'r':
-                                out += '\r';
-                                break;
-                            case 't':
-                                out += '\t';
-                                break;
-                            case 'u':
-                                pos += decode_unicode<char_t> (in + pos + 1, len - pos - 1, out);
-                                break;
-                            default:
-                                JSON_PARSE_CHECK (false);
+                            return start;
                         }
+                        pos += count;
                         break;
+                    }
                     default:
-                        out += in[pos];
-                        break;
+                        return start;
                 }
+                start = pos + 1;
             }
+            out.append (in + start, len - start);
+            return len;
+        }
+
+        template<class char_t, class string_t>
+        void
+        decode (const char_t* in, size_t len, string_t& out)
+        {
+            JSON_DECODE_CHECK (try_decode (in, len, out) == len);
         }
 
         template<class char_t>
@@ -703,130 +1066,413 @@ namespace detail {
             return ch > 127;
         }
 
-       /*
-        * May suffer performance degradation, use `find` or `count + []` then call o() to get reference instead.
-        */
-        template<class char_t, class T>
-        typename json_enable_if<json_is_same<ObjectT<char_t>, T>::value, T>::type
-        internal_type_casting (const JSON::ValueT<char_t>& v, const T& value)
+        template<class char_t, class alloc_t>
+        inline bool
+        try_type_casting (const JSON::ValueT<char_t, alloc_t>& v, ObjectT<char_t, alloc_t>& out)
         {
-            switch (v.type ())
+            if (v.type () != OBJECT)
             {
-                case NIL:
-                    break;
-                case OBJECT:
-                    return T (v.o ());
-                default:
-                    JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: from (%s) type to object.", get_type_name (v.type ()));
+                return false;
             }
-            return T (value);
+            out = v.o ();
+            return true;
         }
 
-       /*
-        * May suffer performance degradation, use `find` or `count + []` then call a() to get reference instead.
-        */
-        template<class char_t, class T>
-        typename json_enable_if<json_is_same<ArrayT<char_t>, T>::value, T>::type
-        internal_type_casting (const JSON::ValueT<char_t>& v, const T& value)
+        template<class char_t, class alloc_t>
+        inline bool
+        try_type_casting (const JSON::ValueT<char_t, alloc_t>& v, ArrayT<char_t, alloc_t>& out)
         {
-            switch (v.type ())
+            if (v.type () != ARRAY)
             {
-                case NIL:
-                    break;
-                case ARRAY:
-                    return T (v.a ());
-                default:
-                    JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: from (%s) type to array.", get_type_name (v.type ()));
+                return false;
             }
-            return T (value);
+            out = v.a ();
+            return true;
         }
 
-        template<class char_t, class T>
-        typename json_enable_if<json_is_arithmetic<T>::value, T>::type
-        internal_type_casting (const JSON::ValueT<char_t>& v, const T& value)
+        template<class char_t, class alloc_t, class T>
+        typename json_enable_if<json_is_arithmetic<T>::value, bool>::type
+        try_type_casting (const JSON::ValueT<char_t, alloc_t>& v, T& out)
         {
             switch (v.type ())
             {
-                case NIL:
-                    break;
                 case INTEGER:
-                    return T (v.i ());
+                    out = T (v.i ());
+                    return true;
                 case FLOAT:
-                    return T (v.f ());
+                    out = T (v.f ());
+                    return true;
                 case BOOLEAN:
-                    return T (v.b ());
+                    out = T (v.b ());
+                    return true;
                 case STRING:
                     if (v.s () == boolean_true<char_t> ())
                     {
-                        return T (1);
+                        out = T (1);
+                        return true;
                     }
                     else if (v.s () == boolean_false<char_t> ())
                     {
-                        return T (0);
+                        out = T (0);
+                        return true;
                     }
                     else
                     {
                         char_t* end = 0;
                         double  d   = ttod (v.s ().c_str (), &end);
-                        JSON_INTERNAL_ASSERT_CHECK_EX(end == &v.s ()[0] + v.s ().length (), "Type-casting error: (%s) to arithmetic.", convert_json_string (v.s ()).c_str ());
-                        return T (d);
+                        if (end != &v.s ()[0] + v.s ().length ())
+                        {
+                            return false;
+                        }
+                        out = T (d);
+                        return true;
                     }
-                    JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: (%s) to arithmetic.", convert_json_string (v.s ()).c_str ());
                 default:
-                    JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: from (%s) type to arithmetic.", get_type_name (v.type ()));
+                    break;
             }
-            return T (value);
+            return false;
         }
 
-        template<class char_t, class T>
-        typename json_enable_if<json_is_same<JSON_TSTRING (char_t), T>::value, T>::type
-        internal_type_casting (const JSON::ValueT<char_t>& v, const T& value)
+        template<class char_t, class alloc_t, class S>
+        inline bool
+        try_type_casting (const JSON::ValueT<char_t, alloc_t>& v, std::basic_string<char_t, std::char_traits<char_t>, S>& out)
         {
             switch (v.type ())
             {
-                case NIL:
-                    break;
                 case INTEGER:
-                    return to_string<int64_t, char_t> (v.i ());
+                    out.clear ();
+                    to_string (v.i (), out);
+                    return true;
                 case FLOAT:
-                    return to_string<double, char_t> (v.f ());
+                    out.clear ();
+                    to_string (static_cast<double> (v.f ()), out);
+                    return true;
                 case BOOLEAN:
-                    return T (v.b () ? detail::boolean_true<char_t> () : detail::boolean_false<char_t> ());
+                    out = v.b () ? detail::boolean_true<char_t> () : detail::boolean_false<char_t> ();
+                    return true;
                 case STRING:
-                    return T (v.s ());
+                    out.assign (v.s ().data (), v.s ().length ());
+                    return true;
                 default:
-                    JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: from (%s) type to string.", get_type_name(v.type()));
+                    break;
+            }
+            return false;
+        }
+
+        template<class char_t, class alloc_t>
+        inline const char*
+        type_casting_name (const ObjectT<char_t, alloc_t>*)
+        {
+            return "object";
+        }
+
+        template<class char_t, class alloc_t>
+        inline const char*
+        type_casting_name (const ArrayT<char_t, alloc_t>*)
+        {
+            return "array";
+        }
+
+        template<class char_t, class S>
+        inline const char*
+        type_casting_name (const std::basic_string<char_t, std::char_traits<char_t>, S>*)
+        {
+            return "string";
+        }
+
+        template<class T>
+        inline const char*
+        type_casting_name (const T*)
+        {
+            return "arithmetic";
+        }
+
+       /*
+        * Object/Array are copied, may suffer performance degradation, use `find` or
+        * `count + []` then call o()/a() to get reference instead.
+        */
+        template<class char_t, class alloc_t, class T>
+        T
+        internal_type_casting (const JSON::ValueT<char_t, alloc_t>& v, const T& value)
+        {
+            if (v.type () == NIL)
+            {
+                return T (value);
             }
-            return T (value);
+            T out = T ();
+            JSON_INTERNAL_ASSERT_CHECK_EX(try_type_casting (v, out), "Type-casting error: from (%s) type to %s.",
+                                          get_type_name (v.type ()), type_casting_name (static_cast<const T*> (0)));
+            return out;
         }
     } // namespace
 } // namespace detail
 
-template<class char_t>
+template<class S>
+inline size_t
+utf8_to_wide (const char* in, size_t len, std::basic_string<wchar_t, std::char_traits<wchar_t>, S>& out)
+{
+    out.reserve (out.length () + len);
+    size_t pos = 0;
+    while (pos < len)
+    {
+        // ASCII runs are widened 8 bytes per step.
+        uint64_t word;
+        if (pos + 8 <= len && (memcpy (&word, in + pos, 8), (word & detail::WORD_HIGHS) == 0))
+        {
+            for (size_t end = pos + 8; pos < end; ++pos)
+            {
+                out += static_cast<wchar_t> (in[pos]);
+            }
+            continue;
+        }
+        size_t count = detail::validate_utf8 (in + pos, len - pos);
+        if (count == 0)
+        {
+            return pos;
+        }
+        detail::decode_unicode_append (detail::utf8_code_point (in + pos, count), out);
+        pos += count;
+    }
+    return pos;
+}
+
+template<class S>
+inline size_t
+wide_to_utf8 (const wchar_t* in, size_t len, std::basic_string<char, std::char_traits<char>, S>& out)
+{
+    out.reserve (out.length () + len);
+    size_t pos = 0;
+    while (pos < len)
+    {
+        unsigned int ch = static_cast<unsigned int> (in[pos]);
+        if (ch < 0x80)
+        {
+            out += static_cast<char> (ch);
+            ++pos;
+            continue;
+        }
+        size_t count = 1;
+        if (sizeof (wchar_t) == 2 && ch >= 0xD800 && ch < 0xDC00 && pos + 1 < len &&
+            in[pos + 1] >= 0xDC00 && in[pos + 1] <= 0xDFFF)
+        {
+            ch    = 0x10000 + ((ch & 0x3FF) << 10) + (in[pos + 1] & 0x3FF);
+            count = 2;
+        }
+        else if ((ch >= 0xD800 && ch <= 0xDFFF) || ch > 0x10FFFF)
+        {
+            return pos;
+        }
+        detail::decode_unicode_append (ch, out);
+        pos += count;
+    }
+    return pos;
+}
+
+namespace detail {
+    /** Store a string read from the input, transcoding UTF-8 to wchar_t if needed. */
+    template<class char_t, class string_t>
+    inline void
+    assign_text (const char_t* in, size_t len, string_t& out)
+    {
+        out.assign (in, len);
+    }
+
+    template<class S>
+    inline void
+    assign_text (const char* in, size_t len, std::basic_string<wchar_t, std::char_traits<wchar_t>, S>& out)
+    {
+        out.clear ();
+        utf8_to_wide (in, len, out);
+    }
+
+    /**
+            Number text kept by ReadOptions::raw_numbers, packed four bits a
+            character into the code units of a string: the text of a double
+            (up to 30 characters in a std::string) stays in the small string
+            buffer instead of costing an allocation per number.
+        */
+    template<class char_t>
+    struct packed_number
+    {
+        enum
+        {
+            PER_UNIT = sizeof (char_t) * 2,
+            END      = 0xF
+        };
+
+        static unsigned int
+        pack_char (unsigned int ch)
+        {
+            switch (ch)
+            {
+                case '-':
+                    return 10;
+                case '+':
+                    return 11;
+                case '.':
+                    return 12;
+                case 'e':
+                    return 13;
+                case 'E':
+                    return 14;
+            }
+            return ch - '0';
+        }
+
+        /** Pack the number text (validated by EventReaderT) into out. */
+        template<class in_char_t, class string_t>
+        static void
+        pack (const in_char_t* in, size_t len, string_t& out)
+        {
+            out.resize ((len + PER_UNIT - 1) / PER_UNIT);
+            for (size_t unit = 0; unit < out.length (); ++unit)
+            {
+                uint64_t bits = 0;
+                for (size_t nibble = 0; nibble < PER_UNIT; ++nibble)
+                {
+                    size_t pos = unit * PER_UNIT + nibble;
+                    bits |= static_cast<uint64_t> (pos < len ? pack_char (static_cast<unsigned int> (in[pos])) : static_cast<unsigned int> (END)) << (4 * nibble);
+                }
+                out[unit] = static_cast<char_t> (bits);
+            }
+        }
+
+        /** Unpack into out, which has room for packed.length () * PER_UNIT characters. Return the text length. */
+        template<class string_t>
+        static size_t
+        unpack (const string_t& packed, char_t* out)
+        {
+            static const char symbols[] = "0123456789-+.eE";
+            const uint64_t    mask      = (static_cast<uint64_t> (1) << (8 * sizeof (char_t))) - 1;
+            size_t            len       = 0;
+            for (size_t unit = 0; unit < packed.length (); ++unit)
+            {
+                uint64_t bits = static_cast<uint64_t> (packed[unit]) & mask;
+                for (size_t nibble = 0; nibble < PER_UNIT; ++nibble, bits >>= 4)
+                {
+                    if ((bits & 0xF) == END)
+                    {
+                        return len;
+                    }
+                    out[len++] = static_cast<char_t> (symbols[bits & 0xF]);
+                }
+            }
+            return len;
+        }
+    };
+
+    /** The unpacked, NUL terminated text of a packed_number. */
+    template<class char_t>
+    class number_text
+    {
+    public:
+        template<class string_t>
+        explicit number_text (const string_t& packed)
+            : _text (_local)
+        {
+            size_t size = packed.length () * packed_number<char_t>::PER_UNIT + 1;
+            if (size > sizeof (_local) / sizeof (char_t))
+            {
+                _heap.resize (size);
+                _text = &_heap[0];
+            }
+            _length        = packed_number<char_t>::unpack (packed, _text);
+            _text[_length] = 0;
+        }
+
+        inline const char_t*
+        c_str () const
+        {
+            return _text;
+        }
+
+        inline size_t
+        length () const
+        {
+            return _length;
+        }
+
+    private:
+        char_t                    _local[64];
+        std::basic_string<char_t> _heap;
+        char_t*                   _text;
+        size_t                    _length;
+    };
+} // namespace detail
+
+template<class char_t, class alloc_t>
 template<class T>
 T
-JSON::ValueT<char_t>::get (const tstring& key, const T& value) const
+JSON::ValueT<char_t, alloc_t>::get (const tstring& key, const T& value) const
 {
     JSON_CHECK_TYPE (_type, OBJECT);
-    typename ObjectT<char_t>::const_iterator it = _object.find (key);
+    typename ObjectT<char_t, alloc_t>::const_iterator it = _object.find (key);
     if (it != _object.end ())
     {
-        return JSON_MOVE ((detail::internal_type_casting<char_t, T> (it->second, value)));
+        return JSON_MOVE ((detail::internal_type_casting<char_t, alloc_t, T> (it->second, value)));
     }
     return T (value);
 }
 
-template<class char_t>
+template<class char_t, class alloc_t>
+template<class T>
+bool
+JSON::ValueT<char_t, alloc_t>::try_get (const tstring& key, T& out) const
+{
+    const ValueT<char_t, alloc_t>* v = find (key);
+    return v != 0 && detail::try_type_casting (*v, out);
+}
+
+template<class char_t, class alloc_t>
+const ValueT<char_t, alloc_t>*
+ValueT<char_t, alloc_t>::find (const tstring& key) const
+{
+    if (_type != OBJECT)
+    {
+        return 0;
+    }
+    typename ObjectT<char_t, alloc_t>::const_iterator it = _object.find (key);
+    return it != _object.end () ? &it->second : 0;
+}
+
+template<class char_t, class alloc_t>
 void
-ValueT<char_t>::write (tstring& out) const
+ValueT<char_t, alloc_t>::write (tstring& out) const
+{
+    write (out, WriteOptions ());
+}
+
+template<class char_t, class alloc_t>
+void
+ValueT<char_t, alloc_t>::write (tstring& out, const WriteOptions& options, size_t depth) const
 {
     switch (_type)
     {
         case INTEGER:
-            detail::to_string (_integer, out);
+            if (!options.canonical && raw_number ())
+            {
+                detail::number_text<char_t> text (_string);
+                out.append (text.c_str (), text.length ());
+            }
+            else
+            {
+                detail::to_string (i (), out);
+            }
             break;
         case FLOAT:
-            detail::to_string (_float, out);
+            if (options.canonical)
+            {
+                detail::to_canonical_string (static_cast<double> (f ()), out);
+            }
+            else if (raw_number ())
+            {
+                detail::number_text<char_t> text (_string);
+                out.append (text.c_str (), text.length ());
+            }
+            else
+            {
+                detail::to_string (static_cast<double> (f ()), out);
+            }
             break;
         case BOOLEAN:
             out += (_boolean ? detail::boolean_true<char_t> () : detail::boolean_false<char_t> ());
@@ -838,7 +1484,7 @@ ValueT<char_t>::write (tstring& out) const
             out += '\"';
             if (_needConv)
             {
-                detail::encode (_string.c_str (), _string.length (), out);
+                detail::encode (_string.c_str (), _string.length (), out, options);
             }
             else
             {
@@ -847,10 +1493,10 @@ ValueT<char_t>::write (tstring& out) const
             out += '\"';
             break;
         case ARRAY:
-            WriterT<char_t>::write (_array, out);
+            WriterT<char_t, alloc_t>::write (_array, out, options, depth);
             break;
         case OBJECT:
-            WriterT<char_t>::write (_object, out);
+            WriterT<char_t, alloc_t>::write (_object, out, options, depth);
             break;
     }
 }
@@ -888,9 +1534,9 @@ ValueT<char_t>::write (tstring& out) const
     case ']':          \
     case '}':
 
-template<class char_t>
+template<class char_t, class alloc_t>
 size_t
-ValueT<char_t>::read_string (const char_t* in, size_t len)
+ValueT<char_t, alloc_t>::read_string (const char_t* in, size_t len)
 {
     enum
     {
@@ -962,9 +1608,9 @@ ValueT<char_t>::read_string (const char_t* in, size_t len)
     JSON_PARSE_CHECK (false);
 }
 
-template<class char_t>
+template<class char_t, class alloc_t>
 size_t
-ValueT<char_t>::read_number (const char_t* in, size_t len)
+ValueT<char_t, alloc_t>::read_number (const char_t* in, size_t len)
 {
     enum
     {
@@ -1132,15 +1778,15 @@ GOTO_END:
             clear ();
             _type  = FLOAT;
             _float = detail::ttod<char_t> (in + start, &end);
-            JSON_PARSE_CHECK (end == in + pos);
+            JSON_PARSE_CHECK (end == in + pos && std::isfinite (_float));
             return pos;
     }
     JSON_PARSE_CHECK (false);
 }
 
-template<class char_t>
+template<class char_t, class alloc_t>
 size_t
-ValueT<char_t>::read_nil (const char_t* in, size_t len)
+ValueT<char_t, alloc_t>::read_nil (const char_t* in, size_t len)
 {
     size_t pos = 0;
     while (pos < len)
@@ -1165,9 +1811,9 @@ ValueT<char_t>::read_nil (const char_t* in, size_t len)
     JSON_PARSE_CHECK (false);
 }
 
-template<class char_t>
+template<class char_t, class alloc_t>
 size_t
-ValueT<char_t>::read_boolean (const char_t* in, size_t len)
+ValueT<char_t, alloc_t>::read_boolean (const char_t* in, size_t len)
 {
     size_t pos = 0;
     while (pos < len)
@@ -1204,330 +1850,284 @@ ValueT<char_t>::read_boolean (const char_t* in, size_t len)
     JSON_PARSE_CHECK (false);
 }
 
-#define OBJECT_ARRAY_PARSE_END(type)              \
-    JSON_PARSE_CHECK (pv.back ()->_type == type); \
-    pv.pop_back ();                               \
-    if (pv.empty ())                              \
-    {                                             \
-        /* Object/Array parse finished. */        \
-        return pos + 1;                           \
-    }                                             \
-    if (pv.back ()->_type == OBJECT)              \
-    {                                             \
-        state = OBJECT_PAIR_VALUE;                \
-    }                                             \
-    else if (pv.back ()->_type == ARRAY)          \
-    {                                             \
-        state = ARRAY_ELEM;                       \
-    }
-
-#define PUSH_VALUE_TO_STACK(type)                                     \
-    if (pv.back ()->_type == NIL)                                     \
-    {                                                                 \
-        /* Object */                                                  \
-        pv.back ()->_type = type;                                     \
-    }                                                                 \
-    else                                                              \
-    {                                                                 \
-        /* Array */                                                   \
-        pv.back ()->_array.push_back (JSON_MOVE (ValueT<char_t> ())); \
-        pv.back ()->_array.back ()._type = type;                      \
-        pv.push_back (&pv.back ()->_array.back ());                   \
-    }
-
-template<class char_t>
+template<class char_t, class alloc_t>
 size_t
-ValueT<char_t>::read (const char_t* in, size_t len)
+ValueT<char_t, alloc_t>::read (const char_t* in, size_t len, const ReadOptions& options)
 {
-    // Indicate current parse state
-    enum
+    ParseResult  result = parse (in, len, options);
+    const size_t pos    = result.offset;
+    JSON_PARSE_CHECK (result.ok ());
+    return pos;
+}
+
+template<class char_t, class alloc_t>
+ParseResult
+ValueT<char_t, alloc_t>::parse (const char_t* in, size_t len, const ReadOptions& options)
+{
+    EventReaderT<char_t> reader (in, len, options);
+    return parse (reader);
+}
+
+template<class char_t, class alloc_t>
+ParseResult
+ValueT<char_t, alloc_t>::parse_utf8 (const char* in, size_t len, const ReadOptions& options)
+{
+    EventReaderT<char> reader (in, len, options);
+    return parse (reader);
+}
+
+template<class char_t, class alloc_t>
+template<class in_char_t>
+ParseResult
+ValueT<char_t, alloc_t>::parse (EventReaderT<in_char_t>& reader)
+{
+    Event e = reader.try_next ();
+    if (e != EVENT_OBJECT_BEGIN && e != EVENT_ARRAY_BEGIN)
     {
-        NONE = 0,
+        return ParseResult (reader.error () != PARSE_OK ? reader.error () : PARSE_NOT_CONTAINER, reader.offset ());
+    }
 
-        /* { */
-        OBJECT_LBRACE,
-        /* {" ," */
-        OBJECT_PAIR_KEY_QUOTE,
-        /* "..." */
-        OBJECT_PAIR_KEY,
-        /* "...": */
-        OBJECT_PAIR_COLON,
-        /* "...": "..." */
-        OBJECT_PAIR_VALUE,
-        /* {..., */
-        OBJECT_COMMA,
-
-        /* [ */
-        ARRAY_LBRACKET,
-        /* [...  [...,... */
-        ARRAY_ELEM,
-        /* [..., */
-        ARRAY_COMMA
-    };
-    unsigned char state = NONE;
-    size_t        pos   = 0;
-    union
-    {
-        size_t start;
-        size_t (ValueT<char_t>::*fp) (const char_t*, size_t);
-    } u;
-    memset (&u, 0, sizeof (u));
-    vector<ValueT<char_t>*> pv (1, this);
-    ValueT<char_t>          v;
-    while (pos < len)
+    // Objects/arrays currently open, and the member the last key selected.
+    vector<ValueT<char_t, alloc_t>*> pv;
+    ValueT<char_t, alloc_t>*         member = 0;
+    tstring                 key;
+    for (;; e = reader.try_next ())
     {
-        switch (state)
+        ValueT<char_t, alloc_t>* v = this;
+        if (!pv.empty ())
         {
-            case NONE:
-                // Topmost value parse.
-                switch (in[pos])
-                {
-                    case '{':
-                        state = OBJECT_LBRACE;
-                        clear ();
-                        _type = OBJECT;
-                        break;
-                    case '[':
-                        state = ARRAY_LBRACKET;
-                        clear ();
-                        _type = ARRAY;
-                        break;
-                        SKIP_WHITE_SPACE_CASES
-                    default:
-                        JSON_PARSE_CHECK (false);
-                }
+            ValueT<char_t, alloc_t>* top = pv.back ();
+            if (top->_type != ARRAY)
+            {
+                v = member;
+            }
+            else if (e != EVENT_ARRAY_END && e != EVENT_END)
+            {
+                top->_array.push_back (JSON_MOVE ((ValueT<char_t, alloc_t> ())));
+                v = &top->_array.back ();
+            }
+        }
+        switch (e)
+        {
+            case EVENT_KEY:
+                detail::assign_text (reader.str (), reader.length (), key);
+                member = &pv.back ()->_object[key];
                 break;
-
-            case OBJECT_LBRACE:
-            case OBJECT_COMMA:
-                switch (in[pos])
-                {
-                    case '\"':
-                        state   = OBJECT_PAIR_KEY_QUOTE;
-                        u.start = pos + 1;
-                        break;
-                    case '}':
-                        if (state == OBJECT_LBRACE)
-                        {
-                            OBJECT_ARRAY_PARSE_END (OBJECT);
-                        }
-                        else
-                        {
-                            JSON_PARSE_CHECK (false);
-                        }
-                        break;
-                        SKIP_WHITE_SPACE_CASES
-                    default:
-                        JSON_PARSE_CHECK (false);
-                }
+            case EVENT_NIL:
+                v->clear ();
                 break;
-
-            case OBJECT_PAIR_KEY_QUOTE:
-                switch (in[pos])
+            case EVENT_INTEGER:
+                if (reader.options ().raw_numbers)
                 {
-                    case '\\':
-                        if (in[pos + 1] != 'u')
-                        {
-                            ++pos;
-                            while (pos < len)
-                            {
-                                if (in[pos + 1] == '\"' && in[pos] != '\\')
-                                {
-                                    break;
-                                }
-                                ++pos;
-                            }
-                            if (pos >= len)
-                            {
-                                JSON_PARSE_CHECK (false);
-                            }
-                        }
-                        break;
-                    case '\"':
-                        state = OBJECT_PAIR_KEY;
-                        // Insert a value
-                        v.read_string (in + u.start - 1, pos - u.start + 1 + 1);
-                        pv.push_back (&pv.back ()->_object[JSON_MOVE (v._string)]);
-                        v.clear ();
-                        u.start = 0;
-                        break;
-                    default:
-                        break;
+                    v->assign_number (INTEGER, reader.str (), reader.length ());
                 }
-                break;
-
-            case OBJECT_PAIR_KEY:
-                switch (in[pos])
+                else
                 {
-                    case ':':
-                        state = OBJECT_PAIR_COLON;
-                        break;
-                        SKIP_WHITE_SPACE_CASES
-                    default:
-                        JSON_PARSE_CHECK (false);
+                    v->assign (reader.integer ());
                 }
                 break;
-
-            case OBJECT_PAIR_COLON:
-            case ARRAY_LBRACKET:
-            case ARRAY_COMMA:
-                switch (in[pos])
+            case EVENT_FLOAT:
+                if (reader.options ().raw_numbers)
                 {
-                    case '\"':
-                        u.fp = &ValueT::read_string;
-                        break;
-                    case '-':
-                        NUMBER_0_9_CASES
-                        u.fp = &ValueT::read_number;
-                        break;
-                    case 't':
-                    case 'f':
-                        u.fp = &ValueT::read_boolean;
-                        break;
-                    case 'n':
-                        u.fp = &ValueT::read_nil;
-                        break;
-                    case '{':
-                        state = OBJECT_LBRACE;
-                        PUSH_VALUE_TO_STACK (OBJECT);
-                        break;
-                    case '[':
-                        state = ARRAY_LBRACKET;
-                        PUSH_VALUE_TO_STACK (ARRAY);
-                        break;
-                    case ']':
-                        if (state == ARRAY_LBRACKET)
-                        {
-                            OBJECT_ARRAY_PARSE_END (ARRAY);
-                        }
-                        else
-                        {
-                            JSON_PARSE_CHECK (false);
-                        }
-                        break;
-                        SKIP_WHITE_SPACE_CASES
-                    default:
-                        JSON_PARSE_CHECK (false);
+                    v->assign_number (FLOAT, reader.str (), reader.length ());
                 }
-                if (u.fp)
+                else
                 {
-                    // If top elem is array, push a elem.
-                    if (pv.back ()->_type == ARRAY)
-                    {
-                        pv.back ()->_array.push_back (JSON_MOVE (ValueT<char_t> ()));
-                        pv.push_back (&pv.back ()->_array.back ());
-                    }
-                    // ++pos at last, so minus 1 here.
-                    pos += (pv.back ()->*u.fp) (in + pos, len - pos) - 1;
-                    u.fp = 0;
-                    // pop nil/number/boolean/string Value
-                    pv.pop_back ();
-                    JSON_PARSE_CHECK (!pv.empty ());
-                    switch (pv.back ()->_type)
-                    {
-                        case OBJECT:
-                            state = OBJECT_PAIR_VALUE;
-                            break;
-                        case ARRAY:
-                            state = ARRAY_ELEM;
-                            break;
-                        default:
-                            JSON_PARSE_CHECK (false);
-                    }
+                    v->assign (reader.real ());
                 }
                 break;
-
-            case OBJECT_PAIR_VALUE:
-                switch (in[pos])
-                {
-                    case '}':
-                        OBJECT_ARRAY_PARSE_END (OBJECT);
-                        break;
-                    case ',':
-                        state = OBJECT_COMMA;
-                        break;
-                        SKIP_WHITE_SPACE_CASES
-                    default:
-                        JSON_PARSE_CHECK (false);
-                }
+            case EVENT_BOOLEAN:
+                v->assign (reader.boolean ());
                 break;
-
-            case ARRAY_ELEM:
-                switch (in[pos])
+            case EVENT_STRING:
+                v->clear ();
+                v->_type     = STRING;
+                v->_needConv = true;
+                detail::assign_text (reader.str (), reader.length (), v->_string);
+                break;
+            case EVENT_OBJECT_BEGIN:
+                v->clear ();
+                v->_type = OBJECT;
+                pv.push_back (v);
+                break;
+            case EVENT_ARRAY_BEGIN:
+                v->clear ();
+                v->_type = ARRAY;
+                pv.push_back (v);
+                break;
+            case EVENT_OBJECT_END:
+            case EVENT_ARRAY_END:
+                pv.pop_back ();
+                if (pv.empty ())
                 {
-                    case ']':
-                        OBJECT_ARRAY_PARSE_END (ARRAY);
-                        break;
-                    case ',':
-                        state = ARRAY_COMMA;
-                        break;
-                        SKIP_WHITE_SPACE_CASES
-                    default:
-                        JSON_PARSE_CHECK (false);
+                    /* Object/Array parse finished. */
+                    return ParseResult (PARSE_OK, reader.offset ());
                 }
                 break;
+            case EVENT_END:
+                return ParseResult (reader.error (), reader.offset ());
         }
-        ++pos;
     }
-    JSON_PARSE_CHECK (false);
 }
 
-template<class char_t>
+template<class char_t, class alloc_t>
+template<class in_char_t>
 void
-WriterT<char_t>::write (const ObjectT<char_t>& o, JSON_TSTRING (char_t) & out)
+ValueT<char_t, alloc_t>::assign_number (Type type, const in_char_t* in, size_t len)
 {
-    out += '{';
-    bool first_elem = true;
-    for (typename ObjectT<char_t>::const_iterator it = o.begin (); it != o.end (); ++it)
+    clear ();
+    _type = type;
+    _lazy = true;
+    detail::packed_number<char_t>::pack (in, len, _string);
+}
+
+template<class char_t, class alloc_t>
+void
+ValueT<char_t, alloc_t>::convert_number () const
+{
+    // The text was validated by EventReaderT.
+    detail::number_text<char_t> text (_string);
+    char_t*                     end = 0;
+    if (_type == INTEGER)
+    {
+        _integer = detail::ttoi64<char_t> (text.c_str (), &end);
+    }
+    else
+    {
+        _float = detail::ttod<char_t> (text.c_str (), &end);
+    }
+    _lazy = false;
+}
+
+template<class char_t, class alloc_t>
+bool
+ValueT<char_t, alloc_t>::raw_number () const
+{
+    if (_string.empty ())
     {
-        if (first_elem)
+        return false;
+    }
+    if (_lazy)
+    {
+        return true;
+    }
+    // Converted already: i ()/f () handed out a reference that may have
+    // been written through, keep the text only if it still reads the same.
+    detail::number_text<char_t> text (_string);
+    char_t*                     end = 0;
+    return _type == INTEGER ? detail::ttoi64<char_t> (text.c_str (), &end) == _integer
+                            : detail::ttod<char_t> (text.c_str (), &end) == _float;
+}
+
+template<class char_t, class alloc_t>
+void
+WriterT<char_t, alloc_t>::write (const ObjectT<char_t, alloc_t>& o, JSON_TSTRING_A (char_t, alloc_t) & out)
+{
+    write (o, out, WriteOptions ());
+}
+
+template<class char_t, class alloc_t>
+void
+WriterT<char_t, alloc_t>::write (const ArrayT<char_t, alloc_t>& a, JSON_TSTRING_A (char_t, alloc_t) & out)
+{
+    write (a, out, WriteOptions ());
+}
+
+template<class char_t, class alloc_t>
+void
+WriterT<char_t, alloc_t>::write_indent (JSON_TSTRING_A (char_t, alloc_t) & out, const WriteOptions& options, size_t depth)
+{
+    if (options.indent != 0)
+    {
+        out += '\n';
+        out.append (options.indent * depth, ' ');
+    }
+}
+
+template<class char_t, class alloc_t>
+void
+WriterT<char_t, alloc_t>::write (const ObjectT<char_t, alloc_t>& o, JSON_TSTRING_A (char_t, alloc_t) & out, const WriteOptions& options, size_t depth)
+{
+    typedef typename ObjectT<char_t, alloc_t>::const_iterator iterator;
+
+    // Keys are already sorted by code unit, re-sort only the objects whose
+    // keys compare differently in UTF-16.
+    std::vector<iterator> sorted;
+    if (options.canonical)
+    {
+        for (iterator it = o.begin (); it != o.end (); ++it)
         {
-            first_elem = false;
+            if (detail::utf16_order_differs (it->first))
+            {
+                sorted.reserve (o.size ());
+                for (it = o.begin (); it != o.end (); ++it)
+                {
+                    sorted.push_back (it);
+                }
+                std::sort (sorted.begin (), sorted.end (), detail::utf16_less<ObjectT<char_t, alloc_t>> ());
+                break;
+            }
         }
-        else
+    }
+
+    out += '{';
+    size_t pos = 0;
+    for (iterator it = o.begin (); it != o.end (); ++it, ++pos)
+    {
+        const iterator& elem = sorted.empty () ? it : sorted[pos];
+        if (pos != 0)
         {
             out += ',';
         }
+        write_indent (out, options, depth + 1);
         out += '\"';
-        out += it->first;
+        detail::encode (elem->first.c_str (), elem->first.length (), out, options);
         out += '\"';
         out += ':';
-        it->second.write (out);
+        if (options.indent != 0)
+        {
+            out += ' ';
+        }
+        elem->second.write (out, options, depth + 1);
+    }
+    if (!o.empty ())
+    {
+        write_indent (out, options, depth);
     }
     out += '}';
 }
 
-template<class char_t>
+template<class char_t, class alloc_t>
 void
-WriterT<char_t>::write (const ArrayT<char_t>& a, JSON_TSTRING (char_t) & out)
+WriterT<char_t, alloc_t>::write (const ArrayT<char_t, alloc_t>& a, JSON_TSTRING_A (char_t, alloc_t) & out, const WriteOptions& options, size_t depth)
 {
     out += '[';
-    bool first_elem = true;
-    for (typename ArrayT<char_t>::const_iterator it = a.begin (); it != a.end (); ++it)
+    for (typename ArrayT<char_t, alloc_t>::const_iterator it = a.begin (); it != a.end (); ++it)
     {
-        if (first_elem)
-        {
-            first_elem = false;
-        }
-        else
+        if (it != a.begin ())
         {
             out += ',';
         }
-        it->write (out);
+        write_indent (out, options, depth + 1);
+        it->write (out, options, depth + 1);
+    }
+    if (!a.empty ())
+    {
+        write_indent (out, options, depth);
     }
     out += ']';
 }
 
-template<class char_t>
+template<class char_t, class alloc_t>
 bool
-operator== (const ObjectT<char_t>& lhs, const ObjectT<char_t>& rhs)
+operator== (const ObjectT<char_t, alloc_t>& lhs, const ObjectT<char_t, alloc_t>& rhs)
 {
     if (lhs.size () != rhs.size ())
     {
         return false;
     }
-    typename ObjectT<char_t>::const_iterator lit = lhs.begin ();
-    typename ObjectT<char_t>::const_iterator rit = rhs.begin ();
+    typename ObjectT<char_t, alloc_t>::const_iterator lit = lhs.begin ();
+    typename ObjectT<char_t, alloc_t>::const_iterator rit = rhs.begin ();
     for (; lit != lhs.end (); ++lit, ++rit)
     {
         if (lit->first != rit->first)
@@ -1542,9 +2142,9 @@ operator== (const ObjectT<char_t>& lhs, const ObjectT<char_t>& rhs)
     return true;
 }
 
-template<class char_t>
+template<class char_t, class alloc_t>
 bool
-operator== (const ArrayT<char_t>& lhs, const ArrayT<char_t>& rhs)
+operator== (const ArrayT<char_t, alloc_t>& lhs, const ArrayT<char_t, alloc_t>& rhs)
 {
     if (lhs.size () != rhs.size ())
     {
@@ -1560,9 +2160,9 @@ operator== (const ArrayT<char_t>& lhs, const ArrayT<char_t>& rhs)
     return true;
 }
 
-template<class char_t>
+template<class char_t, class alloc_t>
 bool
-operator== (const ValueT<char_t>& lhs, const ValueT<char_t>& rhs)
+operator== (const ValueT<char_t, alloc_t>& lhs, const ValueT<char_t, alloc_t>& rhs)
 {
     if (lhs.type () != rhs.type ())
     {
@@ -1588,12 +2188,12 @@ operator== (const ValueT<char_t>& lhs, const ValueT<char_t>& rhs)
     return true;
 }
 
-template<class char_t>
+template<class char_t, class alloc_t>
 std::vector<string>
-ValueT<char_t>::get_keys ()
+ValueT<char_t, alloc_t>::get_keys ()
 {
     std::vector<string>                      key_list;
-    typename ObjectT<char_t>::const_iterator lit = _object.begin ();
+    typename ObjectT<char_t, alloc_t>::const_iterator lit = _object.begin ();
     for (; lit != _object.end (); ++lit)
     {
         key_list.push_back (lit->first);
@@ -1602,12 +2202,12 @@ ValueT<char_t>::get_keys ()
     return key_list;
 }
 
-template<class char_t>
+template<class char_t, class alloc_t>
 std::vector<string>
-ValueT<char_t>::get_keys_like (const string& key_like)
+ValueT<char_t, alloc_t>::get_keys_like (const string& key_like)
 {
     std::vector<string>                      like_key_list;
-    typename ObjectT<char_t>::const_iterator lit = _object.begin ();
+    typename ObjectT<char_t, alloc_t>::const_iterator lit = _object.begin ();
     for (; lit != _object.end (); ++lit)
     {
         if (0 == strncmp (lit->first.c_str (), key_like.c_str (), strlen (key_like.c_str ())))
@@ -1619,6 +2219,945 @@ ValueT<char_t>::get_keys_like (const string& key_like)
     return like_key_list;
 }
 
+#define JSON_EVENT_CHECK(expression)                                                                \
+    JSON_INTERNAL_ASSERT_CHECK_EX (expression, "Parse error: in=%s pos=%u.",                            \
+                                                convert_json_string(tstring(_in, _len)).c_str (),       \
+                                                static_cast<unsigned int> (_pos))
+
+#define JSON_EVENT_EXPECT(expression, error)                                                        \
+    if ((expression) == false)                                                                      \
+    {                                                                                               \
+        return fail (error);                                                                        \
+    }
+
+namespace detail {
+    // EventReaderT parse states
+    enum
+    {
+        EVENT_STATE_VALUE = 0,     /* Topmost value, or after ':' and array ',' */
+        EVENT_STATE_VALUE_OR_END,  /* [ */
+        EVENT_STATE_KEY,           /* Object ',' */
+        EVENT_STATE_KEY_OR_END,    /* { */
+        EVENT_STATE_COMMA_OR_END,  /* After a value in object/array */
+        EVENT_STATE_DONE
+    };
+
+    template<class char_t>
+    inline bool
+    is_digit (char_t ch)
+    {
+        return '0' <= ch && ch <= '9';
+    }
+
+    /** Whether the validated integer literal [in, in + len) fits int64_t. */
+    template<class char_t>
+    inline bool
+    fits_int64 (const char_t* in, size_t len)
+    {
+        const char* limit = "9223372036854775807";
+        if (*in == '-')
+        {
+            limit = "9223372036854775808";
+            ++in;
+            --len;
+        }
+        if (len != 19)
+        {
+            return len < 19;
+        }
+        for (size_t i = 0; i < len; ++i)
+        {
+            if (in[i] != limit[i])
+            {
+                return in[i] < limit[i];
+            }
+        }
+        return true;
+    }
+
+    /** JSON type of the value an event belongs to. */
+    inline Type
+    event_type (Event e)
+    {
+        switch (e)
+        {
+            case EVENT_INTEGER:
+                return INTEGER;
+            case EVENT_FLOAT:
+                return FLOAT;
+            case EVENT_BOOLEAN:
+                return BOOLEAN;
+            case EVENT_STRING:
+            case EVENT_KEY:
+                return STRING;
+            case EVENT_OBJECT_BEGIN:
+            case EVENT_OBJECT_END:
+                return OBJECT;
+            case EVENT_ARRAY_BEGIN:
+            case EVENT_ARRAY_END:
+                return ARRAY;
+            default:
+                break;
+        }
+        return NIL;
+    }
+} // namespace detail
+
+template<class char_t>
+EventReaderT<char_t>::EventReaderT (const char_t* in, size_t len, const ReadOptions& options)
+    : _in (in)
+    , _len (len)
+    , _options (options)
+    , _pos (0)
+    , _state (detail::EVENT_STATE_VALUE)
+    , _event (EVENT_NIL)
+    , _error (PARSE_OK)
+    , _integer (0)
+    , _str (0)
+    , _length (0)
+{
+}
+
+template<class char_t>
+inline void
+EventReaderT<char_t>::skip_white_space ()
+{
+    while (_pos < _len)
+    {
+        switch (_in[_pos])
+        {
+            WHITE_SPACE_CASES
+                ++_pos;
+                break;
+            default:
+                return;
+        }
+    }
+}
+
+template<class char_t>
+Event
+EventReaderT<char_t>::fail (ParseError error)
+{
+    _error = error;
+    _state = detail::EVENT_STATE_DONE;
+    _event = EVENT_END;
+    return _event;
+}
+
+template<class char_t>
+Event
+EventReaderT<char_t>::next ()
+{
+    Event e = try_next ();
+    JSON_EVENT_CHECK (_error == PARSE_OK);
+    return e;
+}
+
+template<class char_t>
+Event
+EventReaderT<char_t>::try_next ()
+{
+    switch (_state)
+    {
+        case detail::EVENT_STATE_VALUE:
+            return read_value ();
+
+        case detail::EVENT_STATE_VALUE_OR_END:
+            skip_white_space ();
+            JSON_EVENT_EXPECT (_pos < _len, PARSE_UNEXPECTED_END);
+            if (_in[_pos] == ']')
+            {
+                ++_pos;
+                _stack.pop_back ();
+                _event = EVENT_ARRAY_END;
+                return read_after_value ();
+            }
+            return read_value ();
+
+        case detail::EVENT_STATE_KEY:
+            return read_key ();
+
+        case detail::EVENT_STATE_KEY_OR_END:
+            skip_white_space ();
+            JSON_EVENT_EXPECT (_pos < _len, PARSE_UNEXPECTED_END);
+            if (_in[_pos] == '}')
+            {
+                ++_pos;
+                _stack.pop_back ();
+                _event = EVENT_OBJECT_END;
+                return read_after_value ();
+            }
+            return read_key ();
+
+        case detail::EVENT_STATE_COMMA_OR_END:
+            skip_white_space ();
+            JSON_EVENT_EXPECT (_pos < _len, PARSE_UNEXPECTED_END);
+            switch (_in[_pos])
+            {
+                case ',':
+                    ++_pos;
+                    if (_stack.back () == OBJECT)
+                    {
+                        return read_key ();
+                    }
+                    return read_value ();
+                case '}':
+                    JSON_EVENT_EXPECT (_stack.back () == OBJECT, PARSE_UNEXPECTED_CHARACTER);
+                    ++_pos;
+                    _stack.pop_back ();
+                    _event = EVENT_OBJECT_END;
+                    return read_after_value ();
+                case ']':
+                    JSON_EVENT_EXPECT (_stack.back () == ARRAY, PARSE_UNEXPECTED_CHARACTER);
+                    ++_pos;
+                    _stack.pop_back ();
+                    _event = EVENT_ARRAY_END;
+                    return read_after_value ();
+                default:
+                    return fail (PARSE_UNEXPECTED_CHARACTER);
+            }
+            break;
+    }
+    _event = EVENT_END;
+    return _event;
+}
+
+template<class char_t>
+void
+EventReaderT<char_t>::skip ()
+{
+    if (_event != EVENT_OBJECT_BEGIN && _event != EVENT_ARRAY_BEGIN)
+    {
+        return;
+    }
+    size_t depth = _stack.size ();
+    while (_stack.size () >= depth)
+    {
+        next ();
+    }
+}
+
+template<class char_t>
+Event
+EventReaderT<char_t>::read_after_value ()
+{
+    _state = _stack.empty () ? detail::EVENT_STATE_DONE : detail::EVENT_STATE_COMMA_OR_END;
+    return _event;
+}
+
+template<class char_t>
+Event
+EventReaderT<char_t>::read_key ()
+{
+    skip_white_space ();
+    JSON_EVENT_EXPECT (_pos < _len, PARSE_UNEXPECTED_END);
+    JSON_EVENT_EXPECT (_in[_pos] == '\"', PARSE_UNEXPECTED_CHARACTER);
+    if (read_string () == EVENT_END)
+    {
+        return _event;
+    }
+    skip_white_space ();
+    JSON_EVENT_EXPECT (_pos < _len, PARSE_UNEXPECTED_END);
+    JSON_EVENT_EXPECT (_in[_pos] == ':', PARSE_UNEXPECTED_CHARACTER);
+    ++_pos;
+    _state = detail::EVENT_STATE_VALUE;
+    _event = EVENT_KEY;
+    return _event;
+}
+
+template<class char_t>
+Event
+EventReaderT<char_t>::read_value ()
+{
+    skip_white_space ();
+    JSON_EVENT_EXPECT (_pos < _len, PARSE_UNEXPECTED_END);
+    switch (_in[_pos])
+    {
+        case '{':
+            ++_pos;
+            _stack.push_back (OBJECT);
+            _state = detail::EVENT_STATE_KEY_OR_END;
+            _event = EVENT_OBJECT_BEGIN;
+            return _event;
+        case '[':
+            ++_pos;
+            _stack.push_back (ARRAY);
+            _state = detail::EVENT_STATE_VALUE_OR_END;
+            _event = EVENT_ARRAY_BEGIN;
+            return _event;
+        case '\"':
+            _event = read_string ();
+            break;
+        case '-':
+            NUMBER_0_9_CASES
+            _event = read_number ();
+            break;
+        case 't':
+            _event   = read_literal (detail::boolean_true<char_t> (), detail::boolean_true_length<char_t> (), EVENT_BOOLEAN);
+            _boolean = true;
+            break;
+        case 'f':
+            _event   = read_literal (detail::boolean_false<char_t> (), detail::boolean_false_length<char_t> (), EVENT_BOOLEAN);
+            _boolean = false;
+            break;
+        case 'n':
+            _event = read_literal (detail::nil_null<char_t> (), detail::nil_null_length<char_t> (), EVENT_NIL);
+            break;
+        default:
+            return fail (PARSE_UNEXPECTED_CHARACTER);
+    }
+    if (_event == EVENT_END)
+    {
+        return _event;
+    }
+    return read_after_value ();
+}
+
+template<class char_t>
+Event
+EventReaderT<char_t>::read_literal (const char_t* literal, size_t len, Event e)
+{
+    JSON_EVENT_EXPECT (_len - _pos >= len && memcmp (_in + _pos, literal, len * sizeof (char_t)) == 0, PARSE_INVALID_LITERAL);
+    _pos += len;
+    return e;
+}
+
+template<class char_t>
+Event
+EventReaderT<char_t>::read_string ()
+{
+    // _in[_pos] is the opening quote. UTF-8 is validated while scanning,
+    // ASCII runs are skipped a word at a time.
+    size_t start   = ++_pos;
+    bool   escaped = false;
+    for (;;)
+    {
+        _pos = detail::scan_string (_in, _pos, _len);
+        if (_pos >= _len)
+        {
+            _pos = _len;
+            return fail (PARSE_UNEXPECTED_END);
+        }
+        if (_in[_pos] == '\"')
+        {
+            break;
+        }
+        if (_in[_pos] == '\\')
+        {
+            escaped = true;
+            _pos += 2;
+        }
+        else
+        {
+            size_t count = detail::validate_utf8 (_in + _pos, _len - _pos);
+            JSON_EVENT_EXPECT (count != 0, PARSE_INVALID_UTF8);
+            _pos += count;
+        }
+    }
+    if (escaped)
+    {
+        _scratch.clear ();
+        size_t count = detail::try_decode (_in + start, _pos - start, _scratch);
+        if (count != _pos - start)
+        {
+            _pos = start + count;
+            return fail (PARSE_INVALID_ESCAPE);
+        }
+        _str    = _scratch.data ();
+        _length = _scratch.length ();
+    }
+    else
+    {
+        _str    = _in + start;
+        _length = _pos - start;
+    }
+    ++_pos;
+    return EVENT_STRING;
+}
+
+template<class char_t>
+Event
+EventReaderT<char_t>::read_number ()
+{
+    size_t start    = _pos;
+    bool   integral = true;
+    if (_in[_pos] == '-')
+    {
+        ++_pos;
+    }
+    JSON_EVENT_EXPECT (_pos < _len && detail::is_digit (_in[_pos]), PARSE_INVALID_NUMBER);
+    if (_in[_pos] == '0')
+    {
+        ++_pos;
+    }
+    else
+    {
+        while (_pos < _len && detail::is_digit (_in[_pos]))
+        {
+            ++_pos;
+        }
+    }
+    // Past the int64_t range, e.g. 1e20 written out in full by the canonical
+    // writer: read as a float rather than saturate.
+    integral = detail::fits_int64 (_in + start, _pos - start);
+    if (_pos < _len && _in[_pos] == '.')
+    {
+        integral = false;
+        ++_pos;
+        JSON_EVENT_EXPECT (_pos < _len && detail::is_digit (_in[_pos]), PARSE_INVALID_NUMBER);
+        while (_pos < _len && detail::is_digit (_in[_pos]))
+        {
+            ++_pos;
+        }
+    }
+    if (_pos < _len && (_in[_pos] == 'e' || _in[_pos] == 'E'))
+    {
+        integral = false;
+        ++_pos;
+        if (_pos < _len && (_in[_pos] == '+' || _in[_pos] == '-'))
+        {
+            ++_pos;
+        }
+        JSON_EVENT_EXPECT (_pos < _len && detail::is_digit (_in[_pos]), PARSE_INVALID_NUMBER);
+        while (_pos < _len && detail::is_digit (_in[_pos]))
+        {
+            ++_pos;
+        }
+    }
+
+    size_t count = _pos - start;
+    _str         = _in + start;
+    _length      = count;
+    if (_options.raw_numbers)
+    {
+        return integral ? EVENT_INTEGER : EVENT_FLOAT;
+    }
+
+    // The input is not required to be NUL terminated, copy the digits out
+    // before handing them to the C library.
+    char_t  local[64];
+    tstring heap;
+    char_t* buf   = local;
+    if (count >= sizeof (local) / sizeof (char_t))
+    {
+        heap.assign (_in + start, count);
+        buf = &heap[0];
+    }
+    else
+    {
+        memcpy (local, _in + start, count * sizeof (char_t));
+        local[count] = 0;
+    }
+    char_t* end = 0;
+    if (integral)
+    {
+        _integer = detail::ttoi64<char_t> (buf, &end);
+    }
+    else
+    {
+        _float = detail::ttod<char_t> (buf, &end);
+    }
+    JSON_EVENT_EXPECT (end == buf + count, PARSE_INVALID_NUMBER);
+    // 1e400 overflows to inf, which has no JSON form to write back.
+    JSON_EVENT_EXPECT (integral || std::isfinite (_float), PARSE_INVALID_NUMBER);
+    return integral ? EVENT_INTEGER : EVENT_FLOAT;
+}
+
+template<class char_t, class alloc_t>
+void
+ValueT<char_t, alloc_t>::read (EventReaderT<char_t>& reader)
+{
+    switch (reader.event ())
+    {
+        case EVENT_NIL:
+            clear ();
+            break;
+        case EVENT_INTEGER:
+            if (reader.options ().raw_numbers)
+            {
+                assign_number (INTEGER, reader.str (), reader.length ());
+            }
+            else
+            {
+                assign (reader.integer ());
+            }
+            break;
+        case EVENT_FLOAT:
+            if (reader.options ().raw_numbers)
+            {
+                assign_number (FLOAT, reader.str (), reader.length ());
+            }
+            else
+            {
+                assign (reader.real ());
+            }
+            break;
+        case EVENT_BOOLEAN:
+            assign (reader.boolean ());
+            break;
+        case EVENT_STRING:
+            assign (reader.str (), reader.length ());
+            break;
+        case EVENT_OBJECT_BEGIN:
+            clear ();
+            _type = OBJECT;
+            while (reader.next () == EVENT_KEY)
+            {
+                ValueT<char_t, alloc_t>& elem = _object[tstring (reader.str (), reader.length ())];
+                reader.next ();
+                elem.read (reader);
+            }
+            break;
+        case EVENT_ARRAY_BEGIN:
+            clear ();
+            _type = ARRAY;
+            while (reader.next () != EVENT_ARRAY_END)
+            {
+                _array.push_back (ValueT<char_t, alloc_t> ());
+                _array.back ().read (reader);
+            }
+            break;
+        default:
+            JSON_INTERNAL_ASSERT_CHECK_EX(false, "Parse error: unexpected event (%d).", static_cast<int> (reader.event ()));
+    }
+}
+
+template<class char_t, class alloc_t>
+FrozenT<char_t>
+ValueT<char_t, alloc_t>::freeze () const
+{
+    FrozenT<char_t> doc;
+    size_t          nodes = 1;
+    size_t          chars = 1;
+    doc.count (*this, nodes, chars);
+    doc._nodes.clear ();
+    doc._nodes.reserve (nodes);
+    doc._nodes.resize (1);
+    doc._pool.clear ();
+    doc._pool.reserve (chars);
+    doc.store (*this, 0);
+    // Keep pool () valid for a document without strings.
+    doc._pool.push_back (char_t ());
+    return doc;
+}
+
+template<class char_t>
+FrozenT<char_t>::FrozenT ()
+    : _nodes (1)
+    , _pool (1)
+{
+    _nodes[0].type    = NIL;
+    _nodes[0].size    = 0;
+    _nodes[0].integer = 0;
+}
+
+template<class char_t>
+template<class alloc_t>
+void
+FrozenT<char_t>::count (const ValueT<char_t, alloc_t>& v, size_t& nodes, size_t& chars) const
+{
+    switch (v.type ())
+    {
+        case STRING:
+            chars += v.s ().length () + 1;
+            break;
+        case ARRAY:
+            nodes += v.a ().size ();
+            for (typename ArrayT<char_t, alloc_t>::const_iterator it = v.a ().begin (); it != v.a ().end (); ++it)
+            {
+                count (*it, nodes, chars);
+            }
+            break;
+        case OBJECT:
+            nodes += v.o ().size () * 2;
+            for (typename ObjectT<char_t, alloc_t>::const_iterator it = v.o ().begin (); it != v.o ().end (); ++it)
+            {
+                chars += it->first.length () + 1;
+                count (it->second, nodes, chars);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+template<class char_t>
+void
+FrozenT<char_t>::store_string (size_t index, const char_t* s, size_t len)
+{
+    JSON_INTERNAL_ASSERT_CHECK_EX (len <= 0xFFFFFFFFu, "Freeze error: string too long (%u).", static_cast<unsigned int> (len));
+    Node& n  = _nodes[index];
+    n.type   = STRING;
+    n.size   = static_cast<uint32_t> (len);
+    n.offset = _pool.size ();
+    _pool.insert (_pool.end (), s, s + len);
+    _pool.push_back (char_t ());
+}
+
+template<class char_t>
+template<class alloc_t>
+void
+FrozenT<char_t>::store (const ValueT<char_t, alloc_t>& v, size_t index)
+{
+    // Children are appended as one block first and filled afterwards, so only
+    // indexes are kept across the recursion: the node array may reallocate.
+    size_t first = _nodes.size ();
+    switch (v.type ())
+    {
+        case NIL:
+            _nodes[index].type    = NIL;
+            _nodes[index].size    = 0;
+            _nodes[index].integer = 0;
+            break;
+        case INTEGER:
+            _nodes[index].type    = INTEGER;
+            _nodes[index].size    = 0;
+            _nodes[index].integer = v.i ();
+            break;
+        case FLOAT:
+            _nodes[index].type = FLOAT;
+            _nodes[index].size = 0;
+            _nodes[index].real = v.f ();
+            break;
+        case BOOLEAN:
+            _nodes[index].type    = BOOLEAN;
+            _nodes[index].size    = 0;
+            _nodes[index].integer = 0;
+            _nodes[index].boolean = v.b ();
+            break;
+        case STRING:
+            store_string (index, v.s ().c_str (), v.s ().length ());
+            break;
+        case ARRAY:
+        {
+            const ArrayT<char_t, alloc_t>& a = v.a ();
+            JSON_INTERNAL_ASSERT_CHECK_EX (a.size () <= 0xFFFFFFFFu, "Freeze error: array too large (%u).", static_cast<unsigned int> (a.size ()));
+            _nodes[index].type   = ARRAY;
+            _nodes[index].size   = static_cast<uint32_t> (a.size ());
+            _nodes[index].offset = first;
+            _nodes.resize (first + a.size ());
+            for (size_t pos = 0; pos < a.size (); ++pos)
+            {
+                store (a[pos], first + pos);
+            }
+            break;
+        }
+        case OBJECT:
+        {
+            const ObjectT<char_t, alloc_t>& o = v.o ();
+            JSON_INTERNAL_ASSERT_CHECK_EX (o.size () <= 0xFFFFFFFFu, "Freeze error: object too large (%u).", static_cast<unsigned int> (o.size ()));
+            _nodes[index].type   = OBJECT;
+            _nodes[index].size   = static_cast<uint32_t> (o.size ());
+            _nodes[index].offset = first;
+            _nodes.resize (first + o.size () * 2);
+            // std::map iterates in key order, so the pairs come out sorted.
+            size_t pos = first;
+            for (typename ObjectT<char_t, alloc_t>::const_iterator it = o.begin (); it != o.end (); ++it, pos += 2)
+            {
+                store_string (pos, it->first.c_str (), it->first.length ());
+                store (it->second, pos + 1);
+            }
+            break;
+        }
+    }
+}
+
+template<class char_t>
+inline Type
+FrozenValueT<char_t>::type () const
+{
+    JSON_INTERNAL_ASSERT_CHECK_EX (_doc != 0, "Frozen error: invalid value.");
+    return _doc->node (_index).type;
+}
+
+template<class char_t>
+inline int64_t
+FrozenValueT<char_t>::i () const
+{
+    JSON_CHECK_TYPE (type (), INTEGER);
+    return _doc->node (_index).integer;
+}
+
+template<class char_t>
+inline double
+FrozenValueT<char_t>::f () const
+{
+    JSON_CHECK_TYPE (type (), FLOAT);
+    return _doc->node (_index).real;
+}
+
+template<class char_t>
+inline bool
+FrozenValueT<char_t>::b () const
+{
+    JSON_CHECK_TYPE (type (), BOOLEAN);
+    return _doc->node (_index).boolean;
+}
+
+template<class char_t>
+inline const char_t*
+FrozenValueT<char_t>::c_str () const
+{
+    JSON_CHECK_TYPE (type (), STRING);
+    return _doc->pool () + _doc->node (_index).offset;
+}
+
+template<class char_t>
+inline size_t
+FrozenValueT<char_t>::length () const
+{
+    JSON_CHECK_TYPE (type (), STRING);
+    return _doc->node (_index).size;
+}
+
+template<class char_t>
+inline size_t
+FrozenValueT<char_t>::size () const
+{
+    Type t = type ();
+    JSON_INTERNAL_ASSERT_CHECK_EX (t == ARRAY || t == OBJECT, "Type error: except(Array/Object), actual(%s)", get_type_name (t));
+    return _doc->node (_index).size;
+}
+
+template<class char_t>
+FrozenValueT<char_t>
+FrozenValueT<char_t>::operator[] (size_t pos) const
+{
+    JSON_CHECK_TYPE (type (), ARRAY);
+    const typename FrozenT<char_t>::Node& n = _doc->node (_index);
+    JSON_INTERNAL_ASSERT_CHECK_EX (pos < n.size, "Frozen error: index %u out of range.", static_cast<unsigned int> (pos));
+    return FrozenValueT<char_t> (_doc, n.offset + pos);
+}
+
+template<class char_t>
+FrozenValueT<char_t>
+FrozenValueT<char_t>::key (size_t pos) const
+{
+    JSON_CHECK_TYPE (type (), OBJECT);
+    const typename FrozenT<char_t>::Node& n = _doc->node (_index);
+    JSON_INTERNAL_ASSERT_CHECK_EX (pos < n.size, "Frozen error: index %u out of range.", static_cast<unsigned int> (pos));
+    return FrozenValueT<char_t> (_doc, n.offset + pos * 2);
+}
+
+template<class char_t>
+FrozenValueT<char_t>
+FrozenValueT<char_t>::value (size_t pos) const
+{
+    JSON_CHECK_TYPE (type (), OBJECT);
+    const typename FrozenT<char_t>::Node& n = _doc->node (_index);
+    JSON_INTERNAL_ASSERT_CHECK_EX (pos < n.size, "Frozen error: index %u out of range.", static_cast<unsigned int> (pos));
+    return FrozenValueT<char_t> (_doc, n.offset + pos * 2 + 1);
+}
+
+template<class char_t>
+FrozenValueT<char_t>
+FrozenValueT<char_t>::find (const char_t* key, size_t len) const
+{
+    JSON_CHECK_TYPE (type (), OBJECT);
+    const typename FrozenT<char_t>::Node& n = _doc->node (_index);
+    // Same ordering as std::map<tstring, ...>, i.e. char_traits::compare then length.
+    size_t lo = 0;
+    size_t hi = n.size;
+    while (lo < hi)
+    {
+        size_t                                mid = lo + (hi - lo) / 2;
+        const typename FrozenT<char_t>::Node& k   = _doc->node (n.offset + mid * 2);
+        const char_t*                         ks  = _doc->pool () + k.offset;
+        int cmp = char_traits<char_t>::compare (ks, key, k.size < len ? k.size : len);
+        if (cmp == 0)
+        {
+            cmp = k.size < len ? -1 : (k.size == len ? 0 : 1);
+        }
+        if (cmp == 0)
+        {
+            return FrozenValueT<char_t> (_doc, n.offset + mid * 2 + 1);
+        }
+        if (cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return FrozenValueT<char_t> ();
+}
+
+template<class char_t>
+FrozenValueT<char_t>
+FrozenValueT<char_t>::operator[] (const tstring& key) const
+{
+    FrozenValueT<char_t> v = find (key);
+    JSON_INTERNAL_ASSERT_CHECK_EX (v.valid (), "Frozen error: key not found.");
+    return v;
+}
+
+namespace detail {
+    template<class char_t, class T>
+    inline typename json_enable_if<json_is_arithmetic<T>::value, T>::type
+    frozen_type_casting (const JSON::FrozenValueT<char_t>& v, const T& value)
+    {
+        switch (v.type ())
+        {
+            case NIL:
+                break;
+            case INTEGER:
+                return T (v.i ());
+            case FLOAT:
+                return T (v.f ());
+            case BOOLEAN:
+                return T (v.b ());
+            case STRING:
+            {
+                JSON_TSTRING (char_t) s (v.c_str (), v.length ());
+                if (s == boolean_true<char_t> ())
+                {
+                    return T (1);
+                }
+                else if (s == boolean_false<char_t> ())
+                {
+                    return T (0);
+                }
+                char_t* end = 0;
+                double  d   = ttod (s.c_str (), &end);
+                JSON_INTERNAL_ASSERT_CHECK_EX(end == &s[0] + s.length (), "Type-casting error: (%s) to arithmetic.", convert_json_string (s).c_str ());
+                return T (d);
+            }
+            default:
+                JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: from (%s) type to arithmetic.", get_type_name (v.type ()));
+        }
+        return T (value);
+    }
+
+    template<class char_t, class T>
+    inline typename json_enable_if<json_is_same<JSON_TSTRING (char_t), T>::value, T>::type
+    frozen_type_casting (const JSON::FrozenValueT<char_t>& v, const T& value)
+    {
+        switch (v.type ())
+        {
+            case NIL:
+                break;
+            case INTEGER:
+                return to_string<T> (v.i ());
+            case FLOAT:
+                return to_string<T> (v.f ());
+            case BOOLEAN:
+                return T (v.b () ? detail::boolean_true<char_t> () : detail::boolean_false<char_t> ());
+            case STRING:
+                return T (v.c_str (), v.length ());
+            default:
+                JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: from (%s) type to string.", get_type_name(v.type()));
+        }
+        return T (value);
+    }
+} // namespace detail
+
+template<class char_t>
+template<class T>
+T
+FrozenValueT<char_t>::get (const tstring& key, const T& value) const
+{
+    FrozenValueT<char_t> v = find (key);
+    if (v.valid ())
+    {
+        return detail::frozen_type_casting<char_t, T> (v, value);
+    }
+    return T (value);
+}
+
+template<class char_t>
+ValueT<char_t>
+FrozenValueT<char_t>::thaw () const
+{
+    switch (type ())
+    {
+        case INTEGER:
+            return ValueT<char_t> (i ());
+        case FLOAT:
+            return ValueT<char_t> (f ());
+        case BOOLEAN:
+            return ValueT<char_t> (b ());
+        case STRING:
+            return ValueT<char_t> (c_str (), length ());
+        case ARRAY:
+        {
+            ValueT<char_t> v (ARRAY);
+            v.a ().reserve (size ());
+            for (size_t pos = 0; pos < size (); ++pos)
+            {
+                v.a ().push_back (operator[] (pos).thaw ());
+            }
+            return v;
+        }
+        case OBJECT:
+        {
+            ValueT<char_t> v (OBJECT);
+            for (size_t pos = 0; pos < size (); ++pos)
+            {
+                v.o ().insert (v.o ().end (), std::make_pair (key (pos).s (), value (pos).thaw ()));
+            }
+            return v;
+        }
+        default:
+            break;
+    }
+    return ValueT<char_t> ();
+}
+
+template<class char_t>
+void
+FrozenValueT<char_t>::write (tstring& out) const
+{
+    switch (type ())
+    {
+        case INTEGER:
+            detail::to_string (i (), out);
+            break;
+        case FLOAT:
+            detail::to_string (f (), out);
+            break;
+        case BOOLEAN:
+            out += (b () ? detail::boolean_true<char_t> () : detail::boolean_false<char_t> ());
+            break;
+        case NIL:
+            out += detail::nil_null<char_t> ();
+            break;
+        case STRING:
+            out += '\"';
+            detail::encode (c_str (), length (), out);
+            out += '\"';
+            break;
+        case ARRAY:
+            out += '[';
+            for (size_t pos = 0; pos < size (); ++pos)
+            {
+                if (pos != 0)
+                {
+                    out += ',';
+                }
+                operator[] (pos).write (out);
+            }
+            out += ']';
+            break;
+        case OBJECT:
+            out += '{';
+            for (size_t pos = 0; pos < size (); ++pos)
+            {
+                if (pos != 0)
+                {
+                    out += ',';
+                }
+                key (pos).write (out);
+                out += ':';
+                value (pos).write (out);
+            }
+            out += '}';
+            break;
+    }
+}
+
 } // namespace JSON
 
 #endif // __NC_JSON_INL__
@@ -0,0 +1,875 @@
+#ifndef __NC_JSON_BIND_H__
+#define __NC_JSON_BIND_H__
+#include <algorithm>
+#include "app/ncJson.h"
+
+/*
+ * Struct <-> JSON binding without an intermediate ValueT tree.
+ *
+ *      struct Point
+ *      {
+ *          int                 x;
+ *          int                 y;
+ *          std::string         tag;
+ *          std::vector<Point>  children;
+ *      };
+ *      JSON_BIND (Point, x, y, tag, children)
+ *
+ *      Point p;
+ *      JSON::from_json (p, in, len);   // fields are filled from EventReader events
+ *      std::string out;
+ *      JSON::to_json (p, out);         // fields are written straight into out
+ *
+ *      JSON::Value v;
+ *      v.read (in, len);
+ *      JSON::from_value (p, v);        // fields are matched to members in one pass
+ *
+ * JSON_BIND has to be placed in the namespace of the struct, the generated
+ * json_bind_fields () overloads are found by argument dependent lookup.
+ * from_json finds the field of a key through a table of the fields of the
+ * struct, built on first use from the compile time name hashes so that no
+ * two fields share a slot: one hash and one name compare per key however
+ * many fields are bound. Fields must be non-static data members.
+ *
+ * Supported member types: bool, integral and floating point types, strings,
+ * std::vector<T>, std::map<string, T>, JSON::ValueT (any JSON, kept as DOM,
+ * deep copied by from_value when the source uses another allocator) and
+ * other bound structs. Unknown keys are skipped, missing keys and null
+ * values leave the member unchanged, like get<T> (key, default) does.
+ */
+
+#define JSON_PP_EXPAND(x) x
+#define JSON_PP_CAT_(a, b) a##b
+#define JSON_PP_CAT(a, b) JSON_PP_CAT_ (a, b)
+#define JSON_PP_ARG_N(_1,_2,_3,_4,_5,_6,_7,_8,_9,_10,_11,_12,_13,_14,_15,_16,_17,_18,_19,_20,_21,_22,_23,_24,_25,_26,_27,_28,_29,_30,_31,_32, N, ...) N
+#define JSON_PP_NARG(...) JSON_PP_EXPAND (JSON_PP_ARG_N (__VA_ARGS__, 32,31,30,29,28,27,26,25,24,23,22,21,20,19,18,17,16,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1))
+#define JSON_PP_FOR_EACH(m, ...) JSON_PP_EXPAND (JSON_PP_CAT (JSON_PP_FOR_EACH_, JSON_PP_NARG (__VA_ARGS__)) (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_1(m, x) m (x)
+#define JSON_PP_FOR_EACH_2(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_1 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_3(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_2 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_4(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_3 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_5(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_4 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_6(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_5 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_7(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_6 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_8(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_7 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_9(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_8 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_10(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_9 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_11(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_10 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_12(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_11 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_13(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_12 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_14(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_13 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_15(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_14 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_16(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_15 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_17(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_16 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_18(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_17 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_19(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_18 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_20(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_19 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_21(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_20 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_22(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_21 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_23(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_22 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_24(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_23 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_25(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_24 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_26(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_25 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_27(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_26 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_28(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_27 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_29(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_28 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_30(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_29 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_31(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_30 (m, __VA_ARGS__))
+#define JSON_PP_FOR_EACH_32(m, x, ...) m (x) JSON_PP_EXPAND (JSON_PP_FOR_EACH_31 (m, __VA_ARGS__))
+
+#define JSON_BIND_FIELD(field)                                                                          \
+    visitor (JSON::detail::bind_constant<JSON::detail::bind_hash (#field)>::value, #field,             \
+             sizeof (#field) - 1, obj.field);
+
+#define JSON_BIND(type, ...)                                                                            \
+    template<class Visitor>                                                                             \
+    inline void json_bind_fields (type& obj, Visitor& visitor)                                          \
+    {                                                                                                   \
+        JSON_PP_FOR_EACH (JSON_BIND_FIELD, __VA_ARGS__)                                                 \
+    }                                                                                                   \
+    template<class Visitor>                                                                             \
+    inline void json_bind_fields (const type& obj, Visitor& visitor)                                    \
+    {                                                                                                   \
+        JSON_PP_FOR_EACH (JSON_BIND_FIELD, __VA_ARGS__)                                                 \
+    }
+
+namespace JSON {
+    namespace detail {
+        /** FNV-1a, evaluated at compile time for the member names. */
+        constexpr uint32_t
+        bind_hash (const char* s, uint32_t h = 2166136261u)
+        {
+            return *s ? bind_hash (s + 1, (h ^ static_cast<unsigned char> (*s)) * 16777619u) : h;
+        }
+
+        template<uint32_t h>
+        struct bind_constant
+        {
+            enum : uint32_t
+            {
+                value = h
+            };
+        };
+
+        template<class char_t>
+        inline uint32_t
+        bind_hash (const char_t* s, size_t len)
+        {
+            uint32_t h = 2166136261u;
+            for (size_t pos = 0; pos < len; ++pos)
+            {
+                h = (h ^ static_cast<uint32_t> (s[pos] & 0xFF)) * 16777619u;
+            }
+            return h;
+        }
+
+        template<class char_t>
+        inline bool
+        bind_key_equals (const char_t* key, const char* name, size_t len)
+        {
+            for (size_t pos = 0; pos < len; ++pos)
+            {
+                if (key[pos] != static_cast<char_t> (name[pos]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        template<>
+        inline bool
+        bind_key_equals<char> (const char* key, const char* name, size_t len)
+        {
+            return memcmp (key, name, len) == 0;
+        }
+
+        inline void
+        bind_append_name (JSON_TSTRING (char) & out, const char* name, size_t len)
+        {
+            out.append (name, len);
+        }
+
+        inline void
+        bind_append_name (JSON_TSTRING (wchar_t) & out, const char* name, size_t len)
+        {
+            out.append (name, name + len);
+        }
+
+        inline const char*
+        bind_event_name (Event e)
+        {
+            return get_type_name (event_type (e));
+        }
+
+        /** Compare like std::basic_string::compare does. */
+        template<class char_t>
+        inline int
+        bind_compare (const char_t* lhs, size_t llen, const char_t* rhs, size_t rlen)
+        {
+            int cmp = std::char_traits<char_t>::compare (lhs, rhs, std::min (llen, rlen));
+            return cmp != 0 ? cmp : (llen < rlen ? -1 : (llen > rlen ? 1 : 0));
+        }
+
+        /** A bound member name and its position in JSON_BIND. */
+        template<class char_t>
+        struct bind_name
+        {
+            JSON_TSTRING (char_t) name;
+            size_t                index;
+
+            inline bool
+            operator< (const bind_name& rhs) const
+            {
+                return name < rhs.name;
+            }
+        };
+
+        /** Bound structs, see JSON_BIND. */
+        template<class T, class Enable = void>
+        struct bind_traits
+        {
+            /** A bound field: its name, where it is in T and how it is read. */
+            template<class char_t>
+            struct field_slot
+            {
+                uint32_t    hash;
+                const char* name; /* 0 for an empty slot. */
+                size_t      length;
+                size_t      offset;
+                void (*read) (EventReaderT<char_t>& reader, void* field);
+            };
+
+            template<class F, class char_t>
+            static void
+            read_field (EventReaderT<char_t>& reader, void* field)
+            {
+                bind_traits<F>::read (reader, *static_cast<F*> (field));
+            }
+
+            /**
+                    The fields of T by name hash. The hashes of the names are
+                    compile time constants; the seed and the size are searched
+                    on first use so that each field sits in the slot its hash
+                    picks, so a key costs one hash and one name compare. If no
+                    seed is found (equal hashes), fields probe linearly.
+                */
+            template<class char_t>
+            struct field_table
+            {
+                std::vector<field_slot<char_t>> slots;
+                uint32_t                        seed;
+                unsigned                        shift;
+
+                inline size_t
+                home (uint32_t h) const
+                {
+                    return static_cast<uint32_t> ((h ^ seed) * 2654435761u) >> shift;
+                }
+
+                inline const field_slot<char_t>*
+                find (const char_t* key, size_t len) const
+                {
+                    const uint32_t h    = bind_hash (key, len);
+                    const size_t   mask = slots.size () - 1;
+                    for (size_t pos = home (h);; pos = (pos + 1) & mask)
+                    {
+                        const field_slot<char_t>& slot = slots[pos];
+                        if (slot.name == 0)
+                        {
+                            return 0;
+                        }
+                        if (slot.hash == h && slot.length == len && bind_key_equals (key, slot.name, len))
+                        {
+                            return &slot;
+                        }
+                    }
+                }
+
+                /** Place the fields, return false on the first taken slot unless probing. */
+                bool
+                place (const std::vector<field_slot<char_t>>& fields, unsigned bits, uint32_t seed_, bool probe)
+                {
+                    field_slot<char_t> empty = { 0, 0, 0, 0, 0 };
+                    slots.assign (size_t (1) << bits, empty);
+                    seed  = seed_;
+                    shift = 32 - bits;
+                    for (size_t pos = 0; pos < fields.size (); ++pos)
+                    {
+                        size_t slot = home (fields[pos].hash);
+                        while (slots[slot].name != 0)
+                        {
+                            if (!probe)
+                            {
+                                return false;
+                            }
+                            slot = (slot + 1) & (slots.size () - 1);
+                        }
+                        slots[slot] = fields[pos];
+                    }
+                    return true;
+                }
+            };
+
+            template<class char_t>
+            struct slot_visitor
+            {
+                std::vector<field_slot<char_t>>& fields;
+                const T&                         obj;
+
+                template<class F>
+                inline void
+                operator() (uint32_t h, const char* name, size_t len, const F& field)
+                {
+                    size_t offset = reinterpret_cast<const char*> (&field) - reinterpret_cast<const char*> (&obj);
+                    JSON_INTERNAL_ASSERT_CHECK_EX (offset < sizeof (T), "Bind error: (%s) is not a data member.", name);
+                    field_slot<char_t> slot = { h, name, len, offset, &read_field<F, char_t> };
+                    fields.push_back (slot);
+                }
+            };
+
+            /** The field table of T, built on first use. */
+            template<class char_t>
+            static const field_table<char_t>&
+            fields ()
+            {
+                struct builder
+                {
+                    static field_table<char_t>
+                    build ()
+                    {
+                        std::vector<field_slot<char_t>> fields;
+                        const T                         obj     = T ();
+                        slot_visitor<char_t>            visitor = { fields, obj };
+                        json_bind_fields (obj, visitor);
+
+                        unsigned bits = 1;
+                        while ((size_t (1) << bits) < fields.size () * 2)
+                        {
+                            ++bits;
+                        }
+                        field_table<char_t> table;
+                        for (unsigned grow = 0; grow < 3; ++grow, ++bits)
+                        {
+                            for (uint32_t seed = 0; seed < 256; ++seed)
+                            {
+                                if (table.place (fields, bits, seed * 0x9E3779B9u, false))
+                                {
+                                    return table;
+                                }
+                            }
+                        }
+                        table.place (fields, bits, 0, true);
+                        return table;
+                    }
+                };
+                static const field_table<char_t> table = builder::build ();
+                return table;
+            }
+
+            template<class char_t>
+            struct name_visitor
+            {
+                std::vector<bind_name<char_t>>& names;
+
+                template<class F>
+                inline void
+                operator() (uint32_t, const char* name, size_t len, const F&)
+                {
+                    bind_name<char_t> field;
+                    bind_append_name (field.name, name, len);
+                    field.index = names.size ();
+                    names.push_back (field);
+                }
+            };
+
+            template<class char_t, class alloc_t>
+            struct value_visitor
+            {
+                const ValueT<char_t, alloc_t>* const* found;
+                size_t                               pos;
+
+                template<class F>
+                inline void
+                operator() (uint32_t, const char*, size_t, F& field)
+                {
+                    if (found[pos] != 0)
+                    {
+                        bind_traits<F>::from_value (*found[pos], field);
+                    }
+                    ++pos;
+                }
+            };
+
+            /** Member names of T in key order, built on first use. */
+            template<class char_t>
+            static const std::vector<bind_name<char_t>>&
+            sorted_names ()
+            {
+                struct builder
+                {
+                    static std::vector<bind_name<char_t>>
+                    build ()
+                    {
+                        std::vector<bind_name<char_t>> names;
+                        name_visitor<char_t>           visitor = { names };
+                        const T                        obj     = T ();
+                        json_bind_fields (obj, visitor);
+                        std::sort (names.begin (), names.end ());
+                        return names;
+                    }
+                };
+                static const std::vector<bind_name<char_t>> names = builder::build ();
+                return names;
+            }
+
+            template<class char_t>
+            struct write_visitor
+            {
+                JSON_TSTRING (char_t) & out;
+                bool first;
+
+                template<class F>
+                inline void
+                operator() (uint32_t, const char* name, size_t len, const F& field)
+                {
+                    if (!first)
+                    {
+                        out += ',';
+                    }
+                    first = false;
+                    out += '\"';
+                    bind_append_name (out, name, len);
+                    out += '\"';
+                    out += ':';
+                    bind_traits<F>::write (field, out);
+                }
+            };
+
+            template<class char_t>
+            static void
+            read (EventReaderT<char_t>& reader, T& v)
+            {
+                if (reader.event () == EVENT_NIL)
+                {
+                    return;
+                }
+                JSON_INTERNAL_ASSERT_CHECK_EX (reader.event () == EVENT_OBJECT_BEGIN, "Type-casting error: from (%s) type to object.", bind_event_name (reader.event ()));
+                const field_table<char_t>& table = fields<char_t> ();
+                while (reader.next () == EVENT_KEY)
+                {
+                    const field_slot<char_t>* field = table.find (reader.str (), reader.length ());
+                    reader.next ();
+                    if (field != 0)
+                    {
+                        field->read (reader, reinterpret_cast<char*> (&v) + field->offset);
+                    }
+                    else
+                    {
+                        reader.skip ();
+                    }
+                }
+            }
+
+            template<class char_t, class alloc_t>
+            static void
+            from_value (const ValueT<char_t, alloc_t>& v, T& obj)
+            {
+                typedef typename ObjectT<char_t, alloc_t>::const_iterator iterator;
+                if (v.type () == NIL)
+                {
+                    return;
+                }
+                JSON_INTERNAL_ASSERT_CHECK_EX (v.type () == OBJECT, "Type-casting error: from (%s) type to object.", get_type_name (v.type ()));
+                const std::vector<bind_name<char_t>>& names = sorted_names<char_t> ();
+                const ObjectT<char_t, alloc_t>&       o     = v.o ();
+                // Member of each field, JSON_BIND takes at most 32 fields.
+                const ValueT<char_t, alloc_t>* found[32] = { 0 };
+                if (o.size () <= names.size () * 2)
+                {
+                    // Both sides are in key order: a single merged pass.
+                    iterator it  = o.begin ();
+                    size_t   pos = 0;
+                    while (it != o.end () && pos < names.size ())
+                    {
+                        int cmp = bind_compare (it->first.data (), it->first.length (), names[pos].name.data (),
+                                                names[pos].name.length ());
+                        if (cmp < 0)
+                        {
+                            ++it;
+                        }
+                        else if (cmp > 0)
+                        {
+                            ++pos;
+                        }
+                        else
+                        {
+                            found[names[pos].index] = &it->second;
+                            ++it;
+                            ++pos;
+                        }
+                    }
+                }
+                else
+                {
+                    // Much wider than the field list: one lookup per field.
+                    typename ObjectT<char_t, alloc_t>::key_type key;
+                    for (size_t pos = 0; pos < names.size (); ++pos)
+                    {
+                        key.assign (names[pos].name.data (), names[pos].name.length ());
+                        iterator it = o.find (key);
+                        if (it != o.end ())
+                        {
+                            found[names[pos].index] = &it->second;
+                        }
+                    }
+                }
+                value_visitor<char_t, alloc_t> visitor = { found, 0 };
+                json_bind_fields (obj, visitor);
+            }
+
+            template<class char_t>
+            static void
+            write (const T& v, JSON_TSTRING (char_t) & out)
+            {
+                out += '{';
+                write_visitor<char_t> visitor = { out, true };
+                json_bind_fields (v, visitor);
+                out += '}';
+            }
+        };
+
+        template<>
+        struct bind_traits<bool>
+        {
+            template<class char_t>
+            static void
+            read (EventReaderT<char_t>& reader, bool& v)
+            {
+                switch (reader.event ())
+                {
+                    case EVENT_NIL:
+                        break;
+                    case EVENT_BOOLEAN:
+                        v = reader.boolean ();
+                        break;
+                    case EVENT_INTEGER:
+                        v = reader.integer () != 0;
+                        break;
+                    default:
+                        JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: from (%s) type to boolean.", bind_event_name (reader.event ()));
+                }
+            }
+
+            template<class char_t, class alloc_t>
+            static void
+            from_value (const ValueT<char_t, alloc_t>& v, bool& out)
+            {
+                switch (v.type ())
+                {
+                    case NIL:
+                        break;
+                    case BOOLEAN:
+                        out = v.b ();
+                        break;
+                    case INTEGER:
+                        out = v.i () != 0;
+                        break;
+                    default:
+                        JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: from (%s) type to boolean.", get_type_name (v.type ()));
+                }
+            }
+
+            template<class char_t>
+            static void
+            write (bool v, JSON_TSTRING (char_t) & out)
+            {
+                out += (v ? boolean_true<char_t> () : boolean_false<char_t> ());
+            }
+        };
+
+        template<class T>
+        struct bind_traits<T, typename json_enable_if<json_is_integral<T>::value || json_is_floating_point<T>::value>::type>
+        {
+            template<class char_t>
+            static void
+            read (EventReaderT<char_t>& reader, T& v)
+            {
+                switch (reader.event ())
+                {
+                    case EVENT_NIL:
+                        break;
+                    case EVENT_INTEGER:
+                        v = T (reader.integer ());
+                        break;
+                    case EVENT_FLOAT:
+                        v = T (reader.real ());
+                        break;
+                    case EVENT_BOOLEAN:
+                        v = T (reader.boolean ());
+                        break;
+                    default:
+                        JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: from (%s) type to arithmetic.", bind_event_name (reader.event ()));
+                }
+            }
+
+            template<class char_t, class alloc_t>
+            static void
+            from_value (const ValueT<char_t, alloc_t>& v, T& out)
+            {
+                switch (v.type ())
+                {
+                    case NIL:
+                        break;
+                    case INTEGER:
+                        out = T (v.i ());
+                        break;
+                    case FLOAT:
+                        out = T (v.f ());
+                        break;
+                    case BOOLEAN:
+                        out = T (v.b ());
+                        break;
+                    default:
+                        JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: from (%s) type to arithmetic.", get_type_name (v.type ()));
+                }
+            }
+
+            template<class char_t>
+            static void
+            write (const T& v, JSON_TSTRING (char_t) & out)
+            {
+                if (json_is_floating_point<T>::value)
+                {
+                    to_string (static_cast<double> (v), out);
+                }
+                else
+                {
+                    to_string (static_cast<int64_t> (v), out);
+                }
+            }
+        };
+
+        template<class C, class Traits, class Alloc>
+        struct bind_traits<std::basic_string<C, Traits, Alloc>>
+        {
+            template<class char_t>
+            static void
+            read (EventReaderT<char_t>& reader, std::basic_string<C, Traits, Alloc>& v)
+            {
+                switch (reader.event ())
+                {
+                    case EVENT_NIL:
+                        break;
+                    case EVENT_STRING:
+                        v.assign (reader.str (), reader.length ());
+                        break;
+                    case EVENT_INTEGER:
+                        v.clear ();
+                        to_string (reader.integer (), v);
+                        break;
+                    case EVENT_FLOAT:
+                        v.clear ();
+                        to_string (reader.real (), v);
+                        break;
+                    case EVENT_BOOLEAN:
+                        v = reader.boolean () ? boolean_true<char_t> () : boolean_false<char_t> ();
+                        break;
+                    default:
+                        JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: from (%s) type to string.", bind_event_name (reader.event ()));
+                }
+            }
+
+            template<class char_t, class alloc_t>
+            static void
+            from_value (const ValueT<char_t, alloc_t>& v, std::basic_string<C, Traits, Alloc>& out)
+            {
+                switch (v.type ())
+                {
+                    case NIL:
+                        break;
+                    case STRING:
+                        out.assign (v.s ().data (), v.s ().length ());
+                        break;
+                    case INTEGER:
+                        out.clear ();
+                        to_string (v.i (), out);
+                        break;
+                    case FLOAT:
+                        out.clear ();
+                        to_string (static_cast<double> (v.f ()), out);
+                        break;
+                    case BOOLEAN:
+                        out = v.b () ? boolean_true<char_t> () : boolean_false<char_t> ();
+                        break;
+                    default:
+                        JSON_INTERNAL_ASSERT_CHECK_EX(false, "Type-casting error: from (%s) type to string.", get_type_name (v.type ()));
+                }
+            }
+
+            template<class char_t>
+            static void
+            write (const std::basic_string<C, Traits, Alloc>& v, JSON_TSTRING (char_t) & out)
+            {
+                out += '\"';
+                encode (v.c_str (), v.length (), out);
+                out += '\"';
+            }
+        };
+
+        template<class T, class Alloc>
+        struct bind_traits<std::vector<T, Alloc>>
+        {
+            template<class char_t>
+            static void
+            read (EventReaderT<char_t>& reader, std::vector<T, Alloc>& v)
+            {
+                if (reader.event () == EVENT_NIL)
+                {
+                    return;
+                }
+                JSON_INTERNAL_ASSERT_CHECK_EX (reader.event () == EVENT_ARRAY_BEGIN, "Type-casting error: from (%s) type to array.", bind_event_name (reader.event ()));
+                v.clear ();
+                while (reader.next () != EVENT_ARRAY_END)
+                {
+                    v.push_back (T ());
+                    bind_traits<T>::read (reader, v.back ());
+                }
+            }
+
+            template<class char_t, class alloc_t>
+            static void
+            from_value (const ValueT<char_t, alloc_t>& v, std::vector<T, Alloc>& out)
+            {
+                if (v.type () == NIL)
+                {
+                    return;
+                }
+                JSON_INTERNAL_ASSERT_CHECK_EX (v.type () == ARRAY, "Type-casting error: from (%s) type to array.", get_type_name (v.type ()));
+                const ArrayT<char_t, alloc_t>& a = v.a ();
+                out.clear ();
+                out.resize (a.size ());
+                for (size_t pos = 0; pos < a.size (); ++pos)
+                {
+                    bind_traits<T>::from_value (a[pos], out[pos]);
+                }
+            }
+
+            template<class char_t>
+            static void
+            write (const std::vector<T, Alloc>& v, JSON_TSTRING (char_t) & out)
+            {
+                out += '[';
+                for (size_t pos = 0; pos < v.size (); ++pos)
+                {
+                    if (pos != 0)
+                    {
+                        out += ',';
+                    }
+                    bind_traits<T>::write (v[pos], out);
+                }
+                out += ']';
+            }
+        };
+
+        template<class C, class T, class Compare, class Alloc>
+        struct bind_traits<std::map<std::basic_string<C>, T, Compare, Alloc>>
+        {
+            typedef std::map<std::basic_string<C>, T, Compare, Alloc> map_type;
+
+            template<class char_t>
+            static void
+            read (EventReaderT<char_t>& reader, map_type& v)
+            {
+                if (reader.event () == EVENT_NIL)
+                {
+                    return;
+                }
+                JSON_INTERNAL_ASSERT_CHECK_EX (reader.event () == EVENT_OBJECT_BEGIN, "Type-casting error: from (%s) type to object.", bind_event_name (reader.event ()));
+                v.clear ();
+                while (reader.next () == EVENT_KEY)
+                {
+                    T& elem = v[std::basic_string<C> (reader.str (), reader.length ())];
+                    reader.next ();
+                    bind_traits<T>::read (reader, elem);
+                }
+            }
+
+            template<class char_t, class alloc_t>
+            static void
+            from_value (const ValueT<char_t, alloc_t>& v, map_type& out)
+            {
+                if (v.type () == NIL)
+                {
+                    return;
+                }
+                JSON_INTERNAL_ASSERT_CHECK_EX (v.type () == OBJECT, "Type-casting error: from (%s) type to object.", get_type_name (v.type ()));
+                out.clear ();
+                for (typename ObjectT<char_t, alloc_t>::const_iterator it = v.o ().begin (); it != v.o ().end (); ++it)
+                {
+                    T& elem = out[std::basic_string<C> (it->first.data (), it->first.length ())];
+                    bind_traits<T>::from_value (it->second, elem);
+                }
+            }
+
+            template<class char_t>
+            static void
+            write (const map_type& v, JSON_TSTRING (char_t) & out)
+            {
+                out += '{';
+                for (typename map_type::const_iterator it = v.begin (); it != v.end (); ++it)
+                {
+                    if (it != v.begin ())
+                    {
+                        out += ',';
+                    }
+                    out += '\"';
+                    encode (it->first.c_str (), it->first.length (), out);
+                    out += '\"';
+                    out += ':';
+                    bind_traits<T>::write (it->second, out);
+                }
+                out += '}';
+            }
+        };
+
+        template<class C, class A>
+        struct bind_traits<ValueT<C, A>>
+        {
+            template<class char_t>
+            static void
+            read (EventReaderT<char_t>& reader, ValueT<C, A>& v)
+            {
+                v.read (reader);
+            }
+
+            static void
+            from_value (const ValueT<C, A>& v, ValueT<C, A>& out)
+            {
+                out = v;
+            }
+
+            /* A member read from a value of another allocator (or the reverse): deep copy. */
+            template<class other_alloc_t>
+            static void
+            from_value (const ValueT<C, other_alloc_t>& v, ValueT<C, A>& out)
+            {
+                out = ValueT<C, A> (v);
+            }
+
+            static void
+            write (const ValueT<C, A>& v, typename ValueT<C, A>::tstring& out)
+            {
+                v.write (out);
+            }
+
+            template<class char_t>
+            static void
+            write (const ValueT<C, A>& v, JSON_TSTRING (char_t) & out)
+            {
+                typename ValueT<C, A>::tstring text;
+                v.write (text);
+                out.append (text.data (), text.length ());
+            }
+        };
+    } // namespace detail
+
+    /**
+            Fill a bound struct (or any supported type) from JSON text.
+            Return char_t count(offset) parsed.
+            If error occurred, throws a exception.
+        */
+    template<class T, class char_t>
+    inline size_t
+    from_json (T& obj, const char_t* in, size_t len)
+    {
+        EventReaderT<char_t> reader (in, len);
+        reader.next ();
+        detail::bind_traits<T>::read (reader, obj);
+        return reader.offset ();
+    }
+
+    /**
+            Fill a bound struct (or any supported type) from a parsed value.
+            The members of an object are matched to the bound fields in one
+            merged pass over both (sorted) key lists, instead of a lookup per
+            get<T> call.
+            If error occurred, throws a exception.
+        */
+    template<class T, class char_t, class alloc_t>
+    inline void
+    from_value (T& obj, const ValueT<char_t, alloc_t>& v)
+    {
+        detail::bind_traits<T>::from_value (v, obj);
+    }
+
+    /** Append a bound struct (or any supported type) as JSON text to out. */
+    template<class T, class char_t>
+    inline void
+    to_json (const T& obj, JSON_TSTRING (char_t) & out)
+    {
+        detail::bind_traits<T>::write (obj, out);
+    }
+} // namespace JSON
+
+#endif // __NC_JSON_BIND_H__
@@ -0,0 +1,225 @@
+#ifndef __NC_JSON_SCHEMA_H__
+#define __NC_JSON_SCHEMA_H__
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <type_traits>
+#include "app/ncJson.h"
+
+namespace JSON {
+namespace detail {
+    /** A "pattern" compiled into an NFA program and matched by simulating
+        every thread at once (Thompson): time is linear in the input length
+        times the program size and the stack does not grow with the input,
+        so a long string cannot overflow it, as std::regex_search does.
+
+        Accepts the regular expression subset JSON Schema recommends:
+        literals, escapes (\d \w \s \D \W \S \b \B \t \n \v \f \r \0 \cX
+        \xHH \uHHHH and escaped punctuation), ., [...] and [^...], ^, $,
+        (...), (?:...), (?<name>...), |, and the greedy or lazy quantifiers
+        * + ? {n} {n,} {n,m}. Backreferences and lookaround throw, and so
+        does a pattern nested deeper than 64 groups or compiling to more
+        than 10000 instructions (e.g. a{99999}). Code units are matched one
+        at a time, so a non ASCII character in a class matches per byte
+        (char) or per surrogate (16-bit wchar_t), as std::regex does. */
+    template<class char_t>
+    class PatternT
+    {
+    public:
+        /**
+                Compile pattern.
+                If pattern is malformed or unsupported, throws a exception.
+            */
+        explicit PatternT (const JSON_TSTRING (char_t) & pattern);
+
+        /** Return true if pattern matches anywhere in s (search, not match). */
+        bool search (const char_t* s, size_t len) const;
+
+    private:
+        enum Op
+        {
+            CHAR,              /* Code unit x. */
+            ANY,               /* Anything but a line terminator. */
+            CLASS,             /* Ranges [x, x + y) of _ranges. */
+            NOT_CLASS,         /* Not in ranges [x, x + y). */
+            SPLIT,             /* Continue at x and at y. */
+            JUMP,              /* Continue at x. */
+            LINE_BEGIN,        /* ^ */
+            LINE_END,          /* $ */
+            WORD_BOUNDARY,     /* \b */
+            NOT_WORD_BOUNDARY, /* \B */
+            MATCH
+        };
+
+        struct Instruction
+        {
+            Op       op;
+            uint32_t x;
+            uint32_t y;
+        };
+
+        struct Range
+        {
+            uint32_t first;
+            uint32_t last;
+        };
+
+        /* A compiled piece, its jumps are relative to its first instruction. */
+        using Fragment = std::vector<Instruction>;
+
+        Fragment parse_alternative (size_t depth);
+        Fragment parse_sequence (size_t depth);
+        Fragment parse_atom (size_t depth);
+        Fragment parse_class ();
+        bool     parse_class_atom (std::vector<Range>& ranges, uint32_t& c);
+        bool     parse_class_escape (std::vector<Range>& ranges);
+        uint32_t parse_escape_char ();
+        uint32_t parse_hex (size_t digits);
+        bool     parse_braces (size_t& min, size_t& max);
+        bool     parse_count (size_t& count);
+        Fragment make_class (const std::vector<Range>& ranges, bool negated);
+
+        static Fragment make_literal (uint32_t c);
+        static Fragment make_op (Op op);
+        static Fragment quantify (const Fragment& atom, size_t min, size_t max);
+        static void     append (Fragment& to, const Fragment& from);
+        static void     add_ranges (std::vector<Range>& ranges, const Range* table, size_t count, bool negated);
+        static uint32_t code_unit (char_t ch);
+        static bool     is_word (const char_t* s, size_t len, size_t pos);
+
+        bool in_class (const Instruction& in, uint32_t c) const;
+        bool add_thread (std::vector<uint32_t>& list, std::vector<uint32_t>& stack, std::vector<size_t>& marks, size_t mark,
+                         const char_t* s, size_t len, size_t pos, uint32_t pc) const;
+
+        std::vector<Instruction> _program;
+        std::vector<Range>       _ranges;
+        const char_t*            _pos; /* Parse position, only valid while compiling. */
+        const char_t*            _end;
+    };
+} // namespace detail
+
+    /** A JSON Schema (draft 7 subset) compiled into a flat program.
+
+        Supported keywords: type, enum, required, properties,
+        additionalProperties, items (single schema), minimum,
+        maximum, exclusiveMinimum, exclusiveMaximum, minLength, maxLength,
+        pattern, minItems, maxItems. Other keywords are ignored, as the
+        specification requires for unknown keywords. A pattern is matched
+        by detail::PatternT, in linear time and without a limit on the
+        string length; see it for the accepted syntax.
+
+        Every schema object becomes one Node; children are referred to by
+        index, property names and required names are kept sorted per node
+        so a key is resolved by binary search.
+
+        A compiled schema is immutable and may be shared between threads. */
+    template<class char_t>
+    class SchemaT
+    {
+    public:
+        using tstring = JSON_TSTRING (char_t);
+
+        /**
+                Compile schema.
+                If schema is malformed, throws a exception.
+            */
+        explicit SchemaT (const ValueT<char_t>& schema);
+
+        /**
+                Validate a parsed value.
+                Return false and fill error (if given) on the first violation.
+            */
+        bool validate (const ValueT<char_t>& v, std::string* error = 0) const;
+
+        /**
+                Validate JSON text while parsing it with EventReaderT, no ValueT
+                is built (except for values checked against an enum of
+                objects/arrays). Stops reading at the first violation.
+                Return false and fill error (if given) on the first violation.
+                If a parse error occurred, throws a exception.
+            */
+        bool validate (const char_t* in, size_t len, std::string* error = 0) const;
+
+        /** Count of compiled nodes. */
+        inline size_t size () const
+        {
+            return _nodes.size ();
+        }
+
+    private:
+        enum
+        {
+            NONE = 0xFFFFFFFFu /* Unconstrained value. */
+        };
+
+        enum
+        {
+            HAS_MINIMUM           = 0x0001,
+            HAS_MAXIMUM           = 0x0002,
+            HAS_EXCLUSIVE_MINIMUM = 0x0004,
+            HAS_EXCLUSIVE_MAXIMUM = 0x0008,
+            NO_ADDITIONAL         = 0x0010, /* "additionalProperties": false */
+            INTEGRAL_FLOAT        = 0x0020  /* "integer": accept 1.0 too. */
+        };
+
+        struct Node
+        {
+            unsigned types; /* Bit (1 << Type) for every accepted type. */
+            unsigned flags;
+            double   minimum;
+            double   maximum;
+            double   exclusive_minimum;
+            double   exclusive_maximum;
+            size_t   min_length;
+            size_t   max_length;
+            size_t   min_items;
+            size_t   max_items;
+            uint32_t items;
+            uint32_t additional;
+            uint32_t pattern;
+            uint32_t first_property;
+            uint32_t property_count;
+            uint32_t first_required;
+            uint32_t required_count;
+            uint32_t first_enum;
+            uint32_t enum_count;
+        };
+
+        struct Property
+        {
+            tstring  key;
+            uint32_t node;
+        };
+
+        struct Frame
+        {
+            uint32_t node;
+            Type     type;
+            size_t   count;
+            size_t   seen; /* Offset of this object's required flags. */
+        };
+
+        uint32_t compile (const ValueT<char_t>& schema);
+
+        bool     find_property (const Node& n, const char_t* key, size_t len, uint32_t& node) const;
+        uint32_t find_required (const Node& n, const char_t* key, size_t len) const;
+
+        bool check (uint32_t node, Type type, double number, const char_t* s, size_t len, std::string* error) const;
+        bool check_enum (const Node& n, const ValueT<char_t>& v, std::string* error) const;
+        bool check_count (const Node& n, Type type, size_t count, std::string* error) const;
+        bool validate (uint32_t node, const ValueT<char_t>& v, std::string* error) const;
+
+        std::vector<Node>                     _nodes;
+        std::vector<Property>                 _properties;
+        std::vector<tstring>                  _required;
+        std::vector<ValueT<char_t>>           _enums;
+        std::vector<detail::PatternT<char_t>> _patterns;
+    };
+
+    using Schema  = SchemaT<char>;
+    using SchemaW = SchemaT<wchar_t>;
+} // namespace JSON
+
+#include "ncJsonSchema.inl"
+
+#endif // __NC_JSON_SCHEMA_H__
@@ -0,0 +1,1260 @@
+#ifndef __NC_JSON_SCHEMA_INL__
+#define __NC_JSON_SCHEMA_INL__
+
+#pragma once
+
+#define JSON_SCHEMA_CHECK(expression, formatStr, ...)                                                   \
+    JSON_INTERNAL_ASSERT_CHECK_EX (expression, "Schema error: " formatStr, ##__VA_ARGS__)
+
+namespace JSON {
+
+namespace detail {
+    template<class char_t>
+    inline JSON_TSTRING (char_t) schema_keyword (const char* name)
+    {
+        return JSON_TSTRING (char_t) (name, name + strlen (name));
+    }
+
+    template<class char_t>
+    inline const ValueT<char_t>*
+    schema_find (const ObjectT<char_t>& o, const char* name)
+    {
+        typename ObjectT<char_t>::const_iterator it = o.find (schema_keyword<char_t> (name));
+        return it == o.end () ? 0 : &it->second;
+    }
+
+    template<class char_t>
+    inline double
+    schema_number (const ValueT<char_t>* v, const char* name)
+    {
+        JSON_SCHEMA_CHECK (v->type () == INTEGER || v->type () == FLOAT, "(%s) must be a number.", name);
+        return v->type () == INTEGER ? static_cast<double> (v->i ()) : static_cast<double> (v->f ());
+    }
+
+    template<class char_t>
+    inline size_t
+    schema_count (const ValueT<char_t>* v, const char* name)
+    {
+        JSON_SCHEMA_CHECK (v->type () == INTEGER && v->i () >= 0, "(%s) must be a non-negative integer.", name);
+        return static_cast<size_t> (v->i ());
+    }
+
+    template<class char_t>
+    inline unsigned
+    schema_type (const ValueT<char_t>& v, bool& integral)
+    {
+        JSON_SCHEMA_CHECK (v.type () == STRING, "type name must be a string.");
+        const JSON_TSTRING (char_t)& name = v.s ();
+        if (name == schema_keyword<char_t> ("null"))
+            return 1u << NIL;
+        if (name == schema_keyword<char_t> ("boolean"))
+            return 1u << BOOLEAN;
+        if (name == schema_keyword<char_t> ("object"))
+            return 1u << OBJECT;
+        if (name == schema_keyword<char_t> ("array"))
+            return 1u << ARRAY;
+        if (name == schema_keyword<char_t> ("string"))
+            return 1u << STRING;
+        if (name == schema_keyword<char_t> ("number"))
+            return (1u << INTEGER) | (1u << FLOAT);
+        if (name == schema_keyword<char_t> ("integer"))
+        {
+            integral = true;
+            return 1u << INTEGER;
+        }
+        JSON_SCHEMA_CHECK (false, "unknown type name.");
+        return 0;
+    }
+
+    /** String length in code points, as minLength/maxLength count it. */
+    inline size_t
+    schema_length (const char* s, size_t len)
+    {
+        size_t count = 0;
+        for (size_t pos = 0; pos < len; ++pos)
+        {
+            if ((static_cast<unsigned char> (s[pos]) & 0xC0) != 0x80)
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    inline size_t
+    schema_length (const wchar_t* s, size_t len)
+    {
+        size_t count = len;
+        if (sizeof (wchar_t) == 2)
+        {
+            for (size_t pos = 0; pos < len; ++pos)
+            {
+                if (s[pos] >= 0xDC00 && s[pos] <= 0xDFFF)
+                {
+                    --count;
+                }
+            }
+        }
+        return count;
+    }
+
+    template<class char_t>
+    inline int
+    schema_compare (const JSON_TSTRING (char_t) & lhs, const char_t* key, size_t len)
+    {
+        int cmp = char_traits<char_t>::compare (lhs.data (), key, lhs.length () < len ? lhs.length () : len);
+        if (cmp == 0)
+        {
+            cmp = lhs.length () < len ? -1 : (lhs.length () == len ? 0 : 1);
+        }
+        return cmp;
+    }
+
+    /** Fill error, only formats the message when the caller asked for one. */
+    inline bool
+    schema_fail (std::string* error, const char* formatStr, ...)
+    {
+        if (error != 0)
+        {
+            char    buffer[256];
+            va_list ap;
+            va_start (ap, formatStr);
+            vsnprintf (buffer, sizeof (buffer), formatStr, ap);
+            va_end (ap);
+            error->assign (buffer);
+        }
+        return false;
+    }
+
+    /** Enum equality: ValueT::operator==, except that an integer and a float
+        of the same value are equal, as the specification requires ("1.0" is
+        written as 1 and must not change the verdict). */
+    template<class char_t>
+    bool
+    schema_equal (const ValueT<char_t>& lhs, const ValueT<char_t>& rhs)
+    {
+        if (lhs.type () != rhs.type ())
+        {
+            if ((lhs.type () != INTEGER && lhs.type () != FLOAT) || (rhs.type () != INTEGER && rhs.type () != FLOAT))
+            {
+                return false;
+            }
+            double l = lhs.type () == INTEGER ? static_cast<double> (lhs.i ()) : lhs.f ();
+            double r = rhs.type () == INTEGER ? static_cast<double> (rhs.i ()) : rhs.f ();
+            return fabs (l - r) < JSON_EPSILON;
+        }
+        if (lhs.type () == ARRAY)
+        {
+            if (lhs.a ().size () != rhs.a ().size ())
+            {
+                return false;
+            }
+            for (size_t pos = 0; pos < lhs.a ().size (); ++pos)
+            {
+                if (!schema_equal (lhs.a ()[pos], rhs.a ()[pos]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (lhs.type () == OBJECT)
+        {
+            if (lhs.o ().size () != rhs.o ().size ())
+            {
+                return false;
+            }
+            // Both are sorted by key.
+            typename ObjectT<char_t>::const_iterator r = rhs.o ().begin ();
+            for (typename ObjectT<char_t>::const_iterator l = lhs.o ().begin (); l != lhs.o ().end (); ++l, ++r)
+            {
+                if (l->first != r->first || !schema_equal (l->second, r->second))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return lhs == rhs;
+    }
+
+    enum
+    {
+        PATTERN_MAX_DEPTH   = 64,
+        PATTERN_MAX_PROGRAM = 10000,
+        PATTERN_MAX_COUNT   = 100000 /* {n,m} bounds are clamped to it, the program size check rejects them anyway. */
+    };
+
+    template<class char_t>
+    PatternT<char_t>::PatternT (const JSON_TSTRING (char_t) & pattern)
+        : _pos (pattern.data ())
+        , _end (pattern.data () + pattern.length ())
+    {
+        _program = parse_alternative (0);
+        JSON_SCHEMA_CHECK (_pos == _end, "invalid pattern, unmatched ')'.");
+        append (_program, make_op (MATCH));
+        _pos = 0;
+        _end = 0;
+    }
+
+    template<class char_t>
+    bool
+    PatternT<char_t>::search (const char_t* s, size_t len) const
+    {
+        std::vector<uint32_t> current;
+        std::vector<uint32_t> next;
+        std::vector<uint32_t> stack;
+        std::vector<size_t>   marks (_program.size (), 0);
+        for (size_t pos = 0;; ++pos)
+        {
+            // A new thread at every position: search, not match. The threads
+            // of pos were marked pos + 1 while stepping over pos - 1.
+            if (add_thread (current, stack, marks, pos + 1, s, len, pos, 0))
+            {
+                return true;
+            }
+            if (pos == len || (current.empty () && _program[0].op == LINE_BEGIN))
+            {
+                return false;
+            }
+            uint32_t c = code_unit (s[pos]);
+            next.clear ();
+            for (size_t index = 0; index < current.size (); ++index)
+            {
+                const Instruction& in   = _program[current[index]];
+                bool               step = false;
+                switch (in.op)
+                {
+                    case CHAR:
+                        step = in.x == c;
+                        break;
+                    case ANY:
+                        step = c != '\n' && c != '\r' && c != 0x2028 && c != 0x2029;
+                        break;
+                    default:
+                        step = in_class (in, c);
+                        break;
+                }
+                if (step && add_thread (next, stack, marks, pos + 2, s, len, pos + 1, current[index] + 1))
+                {
+                    return true;
+                }
+            }
+            current.swap (next);
+        }
+    }
+
+    /** Follow the jumps and assertions from pc without recursion, queue the
+        instructions that consume a code unit. Return true on MATCH. */
+    template<class char_t>
+    bool
+    PatternT<char_t>::add_thread (std::vector<uint32_t>& list, std::vector<uint32_t>& stack, std::vector<size_t>& marks, size_t mark,
+                                  const char_t* s, size_t len, size_t pos, uint32_t pc) const
+    {
+        stack.push_back (pc);
+        while (!stack.empty ())
+        {
+            pc = stack.back ();
+            stack.pop_back ();
+            if (marks[pc] == mark)
+            {
+                continue;
+            }
+            marks[pc]              = mark;
+            const Instruction& in = _program[pc];
+            switch (in.op)
+            {
+                case SPLIT:
+                    stack.push_back (in.y);
+                    stack.push_back (in.x);
+                    break;
+                case JUMP:
+                    stack.push_back (in.x);
+                    break;
+                case LINE_BEGIN:
+                    if (pos == 0)
+                        stack.push_back (pc + 1);
+                    break;
+                case LINE_END:
+                    if (pos == len)
+                        stack.push_back (pc + 1);
+                    break;
+                case WORD_BOUNDARY:
+                    if (is_word (s, len, pos - 1) != is_word (s, len, pos))
+                        stack.push_back (pc + 1);
+                    break;
+                case NOT_WORD_BOUNDARY:
+                    if (is_word (s, len, pos - 1) == is_word (s, len, pos))
+                        stack.push_back (pc + 1);
+                    break;
+                case MATCH:
+                    stack.clear ();
+                    return true;
+                default:
+                    list.push_back (pc);
+                    break;
+            }
+        }
+        return false;
+    }
+
+    template<class char_t>
+    bool
+    PatternT<char_t>::in_class (const Instruction& in, uint32_t c) const
+    {
+        bool found = false;
+        for (uint32_t index = in.x; index < in.x + in.y && !found; ++index)
+        {
+            found = _ranges[index].first <= c && c <= _ranges[index].last;
+        }
+        return found == (in.op == CLASS);
+    }
+
+    template<class char_t>
+    bool
+    PatternT<char_t>::is_word (const char_t* s, size_t len, size_t pos)
+    {
+        if (pos >= len)
+        {
+            return false; // also pos - 1 at the start
+        }
+        uint32_t c = code_unit (s[pos]);
+        return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+    }
+
+    template<class char_t>
+    uint32_t
+    PatternT<char_t>::code_unit (char_t ch)
+    {
+        return static_cast<uint32_t> (static_cast<typename std::make_unsigned<char_t>::type> (ch));
+    }
+
+    template<class char_t>
+    typename PatternT<char_t>::Fragment
+    PatternT<char_t>::parse_alternative (size_t depth)
+    {
+        JSON_SCHEMA_CHECK (depth <= PATTERN_MAX_DEPTH, "pattern nested too deep.");
+        Fragment left = parse_sequence (depth);
+        while (_pos != _end && *_pos == '|')
+        {
+            ++_pos;
+            Fragment    right = parse_sequence (depth);
+            Fragment    both;
+            Instruction split = {SPLIT, 1, static_cast<uint32_t> (left.size () + 2)};
+            Instruction jump  = {JUMP, static_cast<uint32_t> (left.size () + right.size () + 2), 0};
+            both.push_back (split);
+            append (both, left);
+            both.push_back (jump);
+            append (both, right);
+            left.swap (both);
+        }
+        return left;
+    }
+
+    template<class char_t>
+    typename PatternT<char_t>::Fragment
+    PatternT<char_t>::parse_sequence (size_t depth)
+    {
+        Fragment sequence;
+        while (_pos != _end && *_pos != '|' && *_pos != ')')
+        {
+            Fragment atom = parse_atom (depth);
+            size_t   min  = 1;
+            size_t   max  = 1;
+            bool     quantified = _pos != _end;
+            if (quantified)
+            {
+                switch (*_pos)
+                {
+                    case '*':
+                        min = 0;
+                        max = static_cast<size_t> (-1);
+                        ++_pos;
+                        break;
+                    case '+':
+                        max = static_cast<size_t> (-1);
+                        ++_pos;
+                        break;
+                    case '?':
+                        min = 0;
+                        ++_pos;
+                        break;
+                    case '{':
+                        quantified = parse_braces (min, max);
+                        break;
+                    default:
+                        quantified = false;
+                        break;
+                }
+            }
+            if (quantified && _pos != _end && *_pos == '?')
+            {
+                ++_pos; // lazy: the same strings match, only which one is reported differs
+            }
+            append (sequence, quantified ? quantify (atom, min, max) : atom);
+        }
+        return sequence;
+    }
+
+    template<class char_t>
+    typename PatternT<char_t>::Fragment
+    PatternT<char_t>::parse_atom (size_t depth)
+    {
+        switch (*_pos)
+        {
+            case '(':
+            {
+                ++_pos;
+                if (_pos != _end && *_pos == '?')
+                {
+                    ++_pos;
+                    JSON_SCHEMA_CHECK (_pos != _end, "invalid pattern, missing ')'.");
+                    if (*_pos == ':')
+                    {
+                        ++_pos;
+                    }
+                    else
+                    {
+                        JSON_SCHEMA_CHECK (*_pos == '<' && _pos + 1 != _end && _pos[1] != '=' && _pos[1] != '!',
+                                           "lookaround is not supported in pattern.");
+                        while (_pos != _end && *_pos != '>')
+                        {
+                            ++_pos;
+                        }
+                        JSON_SCHEMA_CHECK (_pos != _end, "invalid pattern, missing '>' after group name.");
+                        ++_pos;
+                    }
+                }
+                Fragment group = parse_alternative (depth + 1);
+                JSON_SCHEMA_CHECK (_pos != _end && *_pos == ')', "invalid pattern, missing ')'.");
+                ++_pos;
+                return group;
+            }
+            case '[':
+                ++_pos;
+                return parse_class ();
+            case '.':
+                ++_pos;
+                return make_op (ANY);
+            case '^':
+                ++_pos;
+                return make_op (LINE_BEGIN);
+            case '$':
+                ++_pos;
+                return make_op (LINE_END);
+            case '*':
+            case '+':
+            case '?':
+                JSON_SCHEMA_CHECK (false, "invalid pattern, nothing to repeat.");
+                return Fragment ();
+            case '\\':
+            {
+                ++_pos;
+                JSON_SCHEMA_CHECK (_pos != _end, "invalid pattern, '\\' at end.");
+                if (*_pos == 'b' || *_pos == 'B')
+                {
+                    return make_op (*_pos++ == 'b' ? WORD_BOUNDARY : NOT_WORD_BOUNDARY);
+                }
+                std::vector<Range> ranges;
+                if (parse_class_escape (ranges))
+                {
+                    return make_class (ranges, false);
+                }
+                return make_literal (parse_escape_char ());
+            }
+            default:
+                return make_literal (code_unit (*_pos++));
+        }
+    }
+
+    template<class char_t>
+    typename PatternT<char_t>::Fragment
+    PatternT<char_t>::parse_class ()
+    {
+        bool negated = _pos != _end && *_pos == '^';
+        if (negated)
+        {
+            ++_pos;
+        }
+        std::vector<Range> ranges;
+        for (;;)
+        {
+            JSON_SCHEMA_CHECK (_pos != _end, "invalid pattern, missing ']'.");
+            if (*_pos == ']')
+            {
+                ++_pos;
+                break;
+            }
+            uint32_t first = 0;
+            if (!parse_class_atom (ranges, first))
+            {
+                continue;
+            }
+            uint32_t last = first;
+            if (_end - _pos >= 2 && *_pos == '-' && _pos[1] != ']')
+            {
+                ++_pos;
+                JSON_SCHEMA_CHECK (parse_class_atom (ranges, last), "invalid pattern, class escape in a range.");
+                JSON_SCHEMA_CHECK (first <= last, "invalid pattern, range out of order in class.");
+            }
+            Range range = {first, last};
+            ranges.push_back (range);
+        }
+        return make_class (ranges, negated);
+    }
+
+    /** One class member: return false if it was \d, \w... (added to ranges), else the code unit in c. */
+    template<class char_t>
+    bool
+    PatternT<char_t>::parse_class_atom (std::vector<Range>& ranges, uint32_t& c)
+    {
+        if (*_pos != '\\')
+        {
+            c = code_unit (*_pos++);
+            return true;
+        }
+        ++_pos;
+        JSON_SCHEMA_CHECK (_pos != _end, "invalid pattern, '\\' at end.");
+        if (parse_class_escape (ranges))
+        {
+            return false;
+        }
+        if (*_pos == 'b')
+        {
+            ++_pos;
+            c = '\b';
+            return true;
+        }
+        c = parse_escape_char ();
+        JSON_SCHEMA_CHECK (sizeof (char_t) > 1 || c < 0x80, "invalid pattern, non ASCII escape in a class.");
+        return true;
+    }
+
+    template<class char_t>
+    bool
+    PatternT<char_t>::parse_class_escape (std::vector<Range>& ranges)
+    {
+        static const Range digit[] = {{'0', '9'}};
+        static const Range word[]  = {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}};
+        static const Range space[] = {{0x09, 0x0D}, {0x20, 0x20},     {0xA0, 0xA0},     {0x1680, 0x1680}, {0x2000, 0x200A},
+                                      {0x2028, 0x2029}, {0x202F, 0x202F}, {0x205F, 0x205F}, {0x3000, 0x3000}, {0xFEFF, 0xFEFF}};
+        switch (*_pos)
+        {
+            case 'd':
+            case 'D':
+                add_ranges (ranges, digit, sizeof (digit) / sizeof (digit[0]), *_pos == 'D');
+                break;
+            case 'w':
+            case 'W':
+                add_ranges (ranges, word, sizeof (word) / sizeof (word[0]), *_pos == 'W');
+                break;
+            case 's':
+            case 'S':
+                add_ranges (ranges, space, sizeof (space) / sizeof (space[0]), *_pos == 'S');
+                break;
+            default:
+                return false;
+        }
+        ++_pos;
+        return true;
+    }
+
+    /** The code point of an escape, _pos is after the '\\'. */
+    template<class char_t>
+    uint32_t
+    PatternT<char_t>::parse_escape_char ()
+    {
+        uint32_t c = code_unit (*_pos++);
+        switch (c)
+        {
+            case 't':
+                return '\t';
+            case 'n':
+                return '\n';
+            case 'v':
+                return '\v';
+            case 'f':
+                return '\f';
+            case 'r':
+                return '\r';
+            case '0':
+                JSON_SCHEMA_CHECK (_pos == _end || *_pos < '0' || *_pos > '9', "backreferences are not supported in pattern.");
+                return 0;
+            case 'c':
+                JSON_SCHEMA_CHECK (_pos != _end && ((*_pos >= 'a' && *_pos <= 'z') || (*_pos >= 'A' && *_pos <= 'Z')),
+                                   "invalid pattern, bad \\c escape.");
+                return code_unit (*_pos++) % 32;
+            case 'x':
+                return parse_hex (2);
+            case 'u':
+                return parse_hex (4);
+            default:
+                JSON_SCHEMA_CHECK (c < '1' || c > '9', "backreferences are not supported in pattern.");
+                JSON_SCHEMA_CHECK (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')), "unsupported escape in pattern.");
+                return c;
+        }
+    }
+
+    template<class char_t>
+    uint32_t
+    PatternT<char_t>::parse_hex (size_t digits)
+    {
+        uint32_t c = 0;
+        for (size_t count = 0; count < digits; ++count, ++_pos)
+        {
+            uint32_t digit = _pos != _end ? code_unit (*_pos) : 0;
+            digit          = digit >= 'A' && digit <= 'F' ? digit | 0x20 : digit;
+            JSON_SCHEMA_CHECK ((digit >= '0' && digit <= '9') || (digit >= 'a' && digit <= 'f'), "invalid pattern, bad hex escape.");
+            c = c * 16 + (digit <= '9' ? digit - '0' : digit - 'a' + 10);
+        }
+        return c;
+    }
+
+    /** A {n}, {n,} or {n,m} quantifier, else leave _pos on '{' and take it literally. */
+    template<class char_t>
+    bool
+    PatternT<char_t>::parse_braces (size_t& min, size_t& max)
+    {
+        const char_t* start = _pos++;
+        if (parse_count (min))
+        {
+            max = min;
+            if (_pos != _end && *_pos == ',')
+            {
+                ++_pos;
+                max = static_cast<size_t> (-1);
+                if (_pos != _end && *_pos != '}' && !parse_count (max))
+                {
+                    _pos = start;
+                    return false;
+                }
+            }
+            if (_pos != _end && *_pos == '}')
+            {
+                ++_pos;
+                JSON_SCHEMA_CHECK (min <= max, "invalid pattern, numbers out of order in {} quantifier.");
+                return true;
+            }
+        }
+        _pos = start;
+        return false;
+    }
+
+    template<class char_t>
+    bool
+    PatternT<char_t>::parse_count (size_t& count)
+    {
+        if (_pos == _end || *_pos < '0' || *_pos > '9')
+        {
+            return false;
+        }
+        count = 0;
+        for (; _pos != _end && *_pos >= '0' && *_pos <= '9'; ++_pos)
+        {
+            count = std::min<size_t> (count * 10 + (*_pos - '0'), PATTERN_MAX_COUNT);
+        }
+        return true;
+    }
+
+    template<class char_t>
+    typename PatternT<char_t>::Fragment
+    PatternT<char_t>::make_class (const std::vector<Range>& ranges, bool negated)
+    {
+        Instruction in = {negated ? NOT_CLASS : CLASS, static_cast<uint32_t> (_ranges.size ()), static_cast<uint32_t> (ranges.size ())};
+        _ranges.insert (_ranges.end (), ranges.begin (), ranges.end ());
+        return Fragment (1, in);
+    }
+
+    /** A code unit, or for char the UTF-8 bytes of a \x / \u code point. */
+    template<class char_t>
+    typename PatternT<char_t>::Fragment
+    PatternT<char_t>::make_literal (uint32_t c)
+    {
+        Fragment literal;
+        if (sizeof (char_t) == 1 && c >= 0x80 && c <= 0xFFFF)
+        {
+            if (c < 0x800)
+            {
+                Instruction lead = {CHAR, 0xC0 | (c >> 6), 0};
+                literal.push_back (lead);
+            }
+            else
+            {
+                Instruction lead = {CHAR, 0xE0 | (c >> 12), 0};
+                Instruction next = {CHAR, 0x80 | ((c >> 6) & 0x3F), 0};
+                literal.push_back (lead);
+                literal.push_back (next);
+            }
+            c = 0x80 | (c & 0x3F);
+        }
+        Instruction in = {CHAR, c, 0};
+        literal.push_back (in);
+        return literal;
+    }
+
+    template<class char_t>
+    typename PatternT<char_t>::Fragment
+    PatternT<char_t>::make_op (Op op)
+    {
+        Instruction in = {op, 0, 0};
+        return Fragment (1, in);
+    }
+
+    /** atom{min,max} as min copies of atom, then atom* or (max - min) copies of atom?. */
+    template<class char_t>
+    typename PatternT<char_t>::Fragment
+    PatternT<char_t>::quantify (const Fragment& atom, size_t min, size_t max)
+    {
+        size_t copies = max == static_cast<size_t> (-1) ? min + 1 : max;
+        JSON_SCHEMA_CHECK (copies <= PATTERN_MAX_PROGRAM && (atom.size () + 2) * copies <= PATTERN_MAX_PROGRAM, "pattern too large.");
+        Fragment result;
+        for (size_t count = 1; count < min; ++count)
+        {
+            append (result, atom);
+        }
+        if (max == static_cast<size_t> (-1))
+        {
+            Fragment loop;
+            if (min == 0)
+            {
+                Instruction split = {SPLIT, 1, static_cast<uint32_t> (atom.size () + 2)};
+                Instruction jump  = {JUMP, 0, 0};
+                loop.push_back (split);
+                append (loop, atom);
+                loop.push_back (jump);
+            }
+            else
+            {
+                Instruction split = {SPLIT, 0, static_cast<uint32_t> (atom.size () + 1)};
+                loop = atom;
+                loop.push_back (split);
+            }
+            append (result, loop);
+            return result;
+        }
+        if (min != 0)
+        {
+            append (result, atom);
+        }
+        Fragment    optional;
+        Instruction split = {SPLIT, 1, static_cast<uint32_t> (atom.size () + 1)};
+        optional.push_back (split);
+        append (optional, atom);
+        for (size_t count = min; count < max; ++count)
+        {
+            append (result, optional);
+        }
+        return result;
+    }
+
+    /** Append from to to, moving its jumps by the size of to. */
+    template<class char_t>
+    void
+    PatternT<char_t>::append (Fragment& to, const Fragment& from)
+    {
+        uint32_t base = static_cast<uint32_t> (to.size ());
+        JSON_SCHEMA_CHECK (to.size () + from.size () <= PATTERN_MAX_PROGRAM, "pattern too large.");
+        for (size_t index = 0; index < from.size (); ++index)
+        {
+            Instruction in = from[index];
+            if (in.op == SPLIT || in.op == JUMP)
+            {
+                in.x += base;
+                in.y += in.op == SPLIT ? base : 0;
+            }
+            to.push_back (in);
+        }
+    }
+
+    /** Add table (sorted, disjoint) or its complement to ranges. */
+    template<class char_t>
+    void
+    PatternT<char_t>::add_ranges (std::vector<Range>& ranges, const Range* table, size_t count, bool negated)
+    {
+        uint32_t next = 0;
+        for (size_t index = 0; index < count; ++index)
+        {
+            if (!negated)
+            {
+                ranges.push_back (table[index]);
+            }
+            else
+            {
+                if (table[index].first > next)
+                {
+                    Range gap = {next, table[index].first - 1};
+                    ranges.push_back (gap);
+                }
+                next = table[index].last + 1;
+            }
+        }
+        if (negated)
+        {
+            Range rest = {next, 0xFFFFFFFFu};
+            ranges.push_back (rest);
+        }
+    }
+} // namespace detail
+
+template<class char_t>
+SchemaT<char_t>::SchemaT (const ValueT<char_t>& schema)
+{
+    compile (schema);
+}
+
+template<class char_t>
+uint32_t
+SchemaT<char_t>::compile (const ValueT<char_t>& schema)
+{
+    // Reserve the slot first: children are compiled (and appended) before
+    // this node is complete, so build it on the stack and store it last.
+    uint32_t index = static_cast<uint32_t> (_nodes.size ());
+    Node     n;
+    memset (&n, 0, sizeof (n));
+    n.types      = (1u << NIL) | (1u << INTEGER) | (1u << FLOAT) | (1u << BOOLEAN) | (1u << STRING) | (1u << OBJECT) | (1u << ARRAY);
+    n.max_length = static_cast<size_t> (-1);
+    n.max_items  = static_cast<size_t> (-1);
+    n.items      = NONE;
+    n.additional = NONE;
+    n.pattern    = NONE;
+    _nodes.push_back (n);
+
+    if (schema.type () == BOOLEAN)
+    {
+        n.types = schema.b () ? n.types : 0;
+        _nodes[index] = n;
+        return index;
+    }
+    JSON_SCHEMA_CHECK (schema.type () == OBJECT, "schema must be object or boolean, actual(%s).", get_type_name (schema.type ()));
+    const ObjectT<char_t>& o = schema.o ();
+    const ValueT<char_t>*  v = 0;
+
+    if ((v = detail::schema_find (o, "type")) != 0)
+    {
+        bool integral = false;
+        n.types       = 0;
+        if (v->type () == ARRAY)
+        {
+            for (size_t pos = 0; pos < v->a ().size (); ++pos)
+            {
+                n.types |= detail::schema_type (v->a ()[pos], integral);
+            }
+        }
+        else
+        {
+            n.types = detail::schema_type (*v, integral);
+        }
+        if (integral && (n.types & (1u << FLOAT)) == 0)
+        {
+            n.flags |= INTEGRAL_FLOAT;
+        }
+    }
+
+    if ((v = detail::schema_find (o, "enum")) != 0)
+    {
+        JSON_SCHEMA_CHECK (v->type () == ARRAY, "(enum) must be an array.");
+        n.first_enum = static_cast<uint32_t> (_enums.size ());
+        n.enum_count = static_cast<uint32_t> (v->a ().size ());
+        _enums.insert (_enums.end (), v->a ().begin (), v->a ().end ());
+    }
+
+    if ((v = detail::schema_find (o, "minimum")) != 0)
+    {
+        n.flags |= HAS_MINIMUM;
+        n.minimum = detail::schema_number (v, "minimum");
+    }
+    if ((v = detail::schema_find (o, "maximum")) != 0)
+    {
+        n.flags |= HAS_MAXIMUM;
+        n.maximum = detail::schema_number (v, "maximum");
+    }
+    if ((v = detail::schema_find (o, "exclusiveMinimum")) != 0)
+    {
+        n.flags |= HAS_EXCLUSIVE_MINIMUM;
+        n.exclusive_minimum = detail::schema_number (v, "exclusiveMinimum");
+    }
+    if ((v = detail::schema_find (o, "exclusiveMaximum")) != 0)
+    {
+        n.flags |= HAS_EXCLUSIVE_MAXIMUM;
+        n.exclusive_maximum = detail::schema_number (v, "exclusiveMaximum");
+    }
+    if ((v = detail::schema_find (o, "minLength")) != 0)
+    {
+        n.min_length = detail::schema_count (v, "minLength");
+    }
+    if ((v = detail::schema_find (o, "maxLength")) != 0)
+    {
+        n.max_length = detail::schema_count (v, "maxLength");
+    }
+    if ((v = detail::schema_find (o, "minItems")) != 0)
+    {
+        n.min_items = detail::schema_count (v, "minItems");
+    }
+    if ((v = detail::schema_find (o, "maxItems")) != 0)
+    {
+        n.max_items = detail::schema_count (v, "maxItems");
+    }
+
+    if ((v = detail::schema_find (o, "pattern")) != 0)
+    {
+        JSON_SCHEMA_CHECK (v->type () == STRING, "(pattern) must be a string.");
+        _patterns.push_back (detail::PatternT<char_t> (v->s ()));
+        n.pattern = static_cast<uint32_t> (_patterns.size () - 1);
+    }
+
+    if ((v = detail::schema_find (o, "items")) != 0)
+    {
+        JSON_SCHEMA_CHECK (v->type () != ARRAY, "tuple form of (items) is not supported.");
+        n.items = compile (*v);
+    }
+
+    if ((v = detail::schema_find (o, "additionalProperties")) != 0)
+    {
+        if (v->type () == BOOLEAN)
+        {
+            n.flags |= v->b () ? 0 : NO_ADDITIONAL;
+        }
+        else
+        {
+            n.additional = compile (*v);
+        }
+    }
+
+    if ((v = detail::schema_find (o, "properties")) != 0)
+    {
+        JSON_SCHEMA_CHECK (v->type () == OBJECT, "(properties) must be an object.");
+        // ObjectT is ordered, so the properties come out sorted by key.
+        std::vector<Property> properties;
+        for (typename ObjectT<char_t>::const_iterator it = v->o ().begin (); it != v->o ().end (); ++it)
+        {
+            Property p;
+            p.key  = it->first;
+            p.node = compile (it->second);
+            properties.push_back (p);
+        }
+        n.first_property = static_cast<uint32_t> (_properties.size ());
+        n.property_count = static_cast<uint32_t> (properties.size ());
+        _properties.insert (_properties.end (), properties.begin (), properties.end ());
+    }
+
+    if ((v = detail::schema_find (o, "required")) != 0)
+    {
+        JSON_SCHEMA_CHECK (v->type () == ARRAY, "(required) must be an array.");
+        std::vector<tstring> required;
+        for (size_t pos = 0; pos < v->a ().size (); ++pos)
+        {
+            JSON_SCHEMA_CHECK (v->a ()[pos].type () == STRING, "(required) must contain strings.");
+            required.push_back (v->a ()[pos].s ());
+        }
+        std::sort (required.begin (), required.end ());
+        required.erase (std::unique (required.begin (), required.end ()), required.end ());
+        n.first_required = static_cast<uint32_t> (_required.size ());
+        n.required_count = static_cast<uint32_t> (required.size ());
+        _required.insert (_required.end (), required.begin (), required.end ());
+    }
+
+    _nodes[index] = n;
+    return index;
+}
+
+template<class char_t>
+bool
+SchemaT<char_t>::find_property (const Node& n, const char_t* key, size_t len, uint32_t& node) const
+{
+    size_t lo = n.first_property;
+    size_t hi = n.first_property + n.property_count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        int    cmp = detail::schema_compare (_properties[mid].key, key, len);
+        if (cmp == 0)
+        {
+            node = _properties[mid].node;
+            return true;
+        }
+        if (cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+template<class char_t>
+uint32_t
+SchemaT<char_t>::find_required (const Node& n, const char_t* key, size_t len) const
+{
+    size_t lo = n.first_required;
+    size_t hi = n.first_required + n.required_count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        int    cmp = detail::schema_compare (_required[mid], key, len);
+        if (cmp == 0)
+        {
+            return static_cast<uint32_t> (mid - n.first_required);
+        }
+        if (cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return NONE;
+}
+
+template<class char_t>
+bool
+SchemaT<char_t>::check (uint32_t node, Type type, double number, const char_t* s, size_t len, std::string* error) const
+{
+    const Node& n = _nodes[node];
+    if ((n.types & (1u << type)) == 0 &&
+        !(type == FLOAT && (n.flags & INTEGRAL_FLOAT) && floor (number) == number))
+    {
+        return detail::schema_fail (error, "Type (%s) not allowed.", get_type_name (type));
+    }
+    switch (type)
+    {
+        case INTEGER:
+        case FLOAT:
+            if (((n.flags & HAS_MINIMUM) && number < n.minimum) ||
+                ((n.flags & HAS_EXCLUSIVE_MINIMUM) && number <= n.exclusive_minimum) ||
+                ((n.flags & HAS_MAXIMUM) && number > n.maximum) ||
+                ((n.flags & HAS_EXCLUSIVE_MAXIMUM) && number >= n.exclusive_maximum))
+            {
+                return detail::schema_fail (error, "Number (%g) out of range.", number);
+            }
+            break;
+        case STRING:
+            if (n.min_length != 0 || n.max_length != static_cast<size_t> (-1))
+            {
+                size_t count = detail::schema_length (s, len);
+                if (count < n.min_length || count > n.max_length)
+                {
+                    return detail::schema_fail (error, "String length (%u) out of range.", static_cast<unsigned int> (count));
+                }
+            }
+            if (n.pattern != NONE && !_patterns[n.pattern].search (s, len))
+            {
+                return detail::schema_fail (error, "String does not match pattern.");
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+template<class char_t>
+bool
+SchemaT<char_t>::check_enum (const Node& n, const ValueT<char_t>& v, std::string* error) const
+{
+    for (uint32_t pos = 0; pos < n.enum_count; ++pos)
+    {
+        if (detail::schema_equal (_enums[n.first_enum + pos], v))
+        {
+            return true;
+        }
+    }
+    return detail::schema_fail (error, "Value not in enum.");
+}
+
+template<class char_t>
+bool
+SchemaT<char_t>::check_count (const Node& n, Type type, size_t count, std::string* error) const
+{
+    if (type == ARRAY && (count < n.min_items || count > n.max_items))
+    {
+        return detail::schema_fail (error, "Array size (%u) out of range.", static_cast<unsigned int> (count));
+    }
+    return true;
+}
+
+template<class char_t>
+bool
+SchemaT<char_t>::validate (const ValueT<char_t>& v, std::string* error) const
+{
+    return validate (0, v, error);
+}
+
+template<class char_t>
+bool
+SchemaT<char_t>::validate (uint32_t node, const ValueT<char_t>& v, std::string* error) const
+{
+    if (node == NONE)
+    {
+        return true;
+    }
+    const Node& n      = _nodes[node];
+    double      number = v.type () == INTEGER ? static_cast<double> (v.i ()) : (v.type () == FLOAT ? static_cast<double> (v.f ()) : 0);
+    const char_t* s    = v.type () == STRING ? v.s ().data () : 0;
+    size_t      len    = v.type () == STRING ? v.s ().length () : 0;
+    if (!check (node, v.type (), number, s, len, error))
+    {
+        return false;
+    }
+    if (n.enum_count != 0 && !check_enum (n, v, error))
+    {
+        return false;
+    }
+    switch (v.type ())
+    {
+        case OBJECT:
+            for (uint32_t pos = 0; pos < n.required_count; ++pos)
+            {
+                if (v.o ().find (_required[n.first_required + pos]) == v.o ().end ())
+                {
+                    return detail::schema_fail (error, "Required property (%s) missing.", convert_json_string (_required[n.first_required + pos]).c_str ());
+                }
+            }
+            for (typename ObjectT<char_t>::const_iterator it = v.o ().begin (); it != v.o ().end (); ++it)
+            {
+                uint32_t child = NONE;
+                if (!find_property (n, it->first.data (), it->first.length (), child))
+                {
+                    if (n.flags & NO_ADDITIONAL)
+                    {
+                        return detail::schema_fail (error, "Property (%s) not allowed.", convert_json_string (it->first).c_str ());
+                    }
+                    child = n.additional;
+                }
+                if (!validate (child, it->second, error))
+                {
+                    return false;
+                }
+            }
+            break;
+        case ARRAY:
+            if (!check_count (n, ARRAY, v.a ().size (), error))
+            {
+                return false;
+            }
+            for (size_t pos = 0; n.items != NONE && pos < v.a ().size (); ++pos)
+            {
+                if (!validate (n.items, v.a ()[pos], error))
+                {
+                    return false;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+template<class char_t>
+bool
+SchemaT<char_t>::validate (const char_t* in, size_t len, std::string* error) const
+{
+    EventReaderT<char_t>       reader (in, len);
+    std::vector<Frame>         frames;
+    std::vector<unsigned char> seen;
+    uint32_t                   expect = 0;
+    bool                       ok     = true;
+    Event                      e;
+    while (ok && (e = reader.next ()) != EVENT_END)
+    {
+        switch (e)
+        {
+            case EVENT_KEY:
+            {
+                Frame&      f = frames.back ();
+                const Node& n = _nodes[f.node];
+                uint32_t    r = find_required (n, reader.str (), reader.length ());
+                if (r != NONE)
+                {
+                    seen[f.seen + r] = 1;
+                }
+                if (!find_property (n, reader.str (), reader.length (), expect))
+                {
+                    if (n.flags & NO_ADDITIONAL)
+                    {
+                        ok = detail::schema_fail (error, "Property (%s) not allowed.", convert_json_string (tstring (reader.str (), reader.length ())).c_str ());
+                        continue;
+                    }
+                    expect = n.additional;
+                }
+                continue;
+            }
+            case EVENT_OBJECT_END:
+            {
+                const Frame& f = frames.back ();
+                const Node&  n = _nodes[f.node];
+                for (uint32_t pos = 0; pos < n.required_count; ++pos)
+                {
+                    if (!seen[f.seen + pos])
+                    {
+                        ok = detail::schema_fail (error, "Required property (%s) missing.", convert_json_string (_required[n.first_required + pos]).c_str ());
+                        break;
+                    }
+                }
+                seen.resize (f.seen);
+                frames.pop_back ();
+                continue;
+            }
+            case EVENT_ARRAY_END:
+                ok = check_count (_nodes[frames.back ().node], ARRAY, frames.back ().count, error);
+                frames.pop_back ();
+                continue;
+            default:
+                break;
+        }
+
+        // A value starts here, find the node it is checked against.
+        uint32_t node = 0;
+        if (!frames.empty ())
+        {
+            Frame& f = frames.back ();
+            ++f.count;
+            node = f.type == ARRAY ? _nodes[f.node].items : expect;
+        }
+        if (node == NONE)
+        {
+            reader.skip ();
+            continue;
+        }
+
+        const Node& n    = _nodes[node];
+        Type        type = detail::event_type (e);
+        if (n.enum_count != 0)
+        {
+            // Enums compare whole values, build this one (objects/arrays are
+            // consumed by read () and checked on the DOM path).
+            ValueT<char_t> v;
+            v.read (reader);
+            ok = validate (node, v, error);
+            continue;
+        }
+        double number = e == EVENT_INTEGER ? static_cast<double> (reader.integer ()) : (e == EVENT_FLOAT ? reader.real () : 0);
+        ok = check (node, type, number, reader.str (), reader.length (), error);
+        if (ok && (e == EVENT_OBJECT_BEGIN || e == EVENT_ARRAY_BEGIN))
+        {
+            Frame f;
+            f.node  = node;
+            f.type  = type;
+            f.count = 0;
+            f.seen  = seen.size ();
+            frames.push_back (f);
+            seen.resize (seen.size () + n.required_count, 0);
+        }
+    }
+    if (!ok && error != 0)
+    {
+        char buffer[32];
+        snprintf (buffer, sizeof (buffer), " pos=%u.", static_cast<unsigned int> (reader.offset ()));
+        error->append (buffer);
+    }
+    return ok;
+}
+
+} // namespace JSON
+
+#endif // __NC_JSON_SCHEMA_INL__
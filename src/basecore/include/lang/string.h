@@ -16,10 +16,14 @@ Creating Time:
 #ifndef __CPP_LANG_STRING_H__
 #define __CPP_LANG_STRING_H__
 #include <iostream>
+#include <stdint.h>
 #include <string.h>
 #include <string>
 #include <vector>
 #include <stdarg.h>
+#ifndef __WINDOWS__
+#include <sys/uio.h>
+#endif
 
 #define t_strncmp   strncmp
 #define t_strlen    strlen
@@ -42,6 +46,400 @@ typedef unsigned long long  uint64;
 
 namespace cpp {
     namespace lang {
+        /*
+         * A set of characters, as a 256-bit map. Build it once and pass it to
+         * String::findAny and friends to search a string for many separators
+         * in one pass; the map is laid out as two nibble lookup tables so the
+         * search can test 16 characters with a few SSSE3 shuffles.
+         *
+         * Bit (ch >> 4) & 7 of rows[ch >> 7][ch & 15] tells whether ch is a member.
+         */
+        class CharSet
+        {
+        public:
+            /*
+            * Initializes the empty set.
+            */
+            CharSet ()
+            {
+                ::memset (_rows, 0, sizeof (_rows));
+            }
+
+            /*
+            * Initializes the set with the characters of a C-style string.
+            *
+            * @param chars 	The member characters, may be null.
+            */
+            explicit CharSet (const tchar_t *chars)
+            {
+                ::memset (_rows, 0, sizeof (_rows));
+                if (chars != 0) {
+                    add (chars, ::strlen (chars));
+                }
+            }
+
+            /*
+            * Initializes the set with the characters of [chars, chars + count).
+            */
+            CharSet (const tchar_t *chars, size_t count)
+            {
+                ::memset (_rows, 0, sizeof (_rows));
+                add (chars, count);
+            }
+
+            void add (tchar_t ch)
+            {
+                _rows[(utchar_t)ch >> 7][ch & 15] |= (utchar_t)(1 << (((utchar_t)ch >> 4) & 7));
+            }
+
+            void add (const tchar_t *chars, size_t count)
+            {
+                for (; count > 0; --count) {
+                    add (*chars++);
+                }
+            }
+
+            bool contains (tchar_t ch) const
+            {
+                return (_rows[(utchar_t)ch >> 7][ch & 15] >> (((utchar_t)ch >> 4) & 7) & 1) != 0;
+            }
+
+            /*
+            * The lookup tables: rows[0] for the characters 0x00-0x7F, rows[1] for 0x80-0xFF.
+            */
+            const utchar_t *rows (int high) const
+            {
+                return _rows[high];
+            }
+
+        private:
+            utchar_t _rows[2][16];
+        };
+
+        class String;
+
+        /*
+         * A non-owning view of characters: a pointer and a length. The viewed
+         * characters must outlive the view, and are not NUL terminated.
+         * String, C-strings and views convert to it implicitly, so one
+         * StringView overload serves them all without a temporary String.
+         */
+        class StringView
+        {
+        public:
+            StringView ()
+                : _ptr (0)
+                , _length (0)
+            {
+            }
+
+            StringView (const tchar_t *ptr, size_t length)
+                : _ptr (ptr)
+                , _length (length)
+            {
+            }
+
+            StringView (const tchar_t *ptr)
+                : _ptr (ptr)
+                , _length (ptr != 0 ? t_strlen (ptr) : 0)
+            {
+            }
+
+            StringView (const String &str);
+
+            const tchar_t *data () const
+            {
+                return _ptr;
+            }
+
+            size_t length () const
+            {
+                return _length;
+            }
+
+            size_t size () const
+            {
+                return _length;
+            }
+
+            bool empty () const
+            {
+                return _length == 0;
+            }
+
+            tchar_t operator[] (size_t n) const
+            {
+                return _ptr[n];
+            }
+
+            /*
+            * Returns the view of [offset, offset + count), trimmed to this view.
+            */
+            StringView substr (size_t offset, size_t count = (size_t)(-1)) const
+            {
+                if (offset > _length) {
+                    offset = _length;
+                }
+                return StringView (_ptr + offset, count < _length - offset ? count : _length - offset);
+            }
+
+            /*
+            * Searches the first / last occurrence of @str at or after / before @offset.
+            *
+            * @return The index of the occurrence, String::NO_POSITION if there is none.
+            */
+            size_t find (StringView str, size_t offset = 0) const;
+            size_t find (tchar_t ch, size_t offset = 0) const;
+            size_t rfind (StringView str, size_t offset = (size_t)(-1)) const;
+
+            /*
+            * Compares lexicographically with @str.
+            *
+            * @return < 0, 0 or > 0 as this view is less than, equal to or greater than @str.
+            */
+            int compare (StringView str) const;
+
+            /*
+            * Compares with @str ignoring case: ASCII letters are folded directly,
+            * other characters by the C library toupper / tolower.
+            */
+            int compareIgnoreCase (StringView str) const;
+
+            /*
+            * Returns a hash of all the characters of this view, the hash of
+            * std::hash<String>. See String::setHashSeed.
+            */
+            size_t hash () const;
+
+            /*
+            * Returns a hash of this view that ignores case, consistent with
+            * compareIgnoreCase.
+            */
+            size_t hashIgnoreCase () const;
+
+            bool startsWith (StringView prefix) const
+            {
+                return _length >= prefix._length && ::memcmp (_ptr, prefix._ptr, prefix._length * sizeof (tchar_t)) == 0;
+            }
+
+            bool endsWith (StringView suffix) const
+            {
+                return _length >= suffix._length && ::memcmp (_ptr + _length - suffix._length, suffix._ptr, suffix._length * sizeof (tchar_t)) == 0;
+            }
+
+            /*
+            * Returns the view without the leading and trailing characters of
+            * @chars, white space (' ', '\t', '\n', '\r', '\v', '\f') by default.
+            * Scans 16 characters at a time when SSSE3 is available.
+            */
+            StringView trim () const;
+            StringView trim (const CharSet &chars) const;
+
+            /*
+            * Counts the occurrences of @ch, or of any character of @chars,
+            * 32 characters a step with AVX2, 16 with SSE2 / SSSE3.
+            */
+            size_t count (tchar_t ch) const;
+            size_t countAny (const CharSet &chars) const;
+
+            /*
+            * Counts the lines: the '\n', plus one for a last line without it.
+            */
+            size_t countLines () const;
+
+            /*
+            * Returns a String holding a copy of the viewed characters.
+            */
+            String toString () const;
+
+        private:
+            const tchar_t *_ptr;
+            size_t         _length;
+        };
+
+        /*
+         * An argument of String::fmt: the value, and which of operator<<
+         * prints it. Built on the stack for every call, nothing is copied.
+         */
+        class FormatArg
+        {
+        public:
+            enum Type
+            {
+                NONE,
+                BOOL,
+                CHAR,
+                INTEGER,
+                UNSIGNED,
+                FLOAT,
+                DOUBLE,
+                TEXT,
+                POINTER
+            };
+
+            FormatArg ()
+                : _type (NONE)
+            {
+            }
+
+            FormatArg (bool b)
+                : _type (BOOL)
+            {
+                _value.u = b;
+            }
+
+            FormatArg (tchar_t ch)
+                : _type (CHAR)
+            {
+                _value.u = (utchar_t)ch;
+            }
+
+            FormatArg (short v)
+            {
+                setInteger (v);
+            }
+
+            FormatArg (int v)
+            {
+                setInteger (v);
+            }
+
+            FormatArg (long v)
+            {
+                setInteger (v);
+            }
+
+            FormatArg (long long v)
+            {
+                setInteger (v);
+            }
+
+            FormatArg (unsigned short v)
+            {
+                setUnsigned (v);
+            }
+
+            FormatArg (unsigned int v)
+            {
+                setUnsigned (v);
+            }
+
+            FormatArg (unsigned long v)
+            {
+                setUnsigned (v);
+            }
+
+            FormatArg (unsigned long long v)
+            {
+                setUnsigned (v);
+            }
+
+            FormatArg (float v)
+                : _type (FLOAT)
+            {
+                _value.d = v;
+            }
+
+            FormatArg (double v)
+                : _type (DOUBLE)
+            {
+                _value.d = v;
+            }
+
+            FormatArg (const tchar_t *ptr)
+                : _type (TEXT)
+            {
+                setText (StringView (ptr));
+            }
+
+            FormatArg (StringView str)
+                : _type (TEXT)
+            {
+                setText (str);
+            }
+
+            FormatArg (const std::string &str)
+                : _type (TEXT)
+            {
+                setText (StringView (str.data (), str.size ()));
+            }
+
+            FormatArg (const String &str);
+
+            /*
+            * Prints the address, as 0x and lowercase hex digits.
+            */
+            FormatArg (const void *ptr)
+                : _type (POINTER)
+            {
+                _value.u = (uintptr_t)ptr;
+            }
+
+            /*
+            * Any other pointer would convert to bool and print "True": cast
+            * it to const void * to print the address.
+            */
+            template<class T>
+            FormatArg (const T *ptr) = delete;
+
+            Type type () const
+            {
+                return _type;
+            }
+
+            int64 integer () const
+            {
+                return _value.i;
+            }
+
+            uint64 unsignedInteger () const
+            {
+                return _value.u;
+            }
+
+            double real () const
+            {
+                return _value.d;
+            }
+
+            StringView text () const
+            {
+                return StringView (_value.text.ptr, _value.text.length);
+            }
+
+        private:
+            void setInteger (int64 v)
+            {
+                _type    = INTEGER;
+                _value.i = v;
+            }
+
+            void setUnsigned (uint64 v)
+            {
+                _type    = UNSIGNED;
+                _value.u = v;
+            }
+
+            void setText (StringView str)
+            {
+                _value.text.ptr    = str.data ();
+                _value.text.length = str.length ();
+            }
+
+            Type _type;
+            union
+            {
+                int64  i;
+                uint64 u;
+                double d;
+                struct
+                {
+                    const tchar_t *ptr;
+                    size_t         length;
+                } text;
+            } _value;
+        };
+
         /*
          * The String class represents characters as a series of Unicode(UTF-16) string.
          * Unlike the String class on .NET and J2SE, this class is mutable because it provides
@@ -66,13 +464,15 @@ namespace cpp {
             */
             String(const String &source)
             {
-                _str.assign(source._str);
+                init();
+                _assign(source.getMyPtr(), source.getLength());
             }
 
         #ifdef __ENABLE_CXX11__
             String (String &&source)
             {
-                _str = std::move(source._str);
+                _store = source._store;
+                source.init();
             }
         #endif
 
@@ -91,7 +491,7 @@ namespace cpp {
             */
             String(const String &source, size_t offset, size_t count = NO_POSITION)
             {
-                init(source.size());
+                init();
                 assign(source, offset, count);
             }
 
@@ -103,7 +503,7 @@ namespace cpp {
             */
             explicit String(tchar_t ch, size_t count)
             {
-                init(count);
+                init();
                 assign(ch, count);
             }
 
@@ -115,14 +515,9 @@ namespace cpp {
             */
             String(const tchar_t* ptr)
             {
-                size_t len = INIT_SIZE;
+                init();
                 if (ptr != 0) {
-                    len = t_strlen(ptr);
-                    init(len);
-                    _assign(ptr, len);
-                }
-                else {
-                    init(len);
+                    _assign(ptr, t_strlen(ptr));
                 }
             }
 
@@ -138,10 +533,19 @@ namespace cpp {
             */
             String(const tchar_t *ptr, size_t count)
             {
-                init(count);
+                init();
                 _assign(ptr, count);
             }
 
+            /*
+            * Initializes this string with a copy of the viewed characters.
+            */
+            explicit String(StringView str)
+            {
+                init();
+                _assign(str.data(), str.length());
+            }
+
             /*
             * Destroy current string instance and release its resources.
             */
@@ -156,18 +560,19 @@ namespace cpp {
             */
             size_t getLength() const
             {
-                return _str.length();
+                return isLocal() ? INLINE_CAPACITY - (utchar_t)_store.local[INLINE_CAPACITY] : _store.heap.size;
             }
 
             /*
             * Returns the largest number of elements that could be stored in a string without 
-            * increasing the memory allocation of the string
+            * increasing the memory allocation of the string. Strings up to INLINE_CAPACITY
+            * characters are stored in the object itself and allocate nothing.
             *
             * @return the size of storage currently allocated in memory to hold the string.
             */
             size_t getCapacity() const
             {
-                return _str.capacity();
+                return isLocal() ? (size_t)INLINE_CAPACITY : getHeapCapacity();
             }
 
             /*
@@ -187,7 +592,7 @@ namespace cpp {
             */
             bool isEmpty() const
             {
-                return _str.empty();
+                return getLength() == 0;
             }
 
             /*
@@ -249,6 +654,11 @@ namespace cpp {
             */
             String &assign (tchar_t ch, size_t count);
 
+            String &assign (StringView str)
+            {
+                return assign (str.data (), str.length ());
+            }
+
         #ifdef __ENABLE_CXX11__
             /*
             * Move assigns new string to the contents of this string.
@@ -306,6 +716,14 @@ namespace cpp {
                 return append(ptr, t_strlen(ptr));
             }
 
+            /*
+            * Adds the viewed characters to the end of this string.
+            */
+            String &append(StringView str)
+            {
+                return append(str.data(), str.length());
+            }
+
             /*
             * Adds @param ch which @param count copies to the end of this string.
             * @param ch 	The character value to be added into the string.
@@ -359,12 +777,11 @@ namespace cpp {
             String &_remove (size_t offset = 0, size_t count = NO_POSITION);
 
             /*
-            * Remove the string and free memory. If just want remove the string,
-            * use method remove().
+            * Remove the string contents, the capacity is kept for reuse.
             */
             void clear()
             {
-                _str.clear();
+                setLength(0);
             }
 
             /*
@@ -376,7 +793,7 @@ namespace cpp {
 
             /*
             * Sets the capacity of the string to a number at least as great as a 
-            *	specified number.
+            *	specified number. The capacity never shrinks.
             *
             * @param newSiz 	The number of characters for which memory is being reserved. 		 
             */
@@ -409,11 +826,11 @@ namespace cpp {
             void resize(size_t newSiz, tchar_t ch = 0)
             {
                 // determine new length, padding with ch elements as needed
-                if (newSiz <= _str.size ()) {
+                if (newSiz <= getLength ()) {
                     _remove (newSiz);
                 }
                 else {
-                    append (ch, newSiz - _str.size ());
+                    append (ch, newSiz - getLength ());
                 }
             }
 
@@ -461,6 +878,11 @@ namespace cpp {
                 return find(source.getMyPtr(), offset, source.getLength());
             }
 
+            size_t find(StringView str, size_t offset = 0) const
+            {
+                return find(str.data(), offset, str.length());
+            }
+
             /*
             * Searches a unicode string in a forward direction for the first occurrence of 
             * a substring that matches a specified sequence of characters.
@@ -518,6 +940,11 @@ namespace cpp {
             * @return 	The index of the last occurrence, when searched backwards, of the 
             *			first character of the substring when successful; otherwise NO_POSITION.
             */
+            size_t rfind(StringView str, size_t offset = NO_POSITION) const
+            {
+                return rfind(str.data(), offset, str.length());
+            }
+
             size_t rfind(const String &source, size_t offset = NO_POSITION) const
             {
                 // look for source beginning before offset
@@ -683,6 +1110,15 @@ namespace cpp {
             */
             size_t findAny(size_t offset, const String &chars) const;
 
+            /*
+            * Reports the index of the first occurrence in this string of any character of a
+            *	prebuilt set, searching 16 characters at a time when the CPU allows it.
+            *
+            * @param offset 	Index of the position at which the search is to begin.
+            * @param chars 	The set of characters to seek, reusable across calls.
+            */
+            size_t findAny(size_t offset, const CharSet &chars) const;
+
             /*
             * Reports the index of the first not occurrence in this string of any character string.
             * 
@@ -708,6 +1144,15 @@ namespace cpp {
             */
             size_t findNotOfAny(size_t offset, const String &chars) const;
 
+            /*
+            * Reports the index of the first not occurrence in this string of any character of a
+            *	prebuilt set, searching 16 characters at a time when the CPU allows it.
+            *
+            * @param offset 	Index of the position at which the search is to begin.
+            * @param chars 	The set of characters to seek, reusable across calls.
+            */
+            size_t findNotOfAny(size_t offset, const CharSet &chars) const;
+
             /*
             * Reports the index of the last occurrence in this string of any character string.
             *
@@ -734,6 +1179,15 @@ namespace cpp {
             */
             size_t findLastOfAny(size_t offset, const String &chars) const;
 
+            /*
+            * Reports the index of the last occurrence in this string of any character of a
+            *	prebuilt set, searching 16 characters at a time when the CPU allows it.
+            *
+            * @param offset 	Index of the position at which the search is to begin.
+            * @param chars 	The set of characters to seek, reusable across calls.
+            */
+            size_t findLastOfAny(size_t offset, const CharSet &chars) const;
+
             /*
             * Reports the index of the last not occurrence in this string of any character string.
             *
@@ -761,6 +1215,15 @@ namespace cpp {
             */
             size_t findLastNotOfAny(size_t offset, const String &chars) const;
 
+            /*
+            * Reports the index of the last not occurrence in this string of any character of a
+            *	prebuilt set, searching 16 characters at a time when the CPU allows it.
+            *
+            * @param offset 	Index of the position at which the search is to begin.
+            * @param chars 	The set of characters to seek, reusable across calls.
+            */
+            size_t findLastNotOfAny(size_t offset, const CharSet &chars) const;
+
             /*
             * Copies a substring of at most some number of characters from a string 
             *	beginning from a specified position.
@@ -779,7 +1242,19 @@ namespace cpp {
             }
 
             /*
-            * Compares a string with a specified string to determine if the two strings are equal 
+            * Returns a view of a substring, without copying it. The view is
+            *	invalidated by any change of this string.
+            *
+            * @param offset 	The index of the first character of the view.
+            * @param count 	The number of characters, trimmed to this string.
+            */
+            StringView view(size_t offset = 0, size_t count = NO_POSITION) const
+            {
+                return StringView(getMyPtr(), getLength()).substr(offset, count);
+            }
+
+            /*
+            * Compares a string with a specified string to determine if the two strings are equal 
             * 	or if one is lexicographically less than the other.
             *
             * @param source The string that is to be compared to this string.
@@ -848,6 +1323,11 @@ namespace cpp {
                 return compare (0, size (), ptr, len);
             }
 
+            int compare (StringView str) const
+            {
+                return compare (0, size (), str.data (), str.length ());
+            }
+
             /*
             * Compares a string with a UNICODE C-string to determine if the two strings are equal 
             * 	or if one is lexicographically less than the other.
@@ -950,6 +1430,11 @@ namespace cpp {
                 return compareIgnoreCase (0, size (), ptr, t_strlen (ptr));
             }
 
+            int compareIgnoreCase (StringView str) const
+            {
+                return compareIgnoreCase (0, size (), str.data (), str.length ());
+            }
+
             /*
             * Compares a string with a UNICODE C-string and ignore case to determine if the 
             *	two strings are equal or if one is lexicographically less than the other.
@@ -1057,6 +1542,11 @@ namespace cpp {
                 return replace (offset, number, ptr, t_strlen (ptr));
             }
 
+            String& replace (size_t offset, size_t number, StringView str)
+            {
+                return replace (offset, number, str.data (), str.length ());
+            }
+
             /*
             * Replaces characters in this string at a specified position with specified character.
             *
@@ -1070,6 +1560,16 @@ namespace cpp {
             */
             String& replace (size_t offset, size_t number, size_t count, tchar_t ch);
 
+            /*
+            * Replaces every occurrence of @from with @to, left to right, in one
+            * pass: the matches are found with the SIMD search of find and the
+            * characters between them copied once, into the same buffer unless
+            * the string grows. See StringReplacer for many patterns at once.
+            *
+            * @return A reference to this string object that be replaced.
+            */
+            String& replaceAll (StringView from, StringView to);
+
             String& insert (size_t offset, const String& source)
             {
                 // insert source at offset
@@ -1086,15 +1586,22 @@ namespace cpp {
                 return insert (offset, ptr, t_strlen (ptr));
             }
 
+            String& insert (size_t offset, StringView str)
+            {
+                return insert (offset, str.data (), str.length ());
+            }
+
             String& insert (size_t offset, tchar_t ch, size_t count);
 
             /*
-            * Convert to upper case in place.
+            * Convert to upper case in place. ASCII letters are converted
+            * 16 at a time, other characters by the C library toupper.
             */
             void toUpper (void);
 
             /*
-            * Convert to lower case in place.
+            * Convert to lower case in place. ASCII letters are converted
+            * 16 at a time, other characters by the C library tolower.
             */
             void toLower (void);
 
@@ -1104,6 +1611,9 @@ namespace cpp {
             *
             * @param ch 	The character specifies to remove
             * @return The string that has been trimmed.  
+            *
+            * To trim white space or a set of characters without a copy, see
+            * StringView::trim: str.view ().trim ().
             */
             String trim (tchar_t ch =  (_T(' '))) const;
 
@@ -1163,11 +1673,34 @@ namespace cpp {
             */
             bool startsWith (const String& prefix) const
             {
-                return startsWith (prefix.getMyPtr ());
+                return StringView (getMyPtr (), getLength ()).startsWith (prefix);
             }
 
             bool startsWith (const tchar_t* prefix) const;
 
+            bool startsWith (StringView prefix) const
+            {
+                return StringView (getMyPtr (), getLength ()).startsWith (prefix);
+            }
+
+            /*
+            * Check that the string ends with suffix.
+            */
+            bool endsWith (const String& suffix) const
+            {
+                return StringView (getMyPtr (), getLength ()).endsWith (suffix);
+            }
+
+            bool endsWith (const tchar_t* suffix) const
+            {
+                return StringView (getMyPtr (), getLength ()).endsWith (StringView (suffix));
+            }
+
+            bool endsWith (StringView suffix) const
+            {
+                return StringView (getMyPtr (), getLength ()).endsWith (suffix);
+            }
+
             /*
             * Minimize the string's memory
             */
@@ -1179,9 +1712,30 @@ namespace cpp {
 
             /*
             * Count the number of characters
+            *
+            * The count is truncated to int, see count.
             */
             int freq (tchar_t ch) const;
 
+            /*
+            * Counts the occurrences of @ch, or of any character of @chars, and
+            * the lines. See StringView::count.
+            */
+            size_t count (tchar_t ch) const
+            {
+                return StringView (getMyPtr (), getLength ()).count (ch);
+            }
+
+            size_t countAny (const CharSet& chars) const
+            {
+                return StringView (getMyPtr (), getLength ()).countAny (chars);
+            }
+
+            size_t countLines () const
+            {
+                return StringView (getMyPtr (), getLength ()).countLines ();
+            }
+
             /*
             * Creates an array of strings by splitting this string with a 
             *	specified separator string.
@@ -1198,6 +1752,19 @@ namespace cpp {
             */
             void split (const String& separators, std::vector<String>& substrs, bool oneInSeparators = true) const;
 
+            /*
+            * Splits this string on any character of @separators into views of
+            *	this string, without allocating. Tokens are the same as those
+            *	of split (separators, substrs). Once @capacity tokens are
+            *	found, the last one holds the rest of the string.
+            *
+            * @param separators	The set of separator characters.
+            * @param tokens		The caller-supplied array of views.
+            * @param capacity		The number of elements of @tokens.
+            * @return The number of tokens stored.
+            */
+            size_t split (const CharSet& separators, StringView* tokens, size_t capacity) const;
+
             /*
             * Separates this string with the specified separator.
             *
@@ -1218,8 +1785,7 @@ namespace cpp {
 
             String& operator= (const std::basic_string<tchar_t>& source)
             {
-                _str = source;
-                return *this;
+                return _assign (source.data (), source.size ());
             }
 
         #ifdef __ENABLE_CXX11__
@@ -1230,8 +1796,7 @@ namespace cpp {
 
             String& operator= (std::basic_string<tchar_t>&& source)
             {
-                _str = std::move (source);
-                return *this;
+                return _assign (source.data (), source.size ());
             }
         #endif
 
@@ -1245,6 +1810,11 @@ namespace cpp {
                 return assign (ch, 1);
             }
 
+            String& operator= (StringView str)
+            {
+                return assign (str);
+            }
+
             String& operator+= (const String& source)
             {
                 return append (source);
@@ -1260,6 +1830,11 @@ namespace cpp {
                 return append (ch, (size_t)1);
             }
 
+            String& operator+= (StringView str)
+            {
+                return append (str);
+            }
+
             /*
             * Operator version of at
             */
@@ -1288,8 +1863,7 @@ namespace cpp {
             */
             String& operator<< (int v)
             {
-                std::string str = std::to_string (v);
-                return append (str.data (), str.size ());
+                return appendInteger (v < 0 ? 0 - (uint64)v : (uint64)v, v < 0);
             }
 
             /*
@@ -1297,8 +1871,7 @@ namespace cpp {
             */
             String& operator<< (unsigned int v)
             {
-                std::string str = std::to_string (v);
-                return append (str.data (), str.size ());
+                return appendInteger (v, false);
             }
 
             /*
@@ -1306,8 +1879,7 @@ namespace cpp {
             */
             String& operator<< (const int64& v)
             {
-                std::string str = std::to_string (v);
-                return append (str.data (), str.size ());
+                return appendInteger (v < 0 ? 0 - (uint64)v : (uint64)v, v < 0);
             }
 
             /*
@@ -1315,26 +1887,25 @@ namespace cpp {
             */
             String& operator<< (const uint64& v)
             {
-                std::string str = std::to_string (v);
-                return append (str.data (), str.size ());
+                return appendInteger (v, false);
             }
 
             /*
-            * Append a float into string
+            * Append a float into string, with the fewest digits that read back
+            * as the same float: "0.1", "1e+21", "nan", "-inf".
             */
             String& operator<< (float v)
             {
-                std::string str = std::to_string (v);
-                return append (str.data (), str.size ());
+                return appendFloat (v, true);
             }
 
             /*
-            * Append a double into string
+            * Append a double into string, with the fewest digits that read back
+            * as the same double: "0.1", "1e+21", "nan", "-inf".
             */
             String& operator<< (double v)
             {
-                std::string str = std::to_string (v);
-                return append (str.data (), str.size ());
+                return appendFloat (v, false);
             }
 
             String& operator<< (const String& source)
@@ -1352,6 +1923,11 @@ namespace cpp {
                 return append (ch, (size_t)1);
             }
 
+            String& operator<< (StringView str)
+            {
+                return append (str);
+            }
+
             /*
             * This method writes formatted data to a String in the same way that sprintf 
             *	formats data into a C-style character array.
@@ -1371,38 +1947,62 @@ namespace cpp {
             */
             void formatv (const tchar_t* fmt, va_list ap);
 
-            // for std::string compat
-
-            String (const std::basic_string<tchar_t>& str)
-                : _str (str)
+            /*
+            * Appends @format with its placeholders replaced by the arguments,
+            * each printed as operator<< prints it:
+            *
+            *	str.appendFmt ("{} [worker-{}] took {} ms", level, worker, 12.5);
+            *
+            * "{}" is the next argument, "{n}" the argument n (from 0), "{{" and
+            * "}}" are braces. A placeholder without an argument is copied as is.
+            * A const void * prints as its address, other pointers than text do
+            * not compile.
+            * The arguments are checked by their types, not by the format, and
+            * nothing is rendered into a temporary buffer.
+            *
+            * @param format The format, with "{}" placeholders.
+            */
+            template<class... Args>
+            String& appendFmt (const tchar_t* format, const Args&... args)
             {
+                const FormatArg list[] = { FormatArg (args)..., FormatArg () };
+                return appendFormat (StringView (format), list, sizeof... (Args));
             }
 
-        #ifdef __ENABLE_CXX11__
-            String (std::basic_string<tchar_t>&& str)
-                : _str (std::move (str))
+            /*
+            * Returns @format with its placeholders replaced by the arguments,
+            * see appendFmt.
+            *
+            *	String key = String::fmt ("{}:{}", host, port);
+            */
+            template<class... Args>
+            static String fmt (const tchar_t* format, const Args&... args)
             {
+                String str;
+                str.appendFmt (format, args...);
+                return str;
             }
-        #endif
 
-            std::basic_string<tchar_t>& str ()
-            {
-                return _str;
-            }
+            // for std::string compat
 
-            const std::basic_string<tchar_t>& str () const
+            String (const std::basic_string<tchar_t>& str)
             {
-                return _str;
+                init ();
+                _assign (str.data (), str.size ());
             }
 
-            operator std::basic_string<tchar_t> () const
+            /*
+            * Returns a std::basic_string copy of this string. The copy is const
+            * so that s.str ().append (x), which used to edit s, fails to compile.
+            */
+            const std::basic_string<tchar_t> str () const
             {
-                return _str;
+                return std::basic_string<tchar_t> (getMyPtr (), getLength ());
             }
 
-            operator std::basic_string<tchar_t>& ()
+            operator std::basic_string<tchar_t> () const
             {
-                return _str;
+                return str ();
             }
 
             size_t size () const
@@ -1483,27 +2083,21 @@ namespace cpp {
         #ifdef __WINDOWS__
             String (const char* ptr)
             {
-                size_t len = INIT_SIZE;
+                init ();
                 if (ptr != 0)
                 {
-                    len = strlen (ptr) * 2;
-                    init (len);
                     assign (ptr);
                 }
-                else
-                {
-                    init (len);
-                }
             }
             String (const char* ptr, size_t count)
             {
-                init (count * 2);
+                init ();
                 assign (ptr, count);
             }
             String& operator= (const string& str)
             {
-                _str = utf8_to_utf16 (str);
-                return *this;
+                std::wstring ws = utf8_to_utf16 (str);
+                return _assign (ws.data (), ws.size ());
             }
             String& operator= (const char* ptr)
             {
@@ -1574,24 +2168,51 @@ namespace cpp {
 
             operator std::string () const
             {
-                return utf16_to_utf8 (_str);
+                return utf16_to_utf8 (str ());
             }
 
             String (const std::string& str, bool is_ascii = false)
             {
-                if (is_ascii)
-                {
-                    _str = ascii_to_utf16 (str);
-                }
-                else
-                {
-                    _str = utf8_to_utf16 (str);
-                }
-            }
+                std::wstring ws = is_ascii ? ascii_to_utf16 (str) : utf8_to_utf16 (str);
+                init ();
+                _assign (ws.data (), ws.size ());
+            }
+        #else
+            // UTF-8 <-> wchar_t (UTF-32) and UTF-16, see utf8ToUtf16 and friends;
+            // an invalid sequence ends the conversion
+            static std::wstring   to_wstring (const std::string& utf8);
+            static std::string    to_string (const std::wstring& wstr);
+            static std::u16string utf8_to_utf16 (const std::string& utf8);
+            static std::string    utf16_to_utf8 (const std::u16string& utf16);
         #endif
 
             // static method
         public:
+            /*
+            * Seeds the hash of std::hash<String> and StringView::hash, e.g. with a
+            * random value against hash flooding by untrusted keys. Call it at
+            * start-up before any hashed container is filled: hashes computed
+            * with another seed become invalid. The seed is 0 by default, so the
+            * hashes are the same from run to run.
+            */
+            static void setHashSeed (uint64_t seed);
+
+            /*
+            * Transcoders between UTF-8 (String), UTF-16 and UTF-32, on every
+            * platform. Runs of ASCII are converted 16 characters at a time.
+            * The input is validated: overlong forms, surrogates in UTF-8,
+            * unpaired surrogates and code points above U+10FFFF are invalid.
+            *
+            * @return false if the input is invalid, @out then holds the
+            *	conversion of the input before the invalid sequence.
+            */
+            static bool utf8ToUtf16 (StringView utf8, std::u16string& out);
+            static bool utf8ToUtf32 (StringView utf8, std::u32string& out);
+            static bool utf16ToUtf8 (const char16_t* utf16, size_t count, String& out);
+            static bool utf32ToUtf8 (const char32_t* utf32, size_t count, String& out);
+            static bool utf16ToUtf32 (const char16_t* utf16, size_t count, std::u32string& out);
+            static bool utf32ToUtf16 (const char32_t* utf32, size_t count, std::u16string& out);
+
             // number to string
             static String toString (bool b)
             {
@@ -1667,25 +2288,95 @@ namespace cpp {
 
             // internal methods
         private:
+            /*
+            * Storage of a string. Up to INLINE_CAPACITY characters are kept in
+            * local, the last element of local holds INLINE_CAPACITY - length, so
+            * it is also the terminating NUL of a full inline string. Longer
+            * strings live in heap, and that element is then HEAP_MARK: it
+            * overlaps the capacity, which is encoded to keep the mark there.
+            */
+            struct Heap
+            {
+                tchar_t* ptr;
+                size_t   size;
+                size_t   capacity;
+            };
+
+            union Storage
+            {
+                Heap    heap;
+                tchar_t local[sizeof (Heap) / sizeof (tchar_t)];
+            };
+
             enum
             {
-                /* From the pooled allocator, this init size always used
-                    the third slot(24) fully */
-                INIT_SIZE = 9
+                INLINE_CAPACITY = sizeof (Heap) / sizeof (tchar_t) - 1,
+                HEAP_MARK       = 0xFF
             };
 
-            void init (size_t initsize = INIT_SIZE);
+            void init ()
+            {
+                // the empty inline string, no memory is reserved
+                _store.local[0]               = 0;
+                _store.local[INLINE_CAPACITY] = (tchar_t)INLINE_CAPACITY;
+            }
+
+            bool isLocal () const
+            {
+                return (utchar_t)_store.local[INLINE_CAPACITY] != HEAP_MARK;
+            }
+
+            size_t getHeapCapacity () const
+            {
+            #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                return _store.heap.capacity >> 8;
+            #else
+                return _store.heap.capacity & ~((size_t)HEAP_MARK << (8 * (sizeof (size_t) - 1)));
+            #endif
+            }
+
+            void setHeap (tchar_t* ptr, size_t size, size_t capacity)
+            {
+                _store.heap.ptr  = ptr;
+                _store.heap.size = size;
+            #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                _store.heap.capacity = (capacity << 8) | HEAP_MARK;
+            #else
+                _store.heap.capacity = capacity | ((size_t)HEAP_MARK << (8 * (sizeof (size_t) - 1)));
+            #endif
+            }
+
+            void setLength (size_t length)
+            {
+                // the caller guarantees length <= getCapacity ()
+                if (isLocal ()) {
+                    _store.local[length]          = 0;
+                    _store.local[INLINE_CAPACITY] = (tchar_t)(INLINE_CAPACITY - length);
+                }
+                else {
+                    _store.heap.ptr[length] = 0;
+                    _store.heap.size        = length;
+                }
+            }
+
+            size_t growCapacity (size_t required) const;
+            void   reallocate (size_t capacity);
+            tchar_t* splice (size_t offset, size_t number, size_t count);
+
+            String& appendInteger (uint64 magnitude, bool negative);
+            String& appendFloat (double value, bool single);
+            String& appendFormat (StringView format, const FormatArg* args, size_t count);
 
             tchar_t* getMyPtr (void)
             {
                 // determine current pointer to buffer for mutable string
-                return const_cast<tchar_t*> (_str.data ());
+                return isLocal () ? _store.local : _store.heap.ptr;
             }
 
             const tchar_t* getMyPtr (void) const
             {
                 // determine current pointer to buffer for mutable string
-                return _str.data ();
+                return isLocal () ? _store.local : _store.heap.ptr;
             }
 
             bool inside (const tchar_t* ptr)
@@ -1704,7 +2395,7 @@ namespace cpp {
             }
             // Data members
         private:
-            std::basic_string<tchar_t> _str;
+            Storage _store;
 
         public:
             static const size_t NO_POSITION;
@@ -1715,7 +2406,481 @@ namespace cpp {
 
         }; // End class String
 
-        const size_t String::NO_POSITION = (size_t)(-1);
+        inline
+        StringView::StringView (const String &str)
+            : _ptr (str.getCStr ())
+            , _length (str.getLength ())
+        {
+        }
+
+        inline
+        FormatArg::FormatArg (const String &str)
+            : _type (TEXT)
+        {
+            setText (str);
+        }
+
+        inline String
+        StringView::toString () const
+        {
+            return String (_ptr, _length);
+        }
+
+        /////////////////////////////////////////////////////////////////////////////////////////////////
+        // StringView comparison functions, String and C-strings convert to StringView
+
+        inline bool
+        operator== (StringView s1, StringView s2)
+        {
+            return s1.length () == s2.length () && ::memcmp (s1.data (), s2.data (), s1.length () * sizeof (tchar_t)) == 0;
+        }
+
+        inline bool
+        operator!= (StringView s1, StringView s2)
+        {
+            return !(s1 == s2);
+        }
+
+        inline bool
+        operator< (StringView s1, StringView s2)
+        {
+            return s1.compare (s2) < 0;
+        }
+
+        inline bool
+        operator> (StringView s1, StringView s2)
+        {
+            return s1.compare (s2) > 0;
+        }
+
+        inline bool
+        operator<= (StringView s1, StringView s2)
+        {
+            return s1.compare (s2) <= 0;
+        }
+
+        inline bool
+        operator>= (StringView s1, StringView s2)
+        {
+            return s1.compare (s2) >= 0;
+        }
+
+        /*
+         * Case-insensitive hash and equality, for hash containers keyed by
+         * String whose keys match ignoring case (header names, ...):
+         *
+         *	std::unordered_map<String, String, StringHashIgnoreCase, StringEqualIgnoreCase> headers;
+         */
+        struct StringHashIgnoreCase
+        {
+            size_t operator() (StringView str) const
+            {
+                return str.hashIgnoreCase ();
+            }
+        };
+
+        struct StringEqualIgnoreCase
+        {
+            bool operator() (StringView s1, StringView s2) const
+            {
+                return s1.length () == s2.length () && s1.compareIgnoreCase (s2) == 0;
+            }
+        };
+
+        /*
+         * Splits a string lazily: each call of next () yields the next token
+         * as a view into the string, so tokenizing allocates nothing. The
+         * tokens are those of String::split, the string must outlive the
+         * splitter.
+         *
+         *	StringSplitter tokens (line, CharSet (",;"));
+         *	for (StringView token; tokens.next (token);) {
+         *		...
+         *	}
+         */
+        class StringSplitter
+        {
+        public:
+            /*
+            * Splits on any character of @separators.
+            */
+            StringSplitter (const String &str, const CharSet &separators)
+                : _str (str)
+                , _mode (BY_SET)
+                , _set (separators)
+                , _separator (0)
+                , _offset (str.isEmpty () ? String::NO_POSITION : 0)
+            {
+            }
+
+            /*
+            * Splits on @separator.
+            */
+            StringSplitter (const String &str, tchar_t separator)
+                : _str (str)
+                , _mode (BY_CHAR)
+                , _separator (separator)
+                , _offset (str.isEmpty () ? String::NO_POSITION : 0)
+            {
+            }
+
+            /*
+            * Splits on the characters of @separators, or on the whole
+            *	sequence if @oneInSeparators is false, as String::split does.
+            *	The sequence is copied, so a temporary such as "::" is fine.
+            */
+            StringSplitter (const String &str, const String &separators, bool oneInSeparators = true)
+                : _str (str)
+                , _mode (separators.isEmpty () ? BY_NONE : oneInSeparators ? BY_SET : BY_SEQUENCE)
+                , _set (separators.getCStr (), oneInSeparators ? separators.getLength () : 0)
+                , _separator (0)
+                , _sequence (oneInSeparators ? String () : separators)
+                , _offset (str.isEmpty () ? String::NO_POSITION : 0)
+            {
+            }
+
+            /*
+            * Yields the next token.
+            *
+            * @param token 	Receives the view of the token.
+            * @return false once all tokens were yielded.
+            */
+            bool next (StringView &token);
+
+        private:
+            enum Mode
+            {
+                BY_SET,
+                BY_CHAR,
+                BY_SEQUENCE,
+                BY_NONE
+            };
+
+            const String  &_str;
+            Mode           _mode;
+            CharSet        _set;
+            tchar_t        _separator;
+            String         _sequence;
+            size_t         _offset; // of the next token, NO_POSITION when done
+        };
+
+        /*
+         * Builds a long string out of many pieces. Pieces are copied once into
+         * a list of blocks, and a full block is never moved again. toString and
+         * appendTo flatten the blocks once at the end. chunks exports them for
+         * writev without flattening at all.
+         *
+         *	StringBuilder body;
+         *	body << "{\"items\": [" << count << ...;
+         *
+         *	struct iovec iov[IOV_MAX];
+         *	for (size_t first = 0, n; (n = body.chunks (iov, IOV_MAX, first)) != 0; first += n) {
+         *		writev (fd, iov, (int)n);
+         *	}
+         */
+        class StringBuilder
+        {
+        public:
+            /*
+            * @param blockSize The size of the blocks, in characters.
+            */
+            explicit StringBuilder (size_t blockSize = 64 * 1024);
+            ~StringBuilder ();
+
+            StringBuilder& append (const tchar_t* ptr, size_t count)
+            {
+                if (!_blocks.empty () && _blocks.back ().capacity - _blocks.back ().size >= count) {
+                    Block& block = _blocks.back ();
+                    ::memcpy (block.ptr + block.size, ptr, count * sizeof (tchar_t));
+                    block.size += count;
+                    _length += count;
+                    return *this;
+                }
+                return appendBlocks (ptr, count);
+            }
+
+            StringBuilder& append (StringView str)
+            {
+                return append (str.data (), str.length ());
+            }
+
+            StringBuilder& append (tchar_t ch)
+            {
+                return append (&ch, 1);
+            }
+
+            StringBuilder& operator<< (StringView str)
+            {
+                return append (str.data (), str.length ());
+            }
+
+            StringBuilder& operator<< (const String& str)
+            {
+                return append (str.getCStr (), str.getLength ());
+            }
+
+            StringBuilder& operator<< (const tchar_t* ptr)
+            {
+                return append (StringView (ptr));
+            }
+
+            StringBuilder& operator<< (tchar_t* ptr)
+            {
+                return append (StringView (ptr));
+            }
+
+            StringBuilder& operator<< (tchar_t ch)
+            {
+                return append (&ch, 1);
+            }
+
+            /*
+            * Numbers and bool, printed as String::operator<< prints them.
+            */
+            template<class T>
+            StringBuilder& operator<< (const T& value)
+            {
+                String str; // fits the inline buffer, nothing is allocated
+                str << value;
+                return append (str.getCStr (), str.getLength ());
+            }
+
+            /*
+            * Appends @format with its placeholders replaced, see String::appendFmt.
+            */
+            template<class... Args>
+            StringBuilder& appendFmt (const tchar_t* format, const Args&... args)
+            {
+                String str;
+                str.appendFmt (format, args...);
+                return append (str.getCStr (), str.getLength ());
+            }
+
+            size_t length () const
+            {
+                return _length;
+            }
+
+            bool empty () const
+            {
+                return _length == 0;
+            }
+
+            /*
+            * Empties the builder, keeps its first block.
+            */
+            void clear ();
+
+            /*
+            * Returns the built string, copied into one String.
+            */
+            String toString () const;
+
+            /*
+            * Appends the built string to @str, with one allocation at most.
+            */
+            void appendTo (String& str) const;
+
+            /*
+            * The blocks holding the built string, in order.
+            */
+            size_t chunkCount () const
+            {
+                return _blocks.size ();
+            }
+
+            StringView chunk (size_t index) const
+            {
+                return StringView (_blocks[index].ptr, _blocks[index].size);
+            }
+
+        #ifndef __WINDOWS__
+            /*
+            * Fills @iov with the blocks from @first on, for writev.
+            *
+            * @return The count of entries filled, at most @capacity.
+            */
+            size_t chunks (struct iovec* iov, size_t capacity, size_t first = 0) const;
+        #endif
+
+        private:
+            StringBuilder (const StringBuilder&);
+            StringBuilder& operator= (const StringBuilder&);
+
+            StringBuilder& appendBlocks (const tchar_t* ptr, size_t count);
+
+            struct Block
+            {
+                tchar_t* ptr;
+                size_t   size;
+                size_t   capacity;
+            };
+
+            std::vector<Block> _blocks;
+            size_t             _blockSize;
+            size_t             _length;
+        };
+
+        /*
+         * Replaces many patterns in one pass over the text (escaping, simple
+         * templates), with an Aho-Corasick automaton built once by the
+         * constructor. Where patterns overlap the leftmost match wins, the
+         * longest of those starting at the same place. A replacer is
+         * immutable and may be shared between threads.
+         *
+         * Up to 4 patterns of one character each (escaping) skip the
+         * automaton: the characters are counted, then the result is written
+         * in place, at about the speed of one replaceAll per pattern. Where
+         * a single pattern of one character rarely matches, its replaceAll
+         * (a memchr) remains the faster choice.
+         *
+         *	static const StringView from[] = { "&", "<", ">", "\"" };
+         *	static const StringView to[]   = { "&amp;", "&lt;", "&gt;", "&quot;" };
+         *	static const StringReplacer escape (from, to, 4);
+         *	String html = escape.replace (text);
+         */
+        class StringReplacer
+        {
+        public:
+            /*
+            * @param patterns 	The strings to replace, empty ones are ignored.
+            * @param replacements 	The string that replaces each pattern.
+            * @param count 	The number of patterns.
+            */
+            StringReplacer (const StringView* patterns, const StringView* replacements, size_t count);
+
+            /*
+            * Returns a copy of @text with the patterns replaced.
+            */
+            String replace (StringView text) const;
+
+            /*
+            * Appends @text with the patterns replaced to @out.
+            *
+            * @return The number of replacements.
+            */
+            size_t replace (StringView text, String& out) const;
+
+        private:
+            enum
+            {
+                NO_MATCH = -1
+            };
+
+            struct State
+            {
+                int32_t  match;  // longest pattern ending here, or NO_MATCH
+                uint32_t depth;  // length of the prefix this state matched
+            };
+
+            std::vector<int32_t> _next;    // transitions, one row of _classCount per state
+            std::vector<State>   _states;
+            std::vector<String>  _replacements;
+            std::vector<size_t>  _lengths; // of the patterns
+            utchar_t             _classes[256];
+            size_t               _classCount;
+            CharSet              _firsts;  // first characters of the patterns
+            tchar_t              _singles[4]; // the characters to replace when all patterns are single ones
+            size_t               _singleCount; // 0 when the automaton runs
+        };
+
+        /*
+         * A string interned in a table global to the process: all the
+         * InternedStrings of the same characters share one copy, the atom,
+         * which is never freed. Equality compares the atoms and the hash is
+         * computed once, so repeated keys (metric names, config keys, ...)
+         * are cheap to store, to compare and to use as hash map keys:
+         *
+         *	std::unordered_map<InternedString, Counter> counters;
+         *	counters[InternedString (name)].add (1);
+         *
+         * Interning takes a lock on one of the shards of the table, the
+         * other operations are lock-free. Any thread may intern.
+         */
+        class InternedString
+        {
+        public:
+            /*
+            * The empty string.
+            */
+            InternedString ();
+
+            /*
+            * Looks @str up in the table, adds it when it is not there yet.
+            */
+            explicit InternedString (StringView str);
+
+            const tchar_t* c_str () const
+            {
+                return _atom->chars;
+            }
+
+            size_t length () const
+            {
+                return _atom->length;
+            }
+
+            bool empty () const
+            {
+                return _atom->length == 0;
+            }
+
+            /*
+            * Returns the hash computed when the string was interned. It is
+            * seeded per process, not by String::setHashSeed.
+            */
+            size_t hash () const
+            {
+                return _atom->hash;
+            }
+
+            StringView view () const
+            {
+                return StringView (_atom->chars, _atom->length);
+            }
+
+            String toString () const
+            {
+                return String (_atom->chars, _atom->length);
+            }
+
+            /*
+            * Returns the count of strings interned so far.
+            */
+            static size_t count ();
+
+            friend bool operator== (InternedString s1, InternedString s2)
+            {
+                return s1._atom == s2._atom;
+            }
+
+            friend bool operator!= (InternedString s1, InternedString s2)
+            {
+                return s1._atom != s2._atom;
+            }
+
+            /*
+            * An arbitrary order, fixed for the life of the process, for
+            * ordered containers. Use view () to sort by the characters.
+            */
+            friend bool operator< (InternedString s1, InternedString s2)
+            {
+                return s1._atom < s2._atom;
+            }
+
+            /*
+            * The shared copy of the characters, allocated by the table.
+            */
+            struct Atom
+            {
+                size_t  hash;
+                size_t  length;
+                tchar_t chars[1]; // length characters and '\0'
+            };
+
+        private:
+            const Atom* _atom;
+        };
 
         /////////////////////////////////////////////////////////////////////////////////////////////////
         // String comparison functions: operator versions are always case sensitive
@@ -1973,16 +3138,25 @@ namespace std {
     {
         size_t operator() (const cpp::lang::String &_Str) const
         { // hash string to size_t value
-            size_t _Val  = (size_t)0xdeadbeef;
-            size_t _Size = _Str.getLength ();
-            if (0 < _Size)
-            { // add one or more elements
-                size_t _Stride = (_Size / 16) + 1;
-                _Size -= _Stride; // protect against _Size near _Str.max_size()
-                for (size_t _Idx = 0; _Idx <= _Size; _Idx += _Stride)
-                    _Val += (size_t)_Str[(int)_Idx];
-            }
-            return (_Val);
+            return cpp::lang::StringView (_Str).hash ();
+        }
+    };
+
+    template<>
+    struct hash<cpp::lang::StringView>
+    {
+        size_t operator() (cpp::lang::StringView _Str) const
+        { // hash view to size_t value, equal to the hash of the same String
+            return _Str.hash ();
+        }
+    };
+
+    template<>
+    struct hash<cpp::lang::InternedString>
+    {
+        size_t operator() (cpp::lang::InternedString _Str) const
+        { // the hash computed when the string was interned
+            return _Str.hash ();
         }
     };
 
@@ -5,51 +5,1675 @@
 #include <stdarg.h>
 #include <stdint.h>
 #include <string.h>
+#include <stddef.h>
+#include <new>
+#include <stdexcept>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STRING_SSE2
+#endif
+
+// SSSE3 (pshufb) is not in the x86-64 baseline: unless the build enables it,
+// GCC and Clang compile the SSSE3 functions for that target only and pick
+// them at run time.
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define STRING_SSSE3
+#define STRING_TARGET_SSSE3
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define STRING_SSSE3
+#define STRING_SSSE3_DISPATCH
+#define STRING_TARGET_SSSE3 __attribute__ ((target ("ssse3")))
+#endif
+
+// AVX2 likewise, for the counting loops.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define STRING_AVX2
+#define STRING_TARGET_AVX2
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define STRING_AVX2
+#define STRING_AVX2_DISPATCH
+#define STRING_TARGET_AVX2 __attribute__ ((target ("avx2")))
+#endif
 
 namespace detail {
 
-    inline void throw_xran (const cpp::lang::String &msg) 
+    inline void throw_xran (const char *msg)
     {
-        // throw cpp::lang::Exception(0, ::toSTLString(msg));
+        // what std::basic_string throws for the same offsets
+        throw std::out_of_range (msg);
     }
 
     template<class T>
-    inline const T*
-    find(const T *first, size_t count, const T &ch)
+    inline bool
+    match (const T *first, const T *ch, size_t count)
     {
         // look for ch in [first, first + count)
-        for (; 0 < count; --count, ++first) {
-            if (*first == ch) {
-                return (first);
+        for (; 0 < count; --count, ++first, ++ch) {
+            if (*first != *ch) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // index of the lowest / highest set bit of a non-zero mask
+    inline unsigned
+    lowest_bit (unsigned mask)
+    {
+    #ifdef __GNUC__
+        return (unsigned)__builtin_ctz (mask);
+    #else
+        unsigned bit = 0;
+        for (; (mask & 1) == 0; mask >>= 1) {
+            ++bit;
+        }
+        return bit;
+    #endif
+    }
+
+    inline unsigned
+    highest_bit (unsigned mask)
+    {
+    #ifdef __GNUC__
+        return 31 - (unsigned)__builtin_clz (mask);
+    #else
+        unsigned bit = 0;
+        for (; mask >>= 1;) {
+            ++bit;
+        }
+        return bit;
+    #endif
+    }
+
+    // Maximal suffix of [ptr, ptr + count) for the ordering selected by
+    // reverse, returns its start - 1 and stores its period in period.
+    inline size_t
+    maximal_suffix (const tchar_t *ptr, size_t count, bool reverse, size_t &period)
+    {
+        size_t ip = (size_t)-1, jp = 0, k = 1;
+
+        period = 1;
+        while (jp + k < count) {
+            utchar_t a = (utchar_t)ptr[ip + k];
+            utchar_t b = (utchar_t)ptr[jp + k];
+            if (a == b) {
+                if (k == period) {
+                    jp += period;
+                    k = 1;
+                }
+                else {
+                    ++k;
+                }
+            }
+            else if (reverse ? a < b : a > b) {
+                jp += k;
+                k      = 1;
+                period = jp - ip;
+            }
+            else {
+                ip = jp++;
+                k = period = 1;
+            }
+        }
+        return ip;
+    }
+
+    // Two-Way (Crochemore-Perrin): linear time and constant space for any
+    // needle, used once the filter of search keeps hitting false candidates.
+    // Look for [ptr, ptr + count) in [first, first + size), 1 < count <= size.
+    inline const tchar_t*
+    search_two_way (const tchar_t *first, size_t size, const tchar_t *ptr, size_t count)
+    {
+        // the last character of the window decides the shift when it does
+        // not end a needle prefix: shift[c] is 1 + the last index of c
+        size_t shift[256];
+        size_t present[256 / (8 * sizeof (size_t))] = { 0 };
+        for (size_t i = 0; i < count; ++i) {
+            utchar_t c = (utchar_t)ptr[i];
+            present[c / (8 * sizeof (size_t))] |= (size_t)1 << (c % (8 * sizeof (size_t)));
+            shift[c] = i + 1;
+        }
+
+        // critical factorization: the larger of the two maximal suffixes
+        size_t period, reversePeriod;
+        size_t ms  = maximal_suffix (ptr, count, false, period);
+        size_t rms = maximal_suffix (ptr, count, true, reversePeriod);
+        if (rms + 1 > ms + 1) {
+            ms     = rms;
+            period = reversePeriod;
+        }
+
+        size_t memory0;
+        if (::memcmp (ptr, ptr + period, (ms + 1) * sizeof (tchar_t)) != 0) {
+            // not periodic: the halves can not overlap a match, no memory
+            memory0 = 0;
+            period  = (ms > count - ms - 1 ? ms : count - ms - 1) + 1;
+        }
+        else {
+            memory0 = count - period;
+        }
+
+        const tchar_t *end    = first + size;
+        size_t         memory = 0;
+        for (const tchar_t *uptr = first; (size_t)(end - uptr) >= count;) {
+            utchar_t c = (utchar_t)uptr[count - 1];
+            if ((present[c / (8 * sizeof (size_t))] >> (c % (8 * sizeof (size_t))) & 1) == 0) {
+                uptr += count;
+                memory = 0;
+                continue;
+            }
+            size_t k = count - shift[c];
+            if (k != 0) {
+                uptr += k < memory ? memory : k;
+                memory = 0;
+                continue;
+            }
+
+            // right half, then left half
+            for (k = ms + 1 > memory ? ms + 1 : memory; k < count && ptr[k] == uptr[k]; ++k) {
+            }
+            if (k < count) {
+                uptr += k - ms;
+                memory = 0;
+                continue;
+            }
+            for (k = ms + 1; k > memory && ptr[k - 1] == uptr[k - 1]; --k) {
             }
+            if (k <= memory) {
+                return uptr;
+            }
+            uptr += period;
+            memory = memory0;
         }
         return (0);
     }
 
-    template<class T>
+    // Look for [ptr, ptr + count) in [first, first + size), 0 < count <= size.
+    // Candidates are positions where both the first and the last character of
+    // the needle match, 16 of them are tested with two SSE2 compares; only
+    // candidates are compared in full. When false candidates cost more than
+    // the scan itself (periodic text and needle), the rest is left to Two-Way.
+    inline const tchar_t*
+    search (const tchar_t *first, size_t size, const tchar_t *ptr, size_t count)
+    {
+        if (count == 1) {
+            return static_cast<const tchar_t*> (::memchr (first, ptr[0], size));
+        }
+
+        const tchar_t *last = first + size - count; // last candidate
+        const tchar_t *uptr = first;
+        size_t         work = 0;                    // characters compared for false candidates
+    #ifdef STRING_SSE2
+        const __m128i head = _mm_set1_epi8 (ptr[0]);
+        const __m128i tail = _mm_set1_epi8 (ptr[count - 1]);
+        for (; last - uptr >= 15; uptr += 16) {
+            __m128i  a    = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (uptr));
+            __m128i  b    = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (uptr + count - 1));
+            unsigned mask = (unsigned)_mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (a, head), _mm_cmpeq_epi8 (b, tail)));
+            for (; mask != 0; mask &= mask - 1) {
+                const tchar_t *vptr = uptr + lowest_bit (mask);
+                if (::memcmp (vptr + 1, ptr + 1, count - 2) == 0) {
+                    return vptr;
+                }
+                if ((work += count) > 4 * (size_t)(vptr - first) + 256) {
+                    return search_two_way (vptr + 1, last + count - vptr - 1, ptr, count);
+                }
+            }
+        }
+    #endif
+        while (uptr <= last) {
+            uptr = static_cast<const tchar_t*> (::memchr (uptr, ptr[0], last - uptr + 1));
+            if (uptr == 0) {
+                break;
+            }
+            if (::memcmp (uptr + 1, ptr + 1, count - 1) == 0) {
+                return uptr;
+            }
+            if ((work += count) > 4 * (size_t)(uptr - first) + 256) {
+                return search_two_way (uptr + 1, last + count - uptr - 1, ptr, count);
+            }
+            ++uptr;
+        }
+        return (0);
+    }
+
+    // Look for the last [ptr, ptr + count) in [first, first + size),
+    // 0 < count <= size; the same filter as search, from the end.
+    inline const tchar_t*
+    rsearch (const tchar_t *first, size_t size, const tchar_t *ptr, size_t count)
+    {
+        const tchar_t *uptr = first + size - count + 1; // one past the last candidate
+    #ifdef STRING_SSE2
+        const __m128i head = _mm_set1_epi8 (ptr[0]);
+        const __m128i tail = _mm_set1_epi8 (ptr[count - 1]);
+        while (uptr - first >= 16) {
+            uptr -= 16;
+            __m128i  a    = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (uptr));
+            __m128i  b    = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (uptr + count - 1));
+            unsigned mask = (unsigned)_mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (a, head), _mm_cmpeq_epi8 (b, tail)));
+            for (; mask != 0; mask &= ~(1u << highest_bit (mask))) {
+                const tchar_t *vptr = uptr + highest_bit (mask);
+                if (::memcmp (vptr + 1, ptr + 1, count - 1) == 0) {
+                    return vptr;
+                }
+            }
+        }
+    #endif
+        while (uptr != first) {
+            --uptr;
+            if (*uptr == ptr[0] && ::memcmp (uptr + 1, ptr + 1, count - 1) == 0) {
+                return uptr;
+            }
+        }
+        return (0);
+    }
+
+    #ifdef STRING_SSSE3
     inline bool
-    match (const T *first, const T *ch, size_t count)
+    has_ssse3 ()
     {
-        // look for ch in [first, first + count)
-        for (; 0 < count; --count, ++first, ++ch) {
-            if (*first != *ch) {
-                return false;
+    #ifdef STRING_SSSE3_DISPATCH
+        static const bool ssse3 = (__builtin_cpu_init (), __builtin_cpu_supports ("ssse3") != 0);
+        return ssse3;
+    #else
+        return true;
+    #endif
+    }
+
+    // Membership of 16 characters in a CharSet: the low nibble selects a
+    // byte of the row table (of the character's half of the code space), the
+    // high nibble a bit of that byte.
+    STRING_TARGET_SSSE3 inline __m128i
+    set_bytes (__m128i v, __m128i low, __m128i high)
+    {
+        const __m128i bits   = _mm_setr_epi8 (1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m128i nibble = _mm_set1_epi8 (0x0F);
+
+        __m128i lo      = _mm_and_si128 (v, nibble);
+        __m128i hi      = _mm_and_si128 (_mm_srli_epi16 (v, 4), nibble);
+        __m128i upper   = _mm_cmplt_epi8 (v, _mm_setzero_si128 ());
+        __m128i row     = _mm_or_si128 (_mm_and_si128 (upper, _mm_shuffle_epi8 (high, lo)),
+                                        _mm_andnot_si128 (upper, _mm_shuffle_epi8 (low, lo)));
+        __m128i bit     = _mm_shuffle_epi8 (bits, hi);
+        return _mm_cmpeq_epi8 (_mm_and_si128 (row, bit), bit);
+    }
+
+    STRING_TARGET_SSSE3 inline unsigned
+    set_mask (const tchar_t *uptr, __m128i low, __m128i high)
+    {
+        return (unsigned)_mm_movemask_epi8 (set_bytes (_mm_loadu_si128 (reinterpret_cast<const __m128i*> (uptr)), low, high));
+    }
+
+    STRING_TARGET_SSSE3 size_t
+    scan_set_ssse3 (const tchar_t *first, size_t size, const cpp::lang::CharSet &set, bool member)
+    {
+        const __m128i  low  = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (set.rows (0)));
+        const __m128i  high = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (set.rows (1)));
+        const unsigned flip = member ? 0 : 0xFFFF;
+
+        size_t pos = 0;
+        for (; pos + 16 <= size; pos += 16) {
+            unsigned mask = set_mask (first + pos, low, high) ^ flip;
+            if (mask != 0) {
+                return pos + lowest_bit (mask);
+            }
+        }
+        for (; pos < size && set.contains (first[pos]) != member; ++pos) {
+        }
+        return pos;
+    }
+
+    STRING_TARGET_SSSE3 size_t
+    rscan_set_ssse3 (const tchar_t *first, size_t size, const cpp::lang::CharSet &set, bool member)
+    {
+        const __m128i  low  = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (set.rows (0)));
+        const __m128i  high = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (set.rows (1)));
+        const unsigned flip = member ? 0 : 0xFFFF;
+
+        size_t pos = size;
+        for (; pos >= 16; pos -= 16) {
+            unsigned mask = set_mask (first + pos - 16, low, high) ^ flip;
+            if (mask != 0) {
+                return pos - 16 + highest_bit (mask);
+            }
+        }
+        for (; pos > 0; --pos) {
+            if (set.contains (first[pos - 1]) == member) {
+                return pos - 1;
+            }
+        }
+        return (size_t)-1;
+    }
+    #endif
+
+    // Index of the first character of [first, first + size) whose membership
+    // in set is member, size if there is none.
+    inline size_t
+    scan_set (const tchar_t *first, size_t size, const cpp::lang::CharSet &set, bool member)
+    {
+    #ifdef STRING_SSSE3
+        if (size >= 16 && has_ssse3 ()) {
+            return scan_set_ssse3 (first, size, set, member);
+        }
+    #endif
+        size_t pos = 0;
+        for (; pos < size && set.contains (first[pos]) != member; ++pos) {
+        }
+        return pos;
+    }
+
+    // Index of the last such character, (size_t)-1 if there is none.
+    inline size_t
+    rscan_set (const tchar_t *first, size_t size, const cpp::lang::CharSet &set, bool member)
+    {
+    #ifdef STRING_SSSE3
+        if (size >= 16 && has_ssse3 ()) {
+            return rscan_set_ssse3 (first, size, set, member);
+        }
+    #endif
+        for (size_t pos = size; pos > 0; --pos) {
+            if (set.contains (first[pos - 1]) == member) {
+                return pos - 1;
+            }
+        }
+        return (size_t)-1;
+    }
+
+    // Calls visit (pos) in order for every position of [first, first + size)
+    // holding one of chars[0, count), count in [1, 4]: each block of 16 is
+    // compared to the characters once and its mask walked bit by bit, the
+    // scan does not restart after a match.
+    template<class Visit>
+    inline void
+    each_char (const tchar_t *first, size_t size, const tchar_t *chars, size_t count, Visit &visit)
+    {
+        size_t pos = 0;
+    #ifdef STRING_SSE2
+        const __m128i c0 = _mm_set1_epi8 (chars[0]); // the unused ones repeat the first
+        const __m128i c1 = _mm_set1_epi8 (chars[count > 1 ? 1 : 0]);
+        const __m128i c2 = _mm_set1_epi8 (chars[count > 2 ? 2 : 0]);
+        const __m128i c3 = _mm_set1_epi8 (chars[count > 3 ? 3 : 0]);
+        for (; pos + 16 <= size; pos += 16) {
+            __m128i  v    = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (first + pos));
+            unsigned mask = (unsigned)_mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, c0), _mm_cmpeq_epi8 (v, c1)),
+                                                                       _mm_or_si128 (_mm_cmpeq_epi8 (v, c2), _mm_cmpeq_epi8 (v, c3))));
+            for (; mask != 0; mask &= mask - 1) {
+                visit (pos + lowest_bit (mask));
+            }
+        }
+    #endif
+        for (; pos < size; ++pos) {
+            for (size_t i = 0; i < count; ++i) {
+                if (first[pos] == chars[i]) {
+                    visit (pos);
+                    break;
+                }
+            }
+        }
+    }
+
+    // The visitor of each_char for StringReplacer::replace over single
+    // characters: writes the text and the replacements into a result sized
+    // beforehand.
+    struct SingleReplacements
+    {
+        const tchar_t                  *text;
+        const tchar_t                  *chars;
+        const cpp::lang::String *const *replacements; // of chars
+        tchar_t                        *out;
+        size_t                          copied;
+
+        void operator() (size_t pos)
+        {
+            size_t i = 0;
+            for (; chars[i] != text[pos]; ++i) {
             }
+            const cpp::lang::String &to = *replacements[i];
+            ::memcpy (out, text + copied, (pos - copied) * sizeof (tchar_t));
+            out += pos - copied;
+            ::memcpy (out, to.getCStr (), to.getLength () * sizeof (tchar_t));
+            out += to.getLength ();
+            copied = pos + 1;
         }
+    };
+
+    // Counting: the compare masks (-1) are summed per byte lane, up to 255
+    // blocks, then across the lanes; 32 characters a block with AVX2, 16
+    // with SSE2 / SSSE3.
+    #ifdef STRING_AVX2
+    inline bool
+    has_avx2 ()
+    {
+    #ifdef STRING_AVX2_DISPATCH
+        static const bool avx2 = (__builtin_cpu_init (), __builtin_cpu_supports ("avx2") != 0);
+        return avx2;
+    #else
         return true;
+    #endif
+    }
+
+    STRING_TARGET_AVX2 inline size_t
+    sum_lanes (__m256i counts)
+    {
+        __m256i sums = _mm256_sad_epu8 (counts, _mm256_setzero_si256 ());
+        __m128i half = _mm_add_epi64 (_mm256_castsi256_si128 (sums), _mm256_extracti128_si256 (sums, 1));
+        return (size_t)(_mm_cvtsi128_si32 (half) + _mm_cvtsi128_si32 (_mm_unpackhi_epi64 (half, half)));
+    }
+
+    STRING_TARGET_AVX2 size_t
+    count_char_avx2 (const tchar_t *first, size_t size, tchar_t ch)
+    {
+        const __m256i needle = _mm256_set1_epi8 (ch);
+
+        size_t count = 0;
+        size_t i     = 0;
+        while (i + 32 <= size) {
+            __m256i matches = _mm256_setzero_si256 ();
+            size_t  blocks  = (size - i) / 32 < 255 ? (size - i) / 32 : 255;
+            for (size_t block = 0; block < blocks; ++block, i += 32) {
+                __m256i v = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (first + i));
+                matches   = _mm256_sub_epi8 (matches, _mm256_cmpeq_epi8 (v, needle));
+            }
+            count += sum_lanes (matches);
+        }
+        for (; i < size; ++i) {
+            count += first[i] == ch;
+        }
+        return count;
+    }
+
+    STRING_TARGET_AVX2 size_t
+    count_set_avx2 (const tchar_t *first, size_t size, const cpp::lang::CharSet &set)
+    {
+        const __m256i low    = _mm256_broadcastsi128_si256 (_mm_loadu_si128 (reinterpret_cast<const __m128i*> (set.rows (0))));
+        const __m256i high   = _mm256_broadcastsi128_si256 (_mm_loadu_si128 (reinterpret_cast<const __m128i*> (set.rows (1))));
+        const __m256i bits   = _mm256_setr_epi8 (1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                                 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m256i nibble = _mm256_set1_epi8 (0x0F);
+        const __m256i zero   = _mm256_setzero_si256 ();
+
+        size_t count = 0;
+        size_t i     = 0;
+        while (i + 32 <= size) {
+            __m256i matches = zero;
+            size_t  blocks  = (size - i) / 32 < 255 ? (size - i) / 32 : 255;
+            for (size_t block = 0; block < blocks; ++block, i += 32) {
+                // set_bytes, on both 16-character lanes
+                __m256i v     = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (first + i));
+                __m256i lo    = _mm256_and_si256 (v, nibble);
+                __m256i hi    = _mm256_and_si256 (_mm256_srli_epi16 (v, 4), nibble);
+                __m256i upper = _mm256_cmpgt_epi8 (zero, v);
+                __m256i row   = _mm256_blendv_epi8 (_mm256_shuffle_epi8 (low, lo), _mm256_shuffle_epi8 (high, lo), upper);
+                __m256i bit   = _mm256_shuffle_epi8 (bits, hi);
+                matches       = _mm256_sub_epi8 (matches, _mm256_cmpeq_epi8 (_mm256_and_si256 (row, bit), bit));
+            }
+            count += sum_lanes (matches);
+        }
+        for (; i < size; ++i) {
+            count += set.contains (first[i]);
+        }
+        return count;
+    }
+    #endif
+
+    #ifdef STRING_SSSE3
+    STRING_TARGET_SSSE3 size_t
+    count_set_ssse3 (const tchar_t *first, size_t size, const cpp::lang::CharSet &set)
+    {
+        const __m128i low  = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (set.rows (0)));
+        const __m128i high = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (set.rows (1)));
+        const __m128i zero = _mm_setzero_si128 ();
+
+        size_t count = 0;
+        size_t i     = 0;
+        while (i + 16 <= size) {
+            __m128i matches = zero;
+            size_t  blocks  = (size - i) / 16 < 255 ? (size - i) / 16 : 255;
+            for (size_t block = 0; block < blocks; ++block, i += 16) {
+                __m128i v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (first + i));
+                matches   = _mm_sub_epi8 (matches, set_bytes (v, low, high));
+            }
+            __m128i sums = _mm_sad_epu8 (matches, zero);
+            count += (size_t)(_mm_cvtsi128_si32 (sums) + _mm_cvtsi128_si32 (_mm_unpackhi_epi64 (sums, sums)));
+        }
+        for (; i < size; ++i) {
+            count += set.contains (first[i]);
+        }
+        return count;
+    }
+    #endif
+
+    inline size_t
+    count_char (const tchar_t *first, size_t size, tchar_t ch)
+    {
+    #ifdef STRING_AVX2
+        if (size >= 32 && has_avx2 ()) {
+            return count_char_avx2 (first, size, ch);
+        }
+    #endif
+        size_t count = 0;
+        size_t i     = 0;
+    #ifdef STRING_SSE2
+        const __m128i needle = _mm_set1_epi8 (ch);
+        const __m128i zero   = _mm_setzero_si128 ();
+        while (i + 16 <= size) {
+            __m128i matches = zero;
+            size_t  blocks  = (size - i) / 16 < 255 ? (size - i) / 16 : 255;
+            for (size_t block = 0; block < blocks; ++block, i += 16) {
+                __m128i v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (first + i));
+                matches   = _mm_sub_epi8 (matches, _mm_cmpeq_epi8 (v, needle));
+            }
+            __m128i sums = _mm_sad_epu8 (matches, zero);
+            count += (size_t)(_mm_cvtsi128_si32 (sums) + _mm_cvtsi128_si32 (_mm_unpackhi_epi64 (sums, sums)));
+        }
+    #endif
+        for (; i < size; ++i) {
+            count += first[i] == ch;
+        }
+        return count;
+    }
+
+    inline size_t
+    count_set (const tchar_t *first, size_t size, const cpp::lang::CharSet &set)
+    {
+    #ifdef STRING_AVX2
+        if (size >= 32 && has_avx2 ()) {
+            return count_set_avx2 (first, size, set);
+        }
+    #endif
+    #ifdef STRING_SSSE3
+        if (size >= 16 && has_ssse3 ()) {
+            return count_set_ssse3 (first, size, set);
+        }
+    #endif
+        size_t count = 0;
+        for (size_t i = 0; i < size; ++i) {
+            count += set.contains (first[i]);
+        }
+        return count;
+    }
+
+    // Case folding: ASCII letters are folded directly, 16 at a time with
+    // SSE2; other characters are left to the C library (locale dependent).
+
+    // Key of a character for case-insensitive comparison, the lower case
+    // of its upper case as compareIgnoreCase always used.
+    inline utchar_t
+    fold_key (utchar_t c)
+    {
+        if (c < 0x80) {
+            return (unsigned)(c - 'A') < 26u ? (utchar_t)(c | 0x20) : c;
+        }
+        return (utchar_t)t_tolower ((utchar_t)t_toupper (c));
+    }
+
+    // Keys of 8 ASCII characters: bit 7 of each byte of the sums tells
+    // whether the character is >= 'A' / > 'Z', no carry crosses a byte.
+    inline uint64_t
+    fold_keys (uint64_t word)
+    {
+        const uint64_t ones = 0x0101010101010101ull;
+        uint64_t       geA  = word + ones * (0x80 - 'A');
+        uint64_t       gtZ  = word + ones * (0x80 - 'Z' - 1);
+        return word | ((geA & ~gtZ & ones * 0x80) >> 2);
+    }
+
+    #ifdef STRING_SSE2
+    // Mask of the characters in [first, first + 26) of 16 characters: the
+    // range is moved to the bottom of the signed bytes, one compare.
+    inline __m128i
+    letter_mask (__m128i v, char first)
+    {
+        __m128i moved = _mm_add_epi8 (v, _mm_set1_epi8 ((char)(0x80 - first)));
+        return _mm_cmplt_epi8 (moved, _mm_set1_epi8 ((char)(0x80 + 26)));
+    }
+    #endif
+
+    inline void
+    convert_case (tchar_t *ptr, size_t size, bool upper)
+    {
+        const char first = upper ? 'a' : 'A';
+        size_t     i     = 0;
+    #ifdef STRING_SSE2
+        const __m128i flip = _mm_set1_epi8 (0x20);
+        for (; i + 16 <= size; i += 16) {
+            __m128i v = _mm_loadu_si128 ((const __m128i *)(ptr + i));
+            v = _mm_xor_si128 (v, _mm_and_si128 (letter_mask (v, first), flip));
+            _mm_storeu_si128 ((__m128i *)(ptr + i), v);
+
+            for (unsigned high = (unsigned)_mm_movemask_epi8 (v); high != 0; high &= high - 1) {
+                utchar_t c = (utchar_t)ptr[i + lowest_bit (high)];
+                ptr[i + lowest_bit (high)] = (tchar_t)(upper ? t_toupper (c) : t_tolower (c));
+            }
+        }
+    #endif
+        for (; i < size; ++i) {
+            utchar_t c = (utchar_t)ptr[i];
+            if (c >= 0x80) {
+                ptr[i] = (tchar_t)(upper ? t_toupper (c) : t_tolower (c));
+            }
+            else if ((unsigned)(c - first) < 26u) {
+                ptr[i] = (tchar_t)(c ^ 0x20);
+            }
+        }
     }
 
-    template<class T>
     inline int
-    compare (const T *first1, const T *first2, size_t count)
+    compare_keys (const tchar_t *first1, const tchar_t *first2, size_t count)
     {
-        // compare [first1, first1 + count) with [first2, ...)
         for (; 0 < count; --count, ++first1, ++first2) {
             if (*first1 != *first2) {
-                return ((*first1 < *first2) ? -1 : 1);
+                utchar_t k1 = fold_key ((utchar_t)*first1);
+                utchar_t k2 = fold_key ((utchar_t)*first2);
+                if (k1 != k2) {
+                    return k1 < k2 ? -1 : 1;
+                }
             }
         }
-        return (0);
+        return 0;
+    }
+
+    // Case-insensitive compare of [first1, first1 + count) with [first2, ...):
+    // blocks equal as they are or once their ASCII letters are folded are
+    // skipped, the others are compared one character at a time.
+    inline int
+    compare_ignore_case (const tchar_t *first1, const tchar_t *first2, size_t count)
+    {
+        size_t i = 0;
+    #ifdef STRING_SSE2
+        const __m128i flip = _mm_set1_epi8 (0x20);
+        for (; i + 16 <= count; i += 16) {
+            __m128i a = _mm_loadu_si128 ((const __m128i *)(first1 + i));
+            __m128i b = _mm_loadu_si128 ((const __m128i *)(first2 + i));
+            if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (a, b)) == 0xFFFF) {
+                continue;
+            }
+
+            a = _mm_or_si128 (a, _mm_and_si128 (letter_mask (a, 'A'), flip));
+            b = _mm_or_si128 (b, _mm_and_si128 (letter_mask (b, 'A'), flip));
+            if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (a, b)) != 0xFFFF) {
+                int answer = compare_keys (first1 + i, first2 + i, 16);
+                if (answer != 0) {
+                    return answer;
+                }
+            }
+        }
+    #endif
+        return compare_keys (first1 + i, first2 + i, count - i);
+    }
+
+    // Hashing: wyhash (Wang Yi, public domain), reads 16 characters per
+    // 64x64->128 multiply, all of them, whatever the length. Words are
+    // passed through Words::fold, which lets the case-insensitive hash
+    // share the code: folding is per character, so it commutes with the
+    // overlapping reads of the short keys.
+    uint64_t g_hash_seed = 0;
+
+    inline void
+    multiply (uint64_t &a, uint64_t &b)
+    {
+    #if defined(__SIZEOF_INT128__)
+        unsigned __int128 r = (unsigned __int128)a * b;
+        a = (uint64_t)r;
+        b = (uint64_t)(r >> 64);
+    #else
+        uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        uint64_t t  = rl + (rm0 << 32);
+        uint64_t c  = t < rl;
+        uint64_t lo = t + (rm1 << 32);
+        c += lo < t;
+        a = lo;
+        b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    #endif
+    }
+
+    inline uint64_t
+    mix (uint64_t a, uint64_t b)
+    {
+        multiply (a, b);
+        return a ^ b;
+    }
+
+    inline uint64_t
+    read8 (const tchar_t *p)
+    {
+        uint64_t v;
+        ::memcpy (&v, p, sizeof (v));
+        return v;
+    }
+
+    inline uint64_t
+    read4 (const tchar_t *p)
+    {
+        uint32_t v;
+        ::memcpy (&v, p, sizeof (v));
+        return v;
+    }
+
+    struct RawWords
+    {
+        static uint64_t fold (uint64_t word)
+        {
+            return word;
+        }
+    };
+
+    struct FoldedWords
+    {
+        static uint64_t fold (uint64_t word)
+        {
+            if ((word & 0x8080808080808080ull) == 0) {
+                return fold_keys (word);
+            }
+
+            uint64_t keys = 0;
+            for (int shift = 0; shift < 64; shift += 8) {
+                keys |= (uint64_t)fold_key ((utchar_t)(word >> shift)) << shift;
+            }
+            return keys;
+        }
+    };
+
+    template<class Words>
+    inline size_t
+    hash_words (const tchar_t *p, size_t len, uint64_t seed = g_hash_seed)
+    {
+        static const uint64_t secret[4] = { 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                                            0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull };
+        uint64_t a, b;
+
+        seed ^= mix (seed ^ secret[0], secret[1]);
+        if (len <= 16) {
+            if (len >= 4) {
+                size_t middle = (len >> 3) << 2;
+                a = Words::fold (read4 (p) << 32 | read4 (p + middle));
+                b = Words::fold (read4 (p + len - 4) << 32 | read4 (p + len - 4 - middle));
+            }
+            else if (len > 0) {
+                a = Words::fold ((uint64_t)(utchar_t)p[0] << 16 | (uint64_t)(utchar_t)p[len >> 1] << 8 | (utchar_t)p[len - 1]);
+                b = 0;
+            }
+            else {
+                a = b = 0;
+            }
+        }
+        else {
+            size_t i = len;
+            if (i >= 48) {
+                uint64_t see1 = seed, see2 = seed;
+                do {
+                    seed = mix (Words::fold (read8 (p)) ^ secret[1], Words::fold (read8 (p + 8)) ^ seed);
+                    see1 = mix (Words::fold (read8 (p + 16)) ^ secret[2], Words::fold (read8 (p + 24)) ^ see1);
+                    see2 = mix (Words::fold (read8 (p + 32)) ^ secret[3], Words::fold (read8 (p + 40)) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i >= 48);
+                seed ^= see1 ^ see2;
+            }
+            for (; i > 16; i -= 16, p += 16) {
+                seed = mix (Words::fold (read8 (p)) ^ secret[1], Words::fold (read8 (p + 8)) ^ seed);
+            }
+            a = Words::fold (read8 (p + i - 16));
+            b = Words::fold (read8 (p + i - 8));
+        }
+
+        a ^= secret[1];
+        b ^= seed;
+        multiply (a, b);
+        return (size_t)mix (a ^ secret[0] ^ len, b ^ secret[1]);
+    }
+
+    // The InternedString table: shards picked by the low bits of the hash,
+    // each an open addressing table of atoms under its own mutex, the atoms
+    // carved from blocks that are never freed. The table itself is never
+    // destroyed either, atoms stay valid while static objects are destroyed.
+    typedef cpp::lang::InternedString::Atom Atom;
+
+    class InternTable
+    {
+    public:
+        enum
+        {
+            SHARD_BITS = 6,
+            SHARDS     = 1 << SHARD_BITS,
+            BLOCK_SIZE = 64 * 1024
+        };
+
+        InternTable ()
+            // the addresses differ from run to run, so do the hashes
+            : _seed (mix ((uint64_t)(uintptr_t)this ^ 0xe7037ed1a0b428dbull, (uint64_t)(uintptr_t)&g_hash_seed))
+        {
+        }
+
+        static InternTable &
+        instance ()
+        {
+            static InternTable *table = new InternTable ();
+            return *table;
+        }
+
+        static const Atom *
+        empty ()
+        {
+            static const Atom atom = { 0, 0, { 0 } };
+            return &atom;
+        }
+
+        const Atom *
+        intern (const tchar_t *p, size_t len)
+        {
+            size_t hash  = hash_words<RawWords> (p, len, _seed);
+            Shard &shard = _shards[hash & (SHARDS - 1)];
+            size_t probe = hash >> SHARD_BITS;
+
+            std::lock_guard<std::mutex> lock (shard.mutex);
+
+            if (shard.count * 2 >= shard.slots.size ()) {
+                shard.grow ();
+            }
+            size_t mask = shard.slots.size () - 1;
+            for (size_t i = probe & mask;; i = (i + 1) & mask) {
+                const Atom *atom = shard.slots[i];
+                if (atom == 0) {
+                    atom = shard.slots[i] = shard.allocate (hash, p, len);
+                    shard.count++;
+                    return atom;
+                }
+                if (atom->hash == hash && atom->length == len && ::memcmp (atom->chars, p, len * sizeof (tchar_t)) == 0) {
+                    return atom;
+                }
+            }
+        }
+
+        size_t
+        count ()
+        {
+            size_t total = 0;
+            for (size_t i = 0; i < SHARDS; i++) {
+                std::lock_guard<std::mutex> lock (_shards[i].mutex);
+                total += _shards[i].count;
+            }
+            return total;
+        }
+
+    private:
+        struct Shard
+        {
+            std::mutex                mutex;
+            std::vector<const Atom *> slots;
+            size_t                    count;
+            char                     *block;
+            size_t                    available;
+            char                      padding[64]; // keeps the mutexes off each other's cache lines
+
+            Shard ()
+                : count (0)
+                , block (0)
+                , available (0)
+            {
+            }
+
+            void
+            grow ()
+            {
+                std::vector<const Atom *> bigger (slots.empty () ? 64 : slots.size () * 2, (const Atom *)0);
+                size_t                    mask = bigger.size () - 1;
+                for (size_t i = 0; i < slots.size (); i++) {
+                    if (slots[i] != 0) {
+                        size_t j = (slots[i]->hash >> SHARD_BITS) & mask;
+                        while (bigger[j] != 0) {
+                            j = (j + 1) & mask;
+                        }
+                        bigger[j] = slots[i];
+                    }
+                }
+                slots.swap (bigger);
+            }
+
+            const Atom *
+            allocate (size_t hash, const tchar_t *p, size_t len)
+            {
+                size_t size = (offsetof (Atom, chars) + (len + 1) * sizeof (tchar_t) + sizeof (size_t) - 1) & ~(sizeof (size_t) - 1);
+                char  *mem;
+                if (size > BLOCK_SIZE / 4) {
+                    mem = (char *)::operator new (size);
+                }
+                else {
+                    if (size > available) {
+                        block     = (char *)::operator new (BLOCK_SIZE);
+                        available = BLOCK_SIZE;
+                    }
+                    mem = block;
+                    block += size;
+                    available -= size;
+                }
+                Atom *atom   = (Atom *)mem;
+                atom->hash   = hash;
+                atom->length = len;
+                ::memcpy (atom->chars, p, len * sizeof (tchar_t));
+                atom->chars[len] = 0;
+                return atom;
+            }
+        };
+
+        uint64_t _seed;
+        Shard    _shards[SHARDS];
+    };
+
+    // Number formatting: integers two digits per division, floats with
+    // Grisu2 (Florian Loitsch, "Printing floating-point numbers quickly and
+    // accurately with integers", 2010): the digits always read back to the
+    // same value and are the shortest ones for all but a few values.
+    static const char digit_pairs[201] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    inline unsigned
+    count_digits (uint64_t value)
+    {
+        for (unsigned count = 1;; count += 4, value /= 10000) {
+            if (value < 10) {
+                return count;
+            }
+            if (value < 100) {
+                return count + 1;
+            }
+            if (value < 1000) {
+                return count + 2;
+            }
+            if (value < 10000) {
+                return count + 3;
+            }
+        }
+    }
+
+    // Writes the digits of value backwards from end.
+    inline void
+    write_digits (tchar_t *end, uint64_t value)
+    {
+        for (; value >= 100; value /= 100) {
+            const char *pair = digit_pairs + (value % 100) * 2;
+            *--end = pair[1];
+            *--end = pair[0];
+        }
+        if (value >= 10) {
+            *--end = digit_pairs[value * 2 + 1];
+            *--end = digit_pairs[value * 2];
+        }
+        else {
+            *--end = (tchar_t)('0' + value);
+        }
+    }
+
+    // f * 2^e
+    struct DiyFp
+    {
+        uint64_t f;
+        int      e;
+    };
+
+    inline DiyFp
+    make_fp (uint64_t f, int e)
+    {
+        DiyFp fp = { f, e };
+        return fp;
+    }
+
+    inline DiyFp
+    normalize (DiyFp fp)
+    {
+    #ifdef __GNUC__
+        int shift = __builtin_clzll (fp.f);
+    #else
+        int shift = 0;
+        for (; (fp.f << shift) >> 63 == 0; ++shift) {
+        }
+    #endif
+        return make_fp (fp.f << shift, fp.e - shift);
+    }
+
+    // Product rounded to the upper 64 bits.
+    inline DiyFp
+    times (DiyFp x, DiyFp y)
+    {
+        uint64_t lo = x.f, hi = y.f;
+        multiply (lo, hi);
+        return make_fp (hi + (lo >> 63), x.e + y.e + 64);
+    }
+
+    // Normalized 10^k for k = -348 + 8 * index.
+    inline DiyFp
+    cached_power (int e, int &K)
+    {
+        static const uint64_t significands[] = {
+            0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull,
+            0xcf42894a5dce35eaull, 0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull,
+            0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full, 0xbe5691ef416bd60cull,
+            0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+            0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull,
+            0xc21094364dfb5637ull, 0x9096ea6f3848984full, 0xd77485cb25823ac7ull,
+            0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull, 0xb23867fb2a35b28eull,
+            0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+            0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull,
+            0xb5b5ada8aaff80b8ull, 0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull,
+            0x964e858c91ba2655ull, 0xdff9772470297ebdull, 0xa6dfbd9fb8e5b88full,
+            0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+            0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull,
+            0xaa242499697392d3ull, 0xfd87b5f28300ca0eull, 0xbce5086492111aebull,
+            0x8cbccc096f5088ccull, 0xd1b71758e219652cull, 0x9c40000000000000ull,
+            0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+            0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull,
+            0x9f4f2726179a2245ull, 0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull,
+            0x83c7088e1aab65dbull, 0xc45d1df942711d9aull, 0x924d692ca61be758ull,
+            0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+            0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull,
+            0x952ab45cfa97a0b3ull, 0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull,
+            0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull, 0x88fcf317f22241e2ull,
+            0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+            0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull,
+            0x8bab8eefb6409c1aull, 0xd01fef10a657842cull, 0x9b10a4e5e9913129ull,
+            0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull, 0x80444b5e7aa7cf85ull,
+            0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+            0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull
+        };
+        static const short exponents[] = {
+            -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+            -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+            -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+            -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+            56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+            375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+            694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+            1013, 1039, 1066
+        };
+
+        // the power that brings e into [-60, -32]
+        double   dk    = (-61 - e) * 0.30102999566398114 + 347;
+        int      k     = (int)dk;
+        k             += dk - k > 0.0;
+        unsigned index = (unsigned)((k >> 3) + 1);
+        K              = -(-348 + (int)(index << 3));
+        return make_fp (significands[index], exponents[index]);
+    }
+
+    inline void
+    grisu_round (char *digits, int length, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance)
+    {
+        // move the last digit toward the value while it stays in range
+        while (rest < distance && delta - rest >= tenKappa &&
+               (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance)) {
+            --digits[length - 1];
+            rest += tenKappa;
+        }
+    }
+
+    // Digits of the value W, as few as keep them within delta of Mp.
+    inline void
+    digit_gen (DiyFp W, DiyFp Mp, uint64_t delta, char *digits, int &length, int &K)
+    {
+        static const uint64_t powers[] = { 1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+                                           10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+                                           100000000000ull, 1000000000000ull, 10000000000000ull,
+                                           100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+                                           100000000000000000ull, 1000000000000000000ull,
+                                           10000000000000000000ull };
+        const int      shift    = -Mp.e;
+        const uint64_t one      = (uint64_t)1 << shift;
+        const uint64_t distance = Mp.f - W.f;
+        uint32_t       p1       = (uint32_t)(Mp.f >> shift);
+        uint64_t       p2       = Mp.f & (one - 1);
+        int            kappa    = (int)count_digits (p1);
+
+        length = 0;
+        while (kappa > 0) {
+            uint32_t d = p1 / (uint32_t)powers[kappa - 1];
+            p1 %= (uint32_t)powers[kappa - 1];
+            if (d != 0 || length != 0) {
+                digits[length++] = (char)('0' + d);
+            }
+            --kappa;
+
+            uint64_t rest = ((uint64_t)p1 << shift) + p2;
+            if (rest <= delta) {
+                K += kappa;
+                grisu_round (digits, length, delta, rest, powers[kappa] << shift, distance);
+                return;
+            }
+        }
+
+        for (;;) {
+            p2 *= 10;
+            delta *= 10;
+            char d = (char)(p2 >> shift);
+            if (d != 0 || length != 0) {
+                digits[length++] = (char)('0' + d);
+            }
+            p2 &= one - 1;
+            --kappa;
+            if (p2 < delta) {
+                K += kappa;
+                grisu_round (digits, length, delta, p2, one, -kappa < 20 ? distance * powers[-kappa] : 0);
+                return;
+            }
+        }
+    }
+
+    // Shortest digits of the positive f * 2^e, the value being digits * 10^K;
+    // the lower neighbour is closer when f is the hidden bit alone.
+    inline void
+    grisu2 (uint64_t f, int e, bool lowerCloser, char *digits, int &length, int &K)
+    {
+        DiyFp plus  = normalize (make_fp ((f << 1) + 1, e - 1));
+        DiyFp minus = lowerCloser ? make_fp ((f << 2) - 1, e - 2) : make_fp ((f << 1) - 1, e - 1);
+        minus.f <<= minus.e - plus.e;
+        minus.e = plus.e;
+
+        DiyFp power = cached_power (plus.e, K);
+        DiyFp W     = times (normalize (make_fp (f, e)), power);
+        DiyFp Wp    = times (plus, power);
+        DiyFp Wm    = times (minus, power);
+        ++Wm.f;
+        --Wp.f;
+        digit_gen (W, Wp, Wp.f - Wm.f, digits, length, K);
+    }
+
+    // Formats a double, or the float it holds when single, with its shortest
+    // digits: plain notation in [1e-6, 1e21), exponent form outside as
+    // JSON's canonical numbers. Returns the count written, at most 32.
+    inline size_t
+    format_float (tchar_t *out, double value, bool single)
+    {
+        uint64_t f;
+        int      e           = 0;
+        bool     lowerCloser = false;
+        bool     negative;
+        unsigned biased;
+
+        if (single) {
+            float    v = (float)value;
+            uint32_t bits;
+            ::memcpy (&bits, &v, sizeof (bits));
+            negative = (bits >> 31) != 0;
+            biased   = (bits >> 23) & 0xFF;
+            f        = bits & 0x7FFFFF;
+            if (biased == 0xFF) {
+                biased = (unsigned)-1;
+            }
+            else {
+                lowerCloser = f == 0 && biased > 1;
+                e           = biased != 0 ? (int)biased - 150 : -149;
+                f          |= biased != 0 ? (uint64_t)1 << 23 : 0;
+            }
+        }
+        else {
+            uint64_t bits;
+            ::memcpy (&bits, &value, sizeof (bits));
+            negative = (bits >> 63) != 0;
+            biased   = (unsigned)(bits >> 52) & 0x7FF;
+            f        = bits & 0xFFFFFFFFFFFFFull;
+            if (biased == 0x7FF) {
+                biased = (unsigned)-1;
+            }
+            else {
+                lowerCloser = f == 0 && biased > 1;
+                e           = biased != 0 ? (int)biased - 1075 : -1074;
+                f          |= biased != 0 ? (uint64_t)1 << 52 : 0;
+            }
+        }
+
+        tchar_t *p = out;
+        if (biased == (unsigned)-1) {
+            // same spelling as printf
+            if (f != 0) {
+                ::memcpy (p, "nan", 3);
+                return 3;
+            }
+            if (negative) {
+                *p++ = '-';
+            }
+            ::memcpy (p, "inf", 3);
+            return p + 3 - out;
+        }
+
+        if (negative) {
+            *p++ = '-';
+        }
+        if (f == 0) {
+            *p++ = '0';
+            return p - out;
+        }
+
+        char digits[20];
+        int  k, K = 0;
+        grisu2 (f, e, lowerCloser, digits, k, K);
+
+        const int n = k + K; // decimal point position
+        if (k <= n && n <= 21) {
+            ::memcpy (p, digits, k);
+            ::memset (p + k, '0', n - k);
+            p += n;
+        }
+        else if (0 < n && n <= 21) {
+            ::memcpy (p, digits, n);
+            p[n] = '.';
+            ::memcpy (p + n + 1, digits + n, k - n);
+            p += k + 1;
+        }
+        else if (-6 < n && n <= 0) {
+            *p++ = '0';
+            *p++ = '.';
+            ::memset (p, '0', -n);
+            ::memcpy (p - n, digits, k);
+            p += k - n;
+        }
+        else {
+            *p++ = digits[0];
+            if (k > 1) {
+                *p++ = '.';
+                ::memcpy (p, digits + 1, k - 1);
+                p += k - 1;
+            }
+            *p++ = 'e';
+            *p++ = n - 1 < 0 ? '-' : '+';
+            unsigned exponent = (unsigned)(n - 1 < 0 ? 1 - n : n - 1);
+            unsigned count    = count_digits (exponent);
+            write_digits (p + count, exponent);
+            p += count;
+        }
+        return p - out;
+    }
+
+    // Unicode transcoding. Runs of ASCII are converted 16 characters at a
+    // time with SSE2, everything else one code point at a time with full
+    // validation (RFC 3629): no overlong forms, no surrogates in UTF-8, no
+    // unpaired surrogates in UTF-16, nothing above U+10FFFF.
+
+    // Decodes the UTF-8 sequence at p (p < end, *p >= 0x80), advances p.
+    inline bool
+    decode_utf8 (const utchar_t *&p, const utchar_t *end, uint32_t &cp)
+    {
+        utchar_t c    = p[0];
+        size_t   left = end - p;
+
+        if (c < 0xC2) {
+            return false; // continuation byte or overlong 2-byte form
+        }
+        if (c < 0xE0) {
+            if (left < 2 || (p[1] & 0xC0) != 0x80) {
+                return false;
+            }
+            cp = (uint32_t)(c & 0x1F) << 6 | (p[1] & 0x3F);
+            p += 2;
+            return true;
+        }
+        if (c < 0xF0) {
+            // E0: no overlong form, ED: no surrogate
+            utchar_t low  = c == 0xE0 ? 0xA0 : 0x80;
+            utchar_t high = c == 0xED ? 0x9F : 0xBF;
+            if (left < 3 || p[1] < low || p[1] > high || (p[2] & 0xC0) != 0x80) {
+                return false;
+            }
+            cp = (uint32_t)(c & 0x0F) << 12 | (uint32_t)(p[1] & 0x3F) << 6 | (p[2] & 0x3F);
+            p += 3;
+            return true;
+        }
+        if (c < 0xF5) {
+            // F0: no overlong form, F4: up to U+10FFFF
+            utchar_t low  = c == 0xF0 ? 0x90 : 0x80;
+            utchar_t high = c == 0xF4 ? 0x8F : 0xBF;
+            if (left < 4 || p[1] < low || p[1] > high || (p[2] & 0xC0) != 0x80 || (p[3] & 0xC0) != 0x80) {
+                return false;
+            }
+            cp = (uint32_t)(c & 0x07) << 18 | (uint32_t)(p[1] & 0x3F) << 12 | (uint32_t)(p[2] & 0x3F) << 6 |
+                 (p[3] & 0x3F);
+            p += 4;
+            return true;
+        }
+        return false;
+    }
+
+    // Encodes the valid code point cp at q, advances q.
+    inline void
+    encode_utf8 (uint32_t cp, tchar_t *&q)
+    {
+        if (cp < 0x80) {
+            *q++ = (tchar_t)cp;
+        }
+        else if (cp < 0x800) {
+            q[0] = (tchar_t)(0xC0 | cp >> 6);
+            q[1] = (tchar_t)(0x80 | (cp & 0x3F));
+            q += 2;
+        }
+        else if (cp < 0x10000) {
+            q[0] = (tchar_t)(0xE0 | cp >> 12);
+            q[1] = (tchar_t)(0x80 | (cp >> 6 & 0x3F));
+            q[2] = (tchar_t)(0x80 | (cp & 0x3F));
+            q += 3;
+        }
+        else {
+            q[0] = (tchar_t)(0xF0 | cp >> 18);
+            q[1] = (tchar_t)(0x80 | (cp >> 12 & 0x3F));
+            q[2] = (tchar_t)(0x80 | (cp >> 6 & 0x3F));
+            q[3] = (tchar_t)(0x80 | (cp & 0x3F));
+            q += 4;
+        }
+    }
+
+    // Decodes the UTF-16 / UTF-32 code point at p (p < end), advances p.
+    inline bool
+    decode_unit (const char16_t *&p, const char16_t *end, uint32_t &cp)
+    {
+        uint32_t unit = p[0];
+        if (unit - 0xD800 >= 0x800) {
+            cp = unit;
+            ++p;
+            return true;
+        }
+        if (unit >= 0xDC00 || end - p < 2 || (uint32_t)p[1] - 0xDC00 >= 0x400) {
+            return false; // unpaired surrogate
+        }
+        cp = 0x10000 + ((unit - 0xD800) << 10) + (p[1] - 0xDC00);
+        p += 2;
+        return true;
+    }
+
+    inline bool
+    decode_unit (const char32_t *&p, const char32_t *, uint32_t &cp)
+    {
+        cp = *p;
+        if (cp >= 0xD800 && cp - 0xE000 >= 0x110000 - 0xE000) {
+            return false; // surrogate or above U+10FFFF
+        }
+        ++p;
+        return true;
+    }
+
+    #ifndef __WINDOWS__
+    // wchar_t holds UTF-32 but is a distinct type
+    inline bool
+    decode_unit (const wchar_t *&p, const wchar_t *, uint32_t &cp)
+    {
+        const char32_t unit = (char32_t)*p;
+        const char32_t *q   = &unit;
+        if (!decode_unit (q, q + 1, cp)) {
+            return false;
+        }
+        ++p;
+        return true;
+    }
+    #endif
+
+    // Encodes the valid code point cp in UTF-16 / UTF-32 at q, advances q.
+    inline void
+    encode_unit (uint32_t cp, char16_t *&q)
+    {
+        if (cp < 0x10000) {
+            *q++ = (char16_t)cp;
+        }
+        else {
+            q[0] = (char16_t)(0xD800 + ((cp - 0x10000) >> 10));
+            q[1] = (char16_t)(0xDC00 + (cp & 0x3FF));
+            q += 2;
+        }
+    }
+
+    inline void
+    encode_unit (uint32_t cp, char32_t *&q)
+    {
+        *q++ = (char32_t)cp;
+    }
+
+    #ifndef __WINDOWS__
+    inline void
+    encode_unit (uint32_t cp, wchar_t *&q)
+    {
+        *q++ = (wchar_t)cp;
+    }
+    #endif
+
+    // Count of UTF-16 (pairs) or UTF-32 units of UTF-8 text: one per
+    // leading byte, two for a 4-byte sequence in UTF-16. Exact for valid
+    // text, an upper bound otherwise.
+    inline size_t
+    utf8_units (const tchar_t *first, size_t size, bool pairs)
+    {
+        const utchar_t *p     = (const utchar_t *)first;
+        size_t          count = 0;
+        size_t          i     = 0;
+    #ifdef STRING_SSE2
+        // continuation bytes are the signed bytes < -64, 4-byte leaders the
+        // bytes max (v, 0xF0) leaves; the compare masks (-1) are summed per
+        // byte lane, up to 255 blocks, then across the lanes
+        const __m128i continuation = _mm_set1_epi8 ((char)0xC0);
+        const __m128i leader4      = _mm_set1_epi8 ((char)0xF0);
+        const __m128i zero         = _mm_setzero_si128 ();
+        while (i + 16 <= size) {
+            __m128i trailing = zero, extra = zero;
+            size_t  blocks   = (size - i) / 16 < 255 ? (size - i) / 16 : 255;
+            for (size_t block = 0; block < blocks; ++block, i += 16) {
+                __m128i v = _mm_loadu_si128 ((const __m128i *)(p + i));
+                trailing  = _mm_sub_epi8 (trailing, _mm_cmplt_epi8 (v, continuation));
+                if (pairs) {
+                    extra = _mm_sub_epi8 (extra, _mm_cmpeq_epi8 (_mm_max_epu8 (v, leader4), v));
+                }
+            }
+
+            __m128i sums = _mm_sub_epi64 (_mm_sad_epu8 (extra, zero), _mm_sad_epu8 (trailing, zero));
+            count += blocks * 16 + (size_t)(_mm_cvtsi128_si32 (sums) + _mm_cvtsi128_si32 (_mm_unpackhi_epi64 (sums, sums)));
+        }
+    #endif
+        for (; i < size; ++i) {
+            count += (p[i] & 0xC0) != 0x80;
+            count += pairs && p[i] >= 0xF0;
+        }
+        return count;
+    }
+
+    // Length in UTF-8 of UTF-16 / UTF-32 text, exact for valid text: the
+    // two surrogates of a pair count 3 - 1 each.
+    inline size_t
+    utf8_length (const char16_t *p, size_t size)
+    {
+        size_t length = size;
+        size_t i      = 0;
+    #ifdef STRING_SSE2
+        // a unit has 2 extra bytes, less one if < 0x800, if < 0x80, if a
+        // surrogate: the compare masks (-1) are summed per lane, up to 8192
+        // blocks, then across the lanes
+        const __m128i zero      = _mm_setzero_si128 ();
+        const __m128i high7     = _mm_set1_epi16 ((short)0xFF80);
+        const __m128i high5     = _mm_set1_epi16 ((short)0xF800);
+        const __m128i surrogate = _mm_set1_epi16 ((short)0xD800);
+        while (i + 8 <= size) {
+            __m128i less   = zero;
+            size_t  blocks = (size - i) / 8 < 8192 ? (size - i) / 8 : 8192;
+            for (size_t block = 0; block < blocks; ++block, i += 8) {
+                __m128i v   = _mm_loadu_si128 ((const __m128i *)(p + i));
+                __m128i top = _mm_and_si128 (v, high5);
+                less = _mm_add_epi16 (less, _mm_cmpeq_epi16 (_mm_and_si128 (v, high7), zero));
+                less = _mm_add_epi16 (less, _mm_cmpeq_epi16 (top, zero));
+                less = _mm_add_epi16 (less, _mm_cmpeq_epi16 (top, surrogate));
+            }
+
+            __m128i sums = _mm_madd_epi16 (less, _mm_set1_epi16 (1));
+            sums         = _mm_add_epi32 (sums, _mm_shuffle_epi32 (sums, _MM_SHUFFLE (1, 0, 3, 2)));
+            sums         = _mm_add_epi32 (sums, _mm_shuffle_epi32 (sums, _MM_SHUFFLE (2, 3, 0, 1)));
+            length += blocks * 16 + (size_t)_mm_cvtsi128_si32 (sums);
+        }
+    #endif
+        for (; i < size; ++i) {
+            length += (p[i] >= 0x80) + (p[i] >= 0x800) - (p[i] - 0xD800u < 0x800u);
+        }
+        return length;
+    }
+
+    template<class Unit>
+    inline size_t
+    utf8_length (const Unit *p, size_t size)
+    {
+        size_t length = size;
+        for (size_t i = 0; i < size; ++i) {
+            uint32_t cp = (uint32_t)p[i];
+            length += (cp >= 0x80) + (cp >= 0x800) + (cp >= 0x10000);
+        }
+        return length;
+    }
+
+    // UTF-8 to UTF-16 (Unit = char16_t) or UTF-32 (Unit = char32_t).
+    // Returns the count of units written to out, stops at the first invalid
+    // sequence, whose offset is stored in error (size when all is valid).
+    template<class Unit>
+    inline size_t
+    from_utf8 (const tchar_t *first, size_t size, Unit *out, size_t &error)
+    {
+        const utchar_t *p   = (const utchar_t *)first;
+        const utchar_t *end = p + size;
+        Unit           *q   = out;
+
+        while (p != end) {
+    #ifdef STRING_SSE2
+            const __m128i zero = _mm_setzero_si128 ();
+            for (; end - p >= 16; p += 16, q += 16) {
+                __m128i  v    = _mm_loadu_si128 ((const __m128i *)p);
+                unsigned mask = (unsigned)_mm_movemask_epi8 (v);
+                if (mask != 0) {
+                    // copy the ASCII prefix, the rest is decoded below
+                    unsigned ascii = lowest_bit (mask);
+                    for (unsigned i = 0; i < ascii; ++i) {
+                        q[i] = p[i];
+                    }
+                    p += ascii;
+                    q += ascii;
+                    break;
+                }
+
+                __m128i lo = _mm_unpacklo_epi8 (v, zero);
+                __m128i hi = _mm_unpackhi_epi8 (v, zero);
+                if (sizeof (Unit) == 2) {
+                    _mm_storeu_si128 ((__m128i *)q, lo);
+                    _mm_storeu_si128 ((__m128i *)(q + 8), hi);
+                }
+                else {
+                    _mm_storeu_si128 ((__m128i *)q, _mm_unpacklo_epi16 (lo, zero));
+                    _mm_storeu_si128 ((__m128i *)(q + 4), _mm_unpackhi_epi16 (lo, zero));
+                    _mm_storeu_si128 ((__m128i *)(q + 8), _mm_unpacklo_epi16 (hi, zero));
+                    _mm_storeu_si128 ((__m128i *)(q + 12), _mm_unpackhi_epi16 (hi, zero));
+                }
+            }
+    #endif
+            // one code point at a time up to the next ASCII run
+            while (p != end) {
+                if (*p < 0x80) {
+                    *q++ = *p++;
+    #ifdef STRING_SSE2
+                    if (end - p >= 16) {
+                        break;
+                    }
+    #endif
+                    continue;
+                }
+
+                // runs of 3-byte sequences (CJK): one test of the three bytes,
+                // an overlong form or a surrogate is left to decode_utf8
+                for (; end - p >= 3; p += 3) {
+                    uint32_t cp = (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2];
+                    if ((cp & 0xF0C0C0) != 0xE08080) {
+                        break;
+                    }
+                    cp = (cp >> 4 & 0xF000) | (cp >> 2 & 0x0FC0) | (cp & 0x3F);
+                    if (cp < 0x800 || cp - 0xD800 < 0x800) {
+                        break;
+                    }
+                    *q++ = (Unit)cp;
+                }
+                if (p == end || *p < 0x80) {
+                    continue;
+                }
+
+                uint32_t cp;
+                if (!decode_utf8 (p, end, cp)) {
+                    error = p - (const utchar_t *)first;
+                    return q - out;
+                }
+                encode_unit (cp, q);
+            }
+        }
+
+        error = size;
+        return q - out;
+    }
+
+    // UTF-16 or UTF-32 to UTF-8, as from_utf8.
+    template<class Unit>
+    inline size_t
+    to_utf8 (const Unit *first, size_t size, tchar_t *out, size_t &error)
+    {
+        const Unit *p   = first;
+        const Unit *end = p + size;
+        tchar_t    *q   = out;
+
+        while (p != end) {
+    #ifdef STRING_SSE2
+            if (sizeof (Unit) == 2) {
+                // 8 units at a time while they are ASCII
+                const __m128i high = _mm_set1_epi16 ((short)0xFF80);
+                for (; end - p >= 8; p += 8, q += 8) {
+                    __m128i v = _mm_loadu_si128 ((const __m128i *)p);
+                    if (_mm_movemask_epi8 (_mm_cmpeq_epi16 (_mm_and_si128 (v, high), _mm_setzero_si128 ())) != 0xFFFF) {
+                        break;
+                    }
+                    _mm_storel_epi64 ((__m128i *)q, _mm_packus_epi16 (v, v));
+                }
+            }
+    #endif
+            for (size_t run = 0; p != end && run < 8; ++run) {
+                uint32_t cp = *p;
+                if (cp < 0x80) {
+                    *q++ = (tchar_t)cp;
+                    ++p;
+                    continue;
+                }
+
+                if (!decode_unit (p, end, cp)) {
+                    error = p - first;
+                    return q - out;
+                }
+                encode_utf8 (cp, q);
+            }
+        }
+
+        error = size;
+        return q - out;
+    }
+
+    // UTF-16 to UTF-32 and back.
+    template<class From, class To>
+    inline size_t
+    convert_units (const From *first, size_t size, To *out, size_t &error)
+    {
+        const From *p   = first;
+        const From *end = first + size;
+        To         *q   = out;
+
+        while (p != end) {
+            uint32_t cp;
+            if (!decode_unit (p, end, cp)) {
+                error = p - first;
+                return q - out;
+            }
+            encode_unit (cp, q);
+        }
+
+        error = size;
+        return q - out;
     }
 
     #ifdef __WINDOWS__
@@ -72,23 +1696,118 @@ namespace detail {
             throw;
         }
 
-        wBuf[len / sizeof (tchar_t)] = 0; // append the terminate character.
+        wBuf[len / sizeof (tchar_t)] = 0; // append the terminate character.
+
+        if (outLen != 0) {
+            *outLen = len / sizeof (tchar_t);
+        }
+        return wBuf;
+    }
+
+    #endif
+
+}; // namespace detail
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+// String class
+
+namespace cpp {
+namespace lang {
+
+// public static
+const size_t String::NO_POSITION = (size_t)(-1);
+
+// private
+String &String::appendInteger(uint64 magnitude, bool negative)
+{
+    size_t   count = detail::count_digits (magnitude) + (negative ? 1 : 0);
+    tchar_t *ptr   = splice (getLength (), 0, count);
+
+    if (negative) {
+        *ptr = '-';
+    }
+    detail::write_digits (ptr + count, magnitude);
+
+    return *this;
+}
+
+// private
+String &String::appendFloat(double value, bool single)
+{
+    tchar_t buffer[32];
+    return append (buffer, detail::format_float (buffer, value, single));
+}
+
+// public
+void String::setHashSeed(uint64_t seed)
+{
+    detail::g_hash_seed = seed;
+}
+
+// public
+bool String::utf8ToUtf16(StringView utf8, std::u16string &out)
+{
+    size_t error;
+    size_t units = detail::utf8_units (utf8.data (), utf8.length (), true);
+    if (out.size () < units) {
+        out.resize (units); // grow only: filling the rest costs as much as converting
+    }
+    out.resize (detail::from_utf8 (utf8.data (), utf8.length (), &out[0], error));
+    return error == utf8.length ();
+}
 
-        if (outLen != 0) {
-            *outLen = len / sizeof (tchar_t);
-        }
-        return wBuf;
+// public
+bool String::utf8ToUtf32(StringView utf8, std::u32string &out)
+{
+    size_t error;
+    size_t units = detail::utf8_units (utf8.data (), utf8.length (), false);
+    if (out.size () < units) {
+        out.resize (units);
     }
+    out.resize (detail::from_utf8 (utf8.data (), utf8.length (), &out[0], error));
+    return error == utf8.length ();
+}
 
-    #endif
+// public
+bool String::utf16ToUtf8(const char16_t *utf16, size_t count, String &out)
+{
+    size_t   error;
+    tchar_t *ptr = out.splice (0, out.getLength (), detail::utf8_length (utf16, count));
+    out.setLength (detail::to_utf8 (utf16, count, ptr, error));
+    return error == count;
+}
 
-}; // namespace detail
+// public
+bool String::utf32ToUtf8(const char32_t *utf32, size_t count, String &out)
+{
+    size_t   error;
+    tchar_t *ptr = out.splice (0, out.getLength (), detail::utf8_length (utf32, count));
+    out.setLength (detail::to_utf8 (utf32, count, ptr, error));
+    return error == count;
+}
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-// String class
+// public
+bool String::utf16ToUtf32(const char16_t *utf16, size_t count, std::u32string &out)
+{
+    size_t error;
+    out.resize (count);
+    out.resize (detail::convert_units (utf16, count, &out[0], error));
+    return error == count;
+}
 
-namespace cpp {
-namespace lang {
+// public
+bool String::utf32ToUtf16(const char32_t *utf32, size_t count, std::u16string &out)
+{
+    size_t pairs = 0;
+    for (size_t i = 0; i < count; ++i) {
+        pairs += utf32[i] >= 0x10000;
+    }
+
+    size_t error;
+    out.resize (count + pairs);
+    out.resize (detail::convert_units (utf32, count, &out[0], error));
+    return error == count;
+}
 
 // public static
 const String String::EMPTY;
@@ -103,7 +1822,7 @@ String &String::assign(const tchar_t *ptr)
 String &String::assign(const String &source)
 {
     if (this != &source) {
-        _str.assign (source._str);
+        _assign (source.getMyPtr (), source.getLength ());
     }
     return (*this);
 }
@@ -112,7 +1831,7 @@ String &String::assign(const String &source)
 String &String::assign(const String &source, size_t offset, size_t count)
 {
     if (source.getLength () < offset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR"));
+        detail::throw_xran ("IDS_OFFSET_OFR");
     }
     return _assign(source, offset, count);
 }
@@ -131,7 +1850,7 @@ String &String::_assign(const String &source, size_t offset, size_t count)
         _remove ((size_t)0, offset); // substring
     }
     else {
-        _str.assign (source._str, offset, num);
+        _assign (source.getMyPtr () + offset, num);
     }
 
     return (*this);
@@ -158,7 +1877,7 @@ String &String::_assign(const tchar_t *ptr, size_t num)
     if (inside (ptr)) {
         return (_assign(*this, (ptr - getMyPtr ()), num)); // substring
     }
-    _str.assign(ptr, num);
+    ::memcpy (splice (0, getLength (), num), ptr, num * sizeof (tchar_t));
 
     return (*this);
 }
@@ -169,7 +1888,10 @@ String &String::assign (tchar_t ch, size_t count)
     if (count == NO_POSITION) {
         // detail::throw_xran(String("count is too long.")); // result too long
     }
-    _str.assign (count, ch);
+    tchar_t *ptr = splice (0, getLength (), count);
+    for (; 0 < count; --count) {
+        *ptr++ = ch;
+    }
 
     return (*this);
 }
@@ -178,11 +1900,11 @@ String &String::assign (tchar_t ch, size_t count)
 String &String::assign(String &&source)
 {
     if (this != &source) {
-        auto str = _str;
-        _str     = source._str;
-
-        source._str = str;
-        source.clear ();
+        if (!isLocal ()) {
+            ::operator delete (_store.heap.ptr);
+        }
+        _store = source._store;
+        source.init ();
     }
     return *this;
 }
@@ -193,7 +1915,7 @@ String &String::append(const String &source, size_t offset, size_t count)
 {
     // append source [offset, offset + count)
     if (source.getLength () < offset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
+        detail::throw_xran ("IDS_OFFSET_OFR"); // offset off end
     }
     size_t num = source.getLength () - offset;
     if (num < count) {
@@ -201,7 +1923,9 @@ String &String::append(const String &source, size_t offset, size_t count)
     }
 
     if (count > 0) {
-        _str.append (source._str, offset, count);
+        // source may be this string, so read it after the buffer has grown
+        tchar_t *ptr = splice (getLength (), 0, count);
+        ::memcpy (ptr, source.getMyPtr () + offset, count * sizeof (tchar_t));
     }
 
     return (*this);
@@ -223,7 +1947,7 @@ String &String::append(const tchar_t *ptr, size_t count)
     }
 
     if (count > 0) {
-        _str.append (ptr, count);
+        ::memcpy (splice (size, 0, count), ptr, count * sizeof (tchar_t));
     }
 
     return (*this);
@@ -238,7 +1962,10 @@ String &String::append(tchar_t ch, size_t count)
         // detail::throw_xran(String("count is too long")); // result too long?
     }
     if (count > 0) {
-        _str.append (count, ch);
+        tchar_t *ptr = splice (size, 0, count);
+        for (; 0 < count; --count) {
+            *ptr++ = ch;
+        }
     }
 
     return (*this);
@@ -270,7 +1997,7 @@ tchar_t &String::at(size_t n) // read/write access
 String &String::remove(size_t offset /* = 0 */, size_t count /* = NO_POSITION */)
 {
     if (getLength () < offset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
+        detail::throw_xran ("IDS_OFFSET_OFR"); // offset off end
     }
 
     return _remove (offset, count);
@@ -287,7 +2014,7 @@ String &String::_remove (size_t offset /* = 0 */, size_t count /* = NO_POSITION
     }
 
     if (count > 0) {
-        _str.erase (offset, count);
+        splice (offset, count, 0);
     }
 
     return (*this);
@@ -299,13 +2026,17 @@ void String::swap(String &source)
     //
     //swap control information
     //
-    _str.swap (source._str);
+    Storage store = _store;
+    _store        = source._store;
+    source._store = store;
 }
 
 // public
 void String::reserve (size_t newSiz /* = 0*/)
 {
-    _str.reserve (newSiz);
+    if (getCapacity () < newSiz) {
+        reallocate (newSiz);
+    }
 }
 
 // public
@@ -314,8 +2045,8 @@ size_t String::copy(tchar_t* ptr, size_t count, size_t offset /* = 0 */) const
     // copy [offset, offset + count) to [ptr, ptr + count)
     size_t size = getLength ();
 
-    if (size <= offset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
+    if (size < offset) {
+        detail::throw_xran ("IDS_OFFSET_OFR"); // offset off end
     }
 
     if (size - offset < count) {
@@ -336,17 +2067,11 @@ size_t String::find(const tchar_t *ptr, size_t offset, size_t count) const
         return (offset); // null string always matches (if inside string)
     }
 
-    size_t num;
-    if (offset < size && count <= (num = size - offset)) {
+    if (offset < size && count <= size - offset) {
         // room for match, look for it
-        const tchar_t *uptr, *vptr;
-
-        for (num -= count - 1, vptr = getMyPtr () + offset; (uptr = detail::find (vptr, num, *ptr)) != 0;
-             num -= uptr - vptr + 1, vptr = uptr + 1)
-        {
-            if (detail::compare (uptr, ptr, count) == 0) {
-                return (uptr - getMyPtr ()); // found a match
-            }
+        const tchar_t *uptr = detail::search (getMyPtr () + offset, size - offset, ptr, count);
+        if (uptr != 0) {
+            return (uptr - getMyPtr ()); // found a match
         }
     }
 
@@ -363,16 +2088,11 @@ size_t String::rfind(const tchar_t *ptr, size_t offset, size_t count) const
     }
 
     if (count <= size) {
-        // room for match, look for it
-        const tchar_t *uptr = getMyPtr () + (offset < size - count ? offset : size - count);
-
-        for (;; --uptr) {
-            if ((*uptr == *ptr) && detail::compare (uptr, ptr, count) == 0) {
-                return (uptr - getMyPtr ()); // found a match
-            }
-            else if (uptr == getMyPtr ()) {
-                break; // at beginning, no more chance for match
-            }
+        // room for match, look for it in the candidates [0, offset]
+        size_t         last = offset < size - count ? offset : size - count;
+        const tchar_t *uptr = detail::rsearch (getMyPtr (), last + count, ptr, count);
+        if (uptr != 0) {
+            return (uptr - getMyPtr ()); // found a match
         }
     }
 
@@ -465,594 +2185,1163 @@ size_t String::findLastNotOf (const tchar_t* ptr, size_t offset, size_t count) c
 // public
 size_t String::findAny(size_t offset, const String &chars) const
 {
+    return findAny (offset, CharSet (chars.getMyPtr (), chars.getLength ()));
+}
+
+// public
+size_t String::findAny(size_t offset, const CharSet &chars) const
+{
+    size_t size = getLength ();
+    if (offset > size) {
+        // detail::throw_xran(String("IDS_OFFSET_OFR"));
+        return NO_POSITION;
+    }
+
+    size_t pos = offset + detail::scan_set (getMyPtr () + offset, size - offset, chars, true);
+    return pos < size ? pos : NO_POSITION;
+}
+
+// public
+size_t String::findNotOfAny(size_t offset, const String &chars) const
+{
+    return findNotOfAny (offset, CharSet (chars.getMyPtr (), chars.getLength ()));
+}
+
+// public
+size_t String::findNotOfAny(size_t offset, const CharSet &chars) const
+{
+    size_t size = getLength ();
+    if (offset > size) {
+        // detail::throw_xran(String("IDS_OFFSET_OFR"));
+        return NO_POSITION;
+    }
+
+    size_t pos = offset + detail::scan_set (getMyPtr () + offset, size - offset, chars, false);
+    return pos < size ? pos : NO_POSITION;
+}
+
+// public
+size_t String::findLastOfAny(size_t offset, const String &chars) const
+{
+    return findLastOfAny (offset, CharSet (chars.getMyPtr (), chars.getLength ()));
+}
+
+// public
+size_t String::findLastOfAny(size_t offset, const CharSet &chars) const
+{
+    size_t size = getLength ();
+    if (offset >= size) {
+        // detail::throw_xran(String("IDS_OFFSET_OFR"));
+        offset = size - 1;
+    }
+    if (size == 0) {
+        return NO_POSITION;
+    }
+
+    return detail::rscan_set (getMyPtr (), offset + 1, chars, true);
+}
+
+// public
+size_t String::findLastNotOfAny(size_t offset, const String &chars) const
+{
+    return findLastNotOfAny (offset, CharSet (chars.getMyPtr (), chars.getLength ()));
+}
+
+// public
+size_t String::findLastNotOfAny(size_t offset, const CharSet &chars) const
+{
+    size_t size = getLength ();
+    if (offset >= size) {
+        // detail::throw_xran(String("IDS_OFFSET_OFR"));
+        offset = size - 1;
+    }
+    if (size == 0) {
+        return NO_POSITION;
+    }
+
+    return detail::rscan_set (getMyPtr (), offset + 1, chars, false);
+}
+
+// public
+int String::compare(const String &source) const
+{
+    return StringView (*this).compare (source);
+}
+
+// public
+int String::compare(size_t offset, size_t number, const String &source, size_t roffset, size_t count) const
+{
+    // compare [offset, offset + number) with source [roffset, roffset + count)
+
+    if (source.getLength() < roffset) {
+        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
+    }
+
+    if (source.getLength() - roffset < count) {
+        count = source.getLength() - roffset; // trim count to size
+    }
+
+    return compare(offset, number, source.getMyPtr() + roffset, count);
+}
+
+// public
+int String::compare(size_t offset, size_t number, const tchar_t *ptr, size_t count) const
+{
+    // compare [offset, offset + number) with [ptr, ptr + count)
+    size_t size = getLength ();
+
+    if (size < offset) {
+        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
+        offset = size;
+    }
+
+    if (size - offset < number) {
+        number = size - offset; // trim number to size
+    }
+
+    return StringView (getMyPtr () + offset, number).compare (StringView (ptr, count));
+}
+
+// public
+int String::compareIgnoreCase(size_t offset, size_t number, const String &source, size_t roffset, size_t count) const
+{
+    // compare [offset, offset + number) with source [roffset, roffset + count)
+
+    if (source.getLength() < roffset) {
+        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
+        roffset = source.getLength();
+    }
+
+    if (source.getLength() - roffset < count) {
+        count = source.getLength() - roffset; // trim count to size
+    }
+
+    return compareIgnoreCase (offset, number, source.getMyPtr() + roffset, count);
+}
+
+// public
+int String::compareIgnoreCase(size_t offset, size_t number, const tchar_t* ptr, size_t count) const
+{
+    // compare [offset, offset + number) with [ptr, ptr + count)
+    size_t size = getLength ();
+
+    if (size < offset) {
+        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
+        offset = size;
+    }
+
+    if (size - offset < number) {
+        number = size - offset; // trim number to size
+    }
+
+    return StringView (getMyPtr () + offset, number).compareIgnoreCase (StringView (ptr, count));
+}
+
+// public
+String &String::replace(tchar_t oldValue, tchar_t newValue, bool replaceAll /* = false */)
+{
+    if (oldValue != newValue) {
+        size_t   size = getLength ();
+        tchar_t* ptr  = getMyPtr ();
+
+        for (size_t i = 0; i < size; ++i, ++ptr) {
+            if (*ptr == oldValue) {
+                *ptr = newValue;
+
+                if (!replaceAll) {
+                    break; //don't replace all char, break the loop.
+                }
+            }
+        }
+    }
+
+    return (*this);
+}
+
+// public
+String &String::replace (size_t offset, size_t number, const String& source, size_t roffset, size_t count)
+{
+    // replace [offset, offset + number) with source [roffset, roffset + count)
+    size_t size = getLength();
+
+    if (size < offset || source.getLength() < roffset) {
+        detail::throw_xran ("IDS_OFFSET_OFR"); // offset or roffset off end
+    }
+
+    if (size - offset < number) {
+        number = size - offset; // trim number to size
+    }
+
+    size_t num = source.getLength() - roffset;
+    if (num < count) {
+        count = num; // trim count to size
+    }
+
+    if (NO_POSITION - count <= size - number) {
+        // detail::throw_xran(String("the number of string is too long.")); // result too long
+    }
+
+    if (this == &source) {
+        String substr (source, roffset, count);
+        ::memcpy (splice (offset, number, count), substr.getMyPtr (), count * sizeof (tchar_t));
+    }
+    else {
+        ::memcpy (splice (offset, number, count), source.getMyPtr () + roffset, count * sizeof (tchar_t));
+    }
+
+    return *this;
+}
+
+// public
+String &String::replace (size_t offset, size_t number, const tchar_t *ptr, size_t count)
+{
+    // replace [offset, offset + number) with [ptr, ptr + count)
+    if (inside (ptr)) {
+        return replace(offset, number, *this, ptr - getMyPtr(), count); // substring, replace carefully
+    }
+
+    size_t size = getLength ();
+    if (size < offset) {
+        detail::throw_xran ("IDS_OFFSET_OFR"); // offset off end
+    }
+
+    if (size - offset < number) {
+        number = size - offset; // trim number to size
+    }
+
+    if (NO_POSITION - count <= size - number) {
+        // detail::throw_xran(String("the number of string is too long.")); // result too long
+    }
+
+    ::memcpy (splice (offset, number, count), ptr, count * sizeof (tchar_t));
+
+    return *this;
+}
+
+String &String::replace(size_t offset, size_t number, size_t count, tchar_t ch)
+{
+    // replace [offset, offset + number) with count * ch
     size_t size = getLength ();
-    if (offset > size) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR"));
+
+    if (size < offset) {
+        detail::throw_xran ("IDS_OFFSET_OFR"); // offset off end
+    }
+
+    if (size - offset < number) {
+        number = size - offset; // trim number to size
     }
 
-    //size -= offset;
-    size_t charsSize = chars.getLength ();
-    const tchar_t *ptr = getMyPtr ();
+    if (NO_POSITION - count <= size - number) {
+        // detail::throw_xran(String("the number of string is too long.")); // result too long
+    }
 
-    for (size_t pos = offset; pos < size; pos++) {
-        for (size_t loop = 0; loop != charsSize; loop++) {
-            if (ptr[pos] == chars[loop]) {
-                return pos; // return the position
-            }
-        }
+    tchar_t *ptr = splice (offset, number, count);
+    for (; 0 < count; --count) {
+        *ptr++ = ch;
     }
 
-    return NO_POSITION;
+    return *this;
 }
 
 // public
-size_t String::findNotOfAny(size_t offset, const String &chars) const
+String &String::replaceAll(StringView from, StringView to)
 {
-    size_t size = getLength ();
-    if (offset > size) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR"));
+    // replace every [from) with [to), searching left to right
+    size_t size  = getLength ();
+    size_t count = from.length ();
+
+    if (count == 0 || size < count) {
+        return *this;
     }
 
-    //size -= offset;
-    size_t charsSize = chars.getLength ();
-    const tchar_t *ptr = getMyPtr ();
+    if (inside (from.data ()) || (to.length () > 0 && inside (to.data ()))) {
+        String fromCopy (from.data (), from.length ()); // substrings, replace carefully
+        String toCopy (to.data (), to.length ());
+        return replaceAll (fromCopy, toCopy);
+    }
 
-    for (size_t pos = offset; pos < size; pos++) {
-        for (size_t loop = 0; loop != charsSize; loop++) {
-            if (ptr[pos] != chars[loop]) {
-                return pos; // return the position
-            }
-        }
+    tchar_t       *ptr   = getMyPtr ();
+    const tchar_t *match = detail::search (ptr, size, from.data (), count);
+    if (match == 0) {
+        return *this;
     }
 
-    return NO_POSITION;
-}
+    size_t offset = match - ptr;
+    if (to.length () <= count) {
+        // shrinks or keeps the size: compact behind the search
+        size_t length = offset;
+        do {
+            ::memcpy (ptr + length, to.data (), to.length () * sizeof (tchar_t));
+            length += to.length ();
+            offset += count;
 
-// public
-size_t String::findLastOfAny(size_t offset, const String &chars) const
-{
-    size_t size = getLength ();
-    if (offset >= size) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR"));
+            match       = size - offset < count ? 0 : detail::search (ptr + offset, size - offset, from.data (), count);
+            size_t next = match == 0 ? size : match - ptr;
+            if (length != offset) {
+                ::memmove (ptr + length, ptr + offset, (next - offset) * sizeof (tchar_t));
+            }
+            length += next - offset;
+            offset = next;
+        } while (match != 0);
+        setLength (length);
+        return *this;
+    }
+
+    // grows: count the matches, then copy once into a buffer of the final size
+    size_t matches = 0;
+    while (match != 0) {
+        size_t pos = match - ptr + count;
+        match      = size - pos < count ? 0 : detail::search (ptr + pos, size - pos, from.data (), count);
+        ++matches;
     }
 
-    size_t charsSize = chars.getLength ();
-    const tchar_t *ptr = getMyPtr ();
+    if (NO_POSITION / matches <= to.length () - count || NO_POSITION - size <= matches * (to.length () - count)) {
+        // detail::throw_xran(String("the number of string is too long.")); // result too long
+    }
 
-    for (size_t pos = offset; pos != NO_POSITION; --pos) {
-        for (size_t loop = 0; loop != charsSize; loop++) {
-            if (ptr[pos] == chars[loop]) {
-                return pos; // return the position
-            }
+    String result;
+    result.reserve (size + matches * (to.length () - count));
+    tchar_t *out = result.getMyPtr ();
+    size_t   pos = 0;
+    for (; matches > 0; --matches) {
+        ::memcpy (out, ptr + pos, (offset - pos) * sizeof (tchar_t));
+        out += offset - pos;
+        ::memcpy (out, to.data (), to.length () * sizeof (tchar_t));
+        out += to.length ();
+        pos = offset + count;
+        if (matches > 1) {
+            offset = detail::search (ptr + pos, size - pos, from.data (), count) - ptr;
         }
     }
+    ::memcpy (out, ptr + pos, (size - pos) * sizeof (tchar_t));
+    out += size - pos;
+    result.setLength (out - result.getMyPtr ());
+    swap (result);
 
-    return NO_POSITION;
+    return *this;
 }
 
 // public
-size_t String::findLastNotOfAny(size_t offset, const String &chars) const
+String &String::insert(size_t offset, const String &source, size_t roffset, size_t count)
 {
+    // insert source [roffset, roffset + count) at offset
     size_t size = getLength ();
-    if (offset >= size) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR"));
+
+    if (size < offset || source.getLength () < roffset) {
+        detail::throw_xran ("IDS_OFFSET_OFR"); // offset or roffset off end
+    }
+
+    size_t num = source.getLength () - roffset;
+    if (num < count) {
+        count = num; // trim count to size
     }
 
-    size_t charsSize = chars.getLength ();
-    const tchar_t *ptr = getMyPtr ();
+    if (NO_POSITION - size <= count) {
+        // detail::throw_xran(String("the count is too long")); // result too long
+    }
 
-    for (size_t pos = offset; pos != NO_POSITION; --pos) {
-        for (size_t loop = 0; loop != charsSize; loop++) {
-            if (ptr[pos] != chars[loop]) {
-                return pos; // return the position
-            }
-        }
+    if (this == &source) {
+        String substr (source, roffset, count);
+        ::memcpy (splice (offset, 0, count), substr.getMyPtr (), count * sizeof (tchar_t));
+    }
+    else {
+        ::memcpy (splice (offset, 0, count), source.getMyPtr () + roffset, count * sizeof (tchar_t));
     }
 
-    return NO_POSITION;
+    return *this;
 }
 
 // public
-int String::compare(const String &source) const
+String &String::insert(size_t offset, const tchar_t *ptr, size_t count)
 {
-    // compare [offset, offset + number) with [ptr, ptr + count)
-    size_t number = getLength ();
-    size_t count  = source.getLength ();
+    // insert [ptr, ptr + count) at offset
+    if (inside (ptr)) {
+        return insert (offset, *this, ptr - getMyPtr(), count); // substring
+    }
 
-    size_t answer = 0;
-    if (number != 0) {
-        size_t tmp = number < count ? number : count;
-        const tchar_t *first1 = getMyPtr ();
-        const tchar_t *first2 = source.getMyPtr ();
+    size_t size = getLength ();
 
-        // compare [first1, first1 + tmp) with [first2, ...)
-        for (; 0 < tmp; --tmp, ++first1, ++first2) {
-            if (*first1 != *first2) {
-                answer = (*first1 < *first2) ? -1 : 1;
-                break;
-            }
-        }
+    if (size < offset) {
+        detail::throw_xran ("IDS_OFFSET_OFR"); // offset off end
+    }
+
+    if (NO_POSITION - size <= count) {
+        // detail::throw_xran(String("the count is too long")); // result too long
     }
 
-    return (answer != 0 ? (int)answer : number < count ? -1 : number == count ? 0 : +1);
+    ::memcpy (splice (offset, 0, count), ptr, count * sizeof (tchar_t));
+
+    return *this;
 }
 
 // public
-int String::compare(size_t offset, size_t number, const String &source, size_t roffset, size_t count) const
+String &String::insert(size_t offset, tchar_t ch, size_t count)
 {
-    // compare [offset, offset + number) with source [roffset, roffset + count)
+    // insert count * ch at offset
+    size_t size = getLength();
 
-    if (source.getLength() < roffset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
+    if (size < offset) {
+        detail::throw_xran ("IDS_OFFSET_OFR"); // offset or roffset off end
     }
 
-    if (source.getLength() - roffset < count) {
-        count = source.getLength() - roffset; // trim count to size
+    if (NO_POSITION - size <= count) {
+        // detail::throw_xran(String("the count is too long")); // result too long
     }
 
-    return compare(offset, number, source.getMyPtr() + roffset, count);
+    tchar_t *ptr = splice (offset, 0, count);
+    for (; 0 < count; --count) {
+        *ptr++ = ch;
+    }
+
+    return *this;
 }
 
 // public
-int String::compare(size_t offset, size_t number, const tchar_t *ptr, size_t count) const
+void String::toUpper(void)
 {
-    // compare [offset, offset + number) with [ptr, ptr + count)
-    size_t size = getLength ();
+    detail::convert_case (getMyPtr (), getLength (), true);
+}
 
-    if (size < offset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
-    }
+// public
+void String::toLower(void)
+{
+    detail::convert_case (getMyPtr (), getLength (), false);
+}
 
-    if (size - offset < number) {
-        number = size - offset; // trim number to size
+// public
+String String::trim(tchar_t ch) const
+{
+    if (this->isEmpty ()) {
+        return (*this);
     }
 
-    size_t answer = 0;
-    if (number != 0) {
-        size_t tmp = number < count ? number : count;
-        const tchar_t* first1 = getMyPtr() + offset;
-        const tchar_t* first2 = ptr;
+    const tchar_t* ptr    = getMyPtr();
+    const size_t   size   = getLength();
+    size_t         preLen = 0;
 
-        // compare [first1, first1 + tmp) with [first2, ...)
-        for (; 0 < tmp; --tmp, ++first1, ++first2) {
-            if (*first1 != *first2) {
-                answer = (*first1 < *first2) ? -1 : 1;
-                break;
-            }
-        }
+    // traverse from the begining
+    while (*ptr == ch && preLen < size) {
+        ++preLen, ++ptr;
+    }
+
+    // traverse from the end
+    size_t postLen = size;
+    ptr            = getMyPtr () + size - 1;
+    while (*ptr == ch && (postLen > preLen)) {
+        --postLen, --ptr;
     }
 
-    return (answer != 0 ? (int)answer : number < count ? -1 : number == count ? 0 : +1);
+    return String (getMyPtr () + preLen, postLen - preLen);
 }
 
 // public
-int String::compareIgnoreCase(size_t offset, size_t number, const String &source, size_t roffset, size_t count) const
+String String::leftString(size_t count) const
 {
-    // compare [offset, offset + number) with source [roffset, roffset + count)
-
-    if (source.getLength() < roffset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
-    }
-
-    if (source.getLength() - roffset < count) {
-        count = source.getLength() - roffset; // trim count to size
+    if (count > getLength ()) {
+        // detail::throw_xran(String("the count is too long.")); // result too long
     }
 
-    return compareIgnoreCase (offset, number, source.getMyPtr() + roffset, count);
+    return String (*this, 0, count);
 }
 
 // public
-int String::compareIgnoreCase(size_t offset, size_t number, const tchar_t* ptr, size_t count) const
+String String::rightString (size_t count) const
 {
-    // compare [offset, offset + number) with [ptr, ptr + count)
-    size_t size = getLength ();
-
-    if (size < offset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
+    if (count > getLength ()) {
+        // detail::throw_xran(String("the count is too long.")); // result too long
     }
 
-    if (size - offset < number) {
-        number = size - offset; // trim number to size
-    }
+    return String(*this, getLength() - count, getLength());
+}
 
-    size_t answer = 0;
-    if (number != 0) {
-        size_t         tmp    = number < count ? number : count;
-        const tchar_t* first1 = getMyPtr () + offset;
-        const tchar_t* first2 = ptr;
+// public
+bool String::startsWith(const tchar_t *prefix) const
+{
+    return StringView (getMyPtr (), getLength ()).startsWith (StringView (prefix));
+}
 
-        // compare [first1, first1 + tmp) with [first2, ...)
-        for (; 0 < tmp; --tmp, ++first1, ++first2) {
-            if (*first1 != *first2) {
-                // If characters don't match but case may be ignored,
-                // try converting both characters to uppercase.
-                // If the results match, then the comparison scan should
-                // continue.
-                tchar_t u1 = t_toupper (*first1);
-                tchar_t u2 = t_toupper (*first2);
-
-                if (u1 != u2) {
-                    // Unfortunately, conversion to uppercase does not work properly
-                    // for the Georgian alphabet, which has strange rules about case
-                    // conversion.  So we need to make one last check before
-                    // exiting.
-                    u1 = t_tolower (u1);
-                    u2 = t_tolower (u2);
-
-                    if (u1 != u2) {
-                        answer = (u1 < u2) ? -1 : 1;
-                        break;
-                    }
-                }
-            }
-        }
-    }
+// public
+int String::freq(tchar_t ch) const
+{
+    return (int)detail::count_char (getMyPtr (), getLength (), ch);
+}
 
-    return (answer != 0 ? (int)answer : number < count ? -1 : number == count ? 0 : +1);
+// public
+void String::format(const tchar_t* fmt, ...)
+{
+    va_list ap;
+    va_start (ap, fmt);
+    formatv (fmt, ap);
+    va_end (ap);
 }
 
 // public
-String &String::replace(tchar_t oldValue, tchar_t newValue, bool replaceAll /* = false */)
+void String::formatv(const tchar_t *fmt, va_list ap)
 {
-    if (oldValue != newValue) {
-        size_t   size = getLength ();
-        tchar_t* ptr  = getMyPtr ();
+#ifdef __WINDOWS__
+    va_list vaArgsCopy;
+    va_copy(vaArgsCopy, ap);
+    const int iLen = ::_vscwprintf(fmt, vaArgsCopy);
+    va_end(vaArgsCopy);
 
-        for (size_t i = 0; i < size; ++i, ++ptr) {
-            if (*ptr == oldValue) {
-                *ptr = newValue;
+    std::wstring tmp(iLen + 1, '\0');
+    ::_vsnwprintf(&tmp[0], tmp.size(), fmt, ap);
+    tmp.resize (iLen);
+    _assign (tmp.data (), tmp.size ());
+#else
 
-                if (!replaceAll) {
-                    break; //don't replace all char, break the loop.
-                }
-            }
-        }
+    va_list vaArgsCopy;
+    va_copy(vaArgsCopy, ap);
+    const int iLen = ::vsnprintf(NULL, 0, fmt, vaArgsCopy);
+    va_end(vaArgsCopy);
+
+    if (iLen < 0) {
+        clear ();
+        return;
     }
 
-    return (*this);
+    // render into a fresh string, the arguments may point into this one
+    String tmp;
+    ::vsnprintf(tmp.splice (0, 0, iLen), iLen + 1, fmt, ap);
+    swap(tmp);
+#endif
 }
 
-// public
-String &String::replace (size_t offset, size_t number, const String& source, size_t roffset, size_t count)
+// private
+String &String::appendFormat(StringView format, const FormatArg *args, size_t count)
 {
-    // replace [offset, offset + number) with source [roffset, roffset + count)
-    size_t size = getLength();
-
-    if (size < offset || source.getLength() < roffset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset or roffset off end
+    // appending may move the characters the format or an argument points to
+    bool alias = inside (format.data ());
+    for (size_t i = 0; i < count && !alias; ++i) {
+        alias = args[i].type () == FormatArg::TEXT && inside (args[i].text ().data ());
+    }
+    if (alias) {
+        String tmp;
+        tmp.appendFormat (format, args, count);
+        return append (tmp);
     }
 
-    if (size - offset < number) {
-        number = size - offset; // trim number to size
+    // one allocation for a line that leaves the inline buffer anyway: the
+    // format and ~8 characters per argument
+    if (getLength () + format.length () > INLINE_CAPACITY) {
+        reserve (getLength () + format.length () + 8 * count);
     }
 
-    size_t num = source.getLength() - roffset;
-    if (num < count) {
-        count = num; // trim count to size
+    const tchar_t *ptr  = format.data ();
+    const tchar_t *last = ptr + format.length ();
+    size_t         next = 0;
+
+    while (ptr != last) {
+        // copy the text up to the next brace at once
+        const tchar_t *brace = ptr;
+        for (; brace != last && *brace != '{' && *brace != '}'; ++brace) {
+        }
+        append (ptr, brace - ptr);
+        if (brace == last) {
+            break;
+        }
+
+        ptr = brace + 1;
+        if (ptr != last && *ptr == *brace) {
+            // "{{" or "}}"
+            append (*brace, (size_t)1);
+            ++ptr;
+            continue;
+        }
+        if (*brace == '}') {
+            append (*brace, (size_t)1);
+            continue;
+        }
+
+        // "{}" or "{n}"
+        size_t index = next;
+        if (ptr != last && t_isdigit ((utchar_t)*ptr)) {
+            for (index = 0; ptr != last && t_isdigit ((utchar_t)*ptr); ++ptr) {
+                index = index * 10 + (*ptr - '0');
+            }
+        }
+        else {
+            ++next;
+        }
+        if (ptr == last || *ptr != '}' || count <= index) {
+            // not a placeholder, or no argument for it
+            append (brace, ptr - brace);
+            continue;
+        }
+        ++ptr;
+
+        const FormatArg &arg = args[index];
+        switch (arg.type ()) {
+        case FormatArg::BOOL:
+            *this << (arg.unsignedInteger () != 0);
+            break;
+        case FormatArg::CHAR:
+            append ((tchar_t)arg.unsignedInteger (), (size_t)1);
+            break;
+        case FormatArg::INTEGER:
+            appendInteger (arg.integer () < 0 ? 0 - (uint64)arg.integer () : (uint64)arg.integer (), arg.integer () < 0);
+            break;
+        case FormatArg::UNSIGNED:
+            appendInteger (arg.unsignedInteger (), false);
+            break;
+        case FormatArg::FLOAT:
+            appendFloat (arg.real (), true);
+            break;
+        case FormatArg::DOUBLE:
+            appendFloat (arg.real (), false);
+            break;
+        case FormatArg::TEXT:
+            append (arg.text ());
+            break;
+        case FormatArg::POINTER: {
+            tchar_t digits[2 + 2 * sizeof (uint64)];
+            size_t  first = sizeof (digits) / sizeof (digits[0]);
+            uint64  value = arg.unsignedInteger ();
+            do {
+                digits[--first] = "0123456789abcdef"[value & 15];
+                value >>= 4;
+            } while (value != 0);
+            digits[--first] = 'x';
+            digits[--first] = '0';
+            append (digits + first, sizeof (digits) / sizeof (digits[0]) - first);
+            break;
+        }
+        default:
+            break;
+        }
     }
 
-    if (NO_POSITION - count <= size - number) {
-        // detail::throw_xran(String("the number of string is too long.")); // result too long
+    return *this;
+}
+
+// public
+void String::split(const String &separators, std::vector<String> &substrs, bool oneInSeparators /*= true*/) const
+{
+    StringSplitter tokens (*this, separators, oneInSeparators);
+    for (StringView token; tokens.next (token);) {
+        substrs.push_back (token.toString ());
     }
-
-    _str.replace (offset, number, source._str, roffset, count);
-
-    return *this;
 }
 
 // public
-String &String::replace (size_t offset, size_t number, const tchar_t *ptr, size_t count)
+size_t String::split(const CharSet &separators, StringView *tokens, size_t capacity) const
 {
-    // replace [offset, offset + number) with [ptr, ptr + count)
-    if (inside (ptr)) {
-        return replace(offset, number, *this, ptr - getMyPtr(), count); // substring, replace carefully
+    if (capacity == 0) {
+        return 0;
     }
 
-    size_t size = getLength ();
-    if (size < offset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
+    StringSplitter splitter (*this, separators);
+    size_t         count = 0;
+    while (count + 1 < capacity && splitter.next (tokens[count])) {
+        ++count;
     }
 
-    if (size - offset < number) {
-        number = size - offset; // trim number to size
+    // the last slot takes the rest of the string
+    StringView rest;
+    if (count + 1 == capacity && splitter.next (rest)) {
+        tokens[count++] = StringView (rest.data (), getMyPtr () + getLength () - rest.data ());
     }
 
-    if (NO_POSITION - count <= size - number) {
-        // detail::throw_xran(String("the number of string is too long.")); // result too long
-    }
+    return count;
+}
 
-    _str.replace (offset, number, ptr, count);
+// public
+size_t StringView::find(StringView str, size_t offset) const
+{
+    // look for str beginning at or after offset
+    if (str.length () == 0 && offset <= _length) {
+        return offset; // null string always matches (if inside view)
+    }
+    if (offset < _length && str.length () <= _length - offset) {
+        const tchar_t *uptr = detail::search (_ptr + offset, _length - offset, str.data (), str.length ());
+        if (uptr != 0) {
+            return uptr - _ptr;
+        }
+    }
 
-    return *this;
+    return String::NO_POSITION;
 }
 
-String &String::replace(size_t offset, size_t number, size_t count, tchar_t ch)
+// public
+size_t StringView::find(tchar_t ch, size_t offset) const
 {
-    // replace [offset, offset + number) with count * ch
-    size_t size = getLength ();
-
-    if (size < offset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
-    }
+    return find (StringView (&ch, 1), offset);
+}
 
-    if (size - offset < number) {
-        number = size - offset; // trim number to size
+// public
+size_t StringView::rfind(StringView str, size_t offset) const
+{
+    // look for str beginning at or before offset
+    if (str.length () == 0) {
+        return offset < _length ? offset : _length; // null always matches
     }
-
-    if (NO_POSITION - count <= size - number) {
-        // detail::throw_xran(String("the number of string is too long.")); // result too long
+    if (str.length () <= _length) {
+        size_t         last = offset < _length - str.length () ? offset : _length - str.length ();
+        const tchar_t *uptr = detail::rsearch (_ptr, last + str.length (), str.data (), str.length ());
+        if (uptr != 0) {
+            return uptr - _ptr;
+        }
     }
 
-    _str.replace (offset, number, count, ch);
-
-    return *this;
+    return String::NO_POSITION;
 }
 
 // public
-String &String::insert(size_t offset, const String &source, size_t roffset, size_t count)
+int StringView::compare(StringView str) const
 {
-    // insert source [roffset, roffset + count) at offset
-    size_t size = getLength ();
+    size_t count  = _length < str.length () ? _length : str.length ();
+    int    answer = count != 0 ? ::memcmp (_ptr, str.data (), count * sizeof (tchar_t)) : 0;
 
-    if (size < offset || source.getLength () < roffset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset or roffset off end
+    if (answer != 0) {
+        return answer < 0 ? -1 : 1;
     }
+    return _length < str.length () ? -1 : _length == str.length () ? 0 : +1;
+}
 
-    size_t num = source.getLength () - roffset;
-    if (num < count) {
-        count = num; // trim count to size
-    }
+// public
+int StringView::compareIgnoreCase(StringView str) const
+{
+    size_t count  = _length < str.length () ? _length : str.length ();
+    int    answer = detail::compare_ignore_case (_ptr, str.data (), count);
 
-    if (NO_POSITION - size <= count) {
-        // detail::throw_xran(String("the count is too long")); // result too long
+    if (answer != 0) {
+        return answer;
     }
+    return _length < str.length () ? -1 : _length == str.length () ? 0 : +1;
+}
 
-    _str.insert (offset, source._str, roffset, count);
-
-    return *this;
+// public
+size_t StringView::hashIgnoreCase() const
+{
+    return detail::hash_words<detail::FoldedWords> (_ptr, _length);
 }
 
 // public
-String &String::insert(size_t offset, const tchar_t *ptr, size_t count)
+size_t StringView::hash() const
 {
-    // insert [ptr, ptr + count) at offset
-    if (inside (ptr)) {
-        return insert (offset, *this, ptr - getMyPtr(), count); // substring
+    return detail::hash_words<detail::RawWords> (_ptr, _length);
+}
+
+// public
+StringReplacer::StringReplacer(const StringView *patterns, const StringView *replacements, size_t count)
+    : _classCount (1)
+    , _firsts ()
+    , _singleCount (0)
+{
+    // the characters of the patterns get a class each, all others class 0
+    ::memset (_classes, 0, sizeof (_classes));
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t pos = 0; pos < patterns[i].length (); ++pos) {
+            utchar_t ch = (utchar_t)patterns[i][pos];
+            if (_classes[ch] == 0) {
+                _classes[ch] = (utchar_t)_classCount++;
+            }
+        }
     }
 
-    size_t size = getLength ();
+    // the trie, undefined transitions are -1
+    bool  singles = true;
+    State root = { NO_MATCH, 0 };
+    _states.push_back (root);
+    _next.assign (_classCount, -1);
+    for (size_t i = 0; i < count; ++i) {
+        _replacements.push_back (replacements[i].toString ());
+        _lengths.push_back (patterns[i].length ());
+        if (patterns[i].empty ()) {
+            continue;
+        }
 
-    if (size < offset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset off end
+        size_t state = 0;
+        for (size_t pos = 0; pos < patterns[i].length (); ++pos) {
+            size_t index = state * _classCount + _classes[(utchar_t)patterns[i][pos]];
+            if (_next[index] < 0) {
+                State child = { NO_MATCH, (uint32_t)(pos + 1) };
+                _next[index] = (int32_t)_states.size ();
+                _states.push_back (child);
+                _next.resize (_next.size () + _classCount, -1);
+            }
+            state = (size_t)_next[index];
+        }
+        if (_states[state].match == NO_MATCH) {
+            _states[state].match = (int32_t)i; // the first of duplicates wins
+        }
+        _firsts.add (patterns[i][0]);
+        singles = singles && patterns[i].length () == 1;
     }
 
-    if (NO_POSITION - size <= count) {
-        // detail::throw_xran(String("the count is too long")); // result too long
+    // up to 4 characters to replace and nothing else: replace scans for them
+    // without the automaton
+    if (singles && _classCount > 1 && _classCount <= 5) {
+        for (size_t ch = 0; ch < 256; ++ch) {
+            if (_classes[ch] != 0) {
+                _singles[_singleCount++] = (tchar_t)ch;
+            }
+        }
     }
 
-    _str.insert (offset, ptr, count);
-
-    return *this;
+    // breadth first: failure links complete the transitions, and a state
+    // without a pattern of its own takes the longest one of its failure
+    std::vector<int32_t> fail (_states.size (), 0);
+    std::vector<int32_t> queue (1, 0);
+    for (size_t head = 0; head < queue.size (); ++head) {
+        size_t state = (size_t)queue[head];
+        for (size_t c = 0; c < _classCount; ++c) {
+            int32_t &next = _next[state * _classCount + c];
+            int32_t  back = state == 0 ? 0 : _next[(size_t)fail[state] * _classCount + c];
+            if (next < 0) {
+                next = back;
+            }
+            else {
+                fail[next] = back;
+                if (_states[next].match == NO_MATCH) {
+                    _states[next].match = _states[back].match;
+                }
+                queue.push_back (next);
+            }
+        }
+    }
 }
 
 // public
-String &String::insert(size_t offset, tchar_t ch, size_t count)
+String StringReplacer::replace(StringView text) const
 {
-    // insert count * ch at offset
-    size_t size = getLength();
+    String out;
+    out.reserve (text.length ());
+    replace (text, out);
+    return out;
+}
 
-    if (size < offset) {
-        // detail::throw_xran(String("IDS_OFFSET_OFR")); // offset or roffset off end
-    }
+// public
+size_t StringReplacer::replace(StringView text, String &out) const
+{
+    if (text.length () > 0 && text.data () >= out.getCStr () && text.data () < out.getCStr () + out.getLength ()) {
+        String copy (text.data (), text.length ()); // text views out, which grows
+        return replace (copy, out);
+    }
+
+    const tchar_t *ptr     = text.data ();
+    size_t         size    = text.length ();
+    size_t         copied  = 0;
+    size_t         matches = 0;
+
+    if (_singleCount > 0) {
+        // the root transition of each character leads to its pattern; the
+        // result is sized by counting the characters, then written in place
+        // as replaceAll does
+        const String *replacements[4];
+        size_t        length = size;
+        for (size_t i = 0; i < _singleCount; ++i) {
+            replacements[i] = &_replacements[_states[_next[_classes[(utchar_t)_singles[i]]]].match];
+            size_t count    = detail::count_char (ptr, size, _singles[i]);
+            matches += count;
+            length += count * replacements[i]->getLength () - count;
+        }
+        if (matches == 0) {
+            out.append (ptr, size);
+            return 0;
+        }
 
-    if (NO_POSITION - size <= count) {
-        // detail::throw_xran(String("the count is too long")); // result too long
-    }
+        size_t base = out.getLength ();
+        out.resize (base + length);
+        detail::SingleReplacements visit = { ptr, _singles, replacements, out.data () + base, 0 };
+        detail::each_char (ptr, size, _singles, _singleCount, visit);
+        ::memcpy (visit.out, ptr + visit.copied, (size - visit.copied) * sizeof (tchar_t));
+        return matches;
+    }
+
+    for (size_t pos = 0; pos < size;) {
+        // skip to the next character that can start a pattern
+        pos += detail::scan_set (ptr + pos, size - pos, _firsts, true);
+
+        // run until the leftmost match can not be extended nor preceded
+        size_t  state = 0;
+        int32_t best  = NO_MATCH;
+        size_t  start = 0;
+        size_t  end   = pos;
+        for (; end < size; ++end) {
+            state = (size_t)_next[state * _classCount + _classes[(utchar_t)ptr[end]]];
+
+            const State &current = _states[state];
+            if (current.match != NO_MATCH && (best == NO_MATCH || end + 1 - _lengths[current.match] <= start)) {
+                best  = current.match;
+                start = end + 1 - _lengths[best];
+            }
+            if (best != NO_MATCH ? end + 1 - current.depth > start : state == 0) {
+                break;
+            }
+        }
 
-    _str.insert (offset, count, ch);
+        if (best == NO_MATCH) {
+            pos = end + 1;
+            continue;
+        }
+        out.append (ptr + copied, start - copied);
+        out.append (_replacements[best]);
+        copied = pos = start + _lengths[best];
+        ++matches;
+    }
+    out.append (ptr + copied, size - copied);
 
-    return *this;
+    return matches;
 }
 
 // public
-void String::toUpper(void)
+InternedString::InternedString()
+    : _atom (detail::InternTable::empty ())
 {
-    tchar_t* ptr  = getMyPtr ();
-    size_t   size = getLength ();
-
-    for (; size > 0; --size, ++ptr) {
-        *ptr = t_toupper (*ptr);
-    }
 }
 
 // public
-void String::toLower(void)
+InternedString::InternedString(StringView str)
+    : _atom (str.length () == 0 ? detail::InternTable::empty () : detail::InternTable::instance ().intern (str.data (), str.length ()))
 {
-    tchar_t* ptr  = getMyPtr ();
-    size_t   size = getLength ();
-
-    for (; size > 0; --size, ++ptr) {
-        *ptr = t_tolower (*ptr);
-    }
 }
 
 // public
-String String::trim(tchar_t ch) const
+size_t InternedString::count()
 {
-    if (this->isEmpty ()) {
-        return (*this);
-    }
+    return detail::InternTable::instance ().count ();
+}
 
-    const tchar_t* ptr    = getMyPtr();
-    const size_t   size   = getLength();
-    size_t         preLen = 0;
+// public
+size_t StringView::count(tchar_t ch) const
+{
+    return detail::count_char (_ptr, _length, ch);
+}
 
-    // traverse from the begining
-    while (*ptr == ch && preLen < size) {
-        ++preLen, ++ptr;
-    }
+// public
+size_t StringView::countAny(const CharSet &chars) const
+{
+    return detail::count_set (_ptr, _length, chars);
+}
 
-    // traverse from the end
-    size_t postLen = size;
-    ptr            = getMyPtr () + size - 1;
-    while (*ptr == ch && (postLen > preLen)) {
-        --postLen, --ptr;
+// public
+size_t StringView::countLines() const
+{
+    if (_length == 0) {
+        return 0;
     }
-
-    return String (getMyPtr () + preLen, postLen - preLen);
+    return detail::count_char (_ptr, _length, _T('\n')) + (_ptr[_length - 1] != _T('\n'));
 }
 
 // public
-String String::leftString(size_t count) const
+StringView StringView::trim() const
 {
-    if (count > getLength ()) {
-        // detail::throw_xran(String("the count is too long.")); // result too long
-    }
+    static const CharSet whitespace (_T(" \t\n\r\v\f"));
 
-    return String (*this, 0, count);
+    return trim (whitespace);
 }
 
 // public
-String String::rightString (size_t count) const
+StringView StringView::trim(const CharSet &chars) const
 {
-    if (count > getLength ()) {
-        // detail::throw_xran(String("the count is too long.")); // result too long
+    // most lines have nothing to trim: check both ends before scanning
+    if (_length == 0 || (!chars.contains (_ptr[0]) && !chars.contains (_ptr[_length - 1]))) {
+        return *this;
     }
 
-    return String(*this, getLength() - count, getLength());
+    size_t first = detail::scan_set (_ptr, _length, chars, false);
+    if (first == _length) {
+        return StringView (_ptr + _length, 0);
+    }
+    size_t last = first + detail::rscan_set (_ptr + first, _length - first, chars, false);
+    return StringView (_ptr + first, last + 1 - first);
 }
 
 // public
-bool String::startsWith(const tchar_t *prefix) const
+bool StringSplitter::next(StringView &token)
 {
-    // first check if the beginning of the string matches the prefix: note
-    // that we don't have to check that we don't run out of this string as
-    // when we reach the terminating NUL, either prefix string ends too (and
-    // then it's ok) or we break out of the loop because there is no match
-    const tchar_t* ptr = getMyPtr();
+    if (_offset == String::NO_POSITION) {
+        return false;
+    }
 
-    while (*prefix) {
-        if (*prefix++ != *ptr++) {
-            // no match
-            return false;
-        }
+    size_t index;
+    switch (_mode) {
+    case BY_SET:
+        index = _str.findAny (_offset, _set);
+        break;
+    case BY_CHAR:
+        index = _str.find (_separator, _offset);
+        break;
+    case BY_SEQUENCE:
+        index = _str.find (_sequence.getCStr (), _offset, _sequence.getLength ());
+        break;
+    default:
+        index = String::NO_POSITION;
+        break;
+    }
+
+    const tchar_t *ptr = _str.getCStr ();
+    if (index == String::NO_POSITION) {
+        // the last token runs to the end, a trailing separator yields an empty one
+        token   = StringView (ptr + _offset, _str.getLength () - _offset);
+        _offset = String::NO_POSITION;
+    }
+    else {
+        token   = StringView (ptr + _offset, index - _offset);
+        _offset = index + (_mode == BY_SEQUENCE ? _sequence.getLength () : 1);
     }
 
     return true;
 }
 
 // public
-int String::freq(tchar_t ch) const
+StringBuilder::StringBuilder(size_t blockSize /* = 64 * 1024 */)
+    : _blockSize (blockSize != 0 ? blockSize : 1)
+    , _length (0)
 {
-    int            count  = 0;
-    const tchar_t* ptr    = getMyPtr ();
-    const tchar_t* ptrEnd = ptr + getLength ();
+}
 
-    for (; ptr < ptrEnd; ++ptr) {
-        if (*ptr == ch) {
-            ++count;
-        }
+// public
+StringBuilder::~StringBuilder()
+{
+    for (size_t i = 0; i < _blocks.size (); ++i) {
+        ::operator delete (_blocks[i].ptr);
     }
+}
 
-    return count;
+// private
+StringBuilder &StringBuilder::appendBlocks(const tchar_t *ptr, size_t count)
+{
+    // fill the last block, then one new block for the rest: a piece larger
+    // than a block gets a block of its own size
+    _length += count;
+    if (!_blocks.empty ()) {
+        Block &block = _blocks.back ();
+        size_t room  = block.capacity - block.size;
+        ::memcpy (block.ptr + block.size, ptr, room * sizeof (tchar_t));
+        block.size += room;
+        ptr += room;
+        count -= room;
+    }
+
+    Block block;
+    block.capacity = count > _blockSize ? count : _blockSize;
+    block.ptr      = static_cast<tchar_t*> (::operator new (block.capacity * sizeof (tchar_t)));
+    block.size     = count;
+    ::memcpy (block.ptr, ptr, count * sizeof (tchar_t));
+    _blocks.push_back (block);
+
+    return *this;
 }
 
 // public
-void String::format(const tchar_t* fmt, ...)
+void StringBuilder::clear()
 {
-    va_list ap;
-    va_start (ap, fmt);
-    formatv (fmt, ap);
-    va_end (ap);
+    for (size_t i = 1; i < _blocks.size (); ++i) {
+        ::operator delete (_blocks[i].ptr);
+    }
+    if (!_blocks.empty ()) {
+        _blocks.resize (1);
+        _blocks[0].size = 0;
+    }
+    _length = 0;
 }
 
 // public
-void String::formatv(const tchar_t *fmt, va_list ap)
+String StringBuilder::toString() const
 {
-#ifdef __WINDOWS__
-    va_list vaArgsCopy;
-    va_copy(vaArgsCopy, ap);
-    const int iLen = ::_vscwprintf(fmt, vaArgsCopy);
-    va_end(vaArgsCopy);
-
-    std::wstring tmp(iLen + 1, '\0');
-    ::_vsnwprintf(&tmp[0], tmp.size(), fmt, ap);
-    tmp.resize (iLen);
-    _str.swap (tmp);
-#else
-
-    va_list vaArgsCopy;
-    va_copy(vaArgsCopy, ap);
-    const int iLen = ::vsnprintf(NULL, 0, fmt, vaArgsCopy);
-    va_end(vaArgsCopy);
-
-    std::string tmp(iLen + 1, '\0');
-    ::vsnprintf(&tmp[0], tmp.size (), fmt, ap);
-    tmp.resize(iLen);
-    _str.swap(tmp);
-#endif
+    String str;
+    appendTo (str);
+    return str;
 }
 
 // public
-void String::split(const String &separators, std::vector<String> &substrs, bool oneInSeparators /*= true*/) const
+void StringBuilder::appendTo(String &str) const
 {
-    if (this->isEmpty ()) {
-        return;
+    str.reserve (str.getLength () + _length);
+    for (size_t i = 0; i < _blocks.size (); ++i) {
+        str.append (_blocks[i].ptr, _blocks[i].size);
     }
+}
 
-    if (separators.isEmpty ()) {
-        substrs.push_back (*this);
-        return;
+#ifndef __WINDOWS__
+// public
+size_t StringBuilder::chunks(struct iovec *iov, size_t capacity, size_t first /* = 0 */) const
+{
+    size_t count = 0;
+    for (; count < capacity && first + count < _blocks.size (); ++count) {
+        iov[count].iov_base = _blocks[first + count].ptr;
+        iov[count].iov_len  = _blocks[first + count].size * sizeof (tchar_t);
     }
+    return count;
+}
+#endif
 
-    size_t off = 0;
-    size_t index;
-    if (oneInSeparators == true) {
-        index = findAny(off, separators);
-    }
-    else {
-        index = find(separators, off);
+// private
+size_t String::growCapacity (size_t required) const
+{
+    // grow by half of the current capacity so that repeated appends copy
+    // each character a bounded number of times, then round the block
+    // (with its terminating NUL) up to the 16 bytes malloc hands out anyway
+    size_t capacity = getCapacity ();
+    if (required < capacity + capacity / 2) {
+        required = capacity + capacity / 2;
     }
-    size_t sepslength = separators.getLength();
-    while (true) {
-        if (index == String::NO_POSITION) {
-            substrs.push_back (this->subString (off));
-            break;
-        }
-        else {
-            substrs.push_back (this->subString (off, index - off));
-        }
 
-        if (oneInSeparators == true) {
-            off = index + 1;
-        }
-        else {
-            off = index + sepslength;
-        }
+    return ((((required + 1) * sizeof (tchar_t)) + 15) & ~(size_t)15) / sizeof (tchar_t) - 1;
+}
 
-        if (off >= getLength()) {
-            // last is a seperator
-            substrs.push_back("");
-            break;
-        }
+// private
+void String::reallocate (size_t capacity)
+{
+    // move the contents to a heap block of capacity characters
+    size_t   length = getLength ();
+    tchar_t *ptr    = static_cast<tchar_t*> (::operator new ((capacity + 1) * sizeof (tchar_t)));
 
-        if (oneInSeparators == true) {
-            index = findAny (off, separators);
-        }
-        else {
-            index = find (separators, off);
-        }
+    ::memcpy (ptr, getMyPtr (), (length + 1) * sizeof (tchar_t));
+    if (!isLocal ()) {
+        ::operator delete (_store.heap.ptr);
     }
+    setHeap (ptr, length, capacity);
 }
 
 // private
-void String::init(size_t initsize /* = INIT_SIZE*/)
-{
-    _str.reserve(initsize);
+tchar_t *String::splice (size_t offset, size_t number, size_t count)
+{
+    // replace [offset, offset + number) with count uninitialized characters,
+    // return the pointer to them; offset and number are already trimmed
+    bool     local  = isLocal ();
+    tchar_t *ptr    = local ? _store.local : _store.heap.ptr;
+    size_t   size   = local ? INLINE_CAPACITY - (utchar_t)_store.local[INLINE_CAPACITY] : _store.heap.size;
+    size_t   tail   = size - offset - number;
+    size_t   length = size - number + count;
+
+    if ((local ? (size_t)INLINE_CAPACITY : getHeapCapacity ()) < length) {
+        // copy the head and the tail once into the grown block
+        size_t   capacity = growCapacity (length);
+        tchar_t *block    = static_cast<tchar_t*> (::operator new ((capacity + 1) * sizeof (tchar_t)));
+
+        ::memcpy (block, ptr, offset * sizeof (tchar_t));
+        ::memcpy (block + offset + count, ptr + offset + number, tail * sizeof (tchar_t));
+        block[length] = 0;
+        if (!local) {
+            ::operator delete (ptr);
+        }
+        setHeap (block, length, capacity);
+
+        return block + offset;
+    }
+
+    if (tail != 0 && number != count) {
+        ::memmove (ptr + offset + count, ptr + offset + number, tail * sizeof (tchar_t));
+    }
+    ptr[length] = 0;
+    if (local) {
+        _store.local[INLINE_CAPACITY] = (tchar_t)(INLINE_CAPACITY - length);
+    }
+    else {
+        _store.heap.size = length;
+    }
+
+    return ptr + offset;
 }
 
 String::~String(void)
 {
+    if (!isLocal ()) {
+        ::operator delete (_store.heap.ptr);
+    }
 }
 
 #ifdef __WINDOWS__
@@ -1236,26 +3525,27 @@ void String::format(const char *fmt, ...)
 
 void String::formatv(const char *fmt, va_list arg_list)
 {
-    char *fmt_msg = 0;
-
     // SUSv2 version doesn't work for buf NULL/size 0, so try printing
-    // into a small buffer that avoids the double-rendering and alloca path too...
-    char         short_buf[256];
-    const size_t needed = vsnprintf(short_buf, sizeof short_buf, fmt, arg_list) + 1;
-    if (needed <= sizeof short_buf) {
-        fmt_msg = short_buf;
+    // into a small buffer that avoids the double-rendering too...
+    char    short_buf[256];
+    va_list copy;
+    va_copy (copy, arg_list);
+    const int needed = vsnprintf(short_buf, sizeof short_buf, fmt, copy);
+    va_end (copy);
+
+    if (needed < 0) {
+        clear ();
+    }
+    else if ((size_t)needed < sizeof short_buf) {
+        assign (short_buf, (size_t)needed);
     }
     else {
-#ifdef __GNUC__
-#define alloca(size) __builtin_alloca (size)
-        // need more space...
-        char* p = static_cast<char*> (alloca (needed));
-        vsnprintf(p, needed, fmt, arg_list);
-        fmt_msg = p;
-#endif
+        // need more space: render into a fresh string, the arguments may
+        // point into this one
+        String tmp;
+        vsnprintf(tmp.splice (0, 0, (size_t)needed), (size_t)needed + 1, fmt, arg_list);
+        swap (tmp);
     }
-
-    assign (fmt_msg);
 }
 
 std::wstring String::to_wstring(const std::string &str, UINT codepage)
@@ -1322,6 +3612,39 @@ std::string String::utf8_to_ascii(const std::string &utf8)
     return utf16_to_ascii(ws);
 }
 
+#else
+
+std::wstring String::to_wstring(const std::string &utf8)
+{
+    // wchar_t is UTF-32
+    size_t       error;
+    std::wstring ws (detail::utf8_units (utf8.data (), utf8.size (), false), L'\0');
+    ws.resize (detail::from_utf8 (utf8.data (), utf8.size (), &ws[0], error));
+    return ws;
+}
+
+std::string String::to_string(const std::wstring &wstr)
+{
+    size_t      error;
+    std::string utf8 (detail::utf8_length (wstr.data (), wstr.size ()), '\0');
+    utf8.resize (detail::to_utf8 (wstr.data (), wstr.size (), &utf8[0], error));
+    return utf8;
+}
+
+std::u16string String::utf8_to_utf16(const std::string &utf8)
+{
+    std::u16string utf16;
+    utf8ToUtf16 (StringView (utf8.data (), utf8.size ()), utf16);
+    return utf16;
+}
+
+std::string String::utf16_to_utf8(const std::u16string &utf16)
+{
+    String utf8;
+    utf16ToUtf8 (utf16.data (), utf16.size (), utf8);
+    return utf8.str ();
+}
+
 #endif
 
 } // namespace lang
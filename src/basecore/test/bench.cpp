@@ -0,0 +1,1982 @@
+#include <chrono>
+#include <codecvt>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <locale>
+#include <new>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/resource.h>
+#include "app/ncJson.h"
+#include "app/ncJsonBind.h"
+#include "lang/string.h"
+
+/*
+ * JSON and String benchmark suite.
+ *
+ *   bench [rounds] [file.json ...]
+ *
+ * Without files, runs on generated corpora shaped like the usual ones:
+ * twitter.json (strings, unicode, nested users), canada.json (float
+ * coordinates) and citm_catalog.json (wide objects of small integers).
+ * The String benchmarks run on generated keys and text.
+ * Every line reports throughput, heap allocations per round and the
+ * process peak RSS so far.
+ */
+
+namespace {
+    size_t g_allocations = 0;
+
+    /* The replacement operators below call these rather than malloc / free
+       directly: GCC 11+ otherwise pairs the free with operator new and
+       warns (-Wmismatched-new-delete), though both are replaced here. */
+    void*
+    counted_allocate (size_t size)
+    {
+        ++g_allocations;
+        void* p = malloc (size != 0 ? size : 1);
+        if (p == 0)
+        {
+            throw std::bad_alloc ();
+        }
+        return p;
+    }
+
+    void
+    counted_release (void* p)
+    {
+        free (p);
+    }
+} // namespace
+
+void*
+operator new (size_t size)
+{
+    return counted_allocate (size);
+}
+
+void
+operator delete (void* p) noexcept
+{
+    counted_release (p);
+}
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    struct Corpus
+    {
+        std::string name;
+        std::string text;
+    };
+
+    double
+    seconds_since (const Clock::time_point& start)
+    {
+        return std::chrono::duration<double> (Clock::now () - start).count ();
+    }
+
+    long
+    peak_rss_kb ()
+    {
+        struct rusage usage;
+        getrusage (RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    /* Deterministic inputs: the same corpus on every run. */
+    unsigned int
+    next_random (unsigned int& seed)
+    {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 16) & 0x7FFF;
+    }
+
+    void
+    report (const std::string& name, size_t bytes, size_t rounds, size_t allocations, double elapsed)
+    {
+        printf ("%-44s %10.2f MB/s %12.0f allocs/round %10ld KB peak RSS\n", name.c_str (),
+                bytes * rounds / elapsed / (1024 * 1024), static_cast<double> (allocations) / rounds, peak_rss_kb ());
+    }
+
+    std::string
+    make_twitter (size_t statuses)
+    {
+        static const char* words[] = {"RT", "@groot", "json", "\xE3\x81\x93\xE3\x82\x93\xE3\x81\xAB\xE3\x81\xA1\xE3\x81\xAF",
+                                      "benchmark", "\\n", "http:\\/\\/t.co\\/x", "\xF0\x9F\x98\x80", "#tag", "parse"};
+        unsigned int       seed     = 1;
+        std::ostringstream out;
+        out << "{\"statuses\":[";
+        for (size_t pos = 0; pos < statuses; ++pos)
+        {
+            out << (pos ? "," : "") << "{\"id\":" << 505874924095815681ull + pos << ",\"text\":\"";
+            for (unsigned int word = 0; word < 12; ++word)
+            {
+                out << words[next_random (seed) % 10] << ' ';
+            }
+            out << "\",\"truncated\":false,\"in_reply_to_status_id\":null,\"retweet_count\":"
+                << next_random (seed) % 1000 << ",\"favorited\":" << (next_random (seed) % 2 ? "true" : "false")
+                << ",\"user\":{\"id\":" << next_random (seed) << ",\"name\":\"user "
+                << next_random (seed) << "\",\"screen_name\":\"u" << next_random (seed)
+                << "\",\"followers_count\":" << next_random (seed)
+                << ",\"profile_image_url\":\"http:\\/\\/pbs.twimg.com\\/profile_images\\/" << next_random (seed)
+                << ".jpeg\",\"lang\":\"ja\"},\"entities\":{\"hashtags\":[],\"urls\":[],\"user_mentions\":[{\"id\":"
+                << next_random (seed) << ",\"indices\":[3," << next_random (seed) % 140 << "]}]}}";
+        }
+        out << "],\"search_metadata\":{\"count\":" << statuses << ",\"query\":\"%E4%B8%80\"}}";
+        return out.str ();
+    }
+
+    std::string
+    make_canada (size_t rings)
+    {
+        unsigned int       seed = 2;
+        std::ostringstream out;
+        out.precision (15);
+        out << "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"properties\":{\"name\":\"Canada\"},"
+               "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[";
+        for (size_t ring = 0; ring < rings; ++ring)
+        {
+            out << (ring ? "," : "") << '[';
+            for (unsigned int point = 0; point < 100; ++point)
+            {
+                out << (point ? "," : "") << "[" << -65.0 - next_random (seed) / 3276.7 << ","
+                    << 43.0 + next_random (seed) / 3276.7 << "]";
+            }
+            out << ']';
+        }
+        out << "]}}]}";
+        return out.str ();
+    }
+
+    std::string
+    make_citm (size_t events)
+    {
+        unsigned int       seed = 3;
+        std::ostringstream out;
+        out << "{\"areaNames\":{";
+        for (size_t pos = 0; pos < 100; ++pos)
+        {
+            out << (pos ? "," : "") << "\"" << 205705993 + pos << "\":\"Area " << pos << "\"";
+        }
+        out << "},\"events\":{";
+        for (size_t pos = 0; pos < events; ++pos)
+        {
+            out << (pos ? "," : "") << "\"" << 138586341 + pos << "\":{\"description\":null,\"id\":" << 138586341 + pos
+                << ",\"logo\":\"\\/images\\/UE0AAAAACEKo6QAAAAZDSVRN\",\"name\":\"Event " << pos
+                << "\",\"subTopicIds\":[337184269,337184283],\"subjectCode\":null,\"subtitle\":null,\"topicIds\":["
+                << next_random (seed) << "," << next_random (seed) << "]}";
+        }
+        out << "},\"performances\":[";
+        for (size_t pos = 0; pos < events; ++pos)
+        {
+            out << (pos ? "," : "") << "{\"eventId\":" << 138586341 + pos << ",\"id\":" << 339887544 + pos
+                << ",\"prices\":[{\"amount\":" << next_random (seed) * 10 << ",\"audienceSubCategoryId\":337100890,"
+                   "\"seatCategoryId\":338937295}],\"seatCategories\":[{\"areas\":[{\"areaId\":205705999,"
+                   "\"blockIds\":[]}],\"seatCategoryId\":338937295}],\"start\":"
+                << 1372701600000ull + pos * 86400000ull << ",\"venueCode\":\"PLEYEL_PLEYEL\"}";
+        }
+        out << "]}";
+        return out.str ();
+    }
+
+    bool
+    load_file (const char* path, Corpus& corpus)
+    {
+        std::ifstream in (path, std::ios::binary);
+        if (!in)
+        {
+            return false;
+        }
+        std::ostringstream text;
+        text << in.rdbuf ();
+        corpus.name = path;
+        corpus.text = text.str ();
+        return true;
+    }
+
+    void
+    bench_read (const Corpus& corpus, size_t rounds, const JSON::ReadOptions& options = JSON::ReadOptions ())
+    {
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            JSON::Value v;
+            v.read (corpus.text.data (), corpus.text.length (), options);
+        }
+        report (corpus.name + (options.raw_numbers ? " read (raw numbers)" : " read"), corpus.text.length (), rounds,
+                g_allocations - allocations, seconds_since (start));
+    }
+
+    /*
+     * Monotonic arena: allocation bumps a pointer, deallocation is a no-op,
+     * reset () releases everything at once and keeps the chunks for reuse.
+     * The allocator is stateless (all instances share the arena), as ValueT
+     * default-constructs its nodes.
+     */
+    class Arena
+    {
+    public:
+        static void*
+        allocate (size_t size)
+        {
+            size = (size + 15) & ~static_cast<size_t> (15);
+            if (_next == 0 || _used + size > _chunks[_next - 1].size)
+            {
+                // reuse the next chunk if it is large enough, else put a new one before it
+                if (_next == _chunks.size () || _chunks[_next].size < size)
+                {
+                    Chunk chunk;
+                    chunk.size = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+                    chunk.data = static_cast<char*> (malloc (chunk.size));
+                    if (chunk.data == 0)
+                    {
+                        throw std::bad_alloc ();
+                    }
+                    _chunks.insert (_chunks.begin () + _next, chunk);
+                }
+                ++_next;
+                _used = 0;
+            }
+            void* p = _chunks[_next - 1].data + _used;
+            _used += size;
+            return p;
+        }
+
+        static void
+        reset ()
+        {
+            _next = 0;
+            _used = 0;
+        }
+
+    private:
+        struct Chunk
+        {
+            char*  data;
+            size_t size;
+        };
+
+        static const size_t CHUNK_SIZE = 1 << 20;
+
+        static std::vector<Chunk> _chunks;
+        static size_t             _next; // chunks in use, the last one is being filled
+        static size_t             _used;
+    };
+
+    const size_t              Arena::CHUNK_SIZE;
+    std::vector<Arena::Chunk> Arena::_chunks;
+    size_t                    Arena::_next = 0;
+    size_t                    Arena::_used = 0;
+
+    template<class T>
+    struct ArenaAllocator
+    {
+        typedef T value_type;
+
+        ArenaAllocator ()
+        {
+        }
+
+        template<class U>
+        ArenaAllocator (const ArenaAllocator<U>&)
+        {
+        }
+
+        T*
+        allocate (size_t n)
+        {
+            return static_cast<T*> (Arena::allocate (n * sizeof (T)));
+        }
+
+        void
+        deallocate (T*, size_t)
+        {
+        }
+    };
+
+    template<class T, class U>
+    bool
+    operator== (const ArenaAllocator<T>&, const ArenaAllocator<U>&)
+    {
+        return true;
+    }
+
+    template<class T, class U>
+    bool
+    operator!= (const ArenaAllocator<T>&, const ArenaAllocator<U>&)
+    {
+        return false;
+    }
+
+    void
+    bench_read_arena (const Corpus& corpus, size_t rounds)
+    {
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            {
+                JSON::ValueT<char, ArenaAllocator<char>> v;
+                v.read (corpus.text.data (), corpus.text.length ());
+            }
+            Arena::reset ();
+        }
+        report (corpus.name + " read (arena)", corpus.text.length (), rounds, g_allocations - allocations,
+                seconds_since (start));
+    }
+
+    void
+    bench_write (const Corpus& corpus, size_t rounds)
+    {
+        JSON::Value v;
+        v.read (corpus.text.data (), corpus.text.length ());
+        std::string out;
+        v.write (out);
+
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            out.clear ();
+            v.write (out);
+        }
+        report (corpus.name + " write", out.length (), rounds, g_allocations - allocations, seconds_since (start));
+    }
+
+    /* Visit every object member once through get<T> (by key). */
+    size_t
+    lookup_all (const JSON::Value& v, double& sum)
+    {
+        size_t count = 0;
+        if (v.type () == JSON::OBJECT)
+        {
+            for (JSON::Object::const_iterator it = v.o ().begin (); it != v.o ().end (); ++it)
+            {
+                switch (it->second.type ())
+                {
+                    case JSON::INTEGER:
+                    case JSON::FLOAT:
+                    case JSON::BOOLEAN:
+                        sum += v.get<double> (it->first, 0);
+                        ++count;
+                        break;
+                    case JSON::STRING:
+                        sum += v.get<std::string> (it->first, std::string ()).length ();
+                        ++count;
+                        break;
+                    default:
+                        count += lookup_all (it->second, sum);
+                        break;
+                }
+            }
+        }
+        else if (v.type () == JSON::ARRAY)
+        {
+            for (size_t pos = 0; pos < v.a ().size (); ++pos)
+            {
+                count += lookup_all (v.a ()[pos], sum);
+            }
+        }
+        return count;
+    }
+
+    void
+    bench_get (const Corpus& corpus, size_t rounds)
+    {
+        JSON::Value v;
+        v.read (corpus.text.data (), corpus.text.length ());
+
+        double            sum         = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            lookup_all (v, sum);
+        }
+        report (corpus.name + " get<T>", corpus.text.length (), rounds, g_allocations - allocations, seconds_since (start));
+    }
+
+    void
+    bench_equal (const Corpus& corpus, size_t rounds)
+    {
+        JSON::Value lhs;
+        JSON::Value rhs;
+        lhs.read (corpus.text.data (), corpus.text.length ());
+        rhs.read (corpus.text.data (), corpus.text.length ());
+
+        size_t            equal       = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            equal += lhs == rhs;
+        }
+        report (corpus.name + " operator==", corpus.text.length (), rounds, g_allocations - allocations,
+                seconds_since (start));
+        if (equal != rounds)
+        {
+            printf ("%s: operator== failed\n", corpus.name.c_str ());
+        }
+    }
+
+    /* 12 of the 20 members of a make_records () object. */
+    struct Record
+    {
+        int64_t     id;
+        std::string name;
+        double      score;
+        bool        active;
+        int64_t     owner;
+        std::string lang;
+        int64_t     followers;
+        int64_t     friends;
+        bool        verified;
+        std::string location;
+        int64_t     created;
+        double      ratio;
+    };
+    JSON_BIND (Record, id, name, score, active, owner, lang, followers, friends, verified, location, created, ratio)
+
+    std::string
+    make_records (size_t count)
+    {
+        unsigned int       seed = 4;
+        std::ostringstream out;
+        out << '[';
+        for (size_t pos = 0; pos < count; ++pos)
+        {
+            out << (pos ? "," : "") << "{\"id\":" << pos << ",\"name\":\"user " << next_random (seed)
+                << "\",\"score\":" << next_random (seed) / 100.0 << ",\"active\":true,\"owner\":" << next_random (seed)
+                << ",\"lang\":\"en\",\"followers\":" << next_random (seed) << ",\"friends\":" << next_random (seed)
+                << ",\"verified\":false,\"location\":\"Paris\",\"created\":" << 1372701600000ull + pos
+                << ",\"ratio\":" << next_random (seed) / 3276.7 << ",\"avatar\":null,\"bio\":\"\",\"color\":\"fff\","
+                   "\"listed\":0,\"protected\":false,\"timezone\":\"UTC\",\"url\":null,\"utc_offset\":0}";
+        }
+        out << ']';
+        return out.str ();
+    }
+
+    /*
+     * Fill Record from every object: 12 get<T> calls vs one from_value pass.
+     * A handler reads the fields of an object it has just parsed, so the
+     * records are few enough to stay in cache and are visited many times.
+     */
+    void
+    bench_batch_get (size_t rounds)
+    {
+        rounds *= 50;
+        JSON::Value       v;
+        const std::string text = make_records (200);
+        v.read (text.data (), text.length ());
+        const JSON::Array& a = v.a ();
+
+        Record            r;
+        double            sum         = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < a.size (); ++pos)
+            {
+                const JSON::Value& o = a[pos];
+                r.id        = o.get<int64_t> ("id", 0);
+                r.name      = o.get<std::string> ("name", std::string ());
+                r.score     = o.get<double> ("score", 0);
+                r.active    = o.get<bool> ("active", false);
+                r.owner     = o.get<int64_t> ("owner", 0);
+                r.lang      = o.get<std::string> ("lang", std::string ());
+                r.followers = o.get<int64_t> ("followers", 0);
+                r.friends   = o.get<int64_t> ("friends", 0);
+                r.verified  = o.get<bool> ("verified", false);
+                r.location  = o.get<std::string> ("location", std::string ());
+                r.created   = o.get<int64_t> ("created", 0);
+                r.ratio     = o.get<double> ("ratio", 0);
+                sum += r.score + r.ratio;
+            }
+        }
+        report ("12 fields x get<T>", text.length (), rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < a.size (); ++pos)
+            {
+                JSON::from_value (r, a[pos]);
+                sum -= r.score + r.ratio;
+            }
+        }
+        report ("12 fields x from_value", text.length (), rounds, g_allocations - allocations, seconds_since (start));
+        if (sum > 1e-6 || sum < -1e-6)
+        {
+            printf ("get<T>/from_value disagree\n");
+        }
+    }
+
+    /* A Twitter user object: 32 members, names 2 to 24 characters long. */
+    struct Profile
+    {
+        int64_t     id;
+        std::string id_str;
+        std::string name;
+        std::string screen_name;
+        std::string location;
+        std::string description;
+        std::string url;
+        bool        protected_;
+        int64_t     followers_count;
+        int64_t     friends_count;
+        int64_t     listed_count;
+        std::string created_at;
+        int64_t     favourites_count;
+        int64_t     utc_offset;
+        std::string time_zone;
+        bool        geo_enabled;
+        bool        verified;
+        int64_t     statuses_count;
+        std::string lang;
+        bool        contributors_enabled;
+        bool        is_translator;
+        std::string profile_background_color;
+        std::string profile_image_url;
+        std::string profile_banner_url;
+        std::string profile_link_color;
+        std::string profile_text_color;
+        bool        default_profile;
+        bool        default_profile_image;
+        bool        following;
+        bool        follow_request_sent;
+        bool        notifications;
+        bool        has_extended_profile;
+    };
+    JSON_BIND (Profile, id, id_str, name, screen_name, location, description, url, protected_, followers_count,
+               friends_count, listed_count, created_at, favourites_count, utc_offset, time_zone, geo_enabled, verified,
+               statuses_count, lang, contributors_enabled, is_translator, profile_background_color, profile_image_url,
+               profile_banner_url, profile_link_color, profile_text_color, default_profile, default_profile_image,
+               following, follow_request_sent, notifications, has_extended_profile)
+
+    std::string
+    make_profiles (size_t count)
+    {
+        unsigned int       seed = 27;
+        std::ostringstream out;
+        out << '[';
+        for (size_t pos = 0; pos < count; ++pos)
+        {
+            unsigned int id = next_random (seed);
+            out << (pos ? "," : "") << "{\"id\":" << id << ",\"id_str\":\"" << id << "\",\"name\":\"user " << id
+                << "\",\"screen_name\":\"u" << id << "\",\"location\":\"Paris\",\"description\":\"\",\"url\":null,"
+                   "\"protected_\":false,\"followers_count\":"
+                << next_random (seed) << ",\"friends_count\":" << next_random (seed)
+                << ",\"listed_count\":2,\"created_at\":\"Sun Aug 31 00:29:15 +0000 2014\",\"favourites_count\":"
+                << next_random (seed)
+                << ",\"utc_offset\":-3600,\"time_zone\":\"UTC\",\"geo_enabled\":false,\"verified\":false,"
+                   "\"statuses_count\":"
+                << next_random (seed)
+                << ",\"lang\":\"en\",\"contributors_enabled\":false,\"is_translator\":false,"
+                   "\"profile_background_color\":\"C0DEED\",\"profile_image_url\":\"http:\\/\\/pbs.twimg.com\\/p.jpeg\","
+                   "\"profile_banner_url\":\"http:\\/\\/pbs.twimg.com\\/b\",\"profile_link_color\":\"0084B4\","
+                   "\"profile_text_color\":\"333333\",\"default_profile\":true,\"default_profile_image\":false,"
+                   "\"following\":false,\"follow_request_sent\":false,\"notifications\":false,"
+                   "\"has_extended_profile\":false}";
+        }
+        out << ']';
+        return out.str ();
+    }
+
+    /* from_json straight into bound structs: every key is matched against the bound names. */
+    void
+    bench_from_json (size_t rounds)
+    {
+        rounds *= 10;
+        const std::string profiles = make_profiles (500);
+        std::vector<Profile> p;
+        int64_t              sum         = 0;
+        size_t               allocations = g_allocations;
+        Clock::time_point    start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            p.clear ();
+            JSON::from_json (p, profiles.data (), profiles.length ());
+            sum += p.back ().statuses_count;
+        }
+        report ("32 fields x from_json", profiles.length (), rounds, g_allocations - allocations, seconds_since (start));
+
+        const std::string   records = make_records (500);
+        std::vector<Record> r;
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            r.clear ();
+            JSON::from_json (r, records.data (), records.length ());
+            sum += r.back ().created;
+        }
+        report ("12 of 20 fields x from_json", records.length (), rounds, g_allocations - allocations, seconds_since (start));
+        if (sum == 0)
+        {
+            printf ("from_json read nothing\n");
+        }
+    }
+
+    std::string
+    make_document (unsigned int& seed)
+    {
+        char buffer[256];
+        snprintf (buffer, sizeof (buffer),
+                  "{\"id\":%u,\"name\":\"user_%u\",\"score\":%u.%u,\"active\":%s,"
+                  "\"tags\":[\"a\",\"b\\n\",\"c\"],\"owner\":{\"id\":%u,\"ref\":null}}",
+                  next_random (seed), next_random (seed), next_random (seed), next_random (seed) % 100,
+                  next_random (seed) % 2 ? "true" : "false", next_random (seed));
+        return buffer;
+    }
+
+    /* Half of the documents get corrupted: truncated, or one character replaced. */
+    std::vector<std::string>
+    make_invalid_corpus (size_t count)
+    {
+        static const char        garbage[] = "}]:,x\"\\-";
+        unsigned int             seed      = 42;
+        std::vector<std::string> corpus;
+        for (size_t pos = 0; pos < count; ++pos)
+        {
+            std::string doc = make_document (seed);
+            if (pos % 2 == 1)
+            {
+                size_t at = 1 + next_random (seed) % (doc.length () - 2);
+                if (next_random (seed) % 2)
+                {
+                    doc.resize (at);
+                }
+                else
+                {
+                    doc[at] = garbage[next_random (seed) % (sizeof (garbage) - 1)];
+                }
+            }
+            corpus.push_back (doc);
+        }
+        return corpus;
+    }
+
+    /* Parse throughput on 50% invalid inputs, exception vs error code. */
+    void
+    bench_invalid_inputs (size_t rounds)
+    {
+        std::vector<std::string> corpus = make_invalid_corpus (10000);
+        size_t                   bytes  = 0;
+        for (size_t pos = 0; pos < corpus.size (); ++pos)
+        {
+            bytes += corpus[pos].length ();
+        }
+
+        size_t            failed      = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < corpus.size (); ++pos)
+            {
+                JSON::Value v;
+                try
+                {
+                    v.read (corpus[pos].data (), corpus[pos].length ());
+                }
+                catch (const ncJSONException&)
+                {
+                    ++failed;
+                }
+            }
+        }
+        report ("50% invalid read (exception)", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        size_t failed_codes = 0;
+        allocations         = g_allocations;
+        start               = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < corpus.size (); ++pos)
+            {
+                JSON::Value v;
+                if (!v.parse (corpus[pos].data (), corpus[pos].length ()).ok ())
+                {
+                    ++failed_codes;
+                }
+            }
+        }
+        report ("50% invalid parse (error code)", bytes, rounds, g_allocations - allocations, seconds_since (start));
+        if (failed != failed_codes)
+        {
+            printf ("read/parse disagree: %u/%u\n", static_cast<unsigned int> (failed),
+                    static_cast<unsigned int> (failed_codes));
+        }
+    }
+
+    /* String storage before the inline buffer: std::string, reserved on construction. */
+    struct ReservedString
+    {
+        std::string str;
+
+        explicit ReservedString (const char* ptr)
+        {
+            size_t len = strlen (ptr);
+            str.reserve (len);
+            str.assign (ptr, len);
+        }
+
+        ReservedString& operator+= (const char* ptr)
+        {
+            str.append (ptr);
+            return *this;
+        }
+
+        size_t length () const
+        {
+            return str.length ();
+        }
+    };
+
+    /* Dotted keys of about length characters: "<word>.<word>..." */
+    std::vector<std::string>
+    make_keys (size_t count, size_t length)
+    {
+        unsigned int             seed = 7;
+        std::vector<std::string> keys;
+        for (size_t pos = 0; pos < count; ++pos)
+        {
+            std::string key;
+            while (key.length () + 4 < length)
+            {
+                key += key.empty () ? "" : ".";
+                key += static_cast<char> ('a' + next_random (seed) % 26);
+                key += static_cast<char> ('a' + next_random (seed) % 26);
+                key += static_cast<char> ('a' + next_random (seed) % 26);
+            }
+            keys.push_back (key);
+        }
+        return keys;
+    }
+
+    /* Construct from a key, append a suffix, destroy: building a metric name. */
+    template<class S>
+    void
+    bench_string_lifecycle (const std::string& name, const std::vector<std::string>& keys, size_t rounds)
+    {
+        size_t            bytes       = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < keys.size (); ++pos)
+            {
+                S s (keys[pos].c_str ());
+                s += ".";
+                s += "max";
+                bytes += s.length ();
+            }
+        }
+        report (name, bytes / rounds, rounds, g_allocations - allocations, seconds_since (start));
+    }
+
+    /* Log lines of 120-200 characters, ERROR on one line in 64. */
+    std::vector<cpp::lang::String>
+    make_log_lines (size_t count)
+    {
+        static const char* levels[] = {"INFO ", "DEBUG", "WARN "};
+        static const char* paths[]  = {"/api/v1/items", "/api/v1/users/profile", "/static/app.js", "/health"};
+        unsigned int                   seed = 11;
+        std::vector<cpp::lang::String> lines;
+        for (size_t pos = 0; pos < count; ++pos)
+        {
+            char line[256];
+            snprintf (line, sizeof (line),
+                      "2024-08-14 10:%02u:%02u.%03u %s [worker-%u] request id=%08x user=u%u path=%s/%u "
+                      "status=%u bytes=%u agent=\"curl/7.%u\" latency_ms=%u",
+                      next_random (seed) % 60, next_random (seed) % 60, next_random (seed) % 1000,
+                      next_random (seed) % 64 == 0 ? "ERROR" : levels[next_random (seed) % 3], next_random (seed) % 32,
+                      next_random (seed) * 7919, next_random (seed), paths[next_random (seed) % 4], next_random (seed),
+                      next_random (seed) % 8 == 0 ? 500 : 200, next_random (seed), next_random (seed) % 90,
+                      next_random (seed) % 500);
+            lines.push_back (line);
+        }
+        return lines;
+    }
+
+    /* The String::find loop before the filtered search: memchr-less byte scan, full compare. */
+    size_t
+    naive_find (const cpp::lang::String& s, const char* ptr, size_t count)
+    {
+        const char* first = s.c_str ();
+        size_t      size  = s.length ();
+        for (size_t pos = 0; pos + count <= size; ++pos)
+        {
+            if (first[pos] == ptr[0] && memcmp (first + pos, ptr, count) == 0)
+            {
+                return pos;
+            }
+        }
+        return cpp::lang::String::NO_POSITION;
+    }
+
+    void
+    bench_find (const std::vector<cpp::lang::String>& lines, const char* needle, size_t rounds)
+    {
+        size_t bytes = 0;
+        for (size_t pos = 0; pos < lines.size (); ++pos)
+        {
+            bytes += lines[pos].length ();
+        }
+
+        const size_t      count       = strlen (needle);
+        size_t            found       = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                found += lines[pos].find (needle, 0, count) != cpp::lang::String::NO_POSITION;
+            }
+        }
+        std::string name = std::string ("find \"") + (count > 16 ? std::string (needle, 13) + "...\"" : needle + std::string ("\""));
+        report (name + " String", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        size_t naive = 0;
+        allocations  = g_allocations;
+        start        = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                naive += naive_find (lines[pos], needle, count) != cpp::lang::String::NO_POSITION;
+            }
+        }
+        report (name + " naive loop", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        size_t reverse = 0;
+        allocations    = g_allocations;
+        start          = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                reverse += lines[pos].rfind (needle, cpp::lang::String::NO_POSITION, count) != cpp::lang::String::NO_POSITION;
+            }
+        }
+        report (name + " String rfind", bytes, rounds, g_allocations - allocations, seconds_since (start));
+        if (found != naive || found != reverse)
+        {
+            printf ("find/naive/rfind disagree\n");
+        }
+    }
+
+    /* String::findAny before the character set: every character against every separator. */
+    size_t
+    naive_find_any (const cpp::lang::String& s, size_t offset, const cpp::lang::String& chars)
+    {
+        for (size_t pos = offset; pos < s.length (); ++pos)
+        {
+            for (size_t loop = 0; loop != chars.length (); ++loop)
+            {
+                if (s[pos] == chars[loop])
+                {
+                    return pos;
+                }
+            }
+        }
+        return cpp::lang::String::NO_POSITION;
+    }
+
+    /* Count the tokens of every line, splitting on a set of separators. */
+    void
+    bench_find_any (const std::vector<cpp::lang::String>& lines, size_t rounds)
+    {
+        const cpp::lang::String  separators (" =[]\"/:");
+        const cpp::lang::CharSet set (separators.c_str ());
+        size_t                   bytes = 0;
+        for (size_t pos = 0; pos < lines.size (); ++pos)
+        {
+            bytes += lines[pos].length ();
+        }
+
+        size_t            tokens[3]   = {0, 0, 0};
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                for (size_t at = lines[pos].findAny (0, set); at != cpp::lang::String::NO_POSITION;
+                     at = lines[pos].findAny (at + 1, set))
+                {
+                    ++tokens[0];
+                }
+            }
+        }
+        report ("findAny 8 separators CharSet", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                for (size_t at = lines[pos].findAny (0, separators); at != cpp::lang::String::NO_POSITION;
+                     at = lines[pos].findAny (at + 1, separators))
+                {
+                    ++tokens[1];
+                }
+            }
+        }
+        report ("findAny 8 separators String", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                for (size_t at = naive_find_any (lines[pos], 0, separators); at != cpp::lang::String::NO_POSITION;
+                     at = naive_find_any (lines[pos], at + 1, separators))
+                {
+                    ++tokens[2];
+                }
+            }
+        }
+        report ("findAny 8 separators naive loop", bytes, rounds, g_allocations - allocations, seconds_since (start));
+        if (tokens[0] != tokens[1] || tokens[0] != tokens[2])
+        {
+            printf ("findAny disagree\n");
+        }
+
+        // long runs without separators: the vector path
+        const cpp::lang::CharSet rare ("|#");
+        size_t                   found = 0;
+        allocations                    = g_allocations;
+        start                          = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                found += lines[pos].findAny (0, rare) != cpp::lang::String::NO_POSITION;
+            }
+        }
+        report ("findAny absent separators CharSet", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        const cpp::lang::String rareString ("|#");
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                found += naive_find_any (lines[pos], 0, rareString) != cpp::lang::String::NO_POSITION;
+            }
+        }
+        report ("findAny absent separators naive loop", bytes, rounds, g_allocations - allocations, seconds_since (start));
+    }
+
+    /* Split every line on spaces: vector of Strings, lazy views, views into a fixed array. */
+    void
+    bench_split (const std::vector<cpp::lang::String>& lines, size_t rounds)
+    {
+        size_t bytes = 0;
+        for (size_t pos = 0; pos < lines.size (); ++pos)
+        {
+            bytes += lines[pos].length ();
+        }
+
+        const cpp::lang::String        space (" ");
+        std::vector<cpp::lang::String> substrs;
+        size_t                         tokens[3]   = {0, 0, 0};
+        size_t                         allocations = g_allocations;
+        Clock::time_point              start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                substrs.clear ();
+                lines[pos].split (space, substrs);
+                tokens[0] += substrs.size ();
+            }
+        }
+        report ("split on spaces vector<String>", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                cpp::lang::StringSplitter splitter (lines[pos], ' ');
+                for (cpp::lang::StringView token; splitter.next (token);)
+                {
+                    ++tokens[1];
+                }
+            }
+        }
+        report ("split on spaces StringSplitter", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        const cpp::lang::CharSet separators (" ");
+        cpp::lang::StringView    fields[32];
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                tokens[2] += lines[pos].split (separators, fields, 32);
+            }
+        }
+        report ("split on spaces StringView[32]", bytes, rounds, g_allocations - allocations, seconds_since (start));
+        if (tokens[0] != tokens[1] || tokens[0] != tokens[2])
+        {
+            printf ("split disagree\n");
+        }
+    }
+
+    /* Pick the path field of every line and test its prefix: through a String copy, through a view. */
+    void
+    bench_views (const std::vector<cpp::lang::String>& lines, size_t rounds)
+    {
+        size_t bytes = 0;
+        for (size_t pos = 0; pos < lines.size (); ++pos)
+        {
+            bytes += lines[pos].length ();
+        }
+
+        const cpp::lang::String key ("path=");
+        const cpp::lang::String prefix ("/api/");
+        size_t                  matches[2]  = {0, 0};
+        size_t                  allocations = g_allocations;
+        Clock::time_point       start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                size_t            at   = lines[pos].find (key) + key.length ();
+                cpp::lang::String path = lines[pos].subString (at, lines[pos].find (' ', at) - at);
+                matches[0] += path.startsWith (prefix);
+            }
+        }
+        report ("path field subString", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                size_t                at   = lines[pos].find (key) + key.length ();
+                cpp::lang::StringView path = lines[pos].view (at, lines[pos].find (' ', at) - at);
+                matches[1] += path.startsWith (prefix);
+            }
+        }
+        report ("path field view", bytes, rounds, g_allocations - allocations, seconds_since (start));
+        if (matches[0] != matches[1])
+        {
+            printf ("subString/view disagree\n");
+        }
+    }
+
+    /* String::compareIgnoreCase before the ASCII fast path: toupper, then tolower, per mismatch. */
+    int
+    naive_compare_ignore_case (const cpp::lang::String& s1, const cpp::lang::String& s2)
+    {
+        size_t count = s1.length () < s2.length () ? s1.length () : s2.length ();
+        for (size_t pos = 0; pos < count; ++pos)
+        {
+            if (s1[pos] != s2[pos])
+            {
+                int u1 = tolower (toupper ((unsigned char)s1[pos]));
+                int u2 = tolower (toupper ((unsigned char)s2[pos]));
+                if (u1 != u2)
+                {
+                    return u1 < u2 ? -1 : 1;
+                }
+            }
+        }
+        return s1.length () < s2.length () ? -1 : s1.length () == s2.length () ? 0 : 1;
+    }
+
+    /* Case folding and case-insensitive matching: lines, and header names in a hash map. */
+    void
+    bench_ignore_case (const std::vector<cpp::lang::String>& lines, size_t rounds)
+    {
+        size_t                         bytes = 0;
+        std::vector<cpp::lang::String> upper (lines);
+        for (size_t pos = 0; pos < lines.size (); ++pos)
+        {
+            bytes += lines[pos].length ();
+            upper[pos].toUpper ();
+        }
+
+        std::vector<cpp::lang::String> work (lines);
+        size_t                         allocations = g_allocations;
+        Clock::time_point              start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < work.size (); ++pos)
+            {
+                (round % 2 == 0) ? work[pos].toUpper () : work[pos].toLower ();
+            }
+        }
+        report ("toUpper/toLower", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < work.size (); ++pos)
+            {
+                char* ptr = &work[pos][0];
+                for (size_t loop = 0; loop < work[pos].length (); ++loop)
+                {
+                    ptr[loop] = (char)(round % 2 == 0 ? toupper ((unsigned char)ptr[loop]) : tolower ((unsigned char)ptr[loop]));
+                }
+            }
+        }
+        report ("toUpper/toLower naive loop", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        size_t equal[2] = {0, 0};
+        allocations     = g_allocations;
+        start           = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                equal[0] += lines[pos].compareIgnoreCase (upper[pos]) == 0;
+            }
+        }
+        report ("compareIgnoreCase", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                equal[1] += naive_compare_ignore_case (lines[pos], upper[pos]) == 0;
+            }
+        }
+        report ("compareIgnoreCase naive loop", bytes, rounds, g_allocations - allocations, seconds_since (start));
+        if (equal[0] != equal[1])
+        {
+            printf ("compareIgnoreCase/naive disagree\n");
+        }
+
+        static const char* names[] = {"Content-Type", "content-length", "ACCEPT-ENCODING", "User-Agent", "x-request-id",
+                                      "Cache-Control", "Authorization", "Host"};
+        std::unordered_map<cpp::lang::String, int, cpp::lang::StringHashIgnoreCase, cpp::lang::StringEqualIgnoreCase>
+                                                 folded;
+        std::unordered_map<cpp::lang::String, int> lowered;
+        std::vector<cpp::lang::String>             queries;
+        for (size_t pos = 0; pos < sizeof (names) / sizeof (names[0]); ++pos)
+        {
+            cpp::lang::String key (names[pos]);
+            folded[key] = (int)pos;
+            key.toLower ();
+            lowered[key] = (int)pos;
+            key.toUpper ();
+            queries.push_back (key);
+            queries.push_back (names[pos]);
+        }
+
+        size_t hits[2] = {0, 0};
+        bytes          = 0;
+        for (size_t pos = 0; pos < queries.size (); ++pos)
+        {
+            bytes += queries[pos].length ();
+        }
+        rounds *= 10000;
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < queries.size (); ++pos)
+            {
+                hits[0] += folded.count (queries[pos]);
+            }
+        }
+        report ("header map StringHashIgnoreCase", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < queries.size (); ++pos)
+            {
+                cpp::lang::String key (queries[pos]);
+                key.toLower ();
+                hits[1] += lowered.count (key);
+            }
+        }
+        report ("header map lower copy", bytes, rounds, g_allocations - allocations, seconds_since (start));
+        if (hits[0] != hits[1])
+        {
+            printf ("header maps disagree\n");
+        }
+    }
+
+    /* std::hash<String> before the full-length hash: about 16 sampled characters summed. */
+    struct SampledHash
+    {
+        size_t operator() (const cpp::lang::String& str) const
+        {
+            size_t value = (size_t)0xdeadbeef;
+            size_t size  = str.getLength ();
+            if (0 < size)
+            {
+                size_t stride = (size / 16) + 1;
+                size -= stride;
+                for (size_t pos = 0; pos <= size; pos += stride)
+                {
+                    value += (size_t)str[(int)pos];
+                }
+            }
+            return value;
+        }
+    };
+
+    template<class Hash>
+    void
+    bench_hash_map (const std::string& name, const std::vector<cpp::lang::String>& keys, size_t rounds)
+    {
+        size_t bytes = 0;
+        std::unordered_map<cpp::lang::String, size_t, Hash> map;
+        for (size_t pos = 0; pos < keys.size (); ++pos)
+        {
+            bytes += keys[pos].length ();
+            map[keys[pos]] = pos;
+        }
+
+        size_t            sum         = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < keys.size (); ++pos)
+            {
+                sum += map.find (keys[pos])->second;
+            }
+        }
+        size_t longest = 0;
+        for (size_t bucket = 0; bucket < map.bucket_count (); ++bucket)
+        {
+            longest = map.bucket_size (bucket) > longest ? map.bucket_size (bucket) : longest;
+        }
+        char suffix[64];
+        snprintf (suffix, sizeof (suffix), " [bucket %u]", (unsigned)longest);
+        report (name + suffix, bytes, rounds, g_allocations - allocations, seconds_since (start));
+        if (sum != rounds * (keys.size () * (keys.size () - 1) / 2))
+        {
+            printf ("%s: lookups missed\n", name.c_str ());
+        }
+    }
+
+    /* Lookups of every key of unordered_map<String, ...>: URL paths sharing a prefix, anagram-like ids. */
+    void
+    bench_hash (size_t rounds)
+    {
+        std::vector<cpp::lang::String> paths;
+        std::vector<cpp::lang::String> ids;
+        for (size_t pos = 0; pos < 20000; ++pos)
+        {
+            char key[64];
+            snprintf (key, sizeof (key), "/api/v1/users/%06u/profile", (unsigned)pos);
+            paths.push_back (key);
+            snprintf (key, sizeof (key), "id-%u-%u-%u", (unsigned)(pos % 37), (unsigned)(pos / 37 % 23), (unsigned)(pos / 851));
+            ids.push_back (key);
+        }
+        bench_hash_map<SampledHash> ("map paths sampled hash", paths, rounds);
+        bench_hash_map<std::hash<cpp::lang::String>> ("map paths std::hash", paths, rounds);
+        bench_hash_map<SampledHash> ("map ids sampled hash", ids, rounds);
+        bench_hash_map<std::hash<cpp::lang::String>> ("map ids std::hash", ids, rounds);
+    }
+
+    /* Count over a 64 MB CSV-like buffer, 16 passes (1 GB) per line: the freq loop vs count, countAny, countLines. */
+    void
+    bench_count (const std::vector<cpp::lang::String>& lines)
+    {
+        const size_t      passes = 16;
+        cpp::lang::String text;
+        text.reserve (64 * 1024 * 1024 + 256);
+        for (size_t pos = 0; text.length () < 64 * 1024 * 1024; ++pos)
+        {
+            text << lines[pos % lines.size ()] << _T(",") << (unsigned)pos << _T(";\n");
+        }
+        const size_t bytes = text.length ();
+
+        size_t            old   = 0;
+        Clock::time_point start = Clock::now ();
+        for (size_t pass = 0; pass < passes; ++pass)
+        {
+            // the freq loop before count
+            const tchar_t* ptr = text.c_str ();
+            int            n   = 0;
+            for (const tchar_t* end = ptr + text.length (); ptr < end; ++ptr)
+            {
+                if (*ptr == _T('\n'))
+                {
+                    ++n;
+                }
+            }
+            old += (size_t)n;
+        }
+        report ("count '\\n' scalar loop (freq)", bytes, passes, 0, seconds_since (start));
+
+        size_t total = 0;
+        start        = Clock::now ();
+        for (size_t pass = 0; pass < passes; ++pass)
+        {
+            total += text.count (_T('\n'));
+        }
+        report ("count '\\n' String::count", bytes, passes, 0, seconds_since (start));
+
+        start = Clock::now ();
+        for (size_t pass = 0; pass < passes; ++pass)
+        {
+            total += text.countLines ();
+        }
+        report ("count String::countLines", bytes, passes, 0, seconds_since (start));
+
+        const cpp::lang::CharSet separators (_T(",;\"\n"));
+        size_t                   any = 0;
+        start                        = Clock::now ();
+        for (size_t pass = 0; pass < passes; ++pass)
+        {
+            const tchar_t* ptr = text.c_str ();
+            for (const tchar_t* end = ptr + text.length (); ptr < end; ++ptr)
+            {
+                any += separators.contains (*ptr);
+            }
+        }
+        report ("count CSV separators scalar loop", bytes, passes, 0, seconds_since (start));
+
+        start = Clock::now ();
+        for (size_t pass = 0; pass < passes; ++pass)
+        {
+            total += text.countAny (separators);
+        }
+        report ("count CSV separators String::countAny", bytes, passes, 0, seconds_since (start));
+        if (total != 2 * old + any)
+        {
+            printf ("counts differ\n");
+        }
+    }
+
+    /* Rewrite the log text: find + replace(offset, ...) loop vs replaceAll, then escape it and expand a template: replaceAll per pattern vs StringReplacer. */
+    void
+    bench_replace (const std::vector<cpp::lang::String>& lines, size_t rounds)
+    {
+        cpp::lang::String text;
+        for (size_t pos = 0; pos < lines.size () / 4; ++pos)
+        {
+            text << lines[pos] << "\n";
+        }
+        const size_t bytes = text.length ();
+
+        size_t            total       = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            cpp::lang::String copy (text);
+            for (size_t pos = copy.find (_T("status=")); pos != cpp::lang::String::NO_POSITION; pos = copy.find (_T("status="), pos + 12))
+            {
+                copy.replace (pos, 7, _T("http_status="));
+            }
+            total += copy.length ();
+        }
+        report ("replace find+replace loop", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            cpp::lang::String copy (text);
+            copy.replaceAll (_T("status="), _T("http_status="));
+            total += copy.length ();
+        }
+        report ("replace replaceAll", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        static const cpp::lang::StringView from[] = {_T("&"), _T("<"), _T(">"), _T("\"")};
+        static const cpp::lang::StringView to[]   = {_T("&amp;"), _T("&lt;"), _T("&gt;"), _T("&quot;")};
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            cpp::lang::String copy (text);
+            for (size_t pattern = 0; pattern < 4; ++pattern)
+            {
+                copy.replaceAll (from[pattern], to[pattern]);
+            }
+            total += copy.length ();
+        }
+        report ("escape 4 x replaceAll", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        const cpp::lang::StringReplacer escape (from, to, 4);
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            total += escape.replace (text).length ();
+        }
+        report ("escape StringReplacer", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        // a template of 64 placeholders: one pass instead of one per variable
+        cpp::lang::StringView names[64];
+        cpp::lang::StringView values[64];
+        cpp::lang::String     storage[128];
+        for (size_t pos = 0; pos < 64; ++pos)
+        {
+            storage[pos].appendFmt (_T("${{var{}}}"), pos);
+            storage[pos + 64].appendFmt (_T("value-{}"), pos * 37);
+            names[pos]  = storage[pos];
+            values[pos] = storage[pos + 64];
+        }
+        cpp::lang::String page;
+        for (size_t pos = 0; page.length () < bytes; ++pos)
+        {
+            page << lines[pos % lines.size ()].view ().substr (0, 60) << storage[pos % 64] << _T(" ") << storage[(pos * 7) % 64] << _T("\n");
+        }
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            cpp::lang::String copy (page);
+            for (size_t pattern = 0; pattern < 64; ++pattern)
+            {
+                copy.replaceAll (names[pattern], values[pattern]);
+            }
+            total += copy.length ();
+        }
+        report ("template 64 x replaceAll", page.length (), rounds, g_allocations - allocations, seconds_since (start));
+
+        const cpp::lang::StringReplacer expand (names, values, 64);
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            total += expand.replace (page).length ();
+        }
+        report ("template StringReplacer", page.length (), rounds, g_allocations - allocations, seconds_since (start));
+        if (total == 0)
+        {
+            printf ("nothing replaced\n");
+        }
+    }
+
+    /* Parse INI-like lines: trim with String::trim (copies) vs StringView::trim, then match sections by prefix/suffix. */
+    void
+    bench_trim (size_t rounds)
+    {
+        std::vector<cpp::lang::String> lines;
+        size_t                         bytes = 0;
+        for (size_t pos = 0; pos < 10000; ++pos)
+        {
+            char line[128];
+            if (pos % 20 == 0)
+            {
+                snprintf (line, sizeof (line), "[section.%u]", (unsigned)pos);
+            }
+            else
+            {
+                snprintf (line, sizeof (line), "%*skey_%u = /srv/data/volume%u/path  ", (int)(pos % 5), "", (unsigned)pos, (unsigned)pos);
+            }
+            lines.push_back (line);
+            bytes += lines.back ().length ();
+        }
+
+        size_t            total       = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                cpp::lang::String line = lines[pos].trim ();
+                total += line.length ();
+                total += line.startsWith (_T("[")) && line.getLength () > 0 && line[(int)line.getLength () - 1] == _T(']');
+            }
+        }
+        report ("ini String::trim", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < lines.size (); ++pos)
+            {
+                cpp::lang::StringView line = lines[pos].view ().trim ();
+                total += line.length ();
+                total += line.startsWith (_T("[")) && line.endsWith (_T("]"));
+            }
+        }
+        report ("ini StringView::trim", bytes, rounds, g_allocations - allocations, seconds_since (start));
+        if (total == 0)
+        {
+            printf ("nothing trimmed\n");
+        }
+    }
+
+    /* Count samples of 500 metric names (longer than the inline buffer): keep String keys, intern them, count by InternedString. */
+    void
+    bench_intern (size_t rounds)
+    {
+        std::vector<cpp::lang::String> names;
+        for (size_t pos = 0; pos < 500; ++pos)
+        {
+            char name[64];
+            snprintf (name, sizeof (name), "service.http.requests.latency.p%02u.host%03u", (unsigned)(pos % 100), (unsigned)pos);
+            names.push_back (name);
+        }
+        std::vector<cpp::lang::String> samples;
+        size_t                         bytes = 0;
+        unsigned int                   seed  = 47;
+        for (size_t pos = 0; pos < 20000; ++pos)
+        {
+            seed = seed * 1103515245u + 12345u;
+            samples.push_back (names[(seed >> 16) % names.size ()]);
+            bytes += samples.back ().length ();
+        }
+
+        size_t            total       = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            std::vector<cpp::lang::String> kept (samples.begin (), samples.end ());
+            total += kept.size ();
+        }
+        report ("keep samples String", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            std::vector<cpp::lang::InternedString> kept;
+            kept.reserve (samples.size ());
+            for (size_t pos = 0; pos < samples.size (); ++pos)
+            {
+                kept.push_back (cpp::lang::InternedString (samples[pos]));
+            }
+            total += kept.size ();
+        }
+        report ("keep samples InternedString", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        std::vector<cpp::lang::InternedString> interned;
+        for (size_t pos = 0; pos < samples.size (); ++pos)
+        {
+            interned.push_back (cpp::lang::InternedString (samples[pos]));
+        }
+        std::unordered_map<cpp::lang::String, size_t> byString;
+        std::unordered_map<cpp::lang::InternedString, size_t> byAtom;
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < samples.size (); ++pos)
+            {
+                ++byString[samples[pos]];
+            }
+        }
+        report ("count map<String>", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < interned.size (); ++pos)
+            {
+                ++byAtom[interned[pos]];
+            }
+        }
+        report ("count map<InternedString>", bytes, rounds, g_allocations - allocations, seconds_since (start));
+        if (total != 2 * rounds * samples.size () || byString.size () != byAtom.size ())
+        {
+            printf ("interning lost samples\n");
+        }
+    }
+
+    /* Build a line of numbers: operator<< into a reused String, std::to_string appended as before. */
+    void
+    bench_append_numbers (size_t rounds)
+    {
+        std::vector<long long> integers;
+        std::vector<double>    reals;
+        unsigned int           seed = 13;
+        for (size_t pos = 0; pos < 10000; ++pos)
+        {
+            integers.push_back ((long long)next_random (seed) * (pos % 3 == 0 ? -1 : 1) >> (pos % 24));
+            reals.push_back ((double)next_random (seed) / (1 + next_random (seed) % 1000));
+        }
+
+        cpp::lang::String line;
+        line.reserve (64);
+        size_t            bytes       = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < integers.size (); ++pos)
+            {
+                line.clear ();
+                line << "id=" << (int64)integers[pos] << " bytes=" << (unsigned int)pos;
+                bytes += line.length ();
+            }
+        }
+        report ("operator<< integers", bytes / rounds, rounds, g_allocations - allocations, seconds_since (start));
+
+        bytes       = 0;
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < integers.size (); ++pos)
+            {
+                line.clear ();
+                std::string value = std::to_string (integers[pos]);
+                line << "id=";
+                line.append (value.data (), value.size ());
+                value = std::to_string ((unsigned int)pos);
+                line << " bytes=";
+                line.append (value.data (), value.size ());
+                bytes += line.length ();
+            }
+        }
+        report ("std::to_string integers", bytes / rounds, rounds, g_allocations - allocations, seconds_since (start));
+
+        bytes       = 0;
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < reals.size (); ++pos)
+            {
+                line.clear ();
+                line << "latency=" << reals[pos];
+                bytes += line.length ();
+            }
+        }
+        report ("operator<< double (shortest)", bytes / rounds, rounds, g_allocations - allocations, seconds_since (start));
+
+        bytes       = 0;
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < reals.size (); ++pos)
+            {
+                line.clear ();
+                std::string value = std::to_string (reals[pos]);
+                line << "latency=";
+                line.append (value.data (), value.size ());
+                bytes += line.length ();
+            }
+        }
+        report ("std::to_string double (%f)", bytes / rounds, rounds, g_allocations - allocations, seconds_since (start));
+
+        bytes       = 0;
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pos = 0; pos < reals.size (); ++pos)
+            {
+                char value[32];
+                line.clear ();
+                line << "latency=";
+                line.append (value, (size_t)snprintf (value, sizeof (value), "%.17g", reals[pos]));
+                bytes += line.length ();
+            }
+        }
+        report ("snprintf double (%.17g)", bytes / rounds, rounds, g_allocations - allocations, seconds_since (start));
+    }
+
+    /* Build a log line: String::fmt, String::format (vsnprintf). */
+    void
+    bench_fmt (size_t rounds)
+    {
+        static const char* levels[] = {"INFO", "DEBUG", "WARN", "ERROR"};
+        static const char* paths[]  = {"/api/v1/items", "/api/v1/users/profile", "/static/app.js", "/health"};
+        const size_t       lines    = 10000;
+
+        size_t            bytes       = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            unsigned int seed = 17;
+            for (size_t pos = 0; pos < lines; ++pos)
+            {
+                cpp::lang::String line =
+                    cpp::lang::String::fmt ("{} [worker-{}] request id={} path={} status={}", levels[pos % 4],
+                                            next_random (seed) % 32, next_random (seed), paths[pos % 4], 200u);
+                bytes += line.length ();
+            }
+        }
+        report ("String::fmt", bytes / rounds, rounds, g_allocations - allocations, seconds_since (start));
+
+        bytes       = 0;
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            unsigned int seed = 17;
+            for (size_t pos = 0; pos < lines; ++pos)
+            {
+                cpp::lang::String line;
+                line.format ("%s [worker-%u] request id=%u path=%s status=%u", levels[pos % 4], next_random (seed) % 32,
+                             next_random (seed), paths[pos % 4], 200u);
+                bytes += line.length ();
+            }
+        }
+        report ("String::format (vsnprintf)", bytes / rounds, rounds, g_allocations - allocations, seconds_since (start));
+    }
+
+    /* UTF-8 -> UTF-16 -> UTF-8 and UTF-8 -> UTF-32, against std::wstring_convert. */
+    void
+    bench_transcode (const std::string& name, const std::string& utf8, size_t rounds)
+    {
+        std::u16string    utf16;
+        std::u32string    utf32;
+        cpp::lang::String back;
+        bool              valid       = true;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            valid &= cpp::lang::String::utf8ToUtf16 (cpp::lang::StringView (utf8.data (), utf8.size ()), utf16);
+        }
+        report (name + " UTF-8 -> UTF-16", utf8.size (), rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            valid &= cpp::lang::String::utf16ToUtf8 (utf16.data (), utf16.size (), back);
+        }
+        report (name + " UTF-16 -> UTF-8", utf8.size (), rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            valid &= cpp::lang::String::utf8ToUtf32 (cpp::lang::StringView (utf8.data (), utf8.size ()), utf32);
+        }
+        report (name + " UTF-8 -> UTF-32", utf8.size (), rounds, g_allocations - allocations, seconds_since (start));
+
+        std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
+        std::u16string                                                    converted;
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            converted = convert.from_bytes (utf8);
+        }
+        report (name + " UTF-8 -> UTF-16 codecvt", utf8.size (), rounds, g_allocations - allocations,
+                seconds_since (start));
+
+        std::string reconverted;
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            reconverted = convert.to_bytes (converted);
+        }
+        report (name + " UTF-16 -> UTF-8 codecvt", utf8.size (), rounds, g_allocations - allocations,
+                seconds_since (start));
+        if (!valid || converted != utf16 || back != cpp::lang::String (utf8) || reconverted != utf8)
+        {
+            printf ("%s: transcoders disagree\n", name.c_str ());
+        }
+    }
+
+    /* Assemble a ~4 MB body from the log lines: String +=, operator+, StringBuilder. */
+    void
+    bench_builder (const std::vector<cpp::lang::String>& lines, size_t rounds)
+    {
+        const size_t repeat = 2;
+        size_t       bytes  = 0;
+        for (size_t pos = 0; pos < lines.size (); ++pos)
+        {
+            bytes += (lines[pos].length () + 1) * repeat;
+        }
+
+        size_t            total       = 0;
+        size_t            allocations = g_allocations;
+        Clock::time_point start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            cpp::lang::String body;
+            for (size_t loop = 0; loop < repeat; ++loop)
+            {
+                for (size_t pos = 0; pos < lines.size (); ++pos)
+                {
+                    body << lines[pos] << '\n';
+                }
+            }
+            total += body.length ();
+        }
+        report ("body String <<", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            cpp::lang::StringBuilder body;
+            for (size_t loop = 0; loop < repeat; ++loop)
+            {
+                for (size_t pos = 0; pos < lines.size (); ++pos)
+                {
+                    body << lines[pos] << '\n';
+                }
+            }
+            total += body.length ();
+        }
+        report ("body StringBuilder (chunks)", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            cpp::lang::StringBuilder body;
+            for (size_t loop = 0; loop < repeat; ++loop)
+            {
+                for (size_t pos = 0; pos < lines.size (); ++pos)
+                {
+                    body << lines[pos] << '\n';
+                }
+            }
+            total += body.toString ().length ();
+        }
+        report ("body StringBuilder + toString", bytes, rounds, g_allocations - allocations, seconds_since (start));
+
+        // operator+ copies the body for every piece: a tenth of the lines
+        allocations = g_allocations;
+        start       = Clock::now ();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            cpp::lang::String body;
+            for (size_t pos = 0; pos < lines.size () / 10; ++pos)
+            {
+                body = body + lines[pos] + "\n";
+            }
+            total += body.length ();
+        }
+        report ("body operator+ (1/10 of the lines)", bytes / 20, rounds, g_allocations - allocations,
+                seconds_since (start));
+        if (total == 0)
+        {
+            printf ("empty body\n");
+        }
+    }
+
+    void
+    bench_strings (size_t rounds)
+    {
+        rounds *= 20;
+        static const size_t lengths[] = {8, 19, 40};
+        for (size_t pos = 0; pos < sizeof (lengths) / sizeof (lengths[0]); ++pos)
+        {
+            std::vector<std::string> keys = make_keys (10000, lengths[pos]);
+            char                     name[64];
+            snprintf (name, sizeof (name), "%u-char keys String (inline)", static_cast<unsigned int> (keys[0].length () + 4));
+            bench_string_lifecycle<cpp::lang::String> (name, keys, rounds);
+            snprintf (name, sizeof (name), "%u-char keys String (reserved)", static_cast<unsigned int> (keys[0].length () + 4));
+            bench_string_lifecycle<ReservedString> (name, keys, rounds);
+        }
+
+        std::vector<cpp::lang::String> lines = make_log_lines (10000);
+        bench_find (lines, "ERROR", rounds);
+        bench_find (lines, "latency_ms=", rounds);
+        bench_find (lines, "status=500 bytes=0 agent=\"Mozilla/5.0 (X11; Linux x86_64) Gecko/20100101\"", rounds);
+        bench_find_any (lines, rounds);
+        bench_split (lines, rounds);
+        bench_views (lines, rounds);
+        bench_ignore_case (lines, rounds);
+        bench_trim (rounds);
+        bench_replace (lines, rounds);
+        bench_hash (rounds);
+        bench_intern (rounds);
+        bench_append_numbers (rounds);
+        bench_fmt (rounds);
+        bench_builder (lines, rounds);
+        bench_count (lines);
+
+        std::string ascii;
+        for (size_t pos = 0; pos < lines.size (); ++pos)
+        {
+            ascii.append (lines[pos].c_str (), lines[pos].length ()).append ("\n");
+        }
+        bench_transcode ("ASCII log", ascii, rounds);
+
+        // Chinese text with ASCII punctuation and numbers, ~1 MB
+        std::string  cjk;
+        unsigned int seed = 19;
+        while (cjk.size () < (1 << 20))
+        {
+            unsigned int cp = 0x4E00 + next_random (seed) % 0x5000;
+            char         utf8[3] = {(char)(0xE0 | cp >> 12), (char)(0x80 | (cp >> 6 & 0x3F)), (char)(0x80 | (cp & 0x3F))};
+            cjk.append (utf8, 3);
+            if (next_random (seed) % 16 == 0)
+            {
+                cjk.append (next_random (seed) % 2 == 0 ? ", 2024" : ". ");
+            }
+        }
+        bench_transcode ("CJK text", cjk, rounds);
+    }
+} // namespace
+
+int main (int argc, char *argv[])
+{
+    size_t rounds = argc > 1 ? static_cast<size_t> (atoi (argv[1])) : 20;
+
+    std::vector<Corpus> corpora;
+    for (int arg = 2; arg < argc; ++arg)
+    {
+        Corpus corpus;
+        if (!load_file (argv[arg], corpus))
+        {
+            printf ("can not read %s\n", argv[arg]);
+            return 1;
+        }
+        corpora.push_back (corpus);
+    }
+    if (corpora.empty ())
+    {
+        Corpus corpus;
+        corpus.name = "twitter (generated)";
+        corpus.text = make_twitter (1000);
+        corpora.push_back (corpus);
+        corpus.name = "canada (generated)";
+        corpus.text = make_canada (200);
+        corpora.push_back (corpus);
+        corpus.name = "citm_catalog (generated)";
+        corpus.text = make_citm (1000);
+        corpora.push_back (corpus);
+    }
+
+    for (size_t pos = 0; pos < corpora.size (); ++pos)
+    {
+        printf ("%s: %u bytes\n", corpora[pos].name.c_str (), static_cast<unsigned int> (corpora[pos].text.length ()));
+        bench_read (corpora[pos], rounds);
+        bench_read_arena (corpora[pos], rounds);
+        bench_read (corpora[pos], rounds, JSON::ReadOptions (true));
+        bench_write (corpora[pos], rounds);
+        bench_get (corpora[pos], rounds);
+        bench_equal (corpora[pos], rounds);
+    }
+    bench_batch_get (rounds);
+    bench_from_json (rounds);
+    bench_invalid_inputs (rounds);
+    bench_strings (rounds);
+    return 0;
+}
@@ -0,0 +1,1532 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "app/ncJsonBind.h"
+#include "app/ncJsonSchema.h"
+#include "lang/string.h"
+
+/*
+ * Self-checking tests, run by ctest.
+ *
+ *   check
+ *
+ * Every check compares with a reference: std::string for the String
+ * operations, straightforward loops for the vectorized ones, std::regex
+ * for the schema patterns. Inputs are
+ * generated from a fixed seed, so a failure reproduces. Prints the
+ * failures and exits non-zero if there is any.
+ */
+
+namespace {
+    size_t g_checks   = 0;
+    size_t g_failures = 0;
+
+#define CHECK(condition)                                                             \
+    do                                                                               \
+    {                                                                                \
+        ++g_checks;                                                                  \
+        if (!(condition))                                                            \
+        {                                                                            \
+            ++g_failures;                                                            \
+            printf ("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        }                                                                            \
+    } while (0)
+
+    unsigned int
+    next_random (unsigned int& seed)
+    {
+        seed = seed * 1103515245u + 12345u;
+        return seed >> 16;
+    }
+
+    /* Random text over a small alphabet, so searches and edits hit often. */
+    std::string
+    make_text (unsigned int& seed, size_t length, const char* alphabet)
+    {
+        size_t      size = strlen (alphabet);
+        std::string text;
+        for (size_t pos = 0; pos < length; ++pos)
+        {
+            text += alphabet[next_random (seed) % size];
+        }
+        return text;
+    }
+
+    bool
+    same (const cpp::lang::String& s, const std::string& expected)
+    {
+        return s.getLength () == expected.length () && memcmp (s.getCStr (), expected.data (), expected.length ()) == 0
+               && s.getCStr ()[s.getLength ()] == 0;
+    }
+
+    // str () is a copy; edits through it such as s.str ().append (x) must not compile
+    static_assert (std::is_const<decltype (std::declval<cpp::lang::String&> ().str ())>::value, "str () must return a const copy");
+
+    /* One edit, on String and std::string, with the same arguments: both throw std::out_of_range or neither. */
+    template<class StringEdit, class StdEdit>
+    void
+    check_edit (cpp::lang::String& s, std::string& expected, StringEdit edit, StdEdit stdEdit)
+    {
+        bool thrown    = false;
+        bool stdThrown = false;
+        try
+        {
+            edit (s);
+        }
+        catch (const std::out_of_range&)
+        {
+            thrown = true;
+        }
+        try
+        {
+            stdEdit (expected);
+        }
+        catch (const std::out_of_range&)
+        {
+            stdThrown = true;
+        }
+        CHECK (thrown == stdThrown);
+        CHECK (same (s, expected));
+    }
+
+    /* Random insert / remove / replace / append / assign against std::string, across the inline and heap sizes. */
+    void
+    check_string_edits ()
+    {
+        unsigned int seed = 36;
+        for (size_t round = 0; round < 20000; ++round)
+        {
+            std::string       expected = make_text (seed, next_random (seed) % 40, "abc");
+            cpp::lang::String s (expected.c_str (), expected.length ());
+            for (size_t step = 0; step < 8; ++step)
+            {
+                std::string piece  = make_text (seed, next_random (seed) % 30, "xyz");
+                size_t      offset = next_random (seed) % (expected.length () + 4); // sometimes past the end
+                size_t      number = next_random (seed) % 6;
+                switch (next_random (seed) % 7)
+                {
+                case 0:
+                    check_edit (
+                        s, expected, [&] (cpp::lang::String& str) { str.insert (offset, piece.c_str (), piece.length ()); },
+                        [&] (std::string& str) { str.insert (offset, piece); });
+                    break;
+                case 1:
+                    check_edit (
+                        s, expected, [&] (cpp::lang::String& str) { str.remove (offset, number); },
+                        [&] (std::string& str) { str.erase (offset, number); });
+                    break;
+                case 2:
+                    check_edit (
+                        s, expected,
+                        [&] (cpp::lang::String& str) { str.replace (offset, number, piece.c_str (), piece.length ()); },
+                        [&] (std::string& str) { str.replace (offset, number, piece); });
+                    break;
+                case 3:
+                    check_edit (
+                        s, expected, [&] (cpp::lang::String& str) { str.insert (offset, (tchar_t)'q', number); },
+                        [&] (std::string& str) { str.insert (offset, number, 'q'); });
+                    break;
+                case 4:
+                    // a substring of itself
+                    check_edit (
+                        s, expected, [&] (cpp::lang::String& str) { str.append (cpp::lang::String (str), offset, number); },
+                        [&] (std::string& str) { str.append (std::string (str), offset, number); });
+                    break;
+                case 5:
+                    check_edit (
+                        s, expected, [&] (cpp::lang::String& str) { str.assign (cpp::lang::String (str), offset, number); },
+                        [&] (std::string& str) { str.assign (std::string (str), offset, number); });
+                    break;
+                default:
+                    check_edit (
+                        s, expected, [&] (cpp::lang::String& str) { str.replace (offset, number, number + 1, (tchar_t)'r'); },
+                        [&] (std::string& str) { str.replace (offset, number, number + 1, 'r'); });
+                    break;
+                }
+            }
+        }
+
+        // the cases that corrupted memory
+        cpp::lang::String s ("abc");
+        bool              thrown = false;
+        try
+        {
+            s.insert (10, "xyz", 3);
+        }
+        catch (const std::out_of_range&)
+        {
+            thrown = true;
+        }
+        CHECK (thrown && s == "abc");
+        thrown = false;
+        try
+        {
+            s.remove (10, 2);
+        }
+        catch (const std::out_of_range&)
+        {
+            thrown = true;
+        }
+        CHECK (thrown && s == "abc");
+        thrown = false;
+        try
+        {
+            s.replace (10, 1, "q", 1);
+        }
+        catch (const std::out_of_range&)
+        {
+            thrown = true;
+        }
+        CHECK (thrown && s == "abc");
+    }
+
+    /* find / rfind of substrings and characters against std::string, with needles cut from the text so they hit. */
+    void
+    check_string_search ()
+    {
+        unsigned int seed = 37;
+        for (size_t round = 0; round < 20000; ++round)
+        {
+            std::string       text = make_text (seed, next_random (seed) % 200, round % 2 == 0 ? "ab" : "abcdefgh");
+            cpp::lang::String s (text.c_str (), text.length ());
+            std::string       needle;
+            if (!text.empty () && next_random (seed) % 4 != 0)
+            {
+                size_t offset = next_random (seed) % text.length ();
+                needle        = text.substr (offset, next_random (seed) % 40);
+            }
+            else
+            {
+                needle = make_text (seed, next_random (seed) % 6, "abc");
+            }
+            size_t offset = next_random (seed) % (text.length () + 3);
+            char   ch     = "abcz"[next_random (seed) % 4];
+
+            CHECK (s.find (needle.c_str (), offset, needle.length ()) == text.find (needle, offset));
+            CHECK (s.rfind (needle.c_str (), offset, needle.length ()) == text.rfind (needle, offset));
+            CHECK (s.rfind (needle.c_str (), cpp::lang::String::NO_POSITION, needle.length ()) == text.rfind (needle));
+            CHECK (s.find (ch, offset) == text.find (ch, offset));
+            CHECK (s.rfind (ch, offset) == text.rfind (ch, offset));
+
+            // the same through an unaligned view
+            size_t                shift = text.empty () ? 0 : next_random (seed) % (text.length () < 16 ? text.length () : 16);
+            cpp::lang::StringView view (s.getCStr () + shift, text.length () - shift);
+            std::string           tail  = text.substr (shift);
+            cpp::lang::StringView key (needle.data (), needle.length ());
+            CHECK (view.find (key, offset) == tail.find (needle, offset));
+            CHECK (view.rfind (key, offset) == tail.rfind (needle, offset));
+            CHECK (view.find (ch, offset) == tail.find (ch, offset));
+        }
+    }
+
+    /*
+     * Reference UTF-8 decoder, written from the RFC 3629 definition and not
+     * from the transcoders: the code points up to the first malformed
+     * sequence. Returns the offset of that sequence, text.length () if none.
+     */
+    size_t
+    reference_decode_utf8 (const std::string& text, std::vector<uint32_t>& codePoints)
+    {
+        static const uint32_t minimum[] = {0, 0, 0x80, 0x800, 0x10000};
+        size_t                pos       = 0;
+        while (pos < text.length ())
+        {
+            unsigned char c      = text[pos];
+            size_t        length = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 0;
+            if (length == 0 || pos + length > text.length ())
+            {
+                return pos;
+            }
+            uint32_t cp = length == 1 ? c : c & (0x7F >> length);
+            for (size_t index = 1; index < length; ++index)
+            {
+                unsigned char next = text[pos + index];
+                if ((next & 0xC0) != 0x80)
+                {
+                    return pos;
+                }
+                cp = cp << 6 | (next & 0x3F);
+            }
+            if (cp < minimum[length] || (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+            {
+                return pos;
+            }
+            codePoints.push_back (cp);
+            pos += length;
+        }
+        return pos;
+    }
+
+    std::string
+    reference_utf8 (const std::vector<uint32_t>& codePoints)
+    {
+        std::string text;
+        for (size_t index = 0; index < codePoints.size (); ++index)
+        {
+            uint32_t cp = codePoints[index];
+            if (cp < 0x80)
+            {
+                text += (char)cp;
+                continue;
+            }
+            size_t length = cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+            text += (char)(((0xFF00u >> length) & 0xFF) | cp >> (6 * (length - 1)));
+            for (size_t shift = 6 * (length - 1); shift != 0; shift -= 6)
+            {
+                text += (char)(0x80 | (cp >> (shift - 6) & 0x3F));
+            }
+        }
+        return text;
+    }
+
+    std::u16string
+    reference_utf16 (const std::vector<uint32_t>& codePoints)
+    {
+        std::u16string text;
+        for (size_t index = 0; index < codePoints.size (); ++index)
+        {
+            uint32_t cp = codePoints[index];
+            if (cp < 0x10000)
+            {
+                text += (char16_t)cp;
+            }
+            else
+            {
+                text += (char16_t)(0xD800 | (cp - 0x10000) >> 10);
+                text += (char16_t)(0xDC00 | (cp & 0x3FF));
+            }
+        }
+        return text;
+    }
+
+    /* Random code point: ASCII runs long enough for the vector paths, every sequence length, and the range edges. */
+    uint32_t
+    make_code_point (unsigned int& seed)
+    {
+        static const uint32_t edges[] = {0x7F, 0x80, 0x7FF, 0x800, 0xD7FF, 0xE000, 0xFFFD, 0xFFFF, 0x10000, 0x10FFFF};
+        switch (next_random (seed) % 6)
+        {
+        case 0:
+            return 0x80 + next_random (seed) % 0x780;
+        case 1:
+            return 0x4E00 + next_random (seed) % 0x5200; // CJK
+        case 2:
+            return 0x10000 + (next_random (seed) << 4 ^ next_random (seed)) % 0x100000;
+        case 3:
+            return edges[next_random (seed) % (sizeof (edges) / sizeof (edges[0]))];
+        default:
+            return 'a' + next_random (seed) % 26;
+        }
+    }
+
+    /* UTF-8 text, sometimes with one malformed sequence in it. */
+    std::string
+    make_utf8 (unsigned int& seed)
+    {
+        static const char* invalid[] = {"\xC0\xAF",     "\xC1\xBF", "\xE0\x80\xAF", "\xED\xA0\x80", "\xF0\x8F\xBF\xBF",
+                                        "\xF4\x90\x80\x80", "\xF5\x80", "\x80",         "\xBF",         "\xC2",
+                                        "\xE2\x82",     "\xF0\x9F\x98", "\xFE",         "\xFF",         "\xC2\x41"};
+        std::vector<uint32_t> codePoints;
+        for (size_t count = next_random (seed) % 24; count != 0; --count)
+        {
+            if (next_random (seed) % 3 == 0)
+            {
+                for (size_t run = next_random (seed) % 40; run != 0; --run)
+                {
+                    codePoints.push_back ('a' + next_random (seed) % 26);
+                }
+            }
+            codePoints.push_back (make_code_point (seed));
+        }
+        std::string text = reference_utf8 (codePoints);
+        if (next_random (seed) % 3 == 0)
+        {
+            text.insert (next_random (seed) % (text.length () + 1), invalid[next_random (seed) % (sizeof (invalid) / sizeof (invalid[0]))]);
+        }
+        return text;
+    }
+
+    /* String's UTF-8 / UTF-16 / UTF-32 transcoders against the reference decoder and encoders. */
+    void
+    check_string_utf ()
+    {
+        unsigned int seed = 45;
+        for (size_t round = 0; round < 20000; ++round)
+        {
+            std::string           text = make_utf8 (seed);
+            std::vector<uint32_t> codePoints;
+            bool                  valid = reference_decode_utf8 (text, codePoints) == text.length ();
+            std::u32string        utf32 (codePoints.begin (), codePoints.end ());
+            std::u16string        utf16 = reference_utf16 (codePoints);
+            std::string           utf8  = reference_utf8 (codePoints);
+
+            std::u32string outUtf32;
+            std::u16string outUtf16;
+            CHECK (cpp::lang::String::utf8ToUtf32 (cpp::lang::StringView (text.data (), text.length ()), outUtf32) == valid);
+            CHECK (outUtf32 == utf32);
+            CHECK (cpp::lang::String::utf8ToUtf16 (cpp::lang::StringView (text.data (), text.length ()), outUtf16) == valid);
+            CHECK (outUtf16 == utf16);
+
+            // back from the valid prefix
+            cpp::lang::String outUtf8;
+            CHECK (cpp::lang::String::utf32ToUtf8 (utf32.data (), utf32.length (), outUtf8) && same (outUtf8, utf8));
+            CHECK (cpp::lang::String::utf16ToUtf8 (utf16.data (), utf16.length (), outUtf8) && same (outUtf8, utf8));
+            CHECK (cpp::lang::String::utf16ToUtf32 (utf16.data (), utf16.length (), outUtf32) && outUtf32 == utf32);
+            CHECK (cpp::lang::String::utf32ToUtf16 (utf32.data (), utf32.length (), outUtf16) && outUtf16 == utf16);
+
+            // a lone surrogate or a code point out of range cuts the conversion there
+            if (!utf32.empty ())
+            {
+                size_t         cut        = next_random (seed) % utf32.length ();
+                std::u32string badUtf32   = utf32;
+                badUtf32[cut]             = round % 2 == 0 ? 0xDC00 + next_random (seed) % 0x400 : 0x110000 + next_random (seed);
+                std::u16string badUtf16   = reference_utf16 (std::vector<uint32_t> (codePoints.begin (), codePoints.begin () + cut));
+                size_t         prefix16   = badUtf16.length ();
+                badUtf16                 += (char16_t)(0xD800 + next_random (seed) % 0x800);
+                badUtf16                 += u"ab";
+                std::string    prefix8    = reference_utf8 (std::vector<uint32_t> (codePoints.begin (), codePoints.begin () + cut));
+
+                CHECK (!cpp::lang::String::utf32ToUtf8 (badUtf32.data (), badUtf32.length (), outUtf8) && same (outUtf8, prefix8));
+                CHECK (!cpp::lang::String::utf32ToUtf16 (badUtf32.data (), badUtf32.length (), outUtf16)
+                       && outUtf16 == badUtf16.substr (0, prefix16));
+                CHECK (!cpp::lang::String::utf16ToUtf8 (badUtf16.data (), badUtf16.length (), outUtf8) && same (outUtf8, prefix8));
+                CHECK (!cpp::lang::String::utf16ToUtf32 (badUtf16.data (), badUtf16.length (), outUtf32)
+                       && outUtf32 == utf32.substr (0, cut));
+            }
+        }
+    }
+
+    /* The findAny family with a CharSet against std::string::find_first_of and friends, with bytes above 0x7F. */
+    void
+    check_string_find_any ()
+    {
+        unsigned int seed = 38;
+        for (size_t round = 0; round < 20000; ++round)
+        {
+            std::string        text  = make_text (seed, next_random (seed) % 120, "abcdef\x80\xFF");
+            std::string        chars = make_text (seed, next_random (seed) % 5, "abcdefgz\x80\xFF");
+            cpp::lang::String  s (text.c_str (), text.length ());
+            cpp::lang::CharSet set (chars.data (), chars.length ());
+            cpp::lang::String  charString (chars.c_str (), chars.length ());
+            size_t             offset = next_random (seed) % (text.length () + 3);
+
+            CHECK (s.findAny (offset, set) == text.find_first_of (chars, offset));
+            CHECK (s.findAny (offset, charString) == text.find_first_of (chars, offset));
+            CHECK (s.findNotOfAny (offset, set) == text.find_first_not_of (chars, offset));
+            CHECK (s.findLastOfAny (offset, set) == text.find_last_of (chars, offset));
+            CHECK (s.findLastNotOfAny (offset, set) == text.find_last_not_of (chars, offset));
+            CHECK (s.findLastOfAny (charString) == text.find_last_of (chars));
+        }
+    }
+
+    /* Both ends without the characters of chars, as find_first_not_of / find_last_not_of give them. */
+    std::string
+    reference_trim (const std::string& text, const std::string& chars)
+    {
+        size_t first = text.find_first_not_of (chars);
+        return first == std::string::npos ? std::string () : text.substr (first, text.find_last_not_of (chars) + 1 - first);
+    }
+
+    bool
+    same_view (cpp::lang::StringView view, const std::string& expected)
+    {
+        return view.length () == expected.length () && memcmp (view.data (), expected.data (), expected.length ()) == 0;
+    }
+
+    /* trim, startsWith and endsWith against std::string, with long runs to trim so the vector scan is used. */
+    void
+    check_string_trim ()
+    {
+        unsigned int seed = 48;
+        for (size_t round = 0; round < 20000; ++round)
+        {
+            std::string padding = make_text (seed, next_random (seed) % 40, " \t\n\r\v\f");
+            std::string text    = padding.substr (0, next_random (seed) % (padding.length () + 1))
+                               + make_text (seed, next_random (seed) % 40, round % 4 == 0 ? " \tab" : "ab,;\xE9")
+                               + padding.substr (next_random (seed) % (padding.length () + 1));
+            cpp::lang::StringView view (text.data (), text.length ());
+            std::string           chars = make_text (seed, next_random (seed) % 4, " \t,;a\xE9");
+
+            CHECK (same_view (view.trim (), reference_trim (text, " \t\n\r\v\f")));
+            CHECK (same_view (view.trim (cpp::lang::CharSet (chars.data (), chars.length ())), reference_trim (text, chars)));
+            cpp::lang::String s (text.c_str (), text.length ());
+            CHECK (same (s.trim (), reference_trim (text, " ")));
+            CHECK (same (s.trim ((tchar_t)'\t'), reference_trim (text, "\t")));
+
+            std::string prefix = next_random (seed) % 2 == 0 ? text.substr (0, next_random (seed) % (text.length () + 2))
+                                                             : make_text (seed, next_random (seed) % 4, " ab");
+            std::string suffix = next_random (seed) % 2 == 0 ? text.substr (next_random (seed) % (text.length () + 1))
+                                                             : make_text (seed, next_random (seed) % 4, " ab");
+            CHECK (s.startsWith (cpp::lang::StringView (prefix.data (), prefix.length ())) == (text.compare (0, prefix.length (), prefix) == 0));
+            CHECK (s.endsWith (cpp::lang::StringView (suffix.data (), suffix.length ()))
+                   == (text.length () >= suffix.length () && text.compare (text.length () - suffix.length (), suffix.length (), suffix) == 0));
+        }
+    }
+
+    /* count, countAny, countLines and freq against loops, with long dense texts so the per-lane counters fill up. */
+    void
+    check_string_count ()
+    {
+        unsigned int seed = 50;
+        for (size_t round = 0; round < 4000; ++round)
+        {
+            size_t      length = round % 50 == 0 ? 20000 + next_random (seed) % 2000 : next_random (seed) % 300;
+            std::string text   = make_text (seed, length, round % 2 == 0 ? "\n\n\nab\xE9" : "ab\n\xE9");
+            std::string chars  = make_text (seed, next_random (seed) % 3, "a\n\xE9z");
+            size_t      shift  = text.empty () ? 0 : next_random (seed) % (text.length () < 32 ? text.length () : 32);
+            cpp::lang::StringView view (text.data () + shift, text.length () - shift);
+            cpp::lang::CharSet    set (chars.data (), chars.length ());
+
+            size_t expectedChar  = 0;
+            size_t expectedAny   = 0;
+            size_t expectedLines = 0;
+            for (size_t pos = shift; pos < text.length (); ++pos)
+            {
+                expectedChar += text[pos] == '\xE9';
+                expectedAny += chars.find (text[pos]) != std::string::npos;
+                expectedLines += text[pos] == '\n';
+            }
+            expectedLines += shift < text.length () && text[text.length () - 1] != '\n';
+
+            CHECK (view.count ('\xE9') == expectedChar);
+            CHECK (view.countAny (set) == expectedAny);
+            CHECK (view.countLines () == expectedLines);
+            cpp::lang::String s (view.data (), view.length ());
+            CHECK (s.count ('\xE9') == expectedChar && s.freq ('\xE9') == (int)expectedChar);
+        }
+    }
+
+    /* operator<< for integers against snprintf, for floats and doubles: reads back as the same value. */
+    void
+    check_string_numbers ()
+    {
+        unsigned int seed = 43;
+        for (size_t round = 0; round < 20000; ++round)
+        {
+            uint64 bits = 0;
+            for (size_t part = 0; part < 4; ++part)
+            {
+                bits = bits << 16 | next_random (seed);
+            }
+            int64 integer = (int64)(bits >> (next_random (seed) % 64)) * (round % 2 == 0 ? 1 : -1);
+            char  expected[32];
+
+            cpp::lang::String s;
+            s << integer;
+            snprintf (expected, sizeof (expected), "%lld", (long long)integer);
+            CHECK (s == expected);
+            s.clear ();
+            s << (uint64)bits;
+            snprintf (expected, sizeof (expected), "%llu", (unsigned long long)bits);
+            CHECK (s == expected);
+            s.clear ();
+            s << (int)integer << (unsigned int)bits;
+            snprintf (expected, sizeof (expected), "%d%u", (int)integer, (unsigned int)bits);
+            CHECK (s == expected);
+
+            double real;
+            memcpy (&real, &bits, sizeof (real));
+            if (std::isfinite (real))
+            {
+                s.clear ();
+                s << real;
+                CHECK (strtod (s.getCStr (), 0) == real);
+            }
+            float    single;
+            uint32_t singleBits = (uint32_t)bits;
+            memcpy (&single, &singleBits, sizeof (single));
+            if (std::isfinite (single))
+            {
+                s.clear ();
+                s << single;
+                CHECK (strtof (s.getCStr (), 0) == single);
+            }
+        }
+
+        const double values[]   = {0.1, 1e21, 1e-7, 123.0, 1e20, 5e-324, 1.7976931348623157e308, -0.0};
+        const char*  expected[] = {"0.1", "1e+21", "1e-7", "123", "100000000000000000000", "5e-324", "1.7976931348623157e+308", "-0"};
+        for (size_t index = 0; index < sizeof (values) / sizeof (values[0]); ++index)
+        {
+            cpp::lang::String s;
+            s << values[index];
+            CHECK (s == expected[index]);
+        }
+        cpp::lang::String special;
+        special << (double)NAN << ' ' << (double)INFINITY << ' ' << -(double)INFINITY;
+        CHECK (special == "nan inf -inf");
+    }
+
+    /* Left to right, non-overlapping, like std::string::find in a loop. */
+    std::string
+    reference_replace_all (std::string text, const std::string& from, const std::string& to)
+    {
+        for (size_t pos = 0; !from.empty () && (pos = text.find (from, pos)) != std::string::npos; pos += to.length ())
+        {
+            text.replace (pos, from.length (), to);
+        }
+        return text;
+    }
+
+    /* At each position the leftmost match wins, the longest pattern of those starting there. */
+    std::string
+    reference_replace_many (const std::string& text, const std::vector<std::string>& from, const std::vector<std::string>& to,
+                            size_t& replaced)
+    {
+        std::string out;
+        replaced = 0;
+        for (size_t pos = 0; pos < text.length ();)
+        {
+            size_t best = from.size ();
+            for (size_t index = 0; index < from.size (); ++index)
+            {
+                if (!from[index].empty () && text.compare (pos, from[index].length (), from[index]) == 0
+                    && (best == from.size () || from[index].length () > from[best].length ()))
+                {
+                    best = index;
+                }
+            }
+            if (best == from.size ())
+            {
+                out += text[pos++];
+                continue;
+            }
+            out += to[best];
+            pos += from[best].length ();
+            ++replaced;
+        }
+        return out;
+    }
+
+    /* replaceAll (growing, shrinking, with views into the string itself) and StringReplacer against the references. */
+    void
+    check_string_replace ()
+    {
+        unsigned int seed = 49;
+        for (size_t round = 0; round < 20000; ++round)
+        {
+            const bool        singles = round % 4 == 1; // patterns of one character: StringReplacer skips the automaton
+            std::string       text    = make_text (seed, next_random (seed) % 200, singles ? "abcd\xE9" : round % 2 == 0 ? "ab" : "abcd");
+            std::string       from    = make_text (seed, next_random (seed) % 5, "ab");
+            std::string       to      = make_text (seed, next_random (seed) % 9, "xyz");
+            cpp::lang::String s (text.c_str (), text.length ());
+            s.replaceAll (cpp::lang::StringView (from.data (), from.length ()), cpp::lang::StringView (to.data (), to.length ()));
+            CHECK (same (s, reference_replace_all (text, from, to)));
+
+            // from and to inside the string being replaced
+            if (text.length () >= 6)
+            {
+                size_t            at        = next_random (seed) % (text.length () - 5);
+                size_t            fromCount = 1 + next_random (seed) % 2;
+                size_t            toCount   = next_random (seed) % 4;
+                cpp::lang::String t (text.c_str (), text.length ());
+                t.replaceAll (cpp::lang::StringView (t.getCStr () + at, fromCount), cpp::lang::StringView (t.getCStr () + at + 2, toCount));
+                CHECK (same (t, reference_replace_all (text, text.substr (at, fromCount), text.substr (at + 2, toCount))));
+            }
+
+            std::vector<std::string>           patterns;
+            std::vector<std::string>           replacements;
+            std::vector<cpp::lang::StringView> patternViews;
+            std::vector<cpp::lang::StringView> replacementViews;
+            for (size_t count = 1 + next_random (seed) % 6; count != 0; --count)
+            {
+                std::string pattern = singles ? make_text (seed, 1, "abcd\xE9") : make_text (seed, next_random (seed) % 5, "abcd");
+                if (std::find (patterns.begin (), patterns.end (), pattern) == patterns.end ())
+                {
+                    patterns.push_back (pattern);
+                    replacements.push_back (make_text (seed, next_random (seed) % 6, "XYZ"));
+                }
+            }
+            for (size_t index = 0; index < patterns.size (); ++index)
+            {
+                patternViews.push_back (cpp::lang::StringView (patterns[index].data (), patterns[index].length ()));
+                replacementViews.push_back (cpp::lang::StringView (replacements[index].data (), replacements[index].length ()));
+            }
+            cpp::lang::StringReplacer replacer (&patternViews[0], &replacementViews[0], patterns.size ());
+            size_t                    replaced = 0;
+            std::string               expected = reference_replace_many (text, patterns, replacements, replaced);
+            cpp::lang::String         out ("<");
+            CHECK (replacer.replace (cpp::lang::StringView (text.data (), text.length ()), out) == replaced);
+            CHECK (same (out, "<" + expected));
+            CHECK (same (replacer.replace (cpp::lang::StringView (text.data (), text.length ())), expected));
+        }
+    }
+
+    /* The key compareIgnoreCase orders by, as unsigned bytes. */
+    int
+    fold_key (char c)
+    {
+        return tolower (toupper ((unsigned char)c));
+    }
+
+    int
+    sign (int value)
+    {
+        return value < 0 ? -1 : value > 0 ? 1 : 0;
+    }
+
+    /* toUpper / toLower / compareIgnoreCase / hashIgnoreCase against per-character loops, with bytes above 0x7F. */
+    void
+    check_string_case ()
+    {
+        unsigned int seed = 41;
+        for (size_t round = 0; round < 20000; ++round)
+        {
+            std::string text = make_text (seed, next_random (seed) % 80, "aZ@[`{09 \x80\xE9\xFF");
+            std::string upper;
+            std::string lower;
+            for (size_t pos = 0; pos < text.length (); ++pos)
+            {
+                upper += (char)toupper ((unsigned char)text[pos]);
+                lower += (char)tolower ((unsigned char)text[pos]);
+            }
+            cpp::lang::String s (text.c_str (), text.length ());
+            s.toUpper ();
+            CHECK (same (s, upper));
+            s.toLower ();
+            CHECK (same (s, lower));
+
+            // against a copy with some letters flipped, and sometimes a character changed
+            std::string other = text.substr (0, next_random (seed) % (text.length () + 1));
+            for (size_t pos = 0; pos < other.length (); ++pos)
+            {
+                if (next_random (seed) % 2 == 0 && isalpha ((unsigned char)other[pos]))
+                {
+                    other[pos] ^= 0x20;
+                }
+            }
+            if (!other.empty () && next_random (seed) % 4 == 0)
+            {
+                other[next_random (seed) % other.length ()] = "a@\xE9"[next_random (seed) % 3];
+            }
+            int expected = 0;
+            for (size_t pos = 0; pos < text.length () && pos < other.length () && expected == 0; ++pos)
+            {
+                expected = sign (fold_key (text[pos]) - fold_key (other[pos]));
+            }
+            if (expected == 0)
+            {
+                expected = text.length () < other.length () ? -1 : text.length () == other.length () ? 0 : 1;
+            }
+            cpp::lang::String original (text.c_str (), text.length ());
+            cpp::lang::String compared (other.c_str (), other.length ());
+            CHECK (sign (original.compareIgnoreCase (compared)) == expected);
+            CHECK (sign (cpp::lang::StringView (other.data (), other.length ()).compareIgnoreCase (original.view ())) == -expected);
+            if (expected == 0)
+            {
+                CHECK (original.view ().hashIgnoreCase () == compared.view ().hashIgnoreCase ());
+            }
+        }
+
+        // offsets past the end are clamped
+        cpp::lang::String s ("abc");
+        CHECK (s.compareIgnoreCase (10, 2, cpp::lang::String ("ABC"), 10, 2) == 0);
+        CHECK (s.compareIgnoreCase (0, 3, cpp::lang::String ("ABC"), 0, 10) == 0);
+    }
+
+    /* The tokens of std::string::find / find_first_of, the last token runs to the end. */
+    std::vector<std::string>
+    split_expected (const std::string& text, const std::string& separators, bool oneInSeparators)
+    {
+        std::vector<std::string> tokens;
+        size_t                   offset = 0;
+        for (;;)
+        {
+            size_t index = oneInSeparators ? text.find_first_of (separators, offset) : text.find (separators, offset);
+            tokens.push_back (text.substr (offset, index == std::string::npos ? std::string::npos : index - offset));
+            if (index == std::string::npos)
+            {
+                return tokens;
+            }
+            offset = index + (oneInSeparators ? 1 : separators.length ());
+        }
+    }
+
+    /* StringSplitter with the separators passed as temporaries, against split_expected. */
+    void
+    check_string_splitter ()
+    {
+        unsigned int seed = 39;
+        for (size_t round = 0; round < 20000; ++round)
+        {
+            std::string       text = make_text (seed, 1 + next_random (seed) % 40, "ab:;");
+            cpp::lang::String s (text.c_str (), text.length ());
+            bool              oneInSeparators = next_random (seed) % 2 == 0;
+
+            cpp::lang::StringSplitter tokens (s, oneInSeparators ? ":;" : "::", oneInSeparators);
+            std::vector<std::string>  expected = split_expected (text, oneInSeparators ? ":;" : "::", oneInSeparators);
+            size_t                    count    = 0;
+            for (cpp::lang::StringView token; tokens.next (token); ++count)
+            {
+                CHECK (count < expected.size () && token.length () == expected[count].length ()
+                       && memcmp (token.data (), expected[count].data (), token.length ()) == 0);
+            }
+            CHECK (count == expected.size ());
+        }
+    }
+
+    /* Threads interning overlapping keys in different orders: one atom and one hash per key, one count per distinct key. */
+    void
+    check_interned_strings ()
+    {
+        enum
+        {
+            THREADS = 8,
+            KEYS    = 4096 // a power of two, so every odd stride visits every key
+        };
+        std::vector<std::string> keys;
+        for (size_t index = 0; index < KEYS; ++index)
+        {
+            // a few keys too long for the shared blocks take the other allocation path
+            keys.push_back ("check-intern-" + std::to_string (index) + std::string (index % 500 == 0 ? 20000 : index % 40, 'k'));
+        }
+        const size_t before = cpp::lang::InternedString::count ();
+
+        std::vector<std::vector<cpp::lang::InternedString>> seen (THREADS, std::vector<cpp::lang::InternedString> (KEYS));
+        std::vector<std::thread>                            threads;
+        for (size_t thread = 0; thread < THREADS; ++thread)
+        {
+            threads.push_back (std::thread ([&keys, &seen, thread] () {
+                // each thread starts elsewhere and walks its own stride, so first inserts race
+                for (size_t step = 0; step < KEYS; ++step)
+                {
+                    size_t index         = (thread * 997 + step * (2 * thread + 1)) % KEYS;
+                    seen[thread][index] = cpp::lang::InternedString (cpp::lang::StringView (keys[index].data (), keys[index].length ()));
+                }
+            }));
+        }
+        for (size_t thread = 0; thread < THREADS; ++thread)
+        {
+            threads[thread].join ();
+        }
+
+        CHECK (cpp::lang::InternedString::count () == before + KEYS);
+        for (size_t index = 0; index < KEYS; ++index)
+        {
+            cpp::lang::InternedString expected (cpp::lang::StringView (keys[index].data (), keys[index].length ()));
+            bool                      agree = expected.length () == keys[index].length ()
+                             && memcmp (expected.c_str (), keys[index].data (), keys[index].length ()) == 0;
+            for (size_t thread = 0; thread < THREADS; ++thread)
+            {
+                agree = agree && seen[thread][index] == expected && seen[thread][index].hash () == expected.hash ();
+            }
+            CHECK (agree);
+        }
+        CHECK (cpp::lang::InternedString::count () == before + KEYS);
+    }
+
+    /* Pointers print as addresses; a pointer that is not text does not silently become a bool. */
+    static_assert (!std::is_constructible<cpp::lang::FormatArg, int*>::value, "int * must not format as bool");
+    static_assert (!std::is_constructible<cpp::lang::FormatArg, const wchar_t*>::value, "wide text must not format as bool");
+
+    void
+    check_format_pointers ()
+    {
+        int  value = 0;
+        char expected[32];
+        snprintf (expected, sizeof (expected), "[0x%llx]", (unsigned long long)(uintptr_t)&value);
+        CHECK (cpp::lang::String::fmt ("[{}]", (const void*)&value) == expected);
+        CHECK (cpp::lang::String::fmt ("{}", (void*)0) == "0x0");
+        CHECK (cpp::lang::String::fmt ("{}", "text") == "text");
+        CHECK (cpp::lang::String::fmt ("{}", true) == "True");
+    }
+
+    /* The JSON reader's UTF-8 validation and the UTF-8 / wide transcoders, against the reference decoder. */
+    void
+    check_json_utf ()
+    {
+        unsigned int seed = 31;
+        for (size_t round = 0; round < 20000; ++round)
+        {
+            std::string           text = make_utf8 (seed); // ASCII is letters only, nothing to escape
+            std::vector<uint32_t> codePoints;
+            size_t                stop  = reference_decode_utf8 (text, codePoints);
+            bool                  valid = stop == text.length ();
+            std::wstring          wide (codePoints.begin (), codePoints.end ());
+            if (sizeof (wchar_t) == 2)
+            {
+                std::u16string utf16 = reference_utf16 (codePoints);
+                wide.assign (utf16.begin (), utf16.end ());
+            }
+
+            std::string       json = "[\"" + text + "\"]";
+            JSON::Value       v;
+            JSON::ParseResult result = v.parse (json.data (), json.length ());
+            CHECK (valid ? result.ok () && v.a ()[0].s () == text : result.error == JSON::PARSE_INVALID_UTF8);
+            JSON::ValueW w;
+            result = w.parse_utf8 (json.data (), json.length ());
+            CHECK (valid ? result.ok () && w.a ()[0].s () == wide : result.error == JSON::PARSE_INVALID_UTF8);
+
+            std::wstring outWide;
+            CHECK (JSON::utf8_to_wide (text.data (), text.length (), outWide) == stop && outWide == wide);
+            std::string utf8 = reference_utf8 (codePoints);
+            std::string outUtf8;
+            CHECK (JSON::wide_to_utf8 (wide.data (), wide.length (), outUtf8) == wide.length () && outUtf8 == utf8);
+
+            // a lone surrogate stops wide_to_utf8 there
+            size_t cut = wide.empty () ? 0 : next_random (seed) % wide.length ();
+            if (sizeof (wchar_t) == 2 && cut != 0 && wide[cut - 1] >= 0xD800 && wide[cut - 1] <= 0xDBFF)
+            {
+                --cut; // not between the halves of a pair
+            }
+            std::wstring bad = wide.substr (0, cut) + (wchar_t)0xDC00 + L"ab";
+            outUtf8.clear ();
+            CHECK (JSON::wide_to_utf8 (bad.data (), bad.length (), outUtf8) == cut);
+            std::string prefix;
+            JSON::wide_to_utf8 (wide.data (), cut, prefix);
+            CHECK (outUtf8 == prefix && utf8.compare (0, prefix.length (), prefix) == 0);
+        }
+    }
+
+    /* A random document: every type, strings with escapes, controls and non-ASCII, nested up to depth 3. */
+    JSON::Value
+    make_json (unsigned int& seed, size_t depth)
+    {
+        switch (next_random (seed) % (depth < 3 ? 8 : 6))
+        {
+        case 0:
+            return JSON::Value ();
+        case 1:
+            return JSON::Value (next_random (seed) % 2 == 0);
+        case 2:
+            return JSON::Value ((int64_t)(((int64_t)next_random (seed) << 32 | next_random (seed) << 16 | next_random (seed)) - 0x400000000000LL));
+        case 3:
+            // never integral: "%.16g" and JCS write those as integers, which read back as INTEGER
+            return JSON::Value (((int)(next_random (seed) - 0x4000) + 0.5) / (1 + next_random (seed) % 1000) * 1e-3);
+        case 4:
+        case 5:
+        {
+            static const uint32_t special[] = {'"', '\\', '/', 0x01, 0x1F, '\n', '\t', 0x7F, 0xE9, 0x2028, 0x1F600};
+            std::vector<uint32_t> codePoints;
+            for (size_t count = next_random (seed) % 12; count != 0; --count)
+            {
+                codePoints.push_back (next_random (seed) % 3 == 0 ? special[next_random (seed) % (sizeof (special) / sizeof (special[0]))]
+                                                                 : 'a' + next_random (seed) % 26);
+            }
+            return JSON::Value (reference_utf8 (codePoints));
+        }
+        case 6:
+        {
+            JSON::Value array (JSON::ARRAY);
+            for (size_t count = next_random (seed) % 5; count != 0; --count)
+            {
+                array.a ().push_back (make_json (seed, depth + 1));
+            }
+            return array;
+        }
+        default:
+        {
+            JSON::Value object (JSON::OBJECT);
+            for (size_t count = next_random (seed) % 5; count != 0; --count)
+            {
+                object.o ()[make_text (seed, 1 + next_random (seed) % 4, "ab\"\\") + (next_random (seed) % 2 == 0 ? "\xC3\xA9" : "")] =
+                    make_json (seed, depth + 1);
+            }
+            return object;
+        }
+        }
+    }
+
+    /* Every writer option reads back as the same document; canonical floats read back exactly, ASCII output is ASCII. */
+    void
+    check_json_write ()
+    {
+        unsigned int seed = 29;
+        for (size_t round = 0; round < 5000; ++round)
+        {
+            JSON::Value document (JSON::ARRAY);
+            document.a ().push_back (make_json (seed, 0));
+
+            const JSON::WriteOptions options[] = {JSON::WriteOptions (), JSON::WriteOptions (2), JSON::WriteOptions (0, true),
+                                                  JSON::WriteOptions (4, false, JSON::ASCII_ESCAPE)};
+            for (size_t index = 0; index < sizeof (options) / sizeof (options[0]); ++index)
+            {
+                std::string text;
+                document.write (text, options[index]);
+                JSON::Value back;
+                CHECK (back.parse (text.data (), text.length ()).ok () && back == document);
+                if (options[index].ascii == JSON::ASCII_ESCAPE)
+                {
+                    bool ascii = true;
+                    for (size_t pos = 0; pos < text.length (); ++pos)
+                    {
+                        ascii = ascii && (unsigned char)text[pos] < 0x80;
+                    }
+                    CHECK (ascii);
+                }
+            }
+
+            // raw numbers: the same document, and written back unchanged
+            std::string text;
+            document.write (text);
+            JSON::Value raw;
+            CHECK (raw.parse (text.data (), text.length (), JSON::ReadOptions (true)).ok ());
+            std::string rawText;
+            raw.write (rawText);
+            CHECK (rawText == text && raw == document);
+
+            uint64 bits = (uint64)next_random (seed) << 48 | (uint64)next_random (seed) << 32 | next_random (seed) << 16 | next_random (seed);
+            double real;
+            memcpy (&real, &bits, sizeof (real));
+            if (std::isfinite (real))
+            {
+                JSON::Value number (JSON::ARRAY);
+                number.a ().push_back (JSON::Value (real));
+                std::string canonical;
+                number.write (canonical, JSON::WriteOptions (0, true));
+                CHECK (number.parse (canonical.data (), canonical.length ()).ok ());
+                const JSON::Value& back = number.a ()[0];
+                CHECK (back.type () == JSON::INTEGER ? (double)back.i () == real : back.f () == real);
+            }
+        }
+    }
+
+    /* Every object member of v is found in its frozen copy, a key it does not have is not. */
+    bool
+    frozen_finds (const JSON::Value& v, JSON::FrozenValue frozen)
+    {
+        bool found = true;
+        if (v.type () == JSON::ARRAY)
+        {
+            for (size_t pos = 0; pos < v.a ().size (); ++pos)
+            {
+                found = found && frozen_finds (v.a ()[pos], frozen[pos]);
+            }
+        }
+        else if (v.type () == JSON::OBJECT)
+        {
+            for (JSON::Object::const_iterator it = v.o ().begin (); it != v.o ().end (); ++it)
+            {
+                JSON::FrozenValue member = frozen.find (it->first);
+                found = found && member.valid () && frozen_finds (it->second, member);
+            }
+            found = found && !frozen.find (std::string ("missing")).valid () && !frozen.find ("", 0).valid ();
+        }
+        return found;
+    }
+
+    /* freeze () on the check_json_write documents: thaws back equal, writes the same text, finds every key. */
+    void
+    check_json_freeze ()
+    {
+        unsigned int seed = 26;
+        for (size_t round = 0; round < 5000; ++round)
+        {
+            JSON::Value document (JSON::ARRAY);
+            document.a ().push_back (make_json (seed, 0));
+            JSON::Frozen frozen = document.freeze ();
+            std::string  text;
+            std::string  frozenText;
+            document.write (text);
+            frozen.root ().write (frozenText);
+            CHECK (frozen.root ().thaw () == document && frozenText == text && frozen_finds (document, frozen.root ()));
+
+            // numbers read raw freeze to the same values
+            JSON::Value raw;
+            CHECK (raw.parse (text.data (), text.length (), JSON::ReadOptions (true)).ok () && raw.freeze ().root ().thaw () == document);
+        }
+
+        // null, and empty containers
+        const JSON::Value empties[] = {JSON::Value (), JSON::Value (JSON::ARRAY), JSON::Value (JSON::OBJECT)};
+        for (size_t index = 0; index < sizeof (empties) / sizeof (empties[0]); ++index)
+        {
+            JSON::Frozen frozen = empties[index].freeze ();
+            std::string  text;
+            std::string  frozenText;
+            empties[index].write (text);
+            frozen.root ().write (frozenText);
+            CHECK (frozen.root ().type () == empties[index].type () && frozen.root ().thaw () == empties[index] && frozenText == text);
+        }
+        CHECK (JSON::Frozen ().root ().type () == JSON::NIL && !JSON::Value (JSON::OBJECT).freeze ().root ().find ("a", 1).valid ());
+    }
+
+    /* ValueW escapes non-ASCII by default as it always has, Value writes UTF-8 as is; both opt in or out explicitly. */
+    void
+    check_json_write_ascii ()
+    {
+        JSON::ValueW wide (JSON::ARRAY);
+        wide.a ().push_back (JSON::ValueW (L"\u00e9\u4e2d/"));
+        wide.a ().push_back (JSON::ValueW (std::wstring (1, (wchar_t)0x7F) + (wchar_t)0x80));
+        std::wstring out;
+        wide.write (out);
+        CHECK (out == L"[\"\\u00e9\\u4e2d\\/\",\"\x7f\\u0080\"]");
+        out.clear ();
+        wide.write (out, JSON::WriteOptions (0, false, JSON::ASCII_RAW));
+        CHECK (out == L"[\"\u00e9\u4e2d\\/\",\"\x7f\x80\"]");
+        out.clear ();
+        wide.write (out, JSON::WriteOptions (0, true));
+        CHECK (out == L"[\"\u00e9\u4e2d/\",\"\x7f\x80\"]");
+
+        JSON::Value narrow (JSON::ARRAY);
+        narrow.a ().push_back (JSON::Value ("\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80"));
+        std::string text;
+        narrow.write (text);
+        CHECK (text == "[\"\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80\"]");
+        text.clear ();
+        narrow.write (text, JSON::WriteOptions (0, false, JSON::ASCII_ESCAPE));
+        CHECK (text == "[\"\\u00e9\\u4e2d\\ud83d\\ude00\"]");
+    }
+
+    /* Numbers out of the double range have no JSON form, the reader rejects them. */
+    void
+    check_json_numbers ()
+    {
+        const char* invalid[] = {"[1e400]", "[-1e400]", "[1.5e999]", "[123456789e305]"};
+        for (size_t index = 0; index < sizeof (invalid) / sizeof (invalid[0]); ++index)
+        {
+            JSON::Value v;
+            CHECK (v.parse (invalid[index], strlen (invalid[index])).error == JSON::PARSE_INVALID_NUMBER);
+        }
+
+        const char* valid[] = {"[1e308]", "[-1.7976931348623157e308]", "[1e-400]", "[0.0]"};
+        for (size_t index = 0; index < sizeof (valid) / sizeof (valid[0]); ++index)
+        {
+            JSON::Value v;
+            CHECK (v.parse (valid[index], strlen (valid[index])).ok () && std::isfinite (v.a ()[0].f ()));
+        }
+
+        // raw number text of every length is written back as read, from char and wchar_t text, and converts like an eager read
+        unsigned int seed = 34;
+        for (size_t round = 0; round < 2000; ++round)
+        {
+            std::string number = (next_random (seed) % 2 ? "-" : "") + make_text (seed, 1, "123456789")
+                                 + make_text (seed, next_random (seed) % 20, "0123456789");
+            if (next_random (seed) % 2)
+            {
+                number += "." + make_text (seed, 1 + next_random (seed) % 20, "0123456789");
+            }
+            if (next_random (seed) % 2)
+            {
+                number += make_text (seed, 1, "eE") + make_text (seed, next_random (seed) % 2, "+-") + make_text (seed, 1, "123");
+            }
+            std::string  text = "[" + number + "]";
+            std::wstring wideText (text.begin (), text.end ());
+
+            JSON::Value  raw;
+            JSON::Value  eager;
+            JSON::ValueW rawWide;
+            CHECK (raw.parse (text.data (), text.length (), JSON::ReadOptions (true)).ok ()
+                   && rawWide.parse (wideText.data (), wideText.length (), JSON::ReadOptions (true)).ok ()
+                   && eager.parse (text.data (), text.length ()).ok ());
+            std::string  out;
+            std::wstring outWide;
+            raw.write (out);
+            rawWide.write (outWide);
+            CHECK (out == text && outWide == wideText && raw == eager);
+        }
+
+        // int64_t limits stay integers, one past them reads as a float in both modes
+        const char* integers[] = {"[9223372036854775807]", "[-9223372036854775808]", "[9223372036854775808]",
+                                  "[-9223372036854775809]", "[100000000000000000000]"};
+        for (size_t index = 0; index < sizeof (integers) / sizeof (integers[0]); ++index)
+        {
+            const double expected = strtod (integers[index] + 1, 0);
+            for (int raw = 0; raw < 2; ++raw)
+            {
+                JSON::Value v;
+                CHECK (v.parse (integers[index], strlen (integers[index]), JSON::ReadOptions (raw != 0)).ok ());
+                const JSON::Value& number = v.a ()[0];
+                CHECK (index < 2 ? number.type () == JSON::INTEGER && (double)number.i () == expected
+                                 : number.type () == JSON::FLOAT && number.f () == expected);
+            }
+        }
+    }
+
+    /* A stateless allocator that is not std::allocator, so ValueT<char, CheckAllocator<char>> is another type. */
+    template<class T>
+    struct CheckAllocator
+    {
+        typedef T value_type;
+
+        CheckAllocator ()
+        {
+        }
+
+        template<class U>
+        CheckAllocator (const CheckAllocator<U>&)
+        {
+        }
+
+        T*
+        allocate (size_t n)
+        {
+            return static_cast<T*> (malloc (n * sizeof (T)));
+        }
+
+        void
+        deallocate (T* p, size_t)
+        {
+            free (p);
+        }
+    };
+
+    template<class T, class U>
+    bool
+    operator== (const CheckAllocator<T>&, const CheckAllocator<U>&)
+    {
+        return true;
+    }
+
+    template<class T, class U>
+    bool
+    operator!= (const CheckAllocator<T>&, const CheckAllocator<U>&)
+    {
+        return false;
+    }
+
+    typedef JSON::ValueT<char, CheckAllocator<char>> CheckValue;
+
+    struct Bound
+    {
+        int                      id;
+        JSON::Value              extra;
+        std::vector<JSON::Value> list;
+    };
+    JSON_BIND (Bound, id, extra, list)
+
+    struct BoundOther
+    {
+        int        id;
+        CheckValue extra;
+    };
+    JSON_BIND (BoundOther, id, extra)
+
+    /* from_value / to_json with JSON::Value members and values of another allocator, both ways. */
+    void
+    check_bind_allocators ()
+    {
+        const char  text[]   = "{\"extra\":{\"a\":[1,2.5,\"x\",true,null]},\"id\":7,\"list\":[{\"b\":\"y\"},3]}";
+        std::string expected = "{\"a\":[1,2.5,\"x\",true,null]}";
+
+        CheckValue other;
+        other.read (text, sizeof (text) - 1);
+        Bound bound;
+        JSON::from_value (bound, other);
+        std::string out;
+        bound.extra.write (out);
+        CHECK (bound.id == 7 && out == expected);
+        CHECK (bound.list.size () == 2 && bound.list[0]["b"].s () == "y" && bound.list[1].i () == 3);
+
+        JSON::Value value;
+        value.read (text, sizeof (text) - 1);
+        BoundOther boundOther;
+        JSON::from_value (boundOther, value);
+        out.clear ();
+        JSON::to_json (boundOther, out);
+        CHECK (boundOther.id == 7 && out == "{\"id\":7,\"extra\":" + expected + "}");
+    }
+
+    struct BoundLeaf
+    {
+        std::string name;
+        double      weight;
+    };
+    JSON_BIND (BoundLeaf, name, weight)
+
+    struct BoundRecord
+    {
+        int                           id;
+        int64_t                       created;
+        double                        score;
+        bool                          active;
+        std::string                   title;
+        std::vector<int>              tags;
+        std::map<std::string, double> ratios;
+        std::vector<BoundLeaf>        leaves;
+        BoundLeaf                     owner;
+        JSON::Value                   extra;
+    };
+    JSON_BIND (BoundRecord, id, created, score, active, title, tags, ratios, leaves, owner, extra)
+
+    /* The most fields JSON_BIND takes, with names that share lengths and prefixes. */
+    struct BoundWide
+    {
+        int a, b, c, d, e, f, g, h, aa, ab, ac, ad, ae, af, ag, ah, ba, bb, bc, bd, be, bf, bg, bh, abc, abd, abe, abf,
+            abg, abh, abca, abcb;
+    };
+    JSON_BIND (BoundWide, a, b, c, d, e, f, g, h, aa, ab, ac, ad, ae, af, ag, ah, ba, bb, bc, bd, be, bf, bg, bh, abc,
+               abd, abe, abf, abg, abh, abca, abcb)
+
+    std::string
+    make_utf8_text (unsigned int& seed)
+    {
+        static const uint32_t special[] = {'"', '\\', '/', 0x01, '\n', 0xE9, 0x4E2D, 0x1F600};
+        std::vector<uint32_t> codePoints;
+        for (size_t count = next_random (seed) % 10; count != 0; --count)
+        {
+            codePoints.push_back (next_random (seed) % 3 == 0 ? special[next_random (seed) % (sizeof (special) / sizeof (special[0]))]
+                                                             : 'a' + next_random (seed) % 26);
+        }
+        return reference_utf8 (codePoints);
+    }
+
+    BoundRecord
+    make_record (unsigned int& seed)
+    {
+        BoundRecord r;
+        r.id      = (int)next_random (seed) - 0x4000;
+        r.created = (int64_t)next_random (seed) << 32 | next_random (seed);
+        r.score   = ((int)next_random (seed) - 0x4000) / 8.0; // exact in binary, so written and read back exactly
+        r.active  = next_random (seed) % 2 == 0;
+        r.title   = make_utf8_text (seed);
+        for (size_t count = next_random (seed) % 4; count != 0; --count)
+        {
+            r.tags.push_back ((int)next_random (seed));
+            r.ratios[make_utf8_text (seed)] = next_random (seed) / 4.0;
+            BoundLeaf leaf = { make_utf8_text (seed), next_random (seed) / 2.0 };
+            r.leaves.push_back (leaf);
+        }
+        r.owner.name   = make_utf8_text (seed);
+        r.owner.weight = next_random (seed) / 16.0;
+        r.extra        = make_json (seed, 1);
+        return r;
+    }
+
+    bool
+    same_record (const BoundRecord& lhs, const BoundRecord& rhs)
+    {
+        bool leaves = lhs.leaves.size () == rhs.leaves.size ();
+        for (size_t pos = 0; leaves && pos < lhs.leaves.size (); ++pos)
+        {
+            leaves = lhs.leaves[pos].name == rhs.leaves[pos].name && lhs.leaves[pos].weight == rhs.leaves[pos].weight;
+        }
+        return leaves && lhs.id == rhs.id && lhs.created == rhs.created && lhs.score == rhs.score && lhs.active == rhs.active
+               && lhs.title == rhs.title && lhs.tags == rhs.tags && lhs.ratios == rhs.ratios && lhs.owner.name == rhs.owner.name
+               && lhs.owner.weight == rhs.owner.weight && lhs.extra == rhs.extra;
+    }
+
+    /* to_json then from_json gives the struct back, with keys reordered and unknown keys mixed in; missing keys leave fields as they were. */
+    void
+    check_bind_round_trip ()
+    {
+        unsigned int seed = 27;
+        for (size_t round = 0; round < 5000; ++round)
+        {
+            const BoundRecord record = make_record (seed);
+            std::string       text;
+            JSON::to_json (record, text);
+
+            BoundRecord back;
+            CHECK (JSON::from_json (back, text.data (), text.length ()) == text.length () && same_record (back, record));
+            std::string again;
+            JSON::to_json (back, again);
+            CHECK (again == text);
+
+            // through a Value: keys come back in sorted order, with unknown members next to the bound ones
+            JSON::Value v;
+            v.read (text.data (), text.length ());
+            v.o ()["ida"]    = make_json (seed, 1);
+            v.o ()["zz"]     = make_json (seed, 1);
+            v.o ()[""]       = JSON::Value (1);
+            v.o ()["ownerX"] = JSON::Value (JSON::OBJECT);
+            std::string mixed;
+            v.write (mixed);
+            BoundRecord fromMixed;
+            JSON::from_json (fromMixed, mixed.data (), mixed.length ());
+            BoundRecord fromValue;
+            JSON::from_value (fromValue, v);
+            CHECK (same_record (fromMixed, record) && same_record (fromValue, record));
+
+            const char  missing[] = "{\"unknown\":[1,{\"id\":2}],\"id\":null}";
+            BoundRecord unchanged = record;
+            CHECK (JSON::from_json (unchanged, missing, sizeof (missing) - 1) == sizeof (missing) - 1);
+            CHECK (same_record (unchanged, record));
+        }
+
+        // every field of the widest struct, from narrow and wide text
+        BoundWide wide;
+        int*      fields = &wide.a;
+        for (size_t pos = 0; pos < sizeof (wide) / sizeof (int); ++pos)
+        {
+            fields[pos] = (int)(pos * 7 + 1);
+        }
+        std::string text;
+        JSON::to_json (wide, text);
+        std::wstring wideText;
+        JSON::to_json (wide, wideText);
+        BoundWide back;
+        BoundWide backWide;
+        memset (&back, 0, sizeof (back));
+        memset (&backWide, 0, sizeof (backWide));
+        JSON::from_json (back, text.data (), text.length ());
+        JSON::from_json (backWide, wideText.data (), wideText.length ());
+        CHECK (memcmp (&back, &wide, sizeof (wide)) == 0 && memcmp (&backWide, &wide, sizeof (wide)) == 0);
+    }
+
+    /* Schema patterns against std::regex_search on short inputs, and a long input std::regex overflows the stack on. */
+    void
+    check_schema_patterns ()
+    {
+        const char* patterns[] = {"^(a|b)*$", "a{2,3}", "^\\d+$", "[^a-c]x", "\\bab\\b", "(?:ab|c)+a", "^$",
+                                  "x?", "[\\w-]+b", "a.c", "(a*)*b", "^a{2,}$", "ab??c", "[]a",
+                                  "\\Bb", "c$|^a", "(ab)\\s", "[\\S]{3}", "a+?b*?$", "[-a]b", "\\x61\\u0062"};
+        unsigned int seed = 28;
+        for (size_t index = 0; index < sizeof (patterns) / sizeof (patterns[0]); ++index)
+        {
+            JSON::detail::PatternT<char> pattern (patterns[index]);
+            std::regex                   expected (patterns[index], std::regex_constants::ECMAScript);
+            for (size_t round = 0; round < 2000; ++round)
+            {
+                std::string text = make_text (seed, next_random (seed) % 12, "abcx1- ");
+                CHECK (pattern.search (text.data (), text.length ()) == std::regex_search (text, expected));
+            }
+        }
+
+        // std::regex_search recurses per character here
+        JSON::Value schema;
+        const char  json[] = "{\"pattern\":\"^(a|b)*$\"}";
+        CHECK (schema.parse (json, sizeof (json) - 1).ok ());
+        JSON::Schema compiled (schema);
+        std::string  text = "[\"" + std::string (100000, 'a') + "\"]";
+        JSON::Value  value;
+        CHECK (value.parse (text.data (), text.length ()).ok ());
+        CHECK (compiled.validate (value.a ()[0]));
+        value.a ()[0] = JSON::Value (std::string (100000, 'a') + "c");
+        CHECK (!compiled.validate (value.a ()[0]));
+
+        CHECK (JSON::detail::PatternT<char> ("(?<name>ab)c").search ("xabc", 4)); // std::regex has no named groups
+
+        const char* unsupported[] = {"(a", "a)", "*a", "\\1", "(?=a)", "a{3,2}", "[a", "a{20000}", "\\p{L}"};
+        for (size_t index = 0; index < sizeof (unsupported) / sizeof (unsupported[0]); ++index)
+        {
+            bool thrown = false;
+            try
+            {
+                JSON::detail::PatternT<char> pattern (unsupported[index]);
+            }
+            catch (const std::exception&)
+            {
+                thrown = true;
+            }
+            CHECK (thrown);
+        }
+    }
+
+    /* A random instance over the names and ranges the check_schema_validators schemas constrain. */
+    JSON::Value
+    make_instance (unsigned int& seed, size_t depth)
+    {
+        switch (next_random (seed) % (depth < 2 ? 8 : 6))
+        {
+        case 0:
+            return JSON::Value ();
+        case 1:
+            return JSON::Value (next_random (seed) % 2 == 0);
+        case 2:
+            return JSON::Value ((int)(next_random (seed) % 21) - 5);
+        case 3:
+            return JSON::Value (((int)(next_random (seed) % 41) - 10) / 4.0);
+        case 4:
+        case 5:
+            return JSON::Value (make_text (seed, next_random (seed) % 6, "ab"));
+        case 6:
+        {
+            JSON::Value array (JSON::ARRAY);
+            for (size_t count = next_random (seed) % 5; count != 0; --count)
+            {
+                array.a ().push_back (make_instance (seed, depth + 1));
+            }
+            return array;
+        }
+        default:
+        {
+            static const char* const keys[] = {"a", "b", "c", "d"};
+            JSON::Value              object (JSON::OBJECT);
+            for (size_t count = next_random (seed) % 5; count != 0; --count)
+            {
+                object.o ()[keys[next_random (seed) % 4]] = make_instance (seed, depth + 1);
+            }
+            return object;
+        }
+        }
+    }
+
+    /* The streaming validator gives the DOM validator's verdict on every keyword, over the same random instances. */
+    void
+    check_schema_validators ()
+    {
+        const char* schemas[] = {
+            "{}",
+            "{\"type\":\"object\",\"required\":[\"a\",\"b\"]}",
+            "{\"type\":\"object\",\"properties\":{\"a\":{\"type\":\"integer\",\"minimum\":0,\"maximum\":10},"
+            "\"b\":{\"type\":\"string\",\"minLength\":1,\"maxLength\":3}},\"additionalProperties\":false}",
+            "{\"type\":\"array\",\"items\":{\"type\":[\"integer\",\"null\"]},\"minItems\":1,\"maxItems\":3}",
+            "{\"enum\":[1,\"a\",null,[1,2],{\"a\":1},[],{}]}",
+            "{\"type\":\"number\",\"exclusiveMinimum\":0,\"exclusiveMaximum\":2.5}",
+            "{\"type\":\"integer\"}",
+            "{\"properties\":{\"a\":{\"properties\":{\"b\":{\"type\":\"boolean\"}},\"required\":[\"b\"]}},"
+            "\"additionalProperties\":{\"type\":\"array\",\"maxItems\":2}}",
+            "{\"type\":\"string\",\"pattern\":\"^a+b?$\"}",
+            "{\"items\":{\"type\":\"object\",\"required\":[\"c\"],\"properties\":{\"c\":{\"enum\":[0,1,2]}}}}",
+            "{\"type\":[\"object\",\"array\"],\"maxItems\":2,\"required\":[\"d\"],\"minItems\":1}",
+            "{\"additionalProperties\":false,\"minItems\":2,\"minimum\":1,\"maxLength\":2}",
+            "{\"properties\":{\"a\":{\"items\":{\"enum\":[true,\"ab\",{\"b\":null}]}}},\"required\":[\"a\"]}",
+            "{\"type\":\"array\",\"items\":{\"type\":\"array\",\"items\":{\"type\":\"number\",\"maximum\":1}}}"};
+        unsigned int seed = 28;
+        for (size_t index = 0; index < sizeof (schemas) / sizeof (schemas[0]); ++index)
+        {
+            JSON::Value definition;
+            definition.read (schemas[index], strlen (schemas[index]));
+            JSON::Schema schema (definition);
+            size_t       accepted = 0;
+            for (size_t round = 0; round < 5000; ++round)
+            {
+                JSON::Value instance = make_instance (seed, 0);
+                std::string text;
+                instance.write (text);
+                bool dom = schema.validate (instance);
+                CHECK (schema.validate (text.data (), text.length ()) == dom);
+                accepted += dom ? 1 : 0;
+            }
+            // neither verdict is constant, except for the empty schema
+            CHECK (accepted > 0 && (accepted < 5000 || index == 0));
+        }
+
+        // enum compares numbers by value: 1.0 is written as 1 and both validators accept it
+        const char  definition[] = "{\"enum\":[1,{\"a\":[2]}]}";
+        JSON::Value parsed;
+        parsed.read (definition, sizeof (definition) - 1);
+        JSON::Schema schema (parsed);
+        JSON::Value  nested (JSON::OBJECT);
+        nested.o ()["a"] = JSON::Value (JSON::ARRAY);
+        nested.o ()["a"].a ().push_back (JSON::Value (2.0));
+        CHECK (schema.validate (JSON::Value (1.0)) && schema.validate (nested) && !schema.validate (JSON::Value (1.5)));
+    }
+} // namespace
+
+int main ()
+{
+    check_string_edits ();
+    check_string_search ();
+    check_string_find_any ();
+    check_string_trim ();
+    check_string_count ();
+    check_string_numbers ();
+    check_string_replace ();
+    check_string_case ();
+    check_string_splitter ();
+    check_interned_strings ();
+    check_string_utf ();
+    check_format_pointers ();
+    check_json_utf ();
+    check_json_write ();
+    check_json_write_ascii ();
+    check_json_freeze ();
+    check_json_numbers ();
+    check_bind_allocators ();
+    check_bind_round_trip ();
+    check_schema_patterns ();
+    check_schema_validators ();
+
+    printf ("%u checks, %u failed\n", (unsigned)g_checks, (unsigned)g_failures);
+    return g_failures == 0 ? 0 : 1;
+}